@@ -0,0 +1,375 @@
+#include "fw-ota.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <sys/param.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_ota_ops.h"
+#include "mbedtls/sha256.h"
+#include "mbedtls/pk.h"
+
+static const char *TAG = "fw_ota";
+
+/* Public half of the key versioning.py signs the manifests with */
+extern const uint8_t signing_key_pem_start[] asm("_binary_signing_key_pub_pem_start");
+extern const uint8_t signing_key_pem_end[] asm("_binary_signing_key_pub_pem_end");
+
+static int hex_nibble(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static bool hex_to_bytes(const char *hex, uint8_t *out, size_t max_len, size_t *len)
+{
+    size_t hex_len = strlen(hex);
+    if (hex_len == 0 || hex_len % 2 || hex_len / 2 > max_len) {
+        return false;
+    }
+    for (size_t i = 0; i < hex_len / 2; i++) {
+        int hi = hex_nibble(hex[2 * i]);
+        int lo = hex_nibble(hex[2 * i + 1]);
+        if (hi < 0 || lo < 0) {
+            return false;
+        }
+        out[i] = (hi << 4) | lo;
+    }
+    *len = hex_len / 2;
+    return true;
+}
+
+static bool hex_to_digest(const char *hex, uint8_t digest[32])
+{
+    size_t len;
+    return hex_to_bytes(hex, digest, 32, &len) && len == 32;
+}
+
+static bool parse_manifest_line(fw_manifest_t *manifest, const char *line, size_t *chunk_index)
+{
+    if (strncmp(line, "build=", 6) == 0) {
+        manifest->build = atoi(line + 6);
+    } else if (strncmp(line, "size=", 5) == 0) {
+        manifest->size = strtoul(line + 5, NULL, 10);
+    } else if (strncmp(line, "chunk=", 6) == 0) {
+        manifest->chunk_size = strtoul(line + 6, NULL, 10);
+    } else if (strncmp(line, "root=", 5) == 0) {
+        return hex_to_digest(line + 5, manifest->root);
+    } else if (strncmp(line, "sig=", 4) == 0) {
+        return hex_to_bytes(line + 4, manifest->signature, sizeof(manifest->signature),
+                            &manifest->signature_len);
+    } else if (strncmp(line, "chunks=", 7) == 0) {
+        manifest->chunk_count = strtoul(line + 7, NULL, 10);
+        if (manifest->chunk_count == 0 || manifest->chunk_count > FW_OTA_MAX_CHUNKS || manifest->chunk_sha256) {
+            return false;
+        }
+        manifest->chunk_sha256 = calloc(manifest->chunk_count, sizeof(manifest->chunk_sha256[0]));
+        return manifest->chunk_sha256 != NULL;
+    } else if (line[0] != '\0') {
+        if (!manifest->chunk_sha256 || *chunk_index >= manifest->chunk_count) {
+            return false;
+        }
+        return hex_to_digest(line, manifest->chunk_sha256[(*chunk_index)++]);
+    }
+    return true;
+}
+
+void fw_manifest_free(fw_manifest_t *manifest)
+{
+    free(manifest->chunk_sha256);
+    manifest->chunk_sha256 = NULL;
+}
+
+/* The image is authentic if every chunk matches a digest table that is:
+ * hash the table into the root and check the signature over the manifest
+ * header, which is the exact text versioning.py signed */
+static esp_err_t verify_signature(const fw_manifest_t *manifest)
+{
+    uint8_t root[32];
+    mbedtls_sha256((const uint8_t *)manifest->chunk_sha256, manifest->chunk_count * sizeof(manifest->chunk_sha256[0]),
+                   root, 0);
+    if (memcmp(root, manifest->root, sizeof(root)) != 0) {
+        ESP_LOGE(TAG, "Chunk digests do not match the manifest root");
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    char header[128];
+    int len = snprintf(header, sizeof(header), "build=%d\nsize=%u\nchunk=%u\nroot=",
+                       manifest->build, (unsigned)manifest->size, (unsigned)manifest->chunk_size);
+    for (size_t i = 0; i < sizeof(root); i++) {
+        len += snprintf(header + len, sizeof(header) - len, "%02x", root[i]);
+    }
+    len += snprintf(header + len, sizeof(header) - len, "\n");
+    uint8_t header_hash[32];
+    mbedtls_sha256((const uint8_t *)header, len, header_hash, 0);
+
+    mbedtls_pk_context pk;
+    mbedtls_pk_init(&pk);
+    int ret = mbedtls_pk_parse_public_key(&pk, signing_key_pem_start, signing_key_pem_end - signing_key_pem_start);
+    if (ret == 0) {
+        ret = mbedtls_pk_verify(&pk, MBEDTLS_MD_SHA256, header_hash, sizeof(header_hash),
+                                manifest->signature, manifest->signature_len);
+    }
+    mbedtls_pk_free(&pk);
+    if (ret != 0) {
+        ESP_LOGE(TAG, "Manifest signature rejected (-0x%04x)", -ret);
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+esp_err_t fw_manifest_fetch(const esp_http_client_config_t *config, fw_manifest_t *manifest)
+{
+    memset(manifest, 0, sizeof(*manifest));
+
+    esp_http_client_handle_t client = esp_http_client_init(config);
+    if (client == NULL) {
+        return ESP_FAIL;
+    }
+
+    esp_err_t err = esp_http_client_open(client, 0);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open manifest connection: %s", esp_err_to_name(err));
+        esp_http_client_cleanup(client);
+        return err;
+    }
+    esp_http_client_fetch_headers(client);
+    if (esp_http_client_get_status_code(client) != 200) {
+        ESP_LOGE(TAG, "Manifest request failed, status %d", esp_http_client_get_status_code(client));
+        esp_http_client_cleanup(client);
+        return ESP_FAIL;
+    }
+
+    /* The manifest is parsed line by line as it arrives, so its size only
+     * costs the chunk digest table and not a copy of the text */
+    char buffer[128];
+    char line[160];
+    size_t line_len = 0;
+    size_t chunk_index = 0;
+    bool valid = true;
+    int len;
+    while (valid && (len = esp_http_client_read(client, buffer, sizeof(buffer))) > 0) {
+        for (int i = 0; i < len && valid; i++) {
+            if (buffer[i] == '\n') {
+                line[line_len] = '\0';
+                valid = parse_manifest_line(manifest, line, &chunk_index);
+                line_len = 0;
+            } else if (buffer[i] != '\r') {
+                if (line_len == sizeof(line) - 1) {
+                    valid = false;
+                } else {
+                    line[line_len++] = buffer[i];
+                }
+            }
+        }
+    }
+    if (valid && line_len) {
+        line[line_len] = '\0';
+        valid = parse_manifest_line(manifest, line, &chunk_index);
+    }
+    esp_http_client_cleanup(client);
+
+    if (!valid || manifest->size == 0 || manifest->chunk_size == 0 ||
+        manifest->chunk_size > FW_OTA_MAX_CHUNK_SIZE ||
+        manifest->chunk_count != (manifest->size + manifest->chunk_size - 1) / manifest->chunk_size ||
+        chunk_index != manifest->chunk_count || manifest->signature_len == 0) {
+        ESP_LOGE(TAG, "Malformed manifest");
+        fw_manifest_free(manifest);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    /* Before anything is erased or written, a forged manifest must not get
+     * as far as esp_ota_begin */
+    int64_t start = esp_timer_get_time();
+    err = verify_signature(manifest);
+    if (err != ESP_OK) {
+        fw_manifest_free(manifest);
+        return err;
+    }
+
+    ESP_LOGI(TAG, "Manifest: build %d, %u bytes in %u chunks of %u, signature checked in %" PRId64 " ms",
+             manifest->build, (unsigned)manifest->size, (unsigned)manifest->chunk_count,
+             (unsigned)manifest->chunk_size, (esp_timer_get_time() - start) / 1000);
+    return ESP_OK;
+}
+
+static esp_err_t fetch_range(esp_http_client_handle_t client, size_t offset, size_t len, uint8_t *buffer)
+{
+    char range[40];
+    snprintf(range, sizeof(range), "bytes=%u-%u", (unsigned)offset, (unsigned)(offset + len - 1));
+    esp_http_client_set_header(client, "Range", range);
+
+    /* With keep-alive the connection from the previous chunk is reused */
+    esp_err_t err = esp_http_client_open(client, 0);
+    if (err != ESP_OK) {
+        return err;
+    }
+    esp_http_client_fetch_headers(client);
+    int status = esp_http_client_get_status_code(client);
+    if (status != 206) {
+        ESP_LOGE(TAG, "Range %s answered with status %d", range, status);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    size_t received = 0;
+    while (received < len) {
+        int ret = esp_http_client_read(client, (char *)buffer + received, len - received);
+        if (ret <= 0) {
+            break;
+        }
+        received += ret;
+    }
+    if (received != len) {
+        ESP_LOGE(TAG, "Range %s truncated at %u bytes", range, (unsigned)received);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return ESP_OK;
+}
+
+/* Where the download time goes, logged once the image is installed */
+typedef struct {
+    int64_t fetch_us;
+    int64_t hash_us;
+    int64_t write_us;
+    int64_t validate_us;
+} fw_ota_timing_t;
+
+static esp_err_t fetch_verified_chunk(esp_http_client_handle_t client, const fw_manifest_t *manifest,
+                                      size_t index, uint8_t *buffer, fw_ota_timing_t *timing)
+{
+    size_t offset = index * manifest->chunk_size;
+    size_t len = MIN(manifest->chunk_size, manifest->size - offset);
+    esp_err_t err = ESP_FAIL;
+
+    for (int attempt = 0; attempt <= FW_OTA_CHUNK_RETRIES; attempt++) {
+        int64_t start = esp_timer_get_time();
+        err = fetch_range(client, offset, len, buffer);
+        timing->fetch_us += esp_timer_get_time() - start;
+        if (err == ESP_OK) {
+            /* A one-shot digest keeps the SHA peripheral to a single context
+             * at a time, a second context running in parallel would make
+             * mbedtls fall back to the software implementation */
+            uint8_t digest[32];
+            start = esp_timer_get_time();
+            mbedtls_sha256(buffer, len, digest, 0);
+            timing->hash_us += esp_timer_get_time() - start;
+            if (memcmp(digest, manifest->chunk_sha256[index], sizeof(digest)) == 0) {
+                return ESP_OK;
+            }
+            ESP_LOGW(TAG, "Chunk %u failed verification", (unsigned)index);
+            err = ESP_ERR_INVALID_CRC;
+        }
+        /* Drop the connection, it may be the one corrupting the data */
+        esp_http_client_close(client);
+        if (attempt < FW_OTA_CHUNK_RETRIES) {
+            ESP_LOGW(TAG, "Retrying chunk %u (%d/%d)", (unsigned)index, attempt + 1, FW_OTA_CHUNK_RETRIES);
+        }
+    }
+    return err;
+}
+
+static void log_timing(const fw_manifest_t *manifest, const fw_ota_timing_t *timing, int64_t total_us)
+{
+    ESP_LOGI(TAG, "OTA of %u bytes took %" PRId64 " ms (%u KiB/s)", (unsigned)manifest->size, total_us / 1000,
+             (unsigned)(manifest->size * 1000000LL / 1024 / MAX(total_us, 1)));
+    ESP_LOGI(TAG, "  fetch     %6" PRId64 " ms", timing->fetch_us / 1000);
+    ESP_LOGI(TAG, "  hash      %6" PRId64 " ms", timing->hash_us / 1000);
+    ESP_LOGI(TAG, "  write     %6" PRId64 " ms", timing->write_us / 1000);
+    ESP_LOGI(TAG, "  validate  %6" PRId64 " ms (esp_ota_end)", timing->validate_us / 1000);
+}
+
+esp_err_t fw_ota_download(const esp_http_client_config_t *const sources[], size_t source_count,
+                          const fw_manifest_t *manifest)
+{
+    const esp_partition_t *partition = esp_ota_get_next_update_partition(NULL);
+    if (partition == NULL) {
+        ESP_LOGE(TAG, "No OTA partition available");
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (manifest->size > partition->size) {
+        ESP_LOGE(TAG, "Image of %u bytes does not fit partition %s", (unsigned)manifest->size, partition->label);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (source_count == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint8_t *buffer = malloc(manifest->chunk_size);
+    if (buffer == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    size_t source = 0;
+    esp_http_client_handle_t client = esp_http_client_init(sources[source]);
+    if (client == NULL) {
+        free(buffer);
+        return ESP_FAIL;
+    }
+
+    fw_ota_timing_t timing = {0};
+    int64_t download_start = esp_timer_get_time();
+
+    esp_ota_handle_t ota_handle;
+    esp_err_t err = esp_ota_begin(partition, manifest->size, &ota_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_ota_begin failed: %s", esp_err_to_name(err));
+        esp_http_client_cleanup(client);
+        free(buffer);
+        return err;
+    }
+
+    for (size_t i = 0; i < manifest->chunk_count && err == ESP_OK; i++) {
+        size_t len = MIN(manifest->chunk_size, manifest->size - i * manifest->chunk_size);
+
+        err = fetch_verified_chunk(client, manifest, i, buffer, &timing);
+        /* A source that keeps failing is dropped for the rest of the image,
+         * the chunks already written stay valid whichever source sent them */
+        while (err != ESP_OK && source + 1 < source_count) {
+            esp_http_client_cleanup(client);
+            source++;
+            ESP_LOGW(TAG, "Switching to %s from chunk %u", sources[source]->url, (unsigned)i);
+            client = esp_http_client_init(sources[source]);
+            if (client == NULL) {
+                err = ESP_FAIL;
+                break;
+            }
+            err = fetch_verified_chunk(client, manifest, i, buffer, &timing);
+        }
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Chunk %u could not be fetched from any source, aborting", (unsigned)i);
+            break;
+        }
+
+        int64_t start = esp_timer_get_time();
+        err = esp_ota_write(ota_handle, buffer, len);
+        timing.write_us += esp_timer_get_time() - start;
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "esp_ota_write failed: %s", esp_err_to_name(err));
+        }
+    }
+    if (client) {
+        esp_http_client_cleanup(client);
+    }
+    free(buffer);
+
+    if (err != ESP_OK) {
+        esp_ota_abort(ota_handle);
+        return err;
+    }
+
+    /* esp_ota_end reads the partition back to check the image structure and
+     * the digest appended by the build. There is no way to skip it, so it is
+     * measured on its own. */
+    int64_t start = esp_timer_get_time();
+    err = esp_ota_end(ota_handle);
+    timing.validate_us = esp_timer_get_time() - start;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_ota_end failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    err = esp_ota_set_boot_partition(partition);
+    log_timing(manifest, &timing, esp_timer_get_time() - download_start);
+    return err;
+}
@@ -0,0 +1,44 @@
+#ifndef _FW_OTA_H_
+#define _FW_OTA_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_http_client.h"
+
+/* Must match CHUNK_SIZE in versioning.py */
+#define FW_OTA_MAX_CHUNK_SIZE 16384
+#define FW_OTA_MAX_CHUNKS     256
+#define FW_OTA_CHUNK_RETRIES  3
+/* DER encoded ECDSA P-256 signature */
+#define FW_OTA_MAX_SIG_LEN    72
+
+typedef struct {
+    int build;
+    size_t size;
+    size_t chunk_size;
+    size_t chunk_count;
+    /* SHA-256 over the chunk digests, signed together with the header */
+    uint8_t root[32];
+    uint8_t signature[FW_OTA_MAX_SIG_LEN];
+    size_t signature_len;
+    uint8_t (*chunk_sha256)[32];
+} fw_manifest_t;
+
+/* Download and parse the manifest written by versioning.py, and check its
+ * digest root and signature against the key embedded in the firmware */
+esp_err_t fw_manifest_fetch(const esp_http_client_config_t *config, fw_manifest_t *manifest);
+void fw_manifest_free(fw_manifest_t *manifest);
+
+/* Stream the image chunk by chunk with Range requests, checking each chunk
+ * against the manifest before it is written to the update partition.
+ * A bad chunk is fetched again up to FW_OTA_CHUNK_RETRIES times; after that
+ * the next source in the list takes over (e.g. a peer board first, then the
+ * central server) and the update is aborted only when all of them failed.
+ * The manifest was authenticated by fw_manifest_fetch, so a chunk that
+ * matches its digest is authentic and the image is never hashed a second
+ * time. On success the new partition is set for boot. */
+esp_err_t fw_ota_download(const esp_http_client_config_t *const sources[], size_t source_count,
+                          const fw_manifest_t *manifest);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,278 @@
+#include "fw-peer.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_random.h"
+#include "esp_ota_ops.h"
+#include "esp_http_server.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "mdns.h"
+#include <version.h>
+#include "../../common/boot-prof.h"
+
+#define FW_PEER_NVS_NAMESPACE "fw_peer"
+#define FW_PEER_READ_SIZE     1024
+
+static const char *TAG = "fw_peer";
+
+static const esp_partition_t *s_partition;
+static size_t s_image_size;
+
+/* Images built by IDF end with a SHA-256 of the rest of the image, which
+ * esp_ota_end() and then the bootloader on every start check against the
+ * flash contents. Its 32 bytes identify the image without hashing it again. */
+static esp_err_t read_image_hash(const esp_partition_t *partition, size_t size, uint8_t hash[32])
+{
+    if (size < 32 || size > partition->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return esp_partition_read(partition, size - 32, hash, 32);
+}
+
+esp_err_t fw_peer_remember(const fw_manifest_t *manifest)
+{
+    uint8_t image_hash[32];
+    esp_err_t err = read_image_hash(esp_ota_get_boot_partition(), manifest->size, image_hash);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    nvs_handle_t nvs_handle;
+    err = nvs_open(FW_PEER_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    err = nvs_set_i32(nvs_handle, "build", manifest->build);
+    if (err == ESP_OK) {
+        err = nvs_set_u32(nvs_handle, "size", manifest->size);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_blob(nvs_handle, "image_hash", image_hash, sizeof(image_hash));
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+    return err;
+}
+
+static bool running_image_verified(void)
+{
+    nvs_handle_t nvs_handle;
+    if (nvs_open(FW_PEER_NVS_NAMESPACE, NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return false;
+    }
+
+    int32_t build = 0;
+    uint32_t size = 0;
+    uint8_t expected[32];
+    size_t length = sizeof(expected);
+    esp_err_t err = nvs_get_i32(nvs_handle, "build", &build);
+    if (err == ESP_OK) {
+        err = nvs_get_u32(nvs_handle, "size", &size);
+    }
+    if (err == ESP_OK) {
+        err = nvs_get_blob(nvs_handle, "image_hash", expected, &length);
+    }
+    nvs_close(nvs_handle);
+
+    /* A board flashed over USB runs an image that no manifest describes */
+    if (err != ESP_OK || build != atoi(BUILD_NUMBER)) {
+        return false;
+    }
+
+    const esp_partition_t *partition = esp_ota_get_running_partition();
+    uint8_t image_hash[32];
+    if (read_image_hash(partition, size, image_hash) != ESP_OK ||
+        memcmp(image_hash, expected, sizeof(image_hash)) != 0) {
+        return false;
+    }
+    s_partition = partition;
+    s_image_size = size;
+    return true;
+}
+
+static bool parse_range(const char *value, size_t *start, size_t *end)
+{
+    if (strncmp(value, "bytes=", 6) != 0) {
+        return false;
+    }
+    char *p;
+    unsigned long first = strtoul(value + 6, &p, 10);
+    if (p == value + 6 || *p != '-') {
+        return false;
+    }
+    p++;
+    unsigned long last = s_image_size - 1;
+    if (*p != '\0') {
+        char *q;
+        last = strtoul(p, &q, 10);
+        if (q == p) {
+            return false;
+        }
+    }
+    if (first >= s_image_size || first > last) {
+        return false;
+    }
+    *start = first;
+    *end = MIN(last, s_image_size - 1);
+    return true;
+}
+
+/* Serves the running image straight from flash. The client checks every
+ * chunk against the manifest from the central server, so plain HTTP is
+ * enough here and a bad peer can only cost a retry. */
+static esp_err_t firmware_get_handler(httpd_req_t *req)
+{
+    size_t start = 0;
+    size_t end = s_image_size - 1;
+    char range[48];
+    char content_range[48];
+
+    if (httpd_req_get_hdr_value_str(req, "Range", range, sizeof(range)) == ESP_OK) {
+        if (!parse_range(range, &start, &end)) {
+            httpd_resp_set_status(req, "416 Range Not Satisfiable");
+            return httpd_resp_send(req, NULL, 0);
+        }
+        snprintf(content_range, sizeof(content_range), "bytes %u-%u/%u",
+                 (unsigned)start, (unsigned)end, (unsigned)s_image_size);
+        httpd_resp_set_status(req, "206 Partial Content");
+        httpd_resp_set_hdr(req, "Content-Range", content_range);
+    }
+    httpd_resp_set_type(req, "application/octet-stream");
+
+    boot_prof_mark(BOOT_PHASE_FIRST_PACKET);
+
+    char buffer[FW_PEER_READ_SIZE];
+    for (size_t offset = start; offset <= end; offset += sizeof(buffer)) {
+        size_t len = MIN(sizeof(buffer), end + 1 - offset);
+        if (esp_partition_read(s_partition, offset, buffer, len) != ESP_OK ||
+            httpd_resp_send_chunk(req, buffer, len) != ESP_OK) {
+            return ESP_FAIL;
+        }
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+static httpd_uri_t uri_firmware = {
+    .uri      = "/firmware.bin",
+    .method   = HTTP_GET,
+    .handler  = firmware_get_handler,
+    .user_ctx = NULL
+};
+
+static void fw_peer_task(void *pvParameters)
+{
+    if (!running_image_verified()) {
+        ESP_LOGI(TAG, "Running image is not a verified OTA image, not sharing it");
+        vTaskDelete(NULL);
+        return;
+    }
+
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = FW_PEER_PORT;
+    httpd_handle_t server = NULL;
+    if (httpd_start(&server, &config) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start the peer server");
+        vTaskDelete(NULL);
+        return;
+    }
+    httpd_register_uri_handler(server, &uri_firmware);
+
+    char build[12];
+    snprintf(build, sizeof(build), "%d", atoi(BUILD_NUMBER));
+    mdns_txt_item_t serviceTxtData[1] = {
+        {"build", build}
+    };
+    mdns_service_add(NULL, FW_PEER_SERVICE, FW_PEER_PROTO, FW_PEER_PORT, serviceTxtData, 1);
+    ESP_LOGI(TAG, "Sharing build %s (%u bytes) on port %d", build, (unsigned)s_image_size, FW_PEER_PORT);
+
+    vTaskDelete(NULL);
+}
+
+void fw_peer_start(void)
+{
+    //initialize mDNS service
+    esp_err_t err = mdns_init();
+    if (err) {
+        ESP_LOGE(TAG, "MDNS Init failed: %d", err);
+        return;
+    }
+
+    //every board needs its own hostname for the peers to resolve it
+    uint8_t mac[6];
+    char hostname[24];
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    snprintf(hostname, sizeof(hostname), "esp32-fw-%02x%02x%02x", mac[3], mac[4], mac[5]);
+    mdns_hostname_set(hostname);
+
+    xTaskCreate(fw_peer_task, "fw_peer_task", 4096, NULL, 4, NULL);
+}
+
+static bool peer_has_build(const mdns_result_t *r, const char *build)
+{
+    for (size_t t = 0; t < r->txt_count; t++) {
+        if (strcmp(r->txt[t].key, "build") == 0 && r->txt[t].value && strcmp(r->txt[t].value, build) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool pick_peer(mdns_result_t *results, const char *build, char *url, size_t url_len)
+{
+    size_t matches = 0;
+    for (mdns_result_t *r = results; r; r = r->next) {
+        if (!peer_has_build(r, build)) {
+            continue;
+        }
+        for (mdns_ip_addr_t *a = r->addr; a; a = a->next) {
+            if (a->addr.type != ESP_IPADDR_TYPE_V4) {
+                continue;
+            }
+            /* Every matching peer is equally likely to be picked, so the
+             * download load spreads over all the boards that have the image */
+            matches++;
+            if (esp_random() % matches == 0) {
+                snprintf(url, url_len, "http://" IPSTR ":%u/firmware.bin",
+                         IP2STR(&a->addr.u_addr.ip4), r->port);
+            }
+            break;
+        }
+    }
+    return matches > 0;
+}
+
+esp_err_t fw_peer_find(int build, char *url, size_t url_len)
+{
+    char build_str[12];
+    snprintf(build_str, sizeof(build_str), "%d", build);
+
+    for (int round = 0; round < 2; round++) {
+        if (round) {
+            uint32_t wait = esp_random() % FW_PEER_SEED_WAIT_MS;
+            ESP_LOGI(TAG, "No peer has build %d yet, asking again in %" PRIu32 " ms", build, wait);
+            vTaskDelay(wait / portTICK_PERIOD_MS);
+        }
+
+        mdns_result_t *results = NULL;
+        esp_err_t err = mdns_query_ptr(FW_PEER_SERVICE, FW_PEER_PROTO, 3000, 20, &results);
+        if (err != ESP_OK || results == NULL) {
+            continue;
+        }
+        bool found = pick_peer(results, build_str, url, url_len);
+        mdns_query_results_free(results);
+        if (found) {
+            ESP_LOGI(TAG, "Build %d available from peer %s", build, url);
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#ifndef _FW_PEER_H_
+#define _FW_PEER_H_
+
+#include <stddef.h>
+#include "esp_err.h"
+#include "fw-ota.h"
+
+#define FW_PEER_SERVICE      "_esp32fw"
+#define FW_PEER_PROTO        "_tcp"
+#define FW_PEER_PORT         8070
+/* Upper bound of the random wait before asking the peers a second time,
+ * so the first boards of a rollout become seeds for the rest */
+#define FW_PEER_SEED_WAIT_MS 20000
+
+/* Record the manifest of an image that was just installed and verified,
+ * so it can be shared once the board runs it */
+esp_err_t fw_peer_remember(const fw_manifest_t *manifest);
+
+/* Check that the running image is the one remembered by fw_peer_remember()
+ * and, if it is, serve it over HTTP and advertise it through mDNS.
+ * Only the digest at the end of the image is compared, the bootloader
+ * already checked the rest of it against that digest. */
+void fw_peer_start(void);
+
+/* Look for a board that already serves the given build and write the
+ * URL of its image to url */
+esp_err_t fw_peer_find(int build, char *url, size_t url_len);
+
+#endif
\ No newline at end of file
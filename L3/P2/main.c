@@ -17,9 +17,11 @@
 #include "esp_log.h"
 #include "nvs_flash.h"
 #include "esp_http_client.h"
-#include "esp_https_ota.h"
 #include "esp_tls.h"
 #include <version.h>
+#include "fw-ota.h"
+#include "fw-peer.h"
+#include "../../common/boot-prof.h"
 
 #include "lwip/err.h"
 #include "lwip/sys.h"
@@ -31,11 +33,13 @@
 #define CONFIG_ESP_WIFI_PASS      "IoT-IoT-IoT"
 #define CONFIG_ESP_MAXIMUM_RETRY  5
 #define CONFIG_LOCAL_PORT         10001
+/* 1: configure the pins and start the tasks while Wi-Fi associates,
+ * 0: start them only once the station got an IP */
+#define CONFIG_FAST_BOOT          0
 
 //TODO: Modificati adresa IP de mai jos pentru a coincide cu cea a PC-ul pe care rulati scriptul python
 #define CONFIG_EXAMPLE_FIRMWARE_UPGRADE_URL "https://192.168.245.213:5000/firmware.bin" 
-#define CONFIG_FIRMWARE_VERSION_URL "https://192.168.245.213:5000/version"
-#define MIN(a,b) (((a) < (b)) ? (a) : (b))
+#define CONFIG_FIRMWARE_MANIFEST_URL "https://192.168.245.213:5000/manifest"
 
 #define GPIO_OUTPUT_IO 4
 #define GPIO_OUTPUT_PIN_SEL (1ULL<<GPIO_OUTPUT_IO)
@@ -46,11 +50,9 @@
 static EventGroupHandle_t s_wifi_event_group;
 #define WIFI_CONNECTED_BIT BIT0
 #define WIFI_FAIL_BIT      BIT1
-#define MAX_HTTP_OUTPUT_BUFFER 2048
 
 static EventGroupHandle_t s_event_start_ota;
 #define BIT_BTN_PRESSED    BIT0
-#define BIT_VERSION_GET    BIT1
 
 static const char *TAG = "simple_ota_example";
 extern const uint8_t server_cert_pem_start[] asm("_binary_ca_cert_pem_start");
@@ -58,99 +60,6 @@ extern const uint8_t server_cert_pem_end[] asm("_binary_ca_cert_pem_end");
 
 static int s_retry_num = 0;
 
-esp_err_t _http_get_handler(esp_http_client_event_t *evt)
-{
-    static char *output_buffer;  // Buffer to store response of http request from event handler
-    static int output_len;       // Stores number of bytes read
-    switch(evt->event_id) {
-        case HTTP_EVENT_ERROR:
-            ESP_LOGD(TAG, "HTTP_EVENT_ERROR");
-            break;
-        case HTTP_EVENT_ON_CONNECTED:
-            ESP_LOGD(TAG, "HTTP_EVENT_ON_CONNECTED");
-            break;
-        case HTTP_EVENT_HEADER_SENT:
-            ESP_LOGD(TAG, "HTTP_EVENT_HEADER_SENT");
-            break;
-        case HTTP_EVENT_ON_HEADER:
-            ESP_LOGD(TAG, "HTTP_EVENT_ON_HEADER, key=%s, value=%s", evt->header_key, evt->header_value);
-            break;
-        case HTTP_EVENT_ON_DATA:
-            ESP_LOGD(TAG, "HTTP_EVENT_ON_DATA, len=%d", evt->data_len);
-            // Clean the buffer in case of a new request
-            if (output_len == 0 && evt->user_data) {
-                // we are just starting to copy the output data into the use
-                memset(evt->user_data, 0, MAX_HTTP_OUTPUT_BUFFER);
-            }
-            /*
-             *  Check for chunked encoding is added as the URL for chunked encoding used in this example returns binary data.
-             *  However, event handler can also be used in case chunked encoding is used.
-             */
-            if (!esp_http_client_is_chunked_response(evt->client)) {
-                // If user_data buffer is configured, copy the response into the buffer
-                int copy_len = 0;
-                if (evt->user_data) {
-                    // The last byte in evt->user_data is kept for the NULL character in case of out-of-bound access.
-                    copy_len = MIN(evt->data_len, (MAX_HTTP_OUTPUT_BUFFER - output_len));
-                    if (copy_len) {
-                        memcpy(evt->user_data + output_len, evt->data, copy_len);
-                    }
-                } else {
-                    int content_len = esp_http_client_get_content_length(evt->client);
-                    if (output_buffer == NULL) {
-                        // We initialize output_buffer with 0 because it is used by strlen() and similar functions therefore should be null terminated.
-                        output_buffer = (char *) calloc(content_len + 1, sizeof(char));
-                        output_len = 0;
-                        if (output_buffer == NULL) {
-                            ESP_LOGE(TAG, "Failed to allocate memory for output buffer");
-                            return ESP_FAIL;
-                        }
-                    }
-                    copy_len = MIN(evt->data_len, (content_len - output_len));
-                    if (copy_len) {
-                        memcpy(output_buffer + output_len, evt->data, copy_len);
-                    }
-                }
-                output_len += copy_len;
-            }
-
-            break;
-        case HTTP_EVENT_ON_FINISH:
-            ESP_LOGD(TAG, "HTTP_EVENT_ON_FINISH");
-            if (output_buffer != NULL) {
-#if CONFIG_EXAMPLE_ENABLE_RESPONSE_BUFFER_DUMP
-                ESP_LOG_BUFFER_HEX(TAG, output_buffer, output_len);
-#endif
-                free(output_buffer);
-                output_buffer = NULL;
-            }
-            output_len = 0;
-            break;
-        case HTTP_EVENT_DISCONNECTED:
-            xEventGroupSetBits(s_event_start_ota, BIT_VERSION_GET);
-            ESP_LOGI(TAG, "HTTP_EVENT_DISCONNECTED");
-            int mbedtls_err = 0;
-            esp_err_t err = esp_tls_get_and_clear_last_error((esp_tls_error_handle_t)evt->data, &mbedtls_err, NULL);
-            if (err != 0) {
-                ESP_LOGI(TAG, "Last esp error code: 0x%x", err);
-                ESP_LOGI(TAG, "Last mbedtls failure: 0x%x", mbedtls_err);
-            }
-            if (output_buffer != NULL) {
-                free(output_buffer);
-                output_buffer = NULL;
-            }
-            output_len = 0;
-            break;
-        case HTTP_EVENT_REDIRECT:
-            ESP_LOGD(TAG, "HTTP_EVENT_REDIRECT");
-            esp_http_client_set_header(evt->client, "From", "user@example.com");
-            esp_http_client_set_header(evt->client, "Accept", "text/html");
-            esp_http_client_set_redirection(evt->client);
-            break;
-    }
-    return ESP_OK;
-}
-
 esp_err_t _http_event_handler(esp_http_client_event_t *evt)
 {
     switch (evt->event_id) {
@@ -187,6 +96,8 @@ static void event_handler(void* arg, esp_event_base_t event_base,
 {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
         esp_wifi_connect();
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        boot_prof_mark(BOOT_PHASE_WIFI_CONNECTED);
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
         if (s_retry_num < CONFIG_ESP_MAXIMUM_RETRY) {
             esp_wifi_connect();
@@ -200,11 +111,13 @@ static void event_handler(void* arg, esp_event_base_t event_base,
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
         ESP_LOGI(TAG, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
         s_retry_num = 0;
+        boot_prof_mark(BOOT_PHASE_GOT_IP);
         xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
     }
 }
 
-bool wifi_init_sta(void)
+/* Starts the station without waiting for the connection */
+void wifi_start_sta(void)
 {
     s_wifi_event_group = xEventGroupCreate();
 
@@ -238,6 +151,23 @@ bool wifi_init_sta(void)
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA) );
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config) );
     ESP_ERROR_CHECK(esp_wifi_start() );
+    boot_prof_mark(BOOT_PHASE_WIFI_STARTED);
+}
+
+/* Returns true once the station has an IP, false if it gave up or timed out */
+static bool wifi_sta_wait(TickType_t timeout)
+{
+    EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
+            WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
+            pdFALSE,
+            pdFALSE,
+            timeout);
+    return bits & WIFI_CONNECTED_BIT;
+}
+
+bool wifi_init_sta(void)
+{
+    wifi_start_sta();
 
     ESP_LOGI(TAG, "wifi_init_sta finished.");
 
@@ -266,20 +196,23 @@ bool wifi_init_sta(void)
 
 static void ota_task(void *pvParameters)
 {
+    //returns at once unless the task was started before the connection (fast boot)
+    if (!wifi_sta_wait(portMAX_DELAY)) {
+        vTaskDelete(NULL);
+    }
+    fw_peer_start();
+    boot_prof_report();
+
     xEventGroupWaitBits(s_event_start_ota, BIT_BTN_PRESSED, pdTRUE, pdTRUE, portMAX_DELAY);
-    char local_response_buffer[MAX_HTTP_OUTPUT_BUFFER + 1] = {0};
 
     ESP_LOGI(TAG, "Starting OTA example task");
-    esp_http_client_config_t version_config = {
-        .url = CONFIG_FIRMWARE_VERSION_URL,
+    esp_http_client_config_t manifest_config = {
+        .url = CONFIG_FIRMWARE_MANIFEST_URL,
         .cert_pem = (char *)server_cert_pem_start,
         .cert_len = 1422,
-        .event_handler = _http_get_handler,
-        .keep_alive_enable = true,
+        .event_handler = _http_event_handler,
         .use_global_ca_store = true,
         .skip_cert_common_name_check = true,
-        .user_data = local_response_buffer,        // Pass address of local buffer to get response
-        .disable_auto_redirect = true,
     };
 
     esp_http_client_config_t download_config = {
@@ -292,38 +225,46 @@ static void ota_task(void *pvParameters)
         .skip_cert_common_name_check = true
     };
 
-    esp_https_ota_config_t ota_config = {
-        .http_config = &download_config,
-    };
-    
     ESP_ERROR_CHECK(esp_tls_init_global_ca_store());
     ESP_ERROR_CHECK(esp_tls_set_global_ca_store((unsigned char*)server_cert_pem_start, server_cert_pem_end - server_cert_pem_start));
 
-    esp_http_client_handle_t client = esp_http_client_init(&version_config);
-    esp_err_t err = esp_http_client_perform(client);
-    xEventGroupWaitBits(s_event_start_ota, BIT_VERSION_GET, pdTRUE, pdTRUE, portMAX_DELAY);
+    fw_manifest_t manifest;
+    esp_err_t err = fw_manifest_fetch(&manifest_config, &manifest);
     if (err == ESP_OK) {
-        ESP_LOGI(TAG, "HTTP GET Status = %d, content_length = %"PRId64,
-                esp_http_client_get_status_code(client),
-                esp_http_client_get_content_length(client));
-        
-        int available_version = atoi(local_response_buffer);
-        ESP_LOGI(TAG, "Available version: %d", available_version);
-        if (available_version > atoi(BUILD_NUMBER)) {
+        ESP_LOGI(TAG, "Available version: %d", manifest.build);
+        if (manifest.build > atoi(BUILD_NUMBER)) {
             ESP_LOGI(TAG, "Downloading new version...");
-            ESP_LOGI(TAG, "Attempting to download update from %s", download_config.url);
-            esp_err_t ret = esp_https_ota(&ota_config);
+
+            /* A neighbour that already runs the build takes the load off the
+             * server, which is only used for what the peer fails to deliver */
+            char peer_url[64];
+            esp_http_client_config_t peer_config = {
+                .url = peer_url,
+                .event_handler = _http_event_handler,
+                .keep_alive_enable = true,
+            };
+            const esp_http_client_config_t *sources[2];
+            size_t source_count = 0;
+            if (fw_peer_find(manifest.build, peer_url, sizeof(peer_url)) == ESP_OK) {
+                sources[source_count++] = &peer_config;
+            }
+            sources[source_count++] = &download_config;
+
+            ESP_LOGI(TAG, "Attempting to download update from %s", sources[0]->url);
+            esp_err_t ret = fw_ota_download(sources, source_count, &manifest);
             if (ret == ESP_OK) {
+                fw_peer_remember(&manifest);
                 ESP_LOGI(TAG, "OTA Succeed, Rebooting...");
                 esp_restart();
             } else {
-                ESP_LOGE(TAG, "Firmware upgrade failed");
+                ESP_LOGE(TAG, "Firmware upgrade failed: %s", esp_err_to_name(ret));
             }
         } else {
             ESP_LOGI(TAG, "Up to date");
         }
+        fw_manifest_free(&manifest);
     } else {
-        ESP_LOGE(TAG, "HTTP GET request failed: %s", esp_err_to_name(err));
+        ESP_LOGE(TAG, "Manifest request failed: %s", esp_err_to_name(err));
     }
 
     while (1) {
@@ -378,10 +319,13 @@ void gpio_init()
     io_conf.pin_bit_mask = GPIO_INPUT_PIN_SEL;
     io_conf.pull_up_en = 1;
     gpio_config(&io_conf);
+    boot_prof_mark(BOOT_PHASE_GPIO_READY);
 }
 
 void app_main(void)
 {
+    boot_prof_mark(BOOT_PHASE_APP_MAIN);
+
     //Initialize NVS
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
@@ -389,9 +333,19 @@ void app_main(void)
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
+    boot_prof_mark(BOOT_PHASE_NVS_READY);
 
     gpio_init();
 
+#if CONFIG_FAST_BOOT
+    //the button works right away, ota_task waits for the IP by itself
+    ESP_LOGI(TAG, "ESP_WIFI_MODE_STA");
+    wifi_start_sta();
+    s_event_start_ota = xEventGroupCreate();
+    xTaskCreate(ota_task, "ota_task", 8192, NULL, 5, NULL);
+    xTaskCreate(button_task, "button_task", 4096, NULL, 5, NULL);
+    boot_prof_mark(BOOT_PHASE_TASKS_STARTED);
+#else
     ESP_LOGI(TAG, "ESP_WIFI_MODE_STA");
     bool connected = wifi_init_sta();
 
@@ -399,5 +353,7 @@ void app_main(void)
         s_event_start_ota = xEventGroupCreate();
         xTaskCreate(ota_task, "ota_task", 8192, NULL, 5, NULL);
         xTaskCreate(button_task, "button_task", 4096, NULL, 5, NULL);
+        boot_prof_mark(BOOT_PHASE_TASKS_STARTED);
     }
+#endif
 }
\ No newline at end of file
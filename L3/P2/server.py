@@ -1,17 +1,17 @@
-import io
 from flask import Flask, send_file
 import os.path
 
 app = Flask(__name__)
 
+FIRMWARE_PATH = ".pio\\build\\esp-wrover-kit\\firmware.bin"
+
 @app.route('/firmware.bin')
 def firm():
-    with open(".pio\\build\\esp-wrover-kit\\firmware.bin", 'rb') as bites:
-        print(bites)
-        return send_file(
-                     io.BytesIO(bites.read()),
-                     mimetype='application/octet-stream'
-               )
+    # Serving the path (not a BytesIO copy) lets Werkzeug answer the
+    # Range requests the device uses to re-fetch a single bad chunk
+    return send_file(FIRMWARE_PATH,
+                     mimetype='application/octet-stream',
+                     conditional=True)
 
 @app.route("/")
 def hello():
@@ -22,5 +22,9 @@ def version():
     with open("versioning", 'r') as f:
         return f.readline()
 
+@app.route("/manifest")
+def manifest():
+    return send_file("manifest", mimetype='text/plain')
+
 if __name__ == '__main__':
     app.run(host='0.0.0.0', ssl_context=('ca_cert.pem', 'ca_key.pem'), debug=True)
\ No newline at end of file
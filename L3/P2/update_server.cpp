@@ -0,0 +1,1296 @@
+/* Firmware update server for a whole fleet
+
+   Native replacement for server.py. It serves the same routes
+   (/firmware.bin, /manifest, /version, /) but:
+   - keeps every file in memory (a sealed memfd, mapped) and re-reads it
+     only when it changes on disk, instead of opening it on every request;
+   - streams the image with sendfile(2) (kTLS + SSL_sendfile when the kernel
+     supports it, SSL_write straight from the mapping otherwise);
+   - answers Range and If-None-Match requests, with the SHA-256 of each file
+     as its ETag;
+   - runs one epoll loop per thread on a SO_REUSEPORT socket, so thousands of
+     boards can be connected at the same time.
+
+   It also contains a client simulator that behaves like the OTA task of the
+   boards (manifest, then the image in 16 KiB ranges over one keep-alive
+   connection) and reports latency and throughput.
+
+   Build:
+       g++ -O2 -std=c++17 -pthread update_server.cpp -o update_server -lssl -lcrypto
+   Serve (same files and certificate as server.py):
+       ./update_server --port 5000 --cert ca_cert.pem --key ca_key.pem \
+                       --firmware .pio/build/esp-wrover-kit/firmware.bin
+   Load test:
+       ./update_server --simulate 2000 --host 127.0.0.1 --port 5000
+*/
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+
+namespace {
+
+constexpr size_t MAX_REQUEST_SIZE = 8192;
+constexpr size_t TLS_WRITE_SIZE = 16384;
+constexpr size_t SENDFILE_SIZE = 1 << 20;
+constexpr int IDLE_TIMEOUT_S = 30;
+constexpr int MAX_EVENTS = 256;
+
+uint64_t now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* ------------------------------------------------------------------------ */
+/* File cache                                                               */
+/* ------------------------------------------------------------------------ */
+
+/* A read-only file kept open and mapped for as long as a request uses it */
+class MappedFile {
+public:
+    MappedFile(const std::string &path, const char *mime) : path_(path), mime_(mime) {}
+    ~MappedFile()
+    {
+        if (data_ && size_) {
+            munmap(const_cast<char *>(data_), size_);
+        }
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    /* The file is copied into a sealed memfd, so a build rewriting it in
+     * place can never change (or truncate) the bytes of a running transfer */
+    bool load()
+    {
+        int src = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+        if (src < 0) {
+            return false;
+        }
+        struct stat st;
+        fd_ = memfd_create("update_server", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (fstat(src, &st) != 0 || fd_ < 0) {
+            close(src);
+            return false;
+        }
+        stamp_ = stamp_of(st);
+        char buffer[65536];
+        ssize_t len;
+        while ((len = read(src, buffer, sizeof(buffer))) > 0) {
+            if (write(fd_, buffer, len) != len) {
+                len = -1;
+                break;
+            }
+            size_ += len;
+        }
+        close(src);
+        if (len < 0 || fcntl(fd_, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE) != 0) {
+            return false;
+        }
+        if (size_) {
+            void *map = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+            if (map == MAP_FAILED) {
+                return false;
+            }
+            madvise(map, size_, MADV_WILLNEED);
+            data_ = static_cast<const char *>(map);
+        }
+
+        unsigned char digest[EVP_MAX_MD_SIZE];
+        unsigned int digest_len = 0;
+        EVP_Digest(data_ ? data_ : "", size_, digest, &digest_len, EVP_sha256(), nullptr);
+        static const char hex[] = "0123456789abcdef";
+        etag_ = "\"";
+        for (unsigned int i = 0; i < digest_len; i++) {
+            etag_ += hex[digest[i] >> 4];
+            etag_ += hex[digest[i] & 0xf];
+        }
+        etag_ += "\"";
+        return true;
+    }
+
+    /* True when the file on disk is no longer the one that is mapped */
+    bool changed() const
+    {
+        struct stat st;
+        return stat(path_.c_str(), &st) == 0 && stamp_of(st) != stamp_;
+    }
+
+    const std::string &path() const { return path_; }
+    const char *mime() const { return mime_; }
+    const std::string &etag() const { return etag_; }
+    const char *data() const { return data_; }
+    size_t size() const { return size_; }
+    int fd() const { return fd_; }
+
+private:
+    static std::string stamp_of(const struct stat &st)
+    {
+        return std::to_string(st.st_ino) + ":" + std::to_string(st.st_size) + ":" +
+               std::to_string(st.st_mtim.tv_sec) + "." + std::to_string(st.st_mtim.tv_nsec);
+    }
+
+    std::string path_;
+    const char *mime_;
+    std::string etag_;
+    std::string stamp_;
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+    int fd_ = -1;
+};
+
+struct Route {
+    const char *uri;
+    std::shared_ptr<const MappedFile> file;
+};
+
+/* Immutable set of files served at one point in time. A reload publishes a
+ * new snapshot; transfers already running keep the old one alive. */
+struct Snapshot {
+    std::vector<Route> routes;
+
+    std::shared_ptr<const MappedFile> file(const std::string &uri) const
+    {
+        for (const auto &route : routes) {
+            if (uri == route.uri) {
+                return route.file;
+            }
+        }
+        return nullptr;
+    }
+
+    const MappedFile *find(const std::string &uri) const { return file(uri).get(); }
+};
+
+class FileCache {
+public:
+    void add(const char *uri, const std::string &path, const char *mime)
+    {
+        sources_.push_back({uri, path, mime});
+    }
+
+    /* Maps again only the files that changed; returns false when a file
+     * could not be read (the previous version keeps being served) */
+    bool refresh()
+    {
+        auto current = get();
+        auto next = std::make_shared<Snapshot>();
+        bool changed = !current;
+        bool ok = true;
+        for (const auto &source : sources_) {
+            std::shared_ptr<const MappedFile> file = current ? current->file(source.uri) : nullptr;
+            if (!file || file->changed()) {
+                auto fresh = std::make_shared<MappedFile>(source.path, source.mime);
+                if (fresh->load()) {
+                    fprintf(stderr, "cached %s (%zu bytes, etag %s)\n", source.path.c_str(),
+                            fresh->size(), fresh->etag().c_str());
+                    file = fresh;
+                    changed = true;
+                } else {
+                    ok = false;
+                    if (!file) {
+                        fprintf(stderr, "cannot read %s: %s\n", source.path.c_str(), strerror(errno));
+                    }
+                }
+            }
+            if (file) {
+                next->routes.push_back({source.uri, file});
+            }
+        }
+        if (changed) {
+            std::atomic_store(&snapshot_, std::shared_ptr<const Snapshot>(next));
+        }
+        return ok;
+    }
+
+    std::shared_ptr<const Snapshot> get() const { return std::atomic_load(&snapshot_); }
+
+private:
+    struct Source {
+        const char *uri;
+        std::string path;
+        const char *mime;
+    };
+    std::vector<Source> sources_;
+    std::shared_ptr<const Snapshot> snapshot_;
+};
+
+/* ------------------------------------------------------------------------ */
+/* Transport                                                                */
+/* ------------------------------------------------------------------------ */
+
+enum class Io { Done, Again, Closed };
+
+/* One TCP connection, optionally wrapped in TLS */
+struct Stream {
+    int fd = -1;
+    SSL *ssl = nullptr;
+
+    ~Stream()
+    {
+        if (ssl) {
+            SSL_free(ssl);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    Io tls_result(int ret)
+    {
+        switch (SSL_get_error(ssl, ret)) {
+        case SSL_ERROR_WANT_READ:
+        case SSL_ERROR_WANT_WRITE:
+            return Io::Again;
+        default:
+            ERR_clear_error();
+            return Io::Closed;
+        }
+    }
+
+    Io handshake(bool server)
+    {
+        if (!ssl) {
+            return Io::Done;
+        }
+        int ret = server ? SSL_accept(ssl) : SSL_connect(ssl);
+        return ret == 1 ? Io::Done : tls_result(ret);
+    }
+
+    /* Reads what is available, appending to buffer */
+    Io read_some(std::string &buffer, size_t limit)
+    {
+        char chunk[16384];
+        while (buffer.size() < limit) {
+            int ret;
+            if (ssl) {
+                ret = SSL_read(ssl, chunk, sizeof(chunk));
+                if (ret <= 0) {
+                    return tls_result(ret);
+                }
+            } else {
+                ret = read(fd, chunk, sizeof(chunk));
+                if (ret == 0) {
+                    return Io::Closed;
+                }
+                if (ret < 0) {
+                    return errno == EAGAIN ? Io::Again : Io::Closed;
+                }
+            }
+            buffer.append(chunk, ret);
+        }
+        return Io::Done;
+    }
+
+    /* Writes from memory; *written is advanced by what was sent */
+    Io write_some(const char *data, size_t len, size_t *written)
+    {
+        while (*written < len) {
+            size_t n = std::min(len - *written, TLS_WRITE_SIZE);
+            int ret;
+            if (ssl) {
+                ret = SSL_write(ssl, data + *written, n);
+                if (ret <= 0) {
+                    return tls_result(ret);
+                }
+            } else {
+                ret = send(fd, data + *written, n, MSG_NOSIGNAL);
+                if (ret < 0) {
+                    return errno == EAGAIN ? Io::Again : Io::Closed;
+                }
+            }
+            *written += ret;
+        }
+        return Io::Done;
+    }
+
+    /* Sends len bytes of file from *offset without copying them to user
+     * space when the transport allows it */
+    Io send_file(const MappedFile &file, off_t *offset, size_t *left)
+    {
+        while (*left) {
+            if (!ssl) {
+                ssize_t ret = sendfile(fd, file.fd(), offset, std::min(*left, SENDFILE_SIZE));
+                if (ret <= 0) {
+                    return ret < 0 && errno == EAGAIN ? Io::Again : Io::Closed;
+                }
+                *left -= ret;
+                continue;
+            }
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(OPENSSL_NO_KTLS)
+            if (BIO_get_ktls_send(SSL_get_wbio(ssl))) {
+                ossl_ssize_t ret = SSL_sendfile(ssl, file.fd(), *offset, std::min(*left, SENDFILE_SIZE), 0);
+                if (ret <= 0) {
+                    return tls_result(ret);
+                }
+                *offset += ret;
+                *left -= ret;
+                continue;
+            }
+#endif
+            /* Same length on every retry, as SSL_write expects after WANT_WRITE */
+            size_t n = std::min(*left, TLS_WRITE_SIZE);
+            int ret = SSL_write(ssl, file.data() + *offset, n);
+            if (ret <= 0) {
+                return tls_result(ret);
+            }
+            *offset += ret;
+            *left -= ret;
+        }
+        return Io::Done;
+    }
+};
+
+int listen_socket(int port, bool reuseport)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (reuseport) {
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    }
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(fd, 4096) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void raise_fd_limit()
+{
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+/* ------------------------------------------------------------------------ */
+/* HTTP server                                                              */
+/* ------------------------------------------------------------------------ */
+
+struct Request {
+    std::string method;
+    std::string uri;
+    std::string range;
+    std::string if_none_match;
+    bool keep_alive = true;
+};
+
+bool iequals(const char *a, size_t a_len, const char *b)
+{
+    size_t b_len = strlen(b);
+    if (a_len != b_len) {
+        return false;
+    }
+    for (size_t i = 0; i < a_len; i++) {
+        if (tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool parse_request(const std::string &head, Request &req)
+{
+    size_t line_end = head.find("\r\n");
+    size_t sp1 = head.find(' ');
+    size_t sp2 = sp1 == std::string::npos ? sp1 : head.find(' ', sp1 + 1);
+    if (line_end == std::string::npos || sp2 == std::string::npos || sp2 > line_end) {
+        return false;
+    }
+    req.method = head.substr(0, sp1);
+    req.uri = head.substr(sp1 + 1, sp2 - sp1 - 1);
+    req.keep_alive = head.compare(sp2 + 1, line_end - sp2 - 1, "HTTP/1.0") != 0;
+    size_t query = req.uri.find('?');
+    if (query != std::string::npos) {
+        req.uri.resize(query);
+    }
+
+    size_t pos = line_end + 2;
+    while (pos < head.size()) {
+        size_t end = head.find("\r\n", pos);
+        if (end == std::string::npos || end == pos) {
+            break;
+        }
+        size_t colon = head.find(':', pos);
+        if (colon != std::string::npos && colon < end) {
+            size_t value = colon + 1;
+            while (value < end && head[value] == ' ') {
+                value++;
+            }
+            const char *name = head.data() + pos;
+            size_t name_len = colon - pos;
+            std::string v = head.substr(value, end - value);
+            if (iequals(name, name_len, "range")) {
+                req.range = v;
+            } else if (iequals(name, name_len, "if-none-match")) {
+                req.if_none_match = v;
+            } else if (iequals(name, name_len, "connection")) {
+                if (iequals(v.data(), v.size(), "close")) {
+                    req.keep_alive = false;
+                } else if (iequals(v.data(), v.size(), "keep-alive")) {
+                    req.keep_alive = true;
+                }
+            }
+        }
+        pos = end + 2;
+    }
+    return true;
+}
+
+/* Single range only ("bytes=a-b", "bytes=a-", "bytes=-n"), which is all
+ * the boards send. Returns false for a range outside of the file. */
+bool parse_range(const std::string &value, size_t size, size_t *first, size_t *last)
+{
+    if (value.compare(0, 6, "bytes=") != 0 || value.find(',') != std::string::npos || size == 0) {
+        return false;
+    }
+    const char *p = value.c_str() + 6;
+    char *end;
+    if (*p == '-') {
+        unsigned long long suffix = strtoull(p + 1, &end, 10);
+        if (end == p + 1 || *end || suffix == 0) {
+            return false;
+        }
+        *first = suffix >= size ? 0 : size - suffix;
+        *last = size - 1;
+        return true;
+    }
+    unsigned long long a = strtoull(p, &end, 10);
+    if (end == p || *end != '-') {
+        return false;
+    }
+    p = end + 1;
+    unsigned long long b = size - 1;
+    if (*p) {
+        b = strtoull(p, &end, 10);
+        if (end == p || *end) {
+            return false;
+        }
+    }
+    if (a >= size || a > b) {
+        return false;
+    }
+    *first = a;
+    *last = std::min<unsigned long long>(b, size - 1);
+    return true;
+}
+
+bool etag_matches(const std::string &header, const std::string &etag)
+{
+    if (header == "*") {
+        return true;
+    }
+    return header.find(etag) != std::string::npos;
+}
+
+struct ServerStats {
+    std::atomic<uint64_t> connections{0};
+    std::atomic<uint64_t> requests{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<int64_t> open{0};
+};
+
+struct ServerConfig {
+    int port = 5000;
+    int threads = 0;
+    std::string cert = "ca_cert.pem";
+    std::string key = "ca_key.pem";
+    std::string firmware = ".pio/build/esp-wrover-kit/firmware.bin";
+    std::string manifest = "manifest";
+    std::string versioning = "versioning";
+    bool plain = false;
+};
+
+class Connection {
+public:
+    Connection(int fd, SSL *ssl) : last_activity_(now_us())
+    {
+        stream_.fd = fd;
+        stream_.ssl = ssl;
+        state_ = ssl ? State::Handshake : State::ReadRequest;
+    }
+
+    int fd() const { return stream_.fd; }
+    uint64_t last_activity() const { return last_activity_; }
+
+    /* Runs the connection until it would block. Returns false once it is
+     * finished and can be destroyed. */
+    bool drive(const FileCache &cache, ServerStats &stats)
+    {
+        last_activity_ = now_us();
+        for (;;) {
+            Io io;
+            switch (state_) {
+            case State::Handshake:
+                io = stream_.handshake(true);
+                if (io != Io::Done) {
+                    return io == Io::Again;
+                }
+                state_ = State::ReadRequest;
+                break;
+
+            case State::ReadRequest: {
+                size_t head_end = in_.find("\r\n\r\n");
+                if (head_end == std::string::npos) {
+                    if (in_.size() >= MAX_REQUEST_SIZE) {
+                        return false;
+                    }
+                    io = stream_.read_some(in_, MAX_REQUEST_SIZE);
+                    if (io == Io::Closed) {
+                        return false;
+                    }
+                    if (io == Io::Again && in_.find("\r\n\r\n") == std::string::npos) {
+                        return true;
+                    }
+                    break;
+                }
+                Request req;
+                bool valid = parse_request(in_.substr(0, head_end + 2), req);
+                /* Keep whatever the client pipelined after this request */
+                in_.erase(0, head_end + 4);
+                stats.requests++;
+                respond(cache, valid ? &req : nullptr);
+                state_ = State::WriteHead;
+                break;
+            }
+
+            case State::WriteHead:
+                io = stream_.write_some(out_.data(), out_.size(), &out_written_);
+                if (io != Io::Done) {
+                    return io == Io::Again;
+                }
+                stats.bytes += out_.size();
+                state_ = body_left_ ? State::WriteBody : State::Finished;
+                break;
+
+            case State::WriteBody: {
+                size_t before = body_left_;
+                io = stream_.send_file(*body_, &body_offset_, &body_left_);
+                stats.bytes += before - body_left_;
+                if (io != Io::Done) {
+                    return io == Io::Again;
+                }
+                state_ = State::Finished;
+                break;
+            }
+
+            case State::Finished:
+                body_snapshot_.reset();
+                body_ = nullptr;
+                if (!keep_alive_) {
+                    return false;
+                }
+                state_ = State::ReadRequest;
+                break;
+            }
+        }
+    }
+
+private:
+    enum class State { Handshake, ReadRequest, WriteHead, WriteBody, Finished };
+
+    void respond(const FileCache &cache, const Request *req)
+    {
+        out_.clear();
+        out_written_ = 0;
+        body_left_ = 0;
+        keep_alive_ = req && req->keep_alive;
+
+        if (!req) {
+            head(400, "Bad Request", nullptr, 0, nullptr);
+            return;
+        }
+        bool head_only = req->method == "HEAD";
+        if (req->method != "GET" && !head_only) {
+            head(405, "Method Not Allowed", nullptr, 0, nullptr);
+            return;
+        }
+        if (req->uri == "/") {
+            static const char hello[] = "Hello World!";
+            head(200, "OK", "text/html; charset=utf-8", sizeof(hello) - 1, nullptr);
+            if (!head_only) {
+                out_.append(hello, sizeof(hello) - 1);
+            }
+            return;
+        }
+
+        auto snapshot = cache.get();
+        const MappedFile *file = snapshot ? snapshot->find(req->uri) : nullptr;
+        if (!file) {
+            head(404, "Not Found", nullptr, 0, nullptr);
+            return;
+        }
+        if (!req->if_none_match.empty() && etag_matches(req->if_none_match, file->etag())) {
+            head(304, "Not Modified", nullptr, 0, file);
+            return;
+        }
+
+        size_t first = 0;
+        size_t last = file->size() ? file->size() - 1 : 0;
+        char content_range[64] = "";
+        if (!req->range.empty()) {
+            if (!parse_range(req->range, file->size(), &first, &last)) {
+                snprintf(content_range, sizeof(content_range), "bytes */%zu", file->size());
+                head(416, "Range Not Satisfiable", nullptr, 0, nullptr, content_range);
+                return;
+            }
+            snprintf(content_range, sizeof(content_range), "bytes %zu-%zu/%zu", first, last, file->size());
+        }
+        size_t length = file->size() ? last - first + 1 : 0;
+        if (content_range[0]) {
+            head(206, "Partial Content", file->mime(), length, file, content_range);
+        } else {
+            head(200, "OK", file->mime(), length, file);
+        }
+        if (!head_only && length) {
+            body_snapshot_ = snapshot;
+            body_ = file;
+            body_offset_ = first;
+            body_left_ = length;
+        }
+    }
+
+    void head(int status, const char *reason, const char *type, size_t length,
+              const MappedFile *file, const char *content_range = nullptr)
+    {
+        char buffer[512];
+        int n = snprintf(buffer, sizeof(buffer), "HTTP/1.1 %d %s\r\n%s\r\n", status, reason,
+                         keep_alive_ ? "Connection: keep-alive" : "Connection: close");
+        out_.append(buffer, n);
+        if (status != 304) {
+            n = snprintf(buffer, sizeof(buffer), "Content-Length: %zu\r\n", length);
+            out_.append(buffer, n);
+        }
+        if (type) {
+            out_ += "Content-Type: ";
+            out_ += type;
+            out_ += "\r\n";
+        }
+        if (file) {
+            out_ += "Accept-Ranges: bytes\r\nETag: ";
+            out_ += file->etag();
+            out_ += "\r\nCache-Control: no-cache\r\n";
+        }
+        if (content_range) {
+            out_ += "Content-Range: ";
+            out_ += content_range;
+            out_ += "\r\n";
+        }
+        out_ += "\r\n";
+    }
+
+    Stream stream_;
+    State state_;
+    std::string in_;
+    std::string out_;
+    size_t out_written_ = 0;
+    bool keep_alive_ = true;
+    std::shared_ptr<const Snapshot> body_snapshot_;
+    const MappedFile *body_ = nullptr;
+    off_t body_offset_ = 0;
+    size_t body_left_ = 0;
+    uint64_t last_activity_;
+};
+
+std::atomic<bool> g_running{true};
+
+void worker_loop(int listen_fd, SSL_CTX *ctx, const FileCache &cache, ServerStats &stats)
+{
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.ptr = nullptr;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &ev);
+
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+    epoll_event events[MAX_EVENTS];
+    uint64_t last_sweep = now_us();
+
+    auto drop = [&](int fd) {
+        epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
+        connections.erase(fd);
+        stats.open--;
+    };
+
+    while (g_running) {
+        int n = epoll_wait(epfd, events, MAX_EVENTS, 1000);
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr == nullptr) {
+                for (;;) {
+                    int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                    if (fd < 0) {
+                        break;
+                    }
+                    int one = 1;
+                    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                    SSL *ssl = nullptr;
+                    if (ctx) {
+                        ssl = SSL_new(ctx);
+                        SSL_set_fd(ssl, fd);
+                    }
+                    auto conn = std::make_unique<Connection>(fd, ssl);
+                    Connection *raw = conn.get();
+                    connections[fd] = std::move(conn);
+                    stats.connections++;
+                    stats.open++;
+
+                    epoll_event cev = {};
+                    cev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+                    cev.data.ptr = raw;
+                    epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &cev);
+                    if (!raw->drive(cache, stats)) {
+                        drop(fd);
+                    }
+                }
+                continue;
+            }
+            Connection *conn = static_cast<Connection *>(events[i].data.ptr);
+            if ((events[i].events & (EPOLLERR | EPOLLHUP)) || !conn->drive(cache, stats)) {
+                drop(conn->fd());
+            }
+        }
+
+        uint64_t now = now_us();
+        if (now - last_sweep > 1000000) {
+            last_sweep = now;
+            std::vector<int> idle;
+            for (const auto &it : connections) {
+                if (now - it.second->last_activity() > IDLE_TIMEOUT_S * 1000000ULL) {
+                    idle.push_back(it.first);
+                }
+            }
+            for (int fd : idle) {
+                drop(fd);
+            }
+        }
+    }
+    close(epfd);
+}
+
+SSL_CTX *server_tls_context(const ServerConfig &config)
+{
+    SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+    if (!ctx) {
+        return nullptr;
+    }
+    SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+    SSL_CTX_set_mode(ctx, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER | SSL_MODE_RELEASE_BUFFERS);
+#ifdef SSL_OP_ENABLE_KTLS
+    SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+#endif
+    /* The boards reconnect for every update check, resuming saves them the
+     * full handshake */
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_sess_set_cache_size(ctx, 1 << 16);
+    if (SSL_CTX_use_certificate_chain_file(ctx, config.cert.c_str()) != 1 ||
+        SSL_CTX_use_PrivateKey_file(ctx, config.key.c_str(), SSL_FILETYPE_PEM) != 1) {
+        ERR_print_errors_fp(stderr);
+        SSL_CTX_free(ctx);
+        return nullptr;
+    }
+    return ctx;
+}
+
+int run_server(const ServerConfig &config)
+{
+    FileCache cache;
+    cache.add("/firmware.bin", config.firmware, "application/octet-stream");
+    cache.add("/manifest", config.manifest, "text/plain");
+    cache.add("/version", config.versioning, "text/html; charset=utf-8");
+    cache.refresh();
+
+    SSL_CTX *ctx = nullptr;
+    if (!config.plain) {
+        ctx = server_tls_context(config);
+        if (!ctx) {
+            fprintf(stderr, "TLS setup failed (use --plain to serve without TLS)\n");
+            return 1;
+        }
+    }
+
+    raise_fd_limit();
+    int threads = config.threads > 0 ? config.threads : std::max(1u, std::thread::hardware_concurrency());
+    ServerStats stats;
+    std::vector<std::thread> workers;
+    std::vector<int> listeners;
+    for (int i = 0; i < threads; i++) {
+        int fd = listen_socket(config.port, true);
+        if (fd < 0) {
+            fprintf(stderr, "cannot listen on port %d: %s\n", config.port, strerror(errno));
+            return 1;
+        }
+        listeners.push_back(fd);
+        workers.emplace_back(worker_loop, fd, ctx, std::cref(cache), std::ref(stats));
+    }
+    fprintf(stderr, "serving on port %d with %d threads (%s)\n", config.port, threads,
+            config.plain ? "plain HTTP" : "TLS");
+
+    uint64_t last_requests = 0;
+    uint64_t last_bytes = 0;
+    while (g_running) {
+        sleep(1);
+        cache.refresh();
+        uint64_t requests = stats.requests;
+        uint64_t bytes = stats.bytes;
+        if (requests != last_requests) {
+            fprintf(stderr, "open %lld, %llu req/s, %.1f MB/s\n", (long long)stats.open.load(),
+                    (unsigned long long)(requests - last_requests), (bytes - last_bytes) / 1e6);
+        }
+        last_requests = requests;
+        last_bytes = bytes;
+    }
+
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    for (int fd : listeners) {
+        close(fd);
+    }
+    SSL_CTX_free(ctx);
+    return 0;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Client simulator                                                         */
+/* ------------------------------------------------------------------------ */
+
+struct SimConfig {
+    std::string host = "127.0.0.1";
+    int port = 5000;
+    int boards = 100;
+    int concurrency = 0;
+    int threads = 0;
+    size_t chunk = 16384;
+    bool plain = false;
+};
+
+struct SimResults {
+    std::mutex lock;
+    std::vector<uint32_t> request_us;
+    std::vector<uint32_t> board_us;
+    uint64_t bytes = 0;
+    int failed = 0;
+};
+
+/* One board running the OTA sequence of fw_ota_download() */
+class SimBoard {
+public:
+    explicit SimBoard(const SimConfig &config) : config_(config) {}
+
+    bool start(SSL_CTX *ctx)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            return false;
+        }
+        stream_.fd = fd;
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(config_.port);
+        inet_pton(AF_INET, config_.host.c_str(), &addr.sin_addr);
+        if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 && errno != EINPROGRESS) {
+            return false;
+        }
+        if (ctx) {
+            stream_.ssl = SSL_new(ctx);
+            SSL_set_fd(stream_.ssl, fd);
+        }
+        started_ = now_us();
+        state_ = State::Connecting;
+        return true;
+    }
+
+    int fd() const { return stream_.fd; }
+    bool failed() const { return failed_; }
+    uint64_t started() const { return started_; }
+    uint64_t bytes() const { return bytes_; }
+    const std::vector<uint32_t> &request_us() const { return request_us_; }
+
+    /* Returns false once the board is done (successfully or not) */
+    bool drive()
+    {
+        for (;;) {
+            Io io;
+            switch (state_) {
+            case State::Connecting: {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                getsockopt(stream_.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                if (err) {
+                    return fail();
+                }
+                sockaddr_in peer;
+                len = sizeof(peer);
+                if (getpeername(stream_.fd, reinterpret_cast<sockaddr *>(&peer), &len) != 0) {
+                    return errno == ENOTCONN ? true : fail();
+                }
+                state_ = State::Handshake;
+                break;
+            }
+            case State::Handshake:
+                io = stream_.handshake(false);
+                if (io == Io::Again) {
+                    return true;
+                }
+                if (io == Io::Closed) {
+                    return fail();
+                }
+                request("/manifest", nullptr);
+                break;
+
+            case State::Send:
+                io = stream_.write_some(out_.data(), out_.size(), &out_written_);
+                if (io == Io::Again) {
+                    return true;
+                }
+                if (io == Io::Closed) {
+                    return fail();
+                }
+                state_ = State::Receive;
+                break;
+
+            case State::Receive: {
+                io = stream_.read_some(in_, SIZE_MAX);
+                if (io == Io::Closed) {
+                    return fail();
+                }
+                int done = parse_response();
+                if (done < 0) {
+                    return fail();
+                }
+                if (done == 0) {
+                    if (io == Io::Again) {
+                        return true;
+                    }
+                    break;
+                }
+                request_us_.push_back(now_us() - request_started_);
+                if (!next_request()) {
+                    return false;
+                }
+                break;
+            }
+            }
+        }
+    }
+
+private:
+    enum class State { Connecting, Handshake, Send, Receive };
+
+    bool fail()
+    {
+        failed_ = true;
+        return false;
+    }
+
+    void request(const char *uri, const char *range)
+    {
+        out_ = "GET ";
+        out_ += uri;
+        out_ += " HTTP/1.1\r\nHost: ";
+        out_ += config_.host;
+        out_ += "\r\nConnection: keep-alive\r\n";
+        if (range) {
+            out_ += "Range: ";
+            out_ += range;
+            out_ += "\r\n";
+        }
+        out_ += "\r\n";
+        out_written_ = 0;
+        in_.clear();
+        header_len_ = 0;
+        status_ = 0;
+        request_started_ = now_us();
+        state_ = State::Send;
+    }
+
+    /* 1 when the whole response is in, 0 when more is needed, -1 on error */
+    int parse_response()
+    {
+        if (!header_len_) {
+            size_t end = in_.find("\r\n\r\n");
+            if (end == std::string::npos) {
+                return in_.size() > MAX_REQUEST_SIZE ? -1 : 0;
+            }
+            header_len_ = end + 4;
+            if (sscanf(in_.c_str(), "HTTP/1.%*d %d", &status_) != 1) {
+                return -1;
+            }
+            const char *cl = strcasestr(in_.c_str(), "\r\ncontent-length:");
+            if (!cl || cl > in_.c_str() + end) {
+                return -1;
+            }
+            content_length_ = strtoull(cl + 17, nullptr, 10);
+        }
+        if (in_.size() < header_len_ + content_length_) {
+            return 0;
+        }
+        bytes_ += content_length_;
+        return 1;
+    }
+
+    bool next_request()
+    {
+        if (step_ == 0) {
+            /* Manifest: learn the image size */
+            const char *size = strstr(in_.c_str() + header_len_, "size=");
+            if (status_ != 200 || !size) {
+                return fail();
+            }
+            image_size_ = strtoull(size + 5, nullptr, 10);
+            offset_ = 0;
+        } else if (status_ != 206) {
+            return fail();
+        }
+        step_++;
+        if (offset_ >= image_size_) {
+            return false;
+        }
+        char range[64];
+        size_t last = std::min(offset_ + config_.chunk, image_size_) - 1;
+        snprintf(range, sizeof(range), "bytes=%zu-%zu", offset_, last);
+        offset_ = last + 1;
+        request("/firmware.bin", range);
+        return true;
+    }
+
+    const SimConfig &config_;
+    Stream stream_;
+    State state_ = State::Connecting;
+    std::string out_;
+    size_t out_written_ = 0;
+    std::string in_;
+    size_t header_len_ = 0;
+    size_t content_length_ = 0;
+    int status_ = 0;
+    int step_ = 0;
+    size_t image_size_ = 0;
+    size_t offset_ = 0;
+    uint64_t started_ = 0;
+    uint64_t request_started_ = 0;
+    uint64_t bytes_ = 0;
+    bool failed_ = false;
+    std::vector<uint32_t> request_us_;
+};
+
+void sim_loop(const SimConfig &config, SSL_CTX *ctx, int boards, int concurrency, SimResults &results)
+{
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    std::unordered_map<int, std::unique_ptr<SimBoard>> active;
+    epoll_event events[MAX_EVENTS];
+    int launched = 0;
+    std::vector<uint32_t> request_us;
+    std::vector<uint32_t> board_us;
+    uint64_t bytes = 0;
+    int failed = 0;
+
+    auto finish = [&](SimBoard *board) {
+        int fd = board->fd();
+        epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
+        if (board->failed()) {
+            failed++;
+        } else {
+            board_us.push_back(now_us() - board->started());
+        }
+        bytes += board->bytes();
+        request_us.insert(request_us.end(), board->request_us().begin(), board->request_us().end());
+        active.erase(fd);
+    };
+
+    while (launched < boards || !active.empty()) {
+        while (launched < boards && (int)active.size() < concurrency) {
+            launched++;
+            auto board = std::make_unique<SimBoard>(config);
+            if (!board->start(ctx)) {
+                failed++;
+                continue;
+            }
+            SimBoard *raw = board.get();
+            active[raw->fd()] = std::move(board);
+            epoll_event ev = {};
+            ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+            ev.data.ptr = raw;
+            epoll_ctl(epfd, EPOLL_CTL_ADD, raw->fd(), &ev);
+        }
+        int n = epoll_wait(epfd, events, MAX_EVENTS, 1000);
+        for (int i = 0; i < n; i++) {
+            SimBoard *board = static_cast<SimBoard *>(events[i].data.ptr);
+            if (!board->drive()) {
+                finish(board);
+            }
+        }
+    }
+    close(epfd);
+
+    std::lock_guard<std::mutex> guard(results.lock);
+    results.request_us.insert(results.request_us.end(), request_us.begin(), request_us.end());
+    results.board_us.insert(results.board_us.end(), board_us.begin(), board_us.end());
+    results.bytes += bytes;
+    results.failed += failed;
+}
+
+uint32_t percentile(std::vector<uint32_t> &values, double p)
+{
+    if (values.empty()) {
+        return 0;
+    }
+    size_t index = std::min(values.size() - 1, static_cast<size_t>(p * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+int run_simulator(const SimConfig &config)
+{
+    raise_fd_limit();
+    SSL_CTX *ctx = nullptr;
+    if (!config.plain) {
+        ctx = SSL_CTX_new(TLS_client_method());
+        SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, nullptr);
+        SSL_CTX_set_mode(ctx, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+    }
+
+    int threads = config.threads > 0 ? config.threads : std::max(1u, std::thread::hardware_concurrency());
+    int concurrency = config.concurrency > 0 ? config.concurrency : config.boards;
+    threads = std::min(threads, config.boards);
+
+    SimResults results;
+    std::vector<std::thread> workers;
+    uint64_t started = now_us();
+    for (int i = 0; i < threads; i++) {
+        int boards = config.boards / threads + (i < config.boards % threads);
+        int share = std::max(1, concurrency / threads + (i < concurrency % threads));
+        workers.emplace_back(sim_loop, std::cref(config), ctx, boards, share, std::ref(results));
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    double seconds = (now_us() - started) / 1e6;
+
+    printf("boards            %d (%d concurrent, %d threads, %s)\n", config.boards, concurrency, threads,
+           config.plain ? "plain HTTP" : "TLS");
+    printf("completed         %zu\n", results.board_us.size());
+    printf("failed            %d\n", results.failed);
+    printf("wall time         %.2f s\n", seconds);
+    printf("throughput        %.1f MB/s, %.0f req/s\n", results.bytes / 1e6 / seconds,
+           results.request_us.size() / seconds);
+    printf("request latency   p50 %.2f ms  p99 %.2f ms  max %.2f ms\n",
+           percentile(results.request_us, 0.50) / 1e3, percentile(results.request_us, 0.99) / 1e3,
+           percentile(results.request_us, 1.0) / 1e3);
+    printf("board update time p50 %.2f ms  p99 %.2f ms  max %.2f ms\n",
+           percentile(results.board_us, 0.50) / 1e3, percentile(results.board_us, 0.99) / 1e3,
+           percentile(results.board_us, 1.0) / 1e3);
+    SSL_CTX_free(ctx);
+    return results.failed ? 1 : 0;
+}
+
+void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [--port N] [--threads N] [--plain] [--cert PEM] [--key PEM]\n"
+            "          [--firmware BIN] [--manifest FILE] [--versioning FILE]\n"
+            "       %s --simulate BOARDS [--host IP] [--port N] [--concurrency N]\n"
+            "          [--threads N] [--chunk BYTES] [--plain]\n",
+            name, name);
+}
+
+void on_signal(int)
+{
+    g_running = false;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    ServerConfig server;
+    SimConfig sim;
+    bool simulate = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--plain") {
+            server.plain = sim.plain = true;
+        } else if (arg == "--port" && has_value) {
+            server.port = sim.port = atoi(argv[++i]);
+        } else if (arg == "--threads" && has_value) {
+            server.threads = sim.threads = atoi(argv[++i]);
+        } else if (arg == "--cert" && has_value) {
+            server.cert = argv[++i];
+        } else if (arg == "--key" && has_value) {
+            server.key = argv[++i];
+        } else if (arg == "--firmware" && has_value) {
+            server.firmware = argv[++i];
+        } else if (arg == "--manifest" && has_value) {
+            server.manifest = argv[++i];
+        } else if (arg == "--versioning" && has_value) {
+            server.versioning = argv[++i];
+        } else if (arg == "--simulate" && has_value) {
+            simulate = true;
+            sim.boards = atoi(argv[++i]);
+        } else if (arg == "--host" && has_value) {
+            sim.host = argv[++i];
+        } else if (arg == "--concurrency" && has_value) {
+            sim.concurrency = atoi(argv[++i]);
+        } else if (arg == "--chunk" && has_value) {
+            sim.chunk = strtoul(argv[++i], nullptr, 10);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    if (simulate) {
+        if (sim.boards <= 0 || sim.chunk == 0) {
+            usage(argv[0]);
+            return 2;
+        }
+        return run_simulator(sim);
+    }
+    return run_server(server);
+}
@@ -1,8 +1,63 @@
 FILENAME_BUILDNO = 'versioning'
 FILENAME_VERSION_H = 'include/version.h'
+FILENAME_MANIFEST = 'manifest'
+# Private key the manifests are signed with, its public half is embedded in
+# the firmware as signing_key_pub.pem:
+#   openssl ecparam -name prime256v1 -genkey -noout -out signing_key.pem
+#   openssl ec -in signing_key.pem -pubout -out signing_key_pub.pem
+FILENAME_SIGNING_KEY = 'signing_key.pem'
+# Must match FW_OTA_MAX_CHUNK_SIZE on the device
+CHUNK_SIZE = 16384
 version = 'v0.1.'
 
 import datetime
+import hashlib
+import os
+import subprocess
+import sys
+
+
+def sign(data):
+    """DER encoded ECDSA signature of SHA-256(data), as mbedtls_pk_verify() expects it."""
+    key = os.environ.get('FIRMWARE_SIGNING_KEY', FILENAME_SIGNING_KEY)
+    return subprocess.run(['openssl', 'dgst', '-sha256', '-sign', key],
+                          input=data, stdout=subprocess.PIPE, check=True).stdout
+
+
+def write_manifest(image_path, build_no):
+    """Describe the image so the device can verify it while it streams:
+    build number, total size, the root (SHA-256 over the chunk digests) and
+    a signature over those header lines, then one SHA-256 per CHUNK_SIZE range."""
+    with open(image_path, 'rb') as f:
+        image = f.read()
+
+    chunks = [image[i:i + CHUNK_SIZE] for i in range(0, len(image), CHUNK_SIZE)]
+    digests = [hashlib.sha256(c).digest() for c in chunks]
+    header = [
+        'build={}'.format(build_no),
+        'size={}'.format(len(image)),
+        'chunk={}'.format(CHUNK_SIZE),
+        'root={}'.format(hashlib.sha256(b''.join(digests)).hexdigest()),
+    ]
+    # The device rebuilds exactly this text to check the signature
+    signed = ''.join(line + '\n' for line in header)
+    lines = header + [
+        'sig={}'.format(sign(signed.encode()).hex()),
+        'chunks={}'.format(len(chunks)),
+    ]
+    lines += [d.hex() for d in digests]
+
+    with open(FILENAME_MANIFEST, 'w+') as f:
+        f.write('\n'.join(lines) + '\n')
+    print('Manifest: {} bytes in {} chunks'.format(len(image), len(chunks)))
+
+
+# python versioning.py --manifest <firmware.bin> regenerates the manifest
+# for the current build number without bumping it
+if len(sys.argv) == 3 and sys.argv[1] == '--manifest':
+    with open(FILENAME_BUILDNO) as f:
+        write_manifest(sys.argv[2], int(f.readline()))
+    sys.exit(0)
 
 build_no = 0
 try:
@@ -27,4 +82,13 @@ hf = """
 #endif
 """.format(build_no, version+str(build_no), datetime.datetime.now(), version+str(build_no))
 with open(FILENAME_VERSION_H, 'w+') as f:
-    f.write(hf)
\ No newline at end of file
+    f.write(hf)
+
+# When run by PlatformIO as an extra script, refresh the manifest once the
+# final image has been written
+try:
+    Import("env")
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.bin",
+                      lambda target, source, env: write_manifest(str(target[0]), build_no))
+except NameError:
+    pass
\ No newline at end of file
@@ -7,6 +7,7 @@
    CONDITIONS OF ANY KIND, either express or implied.
 */
 #include <string.h>
+#include <sys/param.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
@@ -14,6 +15,7 @@
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 #include "mdns.h"
 
@@ -24,6 +26,11 @@
 #include "lwip/netdb.h"
 #include <driver/gpio.h>
 
+#include "../common/boot-prof.h"
+#include "mdns-cache.h"
+#include "mdns-resolver.h"
+#include "node-caps.h"
+
 #define GPIO_OUTPUT_IO 4
 #define GPIO_OUTPUT_PIN_SEL (1ULL<<GPIO_OUTPUT_IO)
 
@@ -31,8 +38,11 @@
 #define CONFIG_ESP_WIFI_PASS      "IoT-IoT-IoT"
 #define CONFIG_ESP_MAXIMUM_RETRY  5
 #define CONFIG_LOCAL_PORT         10001
-
-static const char * ip_protocol_str[] = {"V4", "V6", "MAX"};
+/* 1: configure the pins and start the tasks while Wi-Fi associates,
+ * 0: start them only once the station got an IP */
+#define CONFIG_FAST_BOOT          0
+/* Firmware build published in the cap TXT item */
+#define CONFIG_FW_BUILD           1
 
 /* FreeRTOS event group to signal when we are connected*/
 static EventGroupHandle_t s_wifi_event_group;
@@ -52,6 +62,8 @@ static void event_handler(void* arg, esp_event_base_t event_base,
 {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
         esp_wifi_connect();
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        boot_prof_mark(BOOT_PHASE_WIFI_CONNECTED);
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
         if (s_retry_num < CONFIG_ESP_MAXIMUM_RETRY) {
             esp_wifi_connect();
@@ -65,11 +77,13 @@ static void event_handler(void* arg, esp_event_base_t event_base,
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
         ESP_LOGI(TAG, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
         s_retry_num = 0;
+        boot_prof_mark(BOOT_PHASE_GOT_IP);
         xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
     }
 }
 
-bool wifi_init_sta(void)
+/* Starts the station without waiting for the connection */
+void wifi_start_sta(void)
 {
     s_wifi_event_group = xEventGroupCreate();
 
@@ -103,6 +117,23 @@ bool wifi_init_sta(void)
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA) );
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config) );
     ESP_ERROR_CHECK(esp_wifi_start() );
+    boot_prof_mark(BOOT_PHASE_WIFI_STARTED);
+}
+
+/* Returns true once the station has an IP, false if it gave up or timed out */
+static bool wifi_sta_wait(TickType_t timeout)
+{
+    EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
+            WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
+            pdFALSE,
+            pdFALSE,
+            timeout);
+    return bits & WIFI_CONNECTED_BIT;
+}
+
+bool wifi_init_sta(void)
+{
+    wifi_start_sta();
 
     ESP_LOGI(TAG, "wifi_init_sta finished.");
 
@@ -153,13 +184,14 @@ void add_mdns_services()
     //use custom instance for the web server
     mdns_service_instance_name_set("_esp32", "_udp", "Dummy esp32 service description");
 
-    mdns_txt_item_t serviceTxtData[3] = {
-        {"board","{esp32}"},
-        {"u","user"},
-        {"p","password"}
+    //what this board can do, so clients need no extra round trip to find out;
+    //it only announces itself and takes no commands
+    node_caps_t caps = {
+        .formats = 0,
+        .pins = 0,
+        .build = CONFIG_FW_BUILD,
     };
-    //set txt data for service (will free and replace current data)
-    mdns_service_txt_set("_esp32", "_udp", serviceTxtData, 3);
+    node_caps_publish("_esp32", "_udp", &caps);
 }
 
 void resolve_mdns_host(const char * host_name)
@@ -169,7 +201,8 @@ void resolve_mdns_host(const char * host_name)
     struct ip4_addr addr;
     addr.addr = 0;
 
-    int err = mdns_query_a(host_name, 2000,  (esp_ip4_addr_t*) &addr);
+    //answers, NOT_FOUND included, are cached and concurrent lookups share one query
+    int err = mdns_resolve_host(host_name, (esp_ip4_addr_t*) &addr);
     if(err){
         if(err == ESP_ERR_NOT_FOUND){
             ESP_LOGI(TAG, "Host was not found!");
@@ -182,66 +215,74 @@ void resolve_mdns_host(const char * host_name)
     printf(IPSTR, IP2STR(&addr));
 }
 
-static void mdns_print_results(mdns_result_t *results)
+static void mdns_print_results(const mdns_cache_entry_t *entries, size_t count)
 {
-    mdns_result_t *r = results;
-    mdns_ip_addr_t *a = NULL;
-    int i = 1, t;
-    while (r) {
-        if (r->esp_netif) {
-            printf("%d: Interface: %s, Type: %s, TTL: %" PRIu32 "\n", i++, esp_netif_get_ifkey(r->esp_netif),
-                   ip_protocol_str[r->ip_protocol], r->ttl);
-        }
-        if (r->instance_name) {
-            printf("  PTR : %s.%s.%s\n", r->instance_name, r->service_type, r->proto);
+    int64_t now = esp_timer_get_time();
+    for (size_t i = 0; i < count; i++) {
+        const mdns_cache_entry_t *e = &entries[i];
+        printf("%d: TTL: %" PRIu32 " (expires in %lld s)\n", (int)i + 1, e->ttl,
+               (long long)((e->expires_us - now) / 1000000));
+        printf("  PTR : %s.%s.%s\n", e->instance, e->service, e->proto);
+        if (e->hostname[0]) {
+            printf("  SRV : %s.local:%u\n", e->hostname, e->port);
         }
-        if (r->hostname) {
-            printf("  SRV : %s.local:%u\n", r->hostname, r->port);
-        }
-        if (r->txt_count) {
-            printf("  TXT : [%zu] ", r->txt_count);
-            for (t = 0; t < r->txt_count; t++) {
-                printf("%s=%s(%d); ", r->txt[t].key, r->txt[t].value ? r->txt[t].value : "NULL", r->txt_value_len[t]);
+        if (e->txt_len) {
+            printf("  TXT : ");
+            for (size_t pos = 0; pos < e->txt_len; pos += strlen(e->txt + pos) + 1) {
+                printf("%s; ", e->txt + pos);
             }
             printf("\n");
         }
-        a = r->addr;
-        while (a) {
-            if (a->addr.type == ESP_IPADDR_TYPE_V6) {
-                printf("  AAAA: " IPV6STR "\n", IPV62STR(a->addr.u_addr.ip6));
-            } else {
-                printf("  A   : " IPSTR "\n", IP2STR(&(a->addr.u_addr.ip4)));
-            }
-            a = a->next;
+        node_caps_t caps;
+        const char *cap = mdns_cache_txt_get(e, NODE_CAPS_TXT_KEY);
+        if (cap && node_caps_decode(cap, &caps)) {
+            printf("  CAP : v%u formats 0x%x pins %u build %" PRIu32 " load %u%%\n",
+                   caps.version, caps.formats, caps.pins, caps.build, caps.load);
+        }
+        if (e->addr.addr) {
+            printf("  A   : " IPSTR "\n", IP2STR(&e->addr));
         }
-        r = r->next;
     }
 }
 
 void find_mdns_service(const char * service_name, const char * proto)
 {
-    ESP_LOGI(TAG, "Query PTR: %s.%s.local", service_name, proto);
+    //too big for the task stack, only mdns_task calls this
+    static mdns_cache_entry_t entries[MDNS_CACHE_MAX_ENTRIES];
 
-    mdns_result_t * results = NULL;
-    esp_err_t err = mdns_query_ptr(service_name, proto, 5000, 20,  &results);
-    if(err){
-        ESP_LOGE(TAG, "Query Failed");
-        return;
-    }
-    if(!results){
+    ESP_LOGI(TAG, "Cached PTR: %s.%s.local", service_name, proto);
+
+    size_t count = mdns_cache_get(service_name, proto, entries, MDNS_CACHE_MAX_ENTRIES);
+    if(!count){
         ESP_LOGW(TAG, "No results found!");
         return;
     }
 
-    mdns_print_results(results);
-    mdns_query_results_free(results);
+    boot_prof_mark(BOOT_PHASE_FIRST_PACKET);
+    mdns_print_results(entries, MIN(count, MDNS_CACHE_MAX_ENTRIES));
+}
+
+static void mdns_cache_changed(mdns_cache_event_t event, const mdns_cache_entry_t *entry, void *arg)
+{
+    static const char *event_str[] = {"added", "changed", "removed"};
+    ESP_LOGI(TAG, "%s.%s.%s %s (" IPSTR ":%u)", entry->instance, entry->service, entry->proto,
+             event_str[event], IP2STR(&entry->addr), entry->port);
 }
 
 static void mdns_task(void *pvParameters)
 {
+    //returns at once unless the task was started before the connection (fast boot)
+    if (!wifi_sta_wait(portMAX_DELAY)) {
+        vTaskDelete(NULL);
+    }
+
     start_mdns_service();
     add_mdns_services();
 
+    //the answers keep the cache up to date, the loop below only reads it
+    mdns_cache_subscribe(mdns_cache_changed, NULL);
+    mdns_cache_browse("_esp32", "_udp");
+
     while(1) {
         resolve_mdns_host("esp32_BUTACU");
         find_mdns_service("_esp32", "_udp");
@@ -251,19 +292,8 @@ static void mdns_task(void *pvParameters)
     vTaskDelete(NULL);
 }
 
-void app_main(void)
+static void gpio_init(void)
 {
-    //Initialize NVS
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        ret = nvs_flash_init();
-    }
-    ESP_ERROR_CHECK(ret);
-
-    ESP_LOGI(TAG, "ESP_WIFI_MODE_STA");
-    bool connected = wifi_init_sta();
-
     //zero-initialize the config structure.
     gpio_config_t io_conf = {};
     //disable interrupt
@@ -278,8 +308,40 @@ void app_main(void)
     io_conf.pull_up_en = 0;
     //configure GPIO with the given settings
     gpio_config(&io_conf);
+    boot_prof_mark(BOOT_PHASE_GPIO_READY);
+}
+
+void app_main(void)
+{
+    boot_prof_mark(BOOT_PHASE_APP_MAIN);
+
+    //Initialize NVS
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(ret);
+    boot_prof_mark(BOOT_PHASE_NVS_READY);
+    // Before the tasks, so the resolver is never set up twice
+    ESP_ERROR_CHECK(mdns_resolver_init());
+
+#if CONFIG_FAST_BOOT
+    //mdns_task waits for the IP by itself
+    gpio_init();
+    ESP_LOGI(TAG, "ESP_WIFI_MODE_STA");
+    wifi_start_sta();
+    xTaskCreate(mdns_task, "mdns_task", 4096, NULL, 5, NULL);
+    boot_prof_mark(BOOT_PHASE_TASKS_STARTED);
+#else
+    ESP_LOGI(TAG, "ESP_WIFI_MODE_STA");
+    bool connected = wifi_init_sta();
+
+    gpio_init();
 
     if (connected) {
         xTaskCreate(mdns_task, "mdns_task", 4096, NULL, 5, NULL);
+        boot_prof_mark(BOOT_PHASE_TASKS_STARTED);
     }
+#endif
 }
\ No newline at end of file
@@ -7,13 +7,18 @@
 	 CONDITIONS OF ANY KIND, either express or implied.
 */
 #include <string.h>
+#include <stdlib.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
 #include "esp_system.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_random.h"
 #include "nvs_flash.h"
 #include "mdns.h"
 
@@ -24,6 +29,15 @@
 #include "lwip/netdb.h"
 #include <driver/gpio.h>
 
+#include "../common/boot-prof.h"
+#include "udp-pool.h"
+#include "mdns-cache.h"
+#include "peer-table.h"
+#include "udp-fanout.h"
+#include "peer-probe.h"
+#include "node-caps.h"
+#include "relay.h"
+
 #define GPIO_OUTPUT_IO 4
 #define GPIO_OUTPUT_PIN_SEL (1ULL << GPIO_OUTPUT_IO)
 
@@ -31,6 +45,19 @@
 #define CONFIG_ESP_WIFI_PASS "IoT-IoT-IoT"
 #define CONFIG_ESP_MAXIMUM_RETRY 5
 #define CONFIG_LOCAL_PORT 10001
+/* 1: configure the pins and start the tasks while Wi-Fi associates,
+ * 0: start them only once the station got an IP */
+#define CONFIG_FAST_BOOT 0
+/* How the next board to command is picked, see peer-table.h */
+#define CONFIG_PEER_POLICY PEER_POLICY_MIN_RTT
+/* 1: every command goes to all the boards found, 0: to the one picked */
+#define CONFIG_SEND_TO_ALL 0
+/* Firmware build published in the cap TXT item */
+#define CONFIG_FW_BUILD 1
+/* 1: boards that stopped answering probes also get the command through
+ * the others, see relay.h. Only send to all mode starts relays, every mode
+ * forwards them */
+#define CONFIG_RELAY 1
 
 /* FreeRTOS event group to signal when we are connected*/
 static EventGroupHandle_t s_wifi_event_group;
@@ -45,6 +72,12 @@ static const char *TAG = "wifi station";
 
 static int s_retry_num = 0;
 
+/* The _control_led._udp boards, kept in sync with the mDNS cache */
+static peer_table_t s_peers;
+static SemaphoreHandle_t s_peers_lock;
+/* Commands travelling through us, used under s_peers_lock */
+static relay_t s_relay;
+
 static void event_handler(void *arg, esp_event_base_t event_base,
 													int32_t event_id, void *event_data)
 {
@@ -52,6 +85,10 @@ static void event_handler(void *arg, esp_event_base_t event_base,
 	{
 		esp_wifi_connect();
 	}
+	else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED)
+	{
+		boot_prof_mark(BOOT_PHASE_WIFI_CONNECTED);
+	}
 	else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED)
 	{
 		if (s_retry_num < CONFIG_ESP_MAXIMUM_RETRY)
@@ -71,11 +108,13 @@ static void event_handler(void *arg, esp_event_base_t event_base,
 		ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
 		ESP_LOGI(TAG, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
 		s_retry_num = 0;
+		boot_prof_mark(BOOT_PHASE_GOT_IP);
 		xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
 	}
 }
 
-bool wifi_init_sta(void)
+/* Starts the station without waiting for the connection */
+void wifi_start_sta(void)
 {
 	s_wifi_event_group = xEventGroupCreate();
 
@@ -109,6 +148,23 @@ bool wifi_init_sta(void)
 	ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
 	ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
 	ESP_ERROR_CHECK(esp_wifi_start());
+	boot_prof_mark(BOOT_PHASE_WIFI_STARTED);
+}
+
+/* Returns true once the station has an IP, false if it gave up or timed out */
+static bool wifi_sta_wait(TickType_t timeout)
+{
+	EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
+																				 WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
+																				 pdFALSE,
+																				 pdFALSE,
+																				 timeout);
+	return bits & WIFI_CONNECTED_BIT;
+}
+
+bool wifi_init_sta(void)
+{
+	wifi_start_sta();
 
 	ESP_LOGI(TAG, "wifi_init_sta finished.");
 
@@ -140,47 +196,22 @@ bool wifi_init_sta(void)
 	return false;
 }
 
-void udp_send_led(struct ip4_addr *dest_ip, int port)
+static bool s_toggle = false;
+
+void udp_send_led(const struct sockaddr_in *dest_addr)
 {
-	static bool toggle = false;
 	char payload[8] = "GPIO4=0";
-  if (toggle == 1) {
-  	payload[6] = '1';
-  }
-
-	// Init socket
-	int addr_family = 0;
-  int ip_protocol = 0;
-	struct sockaddr_in dest_addr;
+	if (s_toggle == 1)
+	{
+		payload[6] = '1';
+	}
 
-  dest_addr.sin_addr.s_addr = dest_ip->addr;
-  dest_addr.sin_family = AF_INET;
-  dest_addr.sin_port = htons(port);
-  addr_family = AF_INET;
-  ip_protocol = IPPROTO_IP;
-
-	int sock = socket(addr_family, SOCK_DGRAM, ip_protocol);
-	if (sock < 0) {
-    ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
-    return;
-  }
-	ESP_LOGI(TAG, "Socket created");
-
-	struct timeval timeout;
-  timeout.tv_sec = 10;
-  timeout.tv_usec = 0;
-  setsockopt (sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
-
-	int err = sendto(sock, payload, strlen(payload), 0, (struct sockaddr *)&dest_addr, sizeof(dest_addr));
-  if (err < 0) {
-  	ESP_LOGE(TAG, "Error occurred during sending: errno %d", errno);
-  } else {
+	// The socket for this peer stays open for the next commands
+	if (udp_pool_send(dest_addr, payload, strlen(payload)) == ESP_OK)
+	{
 		ESP_LOGI(TAG, "Message sent");
-		toggle = !toggle;
+		s_toggle = !s_toggle;
 	}
-
-	shutdown(sock, 0);
-	close(sock);
 }
 
 void start_mdns_service()
@@ -199,10 +230,24 @@ void start_mdns_service()
 	mdns_instance_name_set("ESP32 Thing");
 }
 
+// Relayed commands are addressed by instance name, so every board needs its own
+static char s_instance[32];
+
 void add_mdns_services()
 {
+	uint8_t mac[6];
+	esp_read_mac(mac, ESP_MAC_WIFI_STA);
+	snprintf(s_instance, sizeof(s_instance), "control_led %02x%02x%02x", mac[3], mac[4], mac[5]);
+
 	mdns_service_add(NULL, "_control_led", "_udp", CONFIG_LOCAL_PORT, NULL, 0);
-	mdns_service_instance_name_set("_control_led", "_udp", "Dummy esp32 service description");
+	mdns_service_instance_name_set("_control_led", "_udp", s_instance);
+
+	node_caps_t caps = {
+			.formats = NODE_CAPS_FMT_GPIO | NODE_CAPS_FMT_PING,
+			.pins = 1,
+			.build = CONFIG_FW_BUILD,
+	};
+	node_caps_publish("_control_led", "_udp", &caps);
 }
 
 struct ip4_addr resolve_mdns_host(const char *host_name)
@@ -227,81 +272,220 @@ struct ip4_addr resolve_mdns_host(const char *host_name)
 	return addr;
 }
 
-size_t mdns_result_len(mdns_result_t *results)
+static void peer_cache_changed(mdns_cache_event_t event, const mdns_cache_entry_t *entry, void *arg)
+{
+	// Boards without a cap item predate it and take GPIO commands
+	node_caps_t caps;
+	const char *cap = mdns_cache_txt_get(entry, NODE_CAPS_TXT_KEY);
+	bool has_caps = cap && node_caps_decode(cap, &caps);
+	bool takes_gpio = !has_caps || node_caps_supports(&caps, NODE_CAPS_FMT_GPIO);
+
+	xSemaphoreTake(s_peers_lock, portMAX_DELAY);
+	// A peer is only usable once its address is known
+	if (event == MDNS_CACHE_REMOVED || entry->addr.addr == 0 || entry->port == 0 || !takes_gpio)
+	{
+		int index = peer_table_find(&s_peers, entry->instance);
+		if (index >= 0)
+		{
+			udp_pool_forget(&s_peers.peers[index].addr);
+			peer_table_remove(&s_peers, entry->instance);
+		}
+	}
+	else
+	{
+		struct sockaddr_in addr = {
+				.sin_family = AF_INET,
+				.sin_port = htons(entry->port),
+				.sin_addr.s_addr = entry->addr.addr,
+		};
+		// An explicit weight wins over the one derived from the load
+		const char *weight_txt = mdns_cache_txt_get(entry, "weight");
+		uint16_t weight = 1;
+		if (weight_txt)
+		{
+			// Clamped here, a negative value would wrap in the uint16_t
+			int value = atoi(weight_txt);
+			weight = value < 1 ? 1 : value > PEER_TABLE_MAX_WEIGHT ? PEER_TABLE_MAX_WEIGHT : value;
+		}
+		else if (has_caps)
+		{
+			weight = node_caps_weight(&caps, PEER_TABLE_MAX_WEIGHT);
+		}
+		if (peer_table_upsert(&s_peers, entry->instance, &addr, weight) < 0)
+		{
+			ESP_LOGW(TAG, "Peer table full, ignoring %s", entry->instance);
+		}
+	}
+	xSemaphoreGive(s_peers_lock);
+}
+
+#if !CONFIG_SEND_TO_ALL
+static void peer_select_and_send(void)
 {
-	size_t l = 0;
-	mdns_result_t *r = results;
-	while (r)
+	struct sockaddr_in dest_addr;
+
+	xSemaphoreTake(s_peers_lock, portMAX_DELAY);
+	int index = peer_table_select(&s_peers);
+	if (index >= 0)
 	{
-		l++;
-		r = r->next;
+		dest_addr = s_peers.peers[index].addr;
+	}
+	xSemaphoreGive(s_peers_lock);
+
+	if (index < 0)
+	{
+		ESP_LOGI(TAG, "No _control_led._udp board found yet");
+		return;
 	}
-	return l;
+	udp_send_led(&dest_addr);
 }
+#endif
 
-void mdns_select_and_send(mdns_result_t *results, int i)
+#if CONFIG_RELAY && CONFIG_SEND_TO_ALL
+// Boards that stopped answering probes may still hear the ones that answer
+static void relay_send_unhealthy(const char *command)
 {
-	mdns_result_t *r = results;
-	mdns_ip_addr_t *a = NULL;
-	size_t l = 0;
-	while (r)
+	static relay_action_t action;
+	char dest[PEER_TABLE_NAME_LEN];
+
+	for (size_t i = 0; i < PEER_TABLE_MAX; i++)
 	{
-		if (l == i)
+		xSemaphoreTake(s_peers_lock, portMAX_DELAY);
+		if (i >= s_peers.count)
+		{
+			xSemaphoreGive(s_peers_lock);
+			break;
+		}
+		strlcpy(dest, s_peers.names[i], sizeof(dest));
+		bool routed = !peer_healthy(&s_peers.peers[i]) && relay_originate(&s_relay, &s_peers, dest, command, &action);
+		xSemaphoreGive(s_peers_lock);
+
+		if (routed)
 		{
-			a = r->addr;
-			while (a)
+			for (size_t j = 0; j < action.next_count; j++)
 			{
-				if (a->addr.type == ESP_IPADDR_TYPE_V4)
-				{
-					// It should send here to the another board
-					udp_send_led((struct ip4_addr *)&a->addr.u_addr.ip4, r->port);
-					return;
-				}
-				a = a->next;
+				udp_pool_send(&action.next[j], action.msg, action.len);
 			}
-			ESP_LOGI(TAG, "No IPV4 on that service!");
-			return;
+			ESP_LOGI(TAG, "Relayed through %u boards for %s", (unsigned)action.next_count, dest);
 		}
-		l++;
-		r = r->next;
 	}
 }
+#endif
 
-static void mdns_result_rand_send(mdns_result_t *results)
+#if CONFIG_SEND_TO_ALL
+static void peer_send_all(void)
 {
-	size_t length = mdns_result_len(results);
+	// Copied so the cache callback is not blocked for the whole pass
+	static peer_t peers[PEER_TABLE_MAX];
+	char payload[8] = "GPIO4=0";
+	if (s_toggle == 1)
+	{
+		payload[6] = '1';
+	}
 
-	int rand_number = rand() % length;
-	mdns_select_and_send(results, rand_number);
-}
+	xSemaphoreTake(s_peers_lock, portMAX_DELAY);
+	size_t count = s_peers.count;
+	memcpy(peers, s_peers.peers, count * sizeof(peer_t));
+	xSemaphoreGive(s_peers_lock);
 
-static void mdns_find_and_send_service(const char* service_name, const char* instance_name)
-{
-	mdns_result_t *results = NULL;
-	ESP_LOGI(TAG, "Querying service %s.%s.local", service_name, instance_name);
-	int err = mdns_query_ptr(service_name, instance_name, 5000, 10, &results);
-	if (err)
+	if (count == 0)
 	{
-		ESP_LOGI(TAG, "Query Failed");
+		ESP_LOGI(TAG, "No _control_led._udp board found yet");
 		return;
 	}
 
-	mdns_result_rand_send(results);
-	mdns_query_results_free(results);
+	udp_fanout_result_t result;
+	udp_fanout_send(peers, count, payload, strlen(payload), &result);
+	ESP_LOGI(TAG, "Message sent to %u/%u boards in %lld us", (unsigned)result.sent, (unsigned)count,
+					 (long long)result.elapsed_us);
+	if (result.sent)
+	{
+		s_toggle = !s_toggle;
+	}
+#if CONFIG_RELAY
+	relay_send_unhealthy(payload);
+#endif
 }
+#endif
 
 static void mdns_task(void *pvParameters)
 {
+	// Returns at once unless the task was started before the connection (fast boot)
+	if (!wifi_sta_wait(portMAX_DELAY))
+	{
+		vTaskDelete(NULL);
+	}
+
 	start_mdns_service();
 	add_mdns_services();
 
+	peer_table_init(&s_peers, CONFIG_PEER_POLICY);
+	relay_init(&s_relay, s_instance, esp_random());
+	s_peers_lock = xSemaphoreCreateMutex();
+	mdns_cache_subscribe(peer_cache_changed, NULL);
+	mdns_cache_browse("_control_led", "_udp");
+	peer_probe_start(&s_peers, s_peers_lock);
+
 	while (1)
 	{
-		mdns_find_and_send_service("_control_led", "_udp");
+#if CONFIG_SEND_TO_ALL
+		peer_send_all();
+#else
+		peer_select_and_send();
+#endif
+		udp_pool_evict_idle(UDP_POOL_IDLE_US);
+		node_caps_update_load();
 		vTaskDelay(2000 / portTICK_PERIOD_MS);
 	}
 }
 
+static void handle_command(const char *command)
+{
+	if (strcmp(command, "GPIO4=1") == 0)
+	{
+		gpio_set_level(GPIO_OUTPUT_IO, 0);
+		node_caps_count_command();
+	}
+	else if (strcmp(command, "GPIO4=0") == 0)
+	{
+		gpio_set_level(GPIO_OUTPUT_IO, 1);
+		node_caps_count_command();
+	}
+	else
+	{
+		ESP_LOGI(TAG, "Invalid message %s", command);
+	}
+}
+
+/* Commands wait here for command_task, so udp_task keeps answering probes
+ * while the LED is paced */
+#define COMMAND_QUEUE_LEN 8
+#define COMMAND_LEN 16
+static QueueHandle_t s_commands;
+
+static void command_task(void *pvParameters)
+{
+	char command[COMMAND_LEN];
+
+	while (1)
+	{
+		xQueueReceive(s_commands, command, portMAX_DELAY);
+		handle_command(command);
+		vTaskDelay(200 / portTICK_PERIOD_MS);
+	}
+}
+
+static void queue_command(const char *command)
+{
+	char item[COMMAND_LEN];
+
+	strlcpy(item, command, sizeof(item));
+	if (xQueueSend(s_commands, item, 0) != pdTRUE)
+	{
+		ESP_LOGW(TAG, "Command queue full, dropped %s", item);
+	}
+}
+
 static void udp_task(void *pvParameters)
 {
 	char rx_buffer[128];
@@ -316,6 +500,9 @@ static void udp_task(void *pvParameters)
 	ip_protocol = IPPROTO_IP;
 	addr_family = AF_INET;
 
+	s_commands = xQueueCreate(COMMAND_QUEUE_LEN, COMMAND_LEN);
+	xTaskCreate(command_task, "command_task", 2048, NULL, 5, NULL);
+
 	while (1)
 	{
 		int sock = socket(addr_family, SOCK_DGRAM, ip_protocol);
@@ -350,23 +537,48 @@ static void udp_task(void *pvParameters)
 			{
 				inet_ntoa_r(((struct sockaddr_in *)&source_addr)->sin_addr, addr_str, sizeof(addr_str) - 1);
 				rx_buffer[len] = 0; // Null-terminate whatever we received and treat like a string
+
+				// Probes are answered at once, a wait here would count in their RTT
+				char reply[32];
+				size_t reply_len;
+				if (peer_probe_answer(rx_buffer, len, reply, sizeof(reply), &reply_len))
+				{
+					sendto(sock, reply, reply_len, 0, &source_addr, socklen);
+					continue;
+				}
+
+				boot_prof_mark(BOOT_PHASE_FIRST_PACKET);
 				// ESP_LOGI(TAG, "Received %d bytes from %s:", len, addr_str);
 				// ESP_LOGI(TAG, "%s", rx_buffer);
-				if (strcmp(rx_buffer, "GPIO4=1") == 0)
+
+				// Relay messages are passed on at once as well, the table is ready once the lock is
+				static relay_action_t action;
+				bool relayed = false;
+				if (s_peers_lock)
 				{
-					gpio_set_level(GPIO_OUTPUT_IO, 0);
+					xSemaphoreTake(s_peers_lock, portMAX_DELAY);
+					relayed = relay_handle(&s_relay, &s_peers, (struct sockaddr_in *)&source_addr, rx_buffer, len,
+																 &action);
+					xSemaphoreGive(s_peers_lock);
 				}
-				else if (strcmp(rx_buffer, "GPIO4=0") == 0)
+				if (relayed)
 				{
-					gpio_set_level(GPIO_OUTPUT_IO, 1);
+					for (size_t i = 0; i < action.next_count; i++)
+					{
+						sendto(sock, action.msg, action.len, 0, (struct sockaddr *)&action.next[i], sizeof(action.next[i]));
+					}
+					if (!action.deliver)
+					{
+						continue;
+					}
+					ESP_LOGI(TAG, "Relayed command from %s after %u hops", addr_str, action.hops);
+					queue_command(action.command);
 				}
 				else
 				{
-					ESP_LOGI(TAG, "Invalid message %s", rx_buffer);
+					queue_command(rx_buffer);
 				}
 			}
-
-			vTaskDelay(200 / portTICK_PERIOD_MS);
 		}
 
 		if (sock != -1)
@@ -379,20 +591,8 @@ static void udp_task(void *pvParameters)
 	vTaskDelete(NULL);
 }
 
-void app_main(void)
+static void gpio_init(void)
 {
-	// Initialize NVS
-	esp_err_t ret = nvs_flash_init();
-	if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
-	{
-		ESP_ERROR_CHECK(nvs_flash_erase());
-		ret = nvs_flash_init();
-	}
-	ESP_ERROR_CHECK(ret);
-
-	ESP_LOGI(TAG, "ESP_WIFI_MODE_STA");
-	bool connected = wifi_init_sta();
-
 	// zero-initialize the config structure.
 	gpio_config_t io_conf = {};
 	// disable interrupt
@@ -407,10 +607,44 @@ void app_main(void)
 	io_conf.pull_up_en = 0;
 	// configure GPIO with the given settings
 	gpio_config(&io_conf);
+	boot_prof_mark(BOOT_PHASE_GPIO_READY);
+}
+
+void app_main(void)
+{
+	boot_prof_mark(BOOT_PHASE_APP_MAIN);
+
+	// Initialize NVS
+	esp_err_t ret = nvs_flash_init();
+	if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
+	{
+		ESP_ERROR_CHECK(nvs_flash_erase());
+		ret = nvs_flash_init();
+	}
+	ESP_ERROR_CHECK(ret);
+	boot_prof_mark(BOOT_PHASE_NVS_READY);
+	// Before the tasks, mdns_task sends through the pool and the cache task forgets peers in it
+	ESP_ERROR_CHECK(udp_pool_init());
+
+#if CONFIG_FAST_BOOT
+	// The LED and the UDP listener do not need the IP, only mdns_task waits for it
+	gpio_init();
+	ESP_LOGI(TAG, "ESP_WIFI_MODE_STA");
+	wifi_start_sta();
+	xTaskCreate(udp_task, "udp_task", 4096, NULL, 5, NULL);
+	xTaskCreate(mdns_task, "mdns_task", 4096, NULL, 5, NULL);
+	boot_prof_mark(BOOT_PHASE_TASKS_STARTED);
+#else
+	ESP_LOGI(TAG, "ESP_WIFI_MODE_STA");
+	bool connected = wifi_init_sta();
+
+	gpio_init();
 
 	if (connected)
 	{
 		xTaskCreate(udp_task, "udp_task", 4096, NULL, 5, NULL);
 		xTaskCreate(mdns_task, "mdns_task", 4096, NULL, 5, NULL);
+		boot_prof_mark(BOOT_PHASE_TASKS_STARTED);
 	}
+#endif
 }
\ No newline at end of file
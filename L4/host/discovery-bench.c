@@ -0,0 +1,197 @@
+/* Discovery latency and memory of the L4 browse cache as the number of
+   boards grows.
+
+   For every N, mdns-sim is started with N boards (half _esp32._udp, half
+   _control_led._udp) and a fresh process browses both services through
+   mdns-cache.c, on top of the host mdns stand-in. It reports when the
+   first and the last instance were added after the browse started, the
+   bytes the cache and the mDNS result lists held, and how long the
+   mdns_cache_get() at the heart of find_mdns_service() takes. Then the
+   simulator churns boards for a while and the cache must still hold
+   exactly the live ones.
+
+   Build: gcc -O2 mdns-sim.c -o mdns-sim
+          gcc -O2 -Istub -I.. -include stub/host-compat.h -DMDNS_CACHE_MAX_ENTRIES=1024 \
+              discovery-bench.c mdns-host.c ../mdns-cache.c -o discovery-bench -lpthread
+   Run:   ./discovery-bench [N ...]      (default 10 50 100 200 500 1000)
+   Built without -DMDNS_CACHE_MAX_ENTRIES the cache keeps its firmware
+   size and drops what does not fit, which shows as missing instances.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include "esp_timer.h"
+#include "mdns.h"
+#include "mdns-cache.h"
+#include "mdns-host.h"
+
+#define BENCH_PORT      "5354"  /* off the real mDNS port */
+#define DISCOVERY_MS    10000
+#define CHURN_PER_S     20
+#define CHURN_MS        3000
+#define GET_ROUNDS      1000
+
+extern char **environ;
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static int64_t s_browse_start;
+static int64_t *s_added_at;     /* latency of every first add, in order */
+static size_t s_added;
+static size_t s_live;
+static size_t s_adds, s_removes;
+
+static void cache_changed(mdns_cache_event_t event, const mdns_cache_entry_t *entry, void *arg)
+{
+    (void)entry;
+    size_t max = (size_t)arg;
+    pthread_mutex_lock(&s_lock);
+    if (event == MDNS_CACHE_ADDED) {
+        if (s_added < max) {
+            s_added_at[s_added++] = esp_timer_get_time() - s_browse_start;
+        }
+        s_live++;
+        s_adds++;
+    } else if (event == MDNS_CACHE_REMOVED) {
+        s_live--;
+        s_removes++;
+    }
+    pthread_mutex_unlock(&s_lock);
+}
+
+static size_t live(void)
+{
+    pthread_mutex_lock(&s_lock);
+    size_t n = s_live;
+    pthread_mutex_unlock(&s_lock);
+    return n;
+}
+
+static pid_t start_sim(size_t count)
+{
+    char n[16];
+    snprintf(n, sizeof(n), "%zu", count);
+    char churn[16];
+    snprintf(churn, sizeof(churn), "%d", CHURN_PER_S);
+    /* Churn waits for SIGUSR1, sent once the discovery is measured */
+    char *argv[] = {"./mdns-sim", "-n", n, "-c", churn, "-w", "3600", "-p", BENCH_PORT, "-q", NULL};
+    pid_t pid;
+    if (posix_spawn(&pid, argv[0], NULL, NULL, argv, environ) != 0) {
+        return -1;
+    }
+    return pid;
+}
+
+static size_t cached(const char *service, mdns_cache_entry_t *entries, size_t max)
+{
+    return mdns_cache_get(service, "_udp", entries, max);
+}
+
+/* One N in a process of its own, the cache cannot be reset */
+static int run(size_t count)
+{
+    pid_t sim = start_sim(count);
+    if (sim < 0) {
+        perror("mdns-sim");
+        return 1;
+    }
+    /* Let the start announcements go by, the browse has to ask */
+    usleep(300 * 1000);
+
+    s_added_at = calloc(count, sizeof(int64_t));
+    mdns_host_set_port(atoi(BENCH_PORT));
+    if (mdns_init() != ESP_OK) {
+        fprintf(stderr, "mdns_init failed\n");
+        return 1;
+    }
+    mdns_cache_subscribe(cache_changed, (void *)count);
+
+    s_browse_start = esp_timer_get_time();
+    mdns_cache_browse("_esp32", "_udp");
+    mdns_cache_browse("_control_led", "_udp");
+
+    int64_t deadline = s_browse_start + DISCOVERY_MS * 1000LL;
+    while (live() < count && esp_timer_get_time() < deadline) {
+        usleep(1000);
+    }
+    /* Anything that overflowed the cache would still be arriving */
+    usleep(200 * 1000);
+
+    pthread_mutex_lock(&s_lock);
+    size_t discovered = s_added;
+    int64_t first = discovered ? s_added_at[0] : 0;
+    int64_t half = discovered ? s_added_at[(discovered - 1) / 2] : 0;
+    int64_t last = discovered ? s_added_at[discovered - 1] : 0;
+    pthread_mutex_unlock(&s_lock);
+
+    mdns_host_stats_t stats;
+    mdns_host_get_stats(&stats);
+
+    static mdns_cache_entry_t entries[MDNS_CACHE_MAX_ENTRIES];
+    int64_t t0 = esp_timer_get_time();
+    size_t esp32 = 0;
+    for (int i = 0; i < GET_ROUNDS; i++) {
+        esp32 = cached("_esp32", entries, MDNS_CACHE_MAX_ENTRIES);
+    }
+    double get_us = (double)(esp_timer_get_time() - t0) / GET_ROUNDS;
+
+    kill(sim, SIGUSR1);
+    usleep(CHURN_MS * 1000);
+    kill(sim, SIGSTOP);
+    usleep(200 * 1000);
+    size_t after_churn = cached("_esp32", entries, MDNS_CACHE_MAX_ENTRIES) +
+                         cached("_control_led", entries, MDNS_CACHE_MAX_ENTRIES);
+    pthread_mutex_lock(&s_lock);
+    size_t adds = s_adds - discovered, removes = s_removes;
+    pthread_mutex_unlock(&s_lock);
+    kill(sim, SIGKILL);
+    waitpid(sim, NULL, 0);
+
+    printf("%5zu %6zu %9.1f %9.1f %9.1f %9zu %9zu %8.1f %7zu %7zu/%-7zu %6zu\n",
+           count, discovered, first / 1000.0, half / 1000.0, last / 1000.0,
+           discovered * sizeof(mdns_cache_entry_t), stats.result_bytes_peak, get_us,
+           esp32, adds, removes, after_churn);
+    fflush(stdout);
+    return after_churn == count && discovered == count ? 0 : 2;
+}
+
+int main(int argc, char **argv)
+{
+    size_t defaults[] = {10, 50, 100, 200, 500, 1000};
+    size_t counts[32];
+    size_t n = 0;
+    for (int i = 1; i < argc && n < 32; i++) {
+        counts[n++] = strtoul(argv[i], NULL, 10);
+    }
+    if (n == 0) {
+        memcpy(counts, defaults, sizeof(defaults));
+        n = sizeof(defaults) / sizeof(defaults[0]);
+    }
+
+    printf("cache: %d entries of %zu B, churn %d boards/s for %d ms\n",
+           MDNS_CACHE_MAX_ENTRIES, sizeof(mdns_cache_entry_t), CHURN_PER_S, CHURN_MS);
+    printf("%5s %6s %9s %9s %9s %9s %9s %8s %7s %15s %6s\n", "N", "found", "first ms", "p50 ms", "last ms",
+           "cache B", "results B", "get us", "_esp32", "churn add/rm", "live");
+
+    int status = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (counts[i] > MDNS_CACHE_MAX_ENTRIES) {
+            fprintf(stderr, "N=%zu is over MDNS_CACHE_MAX_ENTRIES, expect drops\n", counts[i]);
+        }
+        fflush(stdout);
+        pid_t child = fork();
+        if (child == 0) {
+            exit(run(counts[i]));
+        }
+        int child_status;
+        waitpid(child, &child_status, 0);
+        if (!WIFEXITED(child_status) || WEXITSTATUS(child_status) != 0) {
+            status = 1;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,183 @@
+/* Fan-out completion latency for 10, 100 and 500 peers.
+
+   A stand-in fleet of N UDP sockets on loopback, served by one epoll
+   thread, plays the discovered boards. Every round sends one command to
+   all of them and measures the time from the start of the pass until the
+   last board received it. The fan-out pass over the peer table is
+   compared to what P5 would do without it: one udp_send_led() per peer,
+   each with a new socket.
+
+   Build: gcc -O2 -Istub -I.. -DPEER_TABLE_MAX=512 fanout-bench.c ../udp-fanout.c ../peer-table.c \
+              -o fanout-bench -lpthread
+   Run:   ./fanout-bench [rounds]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include "esp_timer.h"
+#include "udp-fanout.h"
+
+#define FLEET_MAX PEER_TABLE_MAX
+
+static int s_fleet[FLEET_MAX];
+static int s_fleet_size;
+static int s_epoll;
+static atomic_int s_received;
+static atomic_llong s_last_us;
+static atomic_bool s_running = true;
+
+static void *fleet_thread(void *arg)
+{
+    (void)arg;
+    struct epoll_event events[64];
+    char buffer[64];
+    while (atomic_load(&s_running)) {
+        int n = epoll_wait(s_epoll, events, 64, 10);
+        for (int i = 0; i < n; i++) {
+            while (recv(events[i].data.fd, buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {
+                atomic_store(&s_last_us, esp_timer_get_time());
+                atomic_fetch_add(&s_received, 1);
+            }
+        }
+    }
+    return NULL;
+}
+
+static void fleet_open(int size, peer_table_t *table)
+{
+    s_epoll = epoll_create1(0);
+    peer_table_init(table, PEER_POLICY_ROUND_ROBIN);
+    for (int i = 0; i < size; i++) {
+        struct sockaddr_in addr = {
+            .sin_family = AF_INET,
+            .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+            .sin_port = 0,
+        };
+        socklen_t len = sizeof(addr);
+        s_fleet[i] = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+        if (s_fleet[i] < 0 || bind(s_fleet[i], (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+            getsockname(s_fleet[i], (struct sockaddr *)&addr, &len) < 0) {
+            perror("fleet");
+            exit(1);
+        }
+        struct epoll_event ev = {.events = EPOLLIN, .data.fd = s_fleet[i]};
+        epoll_ctl(s_epoll, EPOLL_CTL_ADD, s_fleet[i], &ev);
+
+        char name[16];
+        snprintf(name, sizeof(name), "board-%d", i);
+        peer_table_upsert(table, name, &addr, 1);
+    }
+    s_fleet_size = size;
+}
+
+static void fleet_close(void)
+{
+    for (int i = 0; i < s_fleet_size; i++) {
+        close(s_fleet[i]);
+    }
+    close(s_epoll);
+}
+
+/* Waits until the whole fleet got the round, returns the completion time
+ * or -1 if some datagrams were lost */
+static int64_t wait_round(int expected, int64_t start)
+{
+    int64_t deadline = start + 1000000;
+    while (atomic_load(&s_received) < expected) {
+        if (esp_timer_get_time() > deadline) {
+            return -1;
+        }
+    }
+    return atomic_load(&s_last_us) - start;
+}
+
+/* One udp_send_led() per peer as P5 did it, a socket per datagram */
+static void send_one_by_one(const peer_table_t *table, const char *payload, size_t len)
+{
+    for (int i = 0; i < table->count; i++) {
+        int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+        struct timeval timeout = {.tv_sec = 10, .tv_usec = 0};
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+        sendto(sock, payload, len, 0, (const struct sockaddr *)&table->peers[i].addr, sizeof(table->peers[i].addr));
+        shutdown(sock, 0);
+        close(sock);
+    }
+}
+
+static int compare_us(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void run(const char *name, peer_table_t *table, int rounds, bool fanout)
+{
+    const char payload[] = "GPIO4=1";
+    int64_t *latency = calloc(rounds, sizeof(int64_t));
+    int64_t pass_total = 0;
+    int lost = 0, measured = 0;
+
+    for (int r = 0; r < rounds; r++) {
+        atomic_store(&s_received, 0);
+        int64_t start = esp_timer_get_time();
+        if (fanout) {
+            udp_fanout_result_t result;
+            udp_fanout_send(table->peers, table->count, payload, sizeof(payload) - 1, &result);
+            pass_total += result.elapsed_us;
+        } else {
+            send_one_by_one(table, payload, sizeof(payload) - 1);
+            pass_total += esp_timer_get_time() - start;
+        }
+        int64_t done = wait_round(table->count, start);
+        if (done < 0) {
+            lost++;
+        } else {
+            latency[measured++] = done;
+        }
+    }
+
+    qsort(latency, measured, sizeof(int64_t), compare_us);
+    if (measured) {
+        printf("%4d peers  %-12s pass %7.1f us  complete p50 %7lld us  p99 %7lld us  max %7lld us",
+               table->count, name, (double)pass_total / rounds, (long long)latency[measured / 2],
+               (long long)latency[measured * 99 / 100], (long long)latency[measured - 1]);
+    } else {
+        printf("%4d peers  %-12s no round completed", table->count, name);
+    }
+    if (lost) {
+        printf("  (%d rounds lost datagrams)", lost);
+    }
+    printf("\n");
+    free(latency);
+}
+
+int main(int argc, char **argv)
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 200;
+    if (rounds <= 0) {
+        fprintf(stderr, "usage: %s [rounds]\n", argv[0]);
+        return 1;
+    }
+
+    static const int sizes[] = {10, 100, 500};
+    static peer_table_t table;
+    printf("%d rounds per fleet size\n\n", rounds);
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        fleet_open(sizes[s], &table);
+        atomic_store(&s_running, true);
+        pthread_t fleet;
+        pthread_create(&fleet, NULL, fleet_thread, NULL);
+
+        run("one-by-one", &table, rounds, false);
+        run("fan-out", &table, rounds, true);
+
+        atomic_store(&s_running, false);
+        pthread_join(fleet, NULL);
+        fleet_close();
+    }
+    return 0;
+}
@@ -0,0 +1,604 @@
+/* Host stand-in for the parts of the ESP-IDF mdns component that
+   mdns-cache.c uses: browse and async PTR query, over loopback multicast.
+
+   One receive thread parses every response into a table of the instances
+   and hosts seen so far. The instances a packet touched are handed to the
+   browse notifiers as mdns_result_t lists, like the IDF browse does, and
+   appended to the results of the queries in flight. Result lists are
+   allocated through a counter so the benchmarks can report their size.
+*/
+#include "mdns.h"
+#include "mdns-host.h"
+#include "mdns-wire.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "esp_timer.h"
+
+#define MAX_BROWSES 4
+
+struct mdns_browse_s {
+    char service[16];
+    char proto[8];
+    mdns_browse_notify_t notifier;
+};
+
+struct mdns_search_once_s {
+    char service[16];
+    char proto[8];
+    int64_t deadline_us;
+    size_t max_results;
+    size_t count;
+    mdns_result_t *results;
+    struct mdns_search_once_s *next;
+};
+
+typedef struct {
+    char instance[64];
+    char service[16];
+    char proto[8];
+    char hostname[64];
+    uint16_t port;
+    uint32_t ttl;
+    char txt[256];              /* "key=value" items, each ended by '\0' */
+    size_t txt_len;
+    size_t txt_count;
+    bool touched;
+} known_instance_t;
+
+typedef struct {
+    char hostname[64];
+    uint32_t addr;
+    bool touched;
+} known_host_t;
+
+static uint16_t s_port = MDNS_PORT;
+static int s_sock = -1;
+static struct sockaddr_in s_group;
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct mdns_browse_s s_browses[MAX_BROWSES];
+static size_t s_browse_count;
+static struct mdns_search_once_s *s_searches;
+
+static known_instance_t *s_instances;
+static size_t s_instance_count, s_instance_cap;
+static known_host_t *s_hosts;
+static size_t s_host_count, s_host_cap;
+
+static atomic_size_t s_packets;
+static atomic_size_t s_result_bytes;
+static atomic_size_t s_result_bytes_peak;
+
+/* Every block of a result list remembers its size for the counters */
+static void *counted_alloc(size_t size)
+{
+    size_t *block = calloc(1, sizeof(size_t) + size);
+    if (block == NULL) {
+        return NULL;
+    }
+    *block = size;
+    size_t now = atomic_fetch_add(&s_result_bytes, size) + size;
+    size_t peak = atomic_load(&s_result_bytes_peak);
+    while (now > peak && !atomic_compare_exchange_weak(&s_result_bytes_peak, &peak, now)) {
+    }
+    return block + 1;
+}
+
+static void counted_free(void *ptr)
+{
+    if (ptr) {
+        size_t *block = (size_t *)ptr - 1;
+        atomic_fetch_sub(&s_result_bytes, *block);
+        free(block);
+    }
+}
+
+static char *counted_strdup(const char *s)
+{
+    size_t len = strlen(s) + 1;
+    char *copy = counted_alloc(len);
+    if (copy) {
+        memcpy(copy, s, len);
+    }
+    return copy;
+}
+
+void mdns_query_results_free(mdns_result_t *results)
+{
+    while (results) {
+        mdns_result_t *next = results->next;
+        counted_free(results->instance_name);
+        counted_free(results->service_type);
+        counted_free(results->proto);
+        counted_free(results->hostname);
+        for (size_t i = 0; i < results->txt_count; i++) {
+            counted_free((void *)results->txt[i].key);
+        }
+        counted_free(results->txt);
+        counted_free(results->txt_value_len);
+        counted_free(results->addr);
+        counted_free(results);
+        results = next;
+    }
+}
+
+static const known_host_t *find_host(const char *hostname)
+{
+    for (size_t i = 0; i < s_host_count; i++) {
+        if (strcasecmp(s_hosts[i].hostname, hostname) == 0) {
+            return &s_hosts[i];
+        }
+    }
+    return NULL;
+}
+
+static mdns_result_t *make_result(const known_instance_t *inst)
+{
+    mdns_result_t *r = counted_alloc(sizeof(*r));
+    if (r == NULL) {
+        return NULL;
+    }
+    r->ttl = inst->ttl;
+    r->instance_name = counted_strdup(inst->instance);
+    r->service_type = counted_strdup(inst->service);
+    r->proto = counted_strdup(inst->proto);
+    r->port = inst->port;
+    if (inst->hostname[0]) {
+        r->hostname = counted_strdup(inst->hostname);
+        const known_host_t *host = find_host(inst->hostname);
+        if (host) {
+            r->addr = counted_alloc(sizeof(mdns_ip_addr_t));
+            r->addr->addr.type = ESP_IPADDR_TYPE_V4;
+            r->addr->addr.u_addr.ip4.addr = host->addr;
+        }
+    }
+    if (inst->txt_count) {
+        /* key and value share one block, "key\0value\0" */
+        r->txt = counted_alloc(inst->txt_count * sizeof(mdns_txt_item_t));
+        r->txt_value_len = counted_alloc(inst->txt_count);
+        size_t pos = 0;
+        for (size_t i = 0; i < inst->txt_count; i++) {
+            const char *item = inst->txt + pos;
+            size_t len = strlen(item);
+            char *key = counted_strdup(item);
+            char *eq = strchr(key, '=');
+            if (eq) {
+                *eq = '\0';
+            }
+            r->txt[i].key = key;
+            r->txt[i].value = eq ? eq + 1 : NULL;
+            r->txt_value_len[i] = eq ? strlen(eq + 1) : 0;
+            pos += len + 1;
+        }
+        r->txt_count = inst->txt_count;
+    }
+    return r;
+}
+
+/* "name._service._proto.local" into its three parts */
+static bool split_instance(const char *name, known_instance_t *inst)
+{
+    size_t len = strlen(name);
+    if (len < 6 || strcasecmp(name + len - 6, ".local") != 0) {
+        return false;
+    }
+    const char *end = name + len - 6;
+    const char *proto = end;
+    while (proto > name && proto[-1] != '.') {
+        proto--;
+    }
+    if (proto == name) {
+        return false;
+    }
+    const char *service = proto - 1;
+    while (service > name && service[-1] != '.') {
+        service--;
+    }
+    if (service == name || *proto != '_' || *service != '_') {
+        return false;
+    }
+    snprintf(inst->instance, sizeof(inst->instance), "%.*s", (int)(service - 1 - name), name);
+    snprintf(inst->service, sizeof(inst->service), "%.*s", (int)(proto - 1 - service), service);
+    snprintf(inst->proto, sizeof(inst->proto), "%.*s", (int)(end - proto), proto);
+    return true;
+}
+
+static known_instance_t *upsert_instance(const char *full_name)
+{
+    known_instance_t parsed = {0};
+    if (!split_instance(full_name, &parsed)) {
+        return NULL;
+    }
+    for (size_t i = 0; i < s_instance_count; i++) {
+        known_instance_t *inst = &s_instances[i];
+        if (strcasecmp(inst->instance, parsed.instance) == 0 && strcasecmp(inst->service, parsed.service) == 0 &&
+            strcasecmp(inst->proto, parsed.proto) == 0) {
+            return inst;
+        }
+    }
+    if (s_instance_count == s_instance_cap) {
+        s_instance_cap = s_instance_cap ? s_instance_cap * 2 : 64;
+        s_instances = realloc(s_instances, s_instance_cap * sizeof(*s_instances));
+    }
+    s_instances[s_instance_count] = parsed;
+    return &s_instances[s_instance_count++];
+}
+
+static void strip_local(char *name)
+{
+    size_t len = strlen(name);
+    if (len > 6 && strcasecmp(name + len - 6, ".local") == 0) {
+        name[len - 6] = '\0';
+    }
+}
+
+static void update_host(const char *name, uint32_t addr)
+{
+    char hostname[64];
+    snprintf(hostname, sizeof(hostname), "%.63s", name);
+    strip_local(hostname);
+    known_host_t *host = (known_host_t *)find_host(hostname);
+    if (host == NULL) {
+        if (s_host_count == s_host_cap) {
+            s_host_cap = s_host_cap ? s_host_cap * 2 : 64;
+            s_hosts = realloc(s_hosts, s_host_cap * sizeof(*s_hosts));
+        }
+        host = &s_hosts[s_host_count++];
+        snprintf(host->hostname, sizeof(host->hostname), "%s", hostname);
+    }
+    host->addr = addr;
+    host->touched = true;
+}
+
+static void read_txt(known_instance_t *inst, const dns_record_t *rr)
+{
+    inst->txt_len = 0;
+    inst->txt_count = 0;
+    for (size_t pos = 0; pos < rr->rdlen;) {
+        uint8_t len = rr->rdata[pos++];
+        if (pos + len > rr->rdlen || inst->txt_len + len + 1 > sizeof(inst->txt)) {
+            break;
+        }
+        if (len) {
+            memcpy(inst->txt + inst->txt_len, rr->rdata + pos, len);
+            inst->txt[inst->txt_len + len] = '\0';
+            inst->txt_len += len + 1;
+            inst->txt_count++;
+        }
+        pos += len;
+    }
+}
+
+static void read_records(const uint8_t *pkt, size_t len)
+{
+    uint16_t questions = dns_get_u16(pkt + 4);
+    uint16_t records = dns_get_u16(pkt + 6) + dns_get_u16(pkt + 8) + dns_get_u16(pkt + 10);
+    size_t pos = 12;
+
+    for (uint16_t q = 0; q < questions; q++) {
+        char name[MDNS_NAME_MAX];
+        uint16_t type;
+        if (!dns_read_question(pkt, len, &pos, name, &type)) {
+            return;
+        }
+    }
+    for (uint16_t i = 0; i < records; i++) {
+        dns_record_t rr;
+        if (!dns_read_record(pkt, len, &pos, &rr)) {
+            return;
+        }
+        known_instance_t *inst;
+        char target[MDNS_NAME_MAX];
+        size_t rdata_pos = rr.rdata_pos;
+
+        switch (rr.type) {
+        case DNS_TYPE_PTR:
+            if (!dns_read_name(pkt, len, &rdata_pos, target, sizeof(target)) ||
+                (inst = upsert_instance(target)) == NULL) {
+                break;
+            }
+            inst->ttl = rr.ttl;
+            inst->touched = true;
+            break;
+        case DNS_TYPE_SRV:
+            rdata_pos += 6;
+            if (rr.rdlen < 7 || (inst = upsert_instance(rr.name)) == NULL ||
+                !dns_read_name(pkt, len, &rdata_pos, target, sizeof(target))) {
+                break;
+            }
+            strip_local(target);
+            snprintf(inst->hostname, sizeof(inst->hostname), "%s", target);
+            inst->port = dns_get_u16(rr.rdata + 4);
+            inst->touched = true;
+            break;
+        case DNS_TYPE_TXT:
+            if ((inst = upsert_instance(rr.name)) != NULL) {
+                read_txt(inst, &rr);
+                inst->touched = true;
+            }
+            break;
+        case DNS_TYPE_A:
+            if (rr.rdlen == 4) {
+                uint32_t addr;
+                memcpy(&addr, rr.rdata, 4);
+                update_host(rr.name, addr);
+            }
+            break;
+        }
+    }
+}
+
+static bool in_results(const mdns_result_t *results, const char *instance)
+{
+    for (; results; results = results->next) {
+        if (strcasecmp(results->instance_name, instance) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Hands the touched instances to the browses and searches. Like IDF,
+ * which holds its service lock around them, the notifiers are called
+ * with s_lock held, so one that waits on a lock held around the mdns_*
+ * calls deadlocks here as it would on the board. */
+static void deliver(void)
+{
+    mdns_result_t *lists[MAX_BROWSES] = {0};
+    mdns_browse_notify_t notifiers[MAX_BROWSES];
+    size_t browse_count;
+
+    pthread_mutex_lock(&s_lock);
+    for (size_t h = 0; h < s_host_count; h++) {
+        if (!s_hosts[h].touched) {
+            continue;
+        }
+        for (size_t i = 0; i < s_instance_count; i++) {
+            if (strcasecmp(s_instances[i].hostname, s_hosts[h].hostname) == 0) {
+                s_instances[i].touched = true;
+            }
+        }
+        s_hosts[h].touched = false;
+    }
+
+    browse_count = s_browse_count;
+    for (size_t b = 0; b < browse_count; b++) {
+        notifiers[b] = s_browses[b].notifier;
+    }
+
+    for (size_t i = 0; i < s_instance_count; i++) {
+        known_instance_t *inst = &s_instances[i];
+        if (!inst->touched) {
+            continue;
+        }
+        inst->touched = false;
+        for (size_t b = 0; b < browse_count; b++) {
+            if (strcasecmp(s_browses[b].service, inst->service) == 0 &&
+                strcasecmp(s_browses[b].proto, inst->proto) == 0) {
+                mdns_result_t *r = make_result(inst);
+                if (r) {
+                    r->next = lists[b];
+                    lists[b] = r;
+                }
+            }
+        }
+        for (struct mdns_search_once_s *s = s_searches; s; s = s->next) {
+            if (inst->ttl && s->count < s->max_results && strcasecmp(s->service, inst->service) == 0 &&
+                strcasecmp(s->proto, inst->proto) == 0 && !in_results(s->results, inst->instance)) {
+                mdns_result_t *r = make_result(inst);
+                if (r) {
+                    r->next = s->results;
+                    s->results = r;
+                    s->count++;
+                }
+            }
+        }
+        if (inst->ttl == 0) {
+            /* Said goodbye, forget it so a comeback is new again */
+            s_instances[i--] = s_instances[--s_instance_count];
+        }
+    }
+
+    for (size_t b = 0; b < browse_count; b++) {
+        if (lists[b]) {
+            notifiers[b](lists[b]);
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+
+    for (size_t b = 0; b < browse_count; b++) {
+        mdns_query_results_free(lists[b]);
+    }
+}
+
+static void *receive_task(void *arg)
+{
+    (void)arg;
+    static uint8_t pkt[9000];
+    while (1) {
+        ssize_t len = recv(s_sock, pkt, sizeof(pkt), 0);
+        if (len < 0) {
+            break;
+        }
+        if (len < 12 || !(dns_get_u16(pkt + 2) & 0x8000)) {
+            continue;           /* a query */
+        }
+        atomic_fetch_add(&s_packets, 1);
+        pthread_mutex_lock(&s_lock);
+        read_records(pkt, len);
+        pthread_mutex_unlock(&s_lock);
+        deliver();
+    }
+    return NULL;
+}
+
+static void send_ptr_query(const char *service, const char *proto)
+{
+    uint8_t buf[MDNS_PACKET_MAX];
+    dns_writer_t w = {.buf = buf, .cap = sizeof(buf)};
+    char name[64];
+    snprintf(name, sizeof(name), "%s.%s.local", service, proto);
+
+    dns_put_header(&w, 0, 1, 0);
+    dns_put_name(&w, name);
+    dns_put_u16(&w, DNS_TYPE_PTR);
+    dns_put_u16(&w, DNS_CLASS_IN);
+    sendto(s_sock, buf, w.len, 0, (struct sockaddr *)&s_group, sizeof(s_group));
+}
+
+void mdns_host_set_port(uint16_t port)
+{
+    s_port = port;
+}
+
+void mdns_host_get_stats(mdns_host_stats_t *stats)
+{
+    stats->packets = atomic_load(&s_packets);
+    stats->result_bytes = atomic_load(&s_result_bytes);
+    stats->result_bytes_peak = atomic_load(&s_result_bytes_peak);
+}
+
+esp_err_t mdns_init(void)
+{
+    if (s_sock >= 0) {
+        return ESP_OK;
+    }
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        return ESP_FAIL;
+    }
+    int on = 1, rcvbuf = 4 << 20;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    struct sockaddr_in local = {.sin_family = AF_INET, .sin_port = htons(s_port), .sin_addr.s_addr = htonl(INADDR_ANY)};
+    struct ip_mreq mreq;
+    inet_pton(AF_INET, MDNS_GROUP, &mreq.imr_multiaddr);
+    inet_pton(AF_INET, "127.0.0.1", &mreq.imr_interface);
+    struct in_addr loopback = mreq.imr_interface;
+    unsigned char loop = 1;
+    if (bind(sock, (struct sockaddr *)&local, sizeof(local)) < 0 ||
+        setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0 ||
+        setsockopt(sock, IPPROTO_IP, IP_MULTICAST_IF, &loopback, sizeof(loopback)) < 0) {
+        close(sock);
+        return ESP_FAIL;
+    }
+    setsockopt(sock, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+
+    s_group = (struct sockaddr_in){.sin_family = AF_INET, .sin_port = htons(s_port)};
+    inet_pton(AF_INET, MDNS_GROUP, &s_group.sin_addr);
+    s_sock = sock;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, receive_task, NULL) != 0) {
+        return ESP_ERR_NO_MEM;
+    }
+    pthread_detach(thread);
+    return ESP_OK;
+}
+
+void mdns_free(void)
+{
+    if (s_sock >= 0) {
+        shutdown(s_sock, SHUT_RDWR);
+        close(s_sock);
+        s_sock = -1;
+    }
+}
+
+mdns_browse_t *mdns_browse_new(const char *service, const char *proto, mdns_browse_notify_t notifier)
+{
+    if (s_sock < 0) {
+        return NULL;
+    }
+    pthread_mutex_lock(&s_lock);
+    if (s_browse_count == MAX_BROWSES) {
+        pthread_mutex_unlock(&s_lock);
+        return NULL;
+    }
+    mdns_browse_t *browse = &s_browses[s_browse_count++];
+    snprintf(browse->service, sizeof(browse->service), "%s", service);
+    snprintf(browse->proto, sizeof(browse->proto), "%s", proto);
+    browse->notifier = notifier;
+    pthread_mutex_unlock(&s_lock);
+
+    send_ptr_query(service, proto);
+    return browse;
+}
+
+mdns_search_once_t *mdns_query_async_new(const char *name, const char *service, const char *proto, uint16_t type,
+                                         uint32_t timeout, size_t max_results, mdns_query_notify_t notifier)
+{
+    (void)name;
+    (void)notifier;
+    if (s_sock < 0 || type != MDNS_TYPE_PTR || service == NULL || proto == NULL) {
+        return NULL;
+    }
+    mdns_search_once_t *search = calloc(1, sizeof(*search));
+    if (search == NULL) {
+        return NULL;
+    }
+    snprintf(search->service, sizeof(search->service), "%s", service);
+    snprintf(search->proto, sizeof(search->proto), "%s", proto);
+    search->deadline_us = esp_timer_get_time() + (int64_t)timeout * 1000;
+    search->max_results = max_results;
+
+    pthread_mutex_lock(&s_lock);
+    search->next = s_searches;
+    s_searches = search;
+    pthread_mutex_unlock(&s_lock);
+
+    send_ptr_query(service, proto);
+    return search;
+}
+
+bool mdns_query_async_get_results(mdns_search_once_t *search, uint32_t timeout, mdns_result_t **results,
+                                  uint8_t *num_results)
+{
+    int64_t wait_until = esp_timer_get_time() + (int64_t)timeout * 1000;
+    while (1) {
+        pthread_mutex_lock(&s_lock);
+        bool done = search->count >= search->max_results || esp_timer_get_time() >= search->deadline_us;
+        if (done) {
+            *results = search->results;
+            if (num_results) {
+                *num_results = search->count > 255 ? 255 : search->count;
+            }
+            search->results = NULL;
+            search->count = 0;
+        }
+        pthread_mutex_unlock(&s_lock);
+        if (done) {
+            return true;
+        }
+        if (esp_timer_get_time() >= wait_until) {
+            return false;
+        }
+        usleep(1000);
+    }
+}
+
+esp_err_t mdns_query_async_delete(mdns_search_once_t *search)
+{
+    pthread_mutex_lock(&s_lock);
+    for (mdns_search_once_t **p = &s_searches; *p; p = &(*p)->next) {
+        if (*p == search) {
+            *p = search->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    mdns_query_results_free(search->results);
+    free(search);
+    return ESP_OK;
+}
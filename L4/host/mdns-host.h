@@ -0,0 +1,19 @@
+/* Host only parts of the mdns stand-in in mdns-host.c */
+#ifndef _MDNS_HOST_H_
+#define _MDNS_HOST_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct {
+    size_t packets;             /* responses received */
+    size_t result_bytes;        /* result lists not freed yet */
+    size_t result_bytes_peak;
+} mdns_host_stats_t;
+
+/* UDP port of the group, before mdns_init(), MDNS_PORT by default */
+void mdns_host_set_port(uint16_t port);
+
+void mdns_host_get_stats(mdns_host_stats_t *stats);
+
+#endif
@@ -0,0 +1,393 @@
+/* mDNS responder simulator: N synthetic boards on loopback multicast.
+
+   Every board has one instance, alternately of _esp32._udp and of
+   _control_led._udp, a host name esp32-sim-<id>.local with an address in
+   127.1.0.0/16, a cap TXT item (node-caps.h) and a port. All of them are
+   announced at start, then PTR, SRV, TXT and A questions are answered the
+   way the ESP-IDF responder does, from the multicast group.
+
+   With churn, that many boards per second leave (goodbye, TTL 0) and as
+   many new ones join and announce themselves, so the live count stays N.
+   Churn starts after -w seconds, or at once on SIGUSR1.
+
+   Build: gcc -O2 mdns-sim.c -o mdns-sim
+   Run:   ./mdns-sim [-n boards] [-t ttl_s] [-c churn_per_s] [-w churn_after_s]
+                     [-d duration_s] [-p port] [-q]
+   The default port is 5353; the browse side must use the same one.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "mdns-wire.h"
+
+#define SIM_BOARD_PORT 1234
+
+typedef struct {
+    const char *service;
+    const char *proto;
+} sim_service_t;
+
+static const sim_service_t s_services[] = {
+    {"_esp32", "_udp"},
+    {"_control_led", "_udp"},
+};
+#define SERVICE_COUNT (sizeof(s_services) / sizeof(s_services[0]))
+
+typedef struct {
+    uint32_t id;
+    uint8_t service;
+} board_t;
+
+typedef struct {
+    int sock;
+    struct sockaddr_in group;
+    uint32_t ttl;
+    board_t *boards;
+    size_t count;
+    uint32_t next_id;
+    /* per second stats */
+    unsigned queries;
+    unsigned packets;
+    unsigned joined;
+    unsigned left;
+} sim_t;
+
+static volatile sig_atomic_t s_stop;
+static volatile sig_atomic_t s_churn_now;
+
+static void on_signal(int sig)
+{
+    if (sig == SIGUSR1) {
+        s_churn_now = 1;
+    } else {
+        s_stop = 1;
+    }
+}
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void board_instance(const board_t *b, char *out, size_t size)
+{
+    const sim_service_t *svc = &s_services[b->service];
+    snprintf(out, size, "esp32_sim_%05u.%s.%s.local", (unsigned)b->id, svc->service, svc->proto);
+}
+
+static void board_host(const board_t *b, char *out, size_t size)
+{
+    snprintf(out, size, "esp32-sim-%05u.local", (unsigned)b->id);
+}
+
+static uint32_t board_addr(const board_t *b)
+{
+    uint32_t host = b->id % 65534 + 1;
+    return htonl(127u << 24 | 1u << 16 | host);
+}
+
+static void put_a(dns_writer_t *w, const board_t *b, uint32_t ttl)
+{
+    char host[MDNS_NAME_MAX];
+    board_host(b, host, sizeof(host));
+    uint32_t addr = board_addr(b);
+    size_t rdlen = dns_begin_record(w, host, DNS_TYPE_A, DNS_CLASS_IN | DNS_CLASS_CACHE_FLUSH, ttl);
+    dns_put_bytes(w, &addr, 4);
+    dns_end_record(w, rdlen);
+}
+
+/* PTR, SRV, TXT and A of one board */
+static void put_board(dns_writer_t *w, const board_t *b, uint32_t ttl)
+{
+    const sim_service_t *svc = &s_services[b->service];
+    char type[64], instance[MDNS_NAME_MAX], host[MDNS_NAME_MAX];
+    snprintf(type, sizeof(type), "%s.%s.local", svc->service, svc->proto);
+    board_instance(b, instance, sizeof(instance));
+    board_host(b, host, sizeof(host));
+
+    size_t rdlen = dns_begin_record(w, type, DNS_TYPE_PTR, DNS_CLASS_IN, ttl);
+    dns_put_name(w, instance);
+    dns_end_record(w, rdlen);
+
+    rdlen = dns_begin_record(w, instance, DNS_TYPE_SRV, DNS_CLASS_IN | DNS_CLASS_CACHE_FLUSH, ttl);
+    dns_put_u16(w, 0);
+    dns_put_u16(w, 0);
+    dns_put_u16(w, SIM_BOARD_PORT);
+    dns_put_name(w, host);
+    dns_end_record(w, rdlen);
+
+    /* What P5 publishes, with a load that differs between boards */
+    char cap[40], id[16];
+    snprintf(cap, sizeof(cap), "cap=1,f3,p1,b1,l%u", (unsigned)(b->id * 37 % 101));
+    snprintf(id, sizeof(id), "id=%u", (unsigned)b->id);
+    const char *items[] = {cap, id};
+    rdlen = dns_begin_record(w, instance, DNS_TYPE_TXT, DNS_CLASS_IN | DNS_CLASS_CACHE_FLUSH, ttl);
+    for (size_t i = 0; i < sizeof(items) / sizeof(items[0]); i++) {
+        uint8_t len = strlen(items[i]);
+        dns_put_bytes(w, &len, 1);
+        dns_put_bytes(w, items[i], len);
+    }
+    dns_end_record(w, rdlen);
+
+    put_a(w, b, ttl);
+}
+
+static void flush(sim_t *sim, dns_writer_t *w, uint16_t answers)
+{
+    dns_set_answer_count(w, answers);
+    sendto(sim->sock, w->buf, w->len, 0, (struct sockaddr *)&sim->group, sizeof(sim->group));
+    sim->packets++;
+}
+
+/* Answer with the records of every board that matches, split over as
+ * many packets as needed, four records per board */
+static void send_boards(sim_t *sim, int service, uint32_t only_id, bool by_id, uint32_t ttl)
+{
+    uint8_t buf[MDNS_PACKET_MAX];
+    dns_writer_t w = {.buf = buf, .cap = sizeof(buf)};
+    uint16_t answers = 0;
+
+    dns_put_header(&w, DNS_FLAGS_RESPONSE, 0, 0);
+    for (size_t i = 0; i < sim->count; i++) {
+        const board_t *b = &sim->boards[i];
+        if ((by_id && b->id != only_id) || (!by_id && b->service != service)) {
+            continue;
+        }
+        size_t mark = w.len;
+        put_board(&w, b, ttl);
+        if (w.overflow) {
+            w.len = mark;
+            flush(sim, &w, answers);
+            dns_put_header(&w, DNS_FLAGS_RESPONSE, 0, 0);
+            answers = 0;
+            put_board(&w, b, ttl);
+        }
+        answers += 4;
+    }
+    if (answers) {
+        flush(sim, &w, answers);
+    }
+}
+
+static void send_host(sim_t *sim, const board_t *b)
+{
+    uint8_t buf[MDNS_PACKET_MAX];
+    dns_writer_t w = {.buf = buf, .cap = sizeof(buf)};
+    dns_put_header(&w, DNS_FLAGS_RESPONSE, 0, 0);
+    put_a(&w, b, sim->ttl);
+    flush(sim, &w, 1);
+}
+
+static const board_t *find_board(const sim_t *sim, const char *name, bool host)
+{
+    char buf[MDNS_NAME_MAX];
+    for (size_t i = 0; i < sim->count; i++) {
+        if (host) {
+            board_host(&sim->boards[i], buf, sizeof(buf));
+        } else {
+            board_instance(&sim->boards[i], buf, sizeof(buf));
+        }
+        if (strcasecmp(buf, name) == 0) {
+            return &sim->boards[i];
+        }
+    }
+    return NULL;
+}
+
+static void handle_query(sim_t *sim, const uint8_t *pkt, size_t len)
+{
+    if (len < 12 || (dns_get_u16(pkt + 2) & 0x8000)) {
+        return;                 /* a response, ours included */
+    }
+    uint16_t questions = dns_get_u16(pkt + 4);
+    size_t pos = 12;
+    sim->queries++;
+
+    for (uint16_t q = 0; q < questions; q++) {
+        char name[MDNS_NAME_MAX];
+        uint16_t type;
+        if (!dns_read_question(pkt, len, &pos, name, &type)) {
+            return;
+        }
+        if (type == DNS_TYPE_PTR) {
+            for (size_t s = 0; s < SERVICE_COUNT; s++) {
+                char service[64];
+                snprintf(service, sizeof(service), "%s.%s.local", s_services[s].service, s_services[s].proto);
+                if (strcasecmp(name, service) == 0) {
+                    send_boards(sim, s, 0, false, sim->ttl);
+                }
+            }
+        } else if (type == DNS_TYPE_A) {
+            const board_t *b = find_board(sim, name, true);
+            if (b) {
+                send_host(sim, b);
+            }
+        } else if (type == DNS_TYPE_SRV || type == DNS_TYPE_TXT || type == DNS_TYPE_ANY) {
+            const board_t *b = find_board(sim, name, false);
+            if (b) {
+                send_boards(sim, 0, b->id, true, sim->ttl);
+            }
+        }
+    }
+}
+
+/* One board leaves with a goodbye and a new one takes its place */
+static void churn_one(sim_t *sim)
+{
+    board_t *b = &sim->boards[rand() % sim->count];
+    send_boards(sim, 0, b->id, true, 0);
+    sim->left++;
+
+    b->id = sim->next_id++;
+    send_boards(sim, 0, b->id, true, sim->ttl);
+    sim->joined++;
+}
+
+static int open_socket(sim_t *sim, uint16_t port)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        return -1;
+    }
+    int on = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+
+    struct sockaddr_in local = {.sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_ANY)};
+    if (bind(sock, (struct sockaddr *)&local, sizeof(local)) < 0) {
+        close(sock);
+        return -1;
+    }
+
+    struct ip_mreq mreq;
+    inet_pton(AF_INET, MDNS_GROUP, &mreq.imr_multiaddr);
+    inet_pton(AF_INET, "127.0.0.1", &mreq.imr_interface);
+    struct in_addr loopback = mreq.imr_interface;
+    unsigned char ttl = 255, loop = 1;
+    if (setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0 ||
+        setsockopt(sock, IPPROTO_IP, IP_MULTICAST_IF, &loopback, sizeof(loopback)) < 0) {
+        close(sock);
+        return -1;
+    }
+    setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    setsockopt(sock, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+
+    sim->group = (struct sockaddr_in){.sin_family = AF_INET, .sin_port = htons(port)};
+    inet_pton(AF_INET, MDNS_GROUP, &sim->group.sin_addr);
+    return sock;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-n boards] [-t ttl_s] [-c churn_per_s] [-w churn_after_s] "
+            "[-d duration_s] [-p port] [-q]\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    sim_t sim = {.ttl = 120};
+    size_t count = 100;
+    double churn = 0, churn_after = 0, duration = 0;
+    uint16_t port = MDNS_PORT;
+    bool quiet = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:c:w:d:p:q")) != -1) {
+        switch (opt) {
+        case 'n': count = strtoul(optarg, NULL, 10); break;
+        case 't': sim.ttl = strtoul(optarg, NULL, 10); break;
+        case 'c': churn = atof(optarg); break;
+        case 'w': churn_after = atof(optarg); break;
+        case 'd': duration = atof(optarg); break;
+        case 'p': port = strtoul(optarg, NULL, 10); break;
+        case 'q': quiet = true; break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if (count == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    sim.sock = open_socket(&sim, port);
+    if (sim.sock < 0) {
+        perror("mdns-sim: socket");
+        return 1;
+    }
+    sim.boards = calloc(count, sizeof(board_t));
+    sim.count = count;
+    for (size_t i = 0; i < count; i++) {
+        sim.boards[i] = (board_t){.id = sim.next_id++, .service = i % SERVICE_COUNT};
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGUSR1, on_signal);
+    srand(1);
+
+    for (size_t s = 0; s < SERVICE_COUNT; s++) {
+        send_boards(&sim, s, 0, false, sim.ttl);
+    }
+    if (!quiet) {
+        printf("%zu boards on %s:%u, TTL %u s, churn %.1f/s\n", count, MDNS_GROUP, port, (unsigned)sim.ttl, churn);
+    }
+
+    int64_t start = now_us();
+    int64_t next_report = start + 1000000;
+    double churn_due = 0;
+    int64_t last = start;
+    uint8_t pkt[9000];
+
+    while (!s_stop) {
+        struct pollfd pfd = {.fd = sim.sock, .events = POLLIN};
+        if (poll(&pfd, 1, 20) > 0) {
+            ssize_t len = recv(sim.sock, pkt, sizeof(pkt), 0);
+            if (len > 0) {
+                handle_query(&sim, pkt, len);
+            }
+        }
+
+        int64_t now = now_us();
+        if (duration > 0 && now - start >= duration * 1e6) {
+            break;
+        }
+        if (churn > 0 && (s_churn_now || now - start >= churn_after * 1e6)) {
+            churn_due += churn * (now - last) / 1e6;
+            while (churn_due >= 1) {
+                churn_one(&sim);
+                churn_due -= 1;
+            }
+        }
+        last = now;
+
+        if (now >= next_report) {
+            if (!quiet) {
+                printf("live %zu  joined %u  left %u  queries %u  packets %u\n",
+                       sim.count, sim.joined, sim.left, sim.queries, sim.packets);
+                fflush(stdout);
+            }
+            sim.joined = sim.left = sim.queries = sim.packets = 0;
+            next_report += 1000000;
+        }
+    }
+
+    /* Goodbyes for every board, so browsers do not keep them until their
+     * TTL runs out after the simulator is gone */
+    for (size_t s = 0; s < SERVICE_COUNT; s++) {
+        send_boards(&sim, s, 0, false, 0);
+    }
+    free(sim.boards);
+    close(sim.sock);
+    return 0;
+}
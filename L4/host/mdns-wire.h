@@ -0,0 +1,198 @@
+/* Just enough of the DNS wire format (RFC 1035, RFC 6762) for the mDNS
+   simulator and the host mdns stand-in: names without compression on
+   output, compression pointers followed on input. */
+#ifndef _MDNS_WIRE_H_
+#define _MDNS_WIRE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#define MDNS_GROUP       "224.0.0.251"
+#define MDNS_PORT        5353
+#define MDNS_PACKET_MAX  1400
+#define MDNS_NAME_MAX    256
+
+#define DNS_TYPE_A            0x0001
+#define DNS_TYPE_PTR          0x000C
+#define DNS_TYPE_TXT          0x0010
+#define DNS_TYPE_SRV          0x0021
+#define DNS_TYPE_ANY          0x00FF
+#define DNS_CLASS_IN          0x0001
+#define DNS_CLASS_CACHE_FLUSH 0x8000
+#define DNS_FLAGS_RESPONSE    0x8400  /* QR and AA */
+
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    size_t cap;
+    bool overflow;
+} dns_writer_t;
+
+typedef struct {
+    char name[MDNS_NAME_MAX];
+    uint16_t type;
+    uint16_t class;
+    uint32_t ttl;
+    const uint8_t *rdata;
+    uint16_t rdlen;
+    size_t rdata_pos;           /* offset of rdata in the packet */
+} dns_record_t;
+
+static inline void dns_put_u16(dns_writer_t *w, uint16_t v)
+{
+    if (w->len + 2 > w->cap) {
+        w->overflow = true;
+        return;
+    }
+    w->buf[w->len++] = v >> 8;
+    w->buf[w->len++] = v & 0xff;
+}
+
+static inline void dns_put_u32(dns_writer_t *w, uint32_t v)
+{
+    dns_put_u16(w, v >> 16);
+    dns_put_u16(w, v & 0xffff);
+}
+
+static inline void dns_put_bytes(dns_writer_t *w, const void *data, size_t len)
+{
+    if (w->len + len > w->cap) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, data, len);
+    w->len += len;
+}
+
+/* "a.b.local" as length-prefixed labels */
+static inline void dns_put_name(dns_writer_t *w, const char *name)
+{
+    while (*name) {
+        const char *dot = strchr(name, '.');
+        size_t len = dot ? (size_t)(dot - name) : strlen(name);
+        uint8_t label = len > 63 ? 63 : len;
+        dns_put_bytes(w, &label, 1);
+        dns_put_bytes(w, name, label);
+        name += len + (dot ? 1 : 0);
+    }
+    dns_put_bytes(w, "", 1);
+}
+
+static inline void dns_put_header(dns_writer_t *w, uint16_t flags, uint16_t qd, uint16_t an)
+{
+    w->len = 0;
+    w->overflow = false;
+    dns_put_u16(w, 0);          /* id, always 0 in mDNS */
+    dns_put_u16(w, flags);
+    dns_put_u16(w, qd);
+    dns_put_u16(w, an);
+    dns_put_u16(w, 0);
+    dns_put_u16(w, 0);
+}
+
+/* Writes the record header and returns where rdlength goes, to be
+ * patched by dns_end_record() once the rdata is written */
+static inline size_t dns_begin_record(dns_writer_t *w, const char *name, uint16_t type, uint16_t class, uint32_t ttl)
+{
+    dns_put_name(w, name);
+    dns_put_u16(w, type);
+    dns_put_u16(w, class);
+    dns_put_u32(w, ttl);
+    size_t rdlen_pos = w->len;
+    dns_put_u16(w, 0);
+    return rdlen_pos;
+}
+
+static inline void dns_end_record(dns_writer_t *w, size_t rdlen_pos)
+{
+    if (w->overflow) {
+        return;
+    }
+    size_t rdlen = w->len - rdlen_pos - 2;
+    w->buf[rdlen_pos] = rdlen >> 8;
+    w->buf[rdlen_pos + 1] = rdlen & 0xff;
+}
+
+static inline void dns_set_answer_count(dns_writer_t *w, uint16_t an)
+{
+    w->buf[6] = an >> 8;
+    w->buf[7] = an & 0xff;
+}
+
+static inline uint16_t dns_get_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+/* Read the name at *pos into dotted form and move *pos past it */
+static inline bool dns_read_name(const uint8_t *pkt, size_t len, size_t *pos, char *out, size_t out_size)
+{
+    size_t p = *pos;
+    size_t out_len = 0;
+    bool jumped = false;
+    int jumps = 0;
+
+    while (p < len) {
+        uint8_t label = pkt[p];
+        if (label == 0) {
+            if (!jumped) {
+                *pos = p + 1;
+            }
+            out[out_len ? out_len - 1 : 0] = '\0';
+            return true;
+        }
+        if ((label & 0xc0) == 0xc0) {
+            if (p + 1 >= len || ++jumps > 16) {
+                return false;
+            }
+            if (!jumped) {
+                *pos = p + 2;
+            }
+            jumped = true;
+            p = (label & 0x3f) << 8 | pkt[p + 1];
+            continue;
+        }
+        if (p + 1 + label > len || out_len + label + 1 >= out_size) {
+            return false;
+        }
+        memcpy(out + out_len, pkt + p + 1, label);
+        out_len += label;
+        out[out_len++] = '.';
+        p += 1 + label;
+    }
+    return false;
+}
+
+/* Skip the question of the packet at *pos, filling name and type */
+static inline bool dns_read_question(const uint8_t *pkt, size_t len, size_t *pos, char *name, uint16_t *type)
+{
+    if (!dns_read_name(pkt, len, pos, name, MDNS_NAME_MAX) || *pos + 4 > len) {
+        return false;
+    }
+    *type = dns_get_u16(pkt + *pos);
+    *pos += 4;
+    return true;
+}
+
+static inline bool dns_read_record(const uint8_t *pkt, size_t len, size_t *pos, dns_record_t *rr)
+{
+    if (!dns_read_name(pkt, len, pos, rr->name, sizeof(rr->name)) || *pos + 10 > len) {
+        return false;
+    }
+    const uint8_t *p = pkt + *pos;
+    rr->type = dns_get_u16(p);
+    rr->class = dns_get_u16(p + 2);
+    rr->ttl = (uint32_t)dns_get_u16(p + 4) << 16 | dns_get_u16(p + 6);
+    rr->rdlen = dns_get_u16(p + 8);
+    rr->rdata_pos = *pos + 10;
+    if (rr->rdata_pos + rr->rdlen > len) {
+        return false;
+    }
+    rr->rdata = pkt + rr->rdata_pos;
+    *pos = rr->rdata_pos + rr->rdlen;
+    return true;
+}
+
+#endif
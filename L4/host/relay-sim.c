@@ -0,0 +1,387 @@
+/* Multi-hop command relay over a simulated radio topology, one process
+   per board.
+
+   Board i is a UDP socket on 127.0.1.(i + 1), port SIM_PORT, one address
+   per board as on the WLAN. Every datagram they send goes through
+   __wrap_sendto (linked with -Wl,--wrap=sendto), which drops it with the
+   loss of the link from the topology: boards in range lose nothing,
+   boards at the edge of coverage -e percent, all others everything. Each
+   board knows every other one, as if mDNS had found them, and peer-probe.c
+   measures the links, so relay.c picks its relays from real probe
+   results. Probe answers go back to the unbound probe socket on 127.0.0.1,
+   which the wrapper cannot place, so the loss a board sees is that of its
+   outgoing pings.
+
+   Board 0 is the controller. Once the probes settled, it sends every
+   other board a command per round twice: straight to it, as P5 does
+   without relays, and through relay.c. The boards report what reached
+   them on a side channel without loss. Per board, the controller prints
+   the delivery rate of both, the latency and hops of the relayed copies
+   and the datagrams each relayed command cost.
+
+   line: board i hears i-1 and i+1, i-2 and i+2 at the edge
+   grid: the four neighbours in range, the diagonals at the edge
+
+   Build: gcc -O2 -Istub -I.. -include stub/host-compat.h -Wl,--wrap=sendto \
+              relay-sim.c ../relay.c ../peer-table.c ../peer-probe.c -o relay-sim -lpthread -lm
+   Run:   ./relay-sim [-n boards] [-t line|grid] [-r rounds] [-e edge_loss_pct]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <inttypes.h>
+#include <sys/wait.h>
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "peer-table.h"
+#include "peer-probe.h"
+#include "relay.h"
+
+#define SIM_PORT        20000
+#define SIM_NET         0x7f000100  /* 127.0.1.0 */
+#define SIM_REPORT_PORT (SIM_PORT - 1)
+#define SIM_MAX_BOARDS  64
+#define SETTLE_MS       4000
+#define ROUND_MS        50
+#define GRACE_MS        500
+
+typedef enum {
+    TOPOLOGY_LINE,
+    TOPOLOGY_GRID,
+} topology_t;
+
+static int s_boards = 6;
+static topology_t s_topology = TOPOLOGY_LINE;
+static int s_edge_loss = 60;
+static int s_self;
+static unsigned s_seed;
+
+static int s_sock;
+static int s_report;
+static struct sockaddr_in s_report_addr;
+static peer_table_t s_table;
+static SemaphoreHandle_t s_lock;
+static relay_t s_relay;
+
+ssize_t __real_sendto(int sock, const void *buf, size_t len, int flags, const struct sockaddr *to, socklen_t tolen);
+
+static int link_loss(int a, int b)
+{
+    int d;
+    if (s_topology == TOPOLOGY_LINE) {
+        d = abs(a - b);
+        return d == 1 ? 0 : d == 2 ? s_edge_loss : 100;
+    }
+    int cols = (int)ceil(sqrt(s_boards));
+    int dx = abs(a % cols - b % cols), dy = abs(a / cols - b / cols);
+    if (dx + dy == 1) {
+        return 0;
+    }
+    return dx == 1 && dy == 1 ? s_edge_loss : 100;
+}
+
+static struct sockaddr_in board_addr(int board)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(SIM_PORT),
+        .sin_addr.s_addr = htonl(SIM_NET + board + 1),
+    };
+    return addr;
+}
+
+/* The radio: datagrams to a board out of range never arrive */
+ssize_t __wrap_sendto(int sock, const void *buf, size_t len, int flags, const struct sockaddr *to, socklen_t tolen)
+{
+    const struct sockaddr_in *dest = (const struct sockaddr_in *)to;
+    int board = (int)(ntohl(dest->sin_addr.s_addr) - SIM_NET) - 1;
+    if (board >= 0 && board < s_boards && board != s_self &&
+        (int)(rand_r(&s_seed) % 100) < link_loss(s_self, board)) {
+        return len;
+    }
+    return __real_sendto(sock, buf, len, flags, to, tolen);
+}
+
+static void report(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+static void report(const char *fmt, ...)
+{
+    char line[96];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    __real_sendto(s_report, line, len, 0, (struct sockaddr *)&s_report_addr, sizeof(s_report_addr));
+}
+
+static void board_name(int board, char *out, size_t size)
+{
+    snprintf(out, size, "board-%d", board);
+}
+
+static void send_action(const relay_action_t *action)
+{
+    for (size_t i = 0; i < action->next_count; i++) {
+        sendto(s_sock, action->msg, action->len, 0, (const struct sockaddr *)&action->next[i],
+               sizeof(action->next[i]));
+    }
+    if (action->next_count) {
+        report("F %08" PRIx32 ".%" PRIu32 " %zu", action->id.origin, action->id.seq, action->next_count);
+    }
+}
+
+/* What udp_task of P5 does with a datagram */
+static void *board_task(void *arg)
+{
+    (void)arg;
+    char buffer[RELAY_MSG_LEN];
+    while (1) {
+        struct sockaddr_in source;
+        socklen_t socklen = sizeof(source);
+        ssize_t len = recvfrom(s_sock, buffer, sizeof(buffer) - 1, 0, (struct sockaddr *)&source, &socklen);
+        if (len < 0) {
+            break;
+        }
+        buffer[len] = '\0';
+        int64_t now = esp_timer_get_time();
+
+        char reply[32];
+        size_t reply_len;
+        if (peer_probe_answer(buffer, len, reply, sizeof(reply), &reply_len)) {
+            sendto(s_sock, reply, reply_len, 0, (struct sockaddr *)&source, socklen);
+            continue;
+        }
+
+        relay_action_t action;
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        bool relayed = relay_handle(&s_relay, &s_table, &source, buffer, len, &action);
+        xSemaphoreGive(s_lock);
+        if (relayed) {
+            if (action.deliver) {
+                report("D %08" PRIx32 ".%" PRIu32 " %d %u %" PRId64, action.id.origin, action.id.seq, s_self,
+                       action.hops, now);
+            }
+            send_action(&action);
+            continue;
+        }
+
+        unsigned round;
+        if (sscanf(buffer, "CMD %u", &round) == 1) {
+            report("P %u %d %" PRId64, round, s_self, now);
+        }
+    }
+    return NULL;
+}
+
+static int open_board(int board)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    struct sockaddr_in local = board_addr(board);
+    if (sock < 0 || bind(sock, (struct sockaddr *)&local, sizeof(local)) < 0) {
+        perror("relay-sim: board socket");
+        exit(1);
+    }
+    return sock;
+}
+
+static void start_board(int board)
+{
+    s_self = board;
+    s_seed = 0x9e3779b9u * (board + 1);
+    s_sock = open_board(board);
+    s_report = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+    char name[PEER_TABLE_NAME_LEN];
+    board_name(board, name, sizeof(name));
+    relay_init(&s_relay, name, 0x1000u + board);
+
+    peer_table_init(&s_table, PEER_POLICY_MIN_RTT);
+    s_lock = xSemaphoreCreateMutex();
+    for (int i = 0; i < s_boards; i++) {
+        if (i == board) {
+            continue;
+        }
+        struct sockaddr_in addr = board_addr(i);
+        board_name(i, name, sizeof(name));
+        peer_table_upsert(&s_table, name, &addr, 1);
+    }
+    peer_probe_start(&s_table, s_lock);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, board_task, NULL);
+    pthread_detach(thread);
+}
+
+typedef struct {
+    int64_t sent_us;
+    int64_t latency_us;         /* -1 until delivered */
+    unsigned hops;
+    unsigned datagrams;
+} relayed_t;
+
+typedef struct {
+    unsigned direct;
+    unsigned relayed;
+    unsigned hops;
+    unsigned datagrams;
+    int64_t latencies[4096];
+    unsigned latency_count;
+} board_stats_t;
+
+static int compare_i64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void run_controller(int rounds)
+{
+    int commands = rounds * (s_boards - 1);
+    relayed_t *relayed = calloc(commands, sizeof(relayed_t));
+    board_stats_t *stats = calloc(s_boards, sizeof(board_stats_t));
+    int64_t *direct_sent = calloc(rounds, sizeof(int64_t));
+
+    usleep(SETTLE_MS * 1000);
+
+    for (int r = 0; r < rounds; r++) {
+        direct_sent[r] = esp_timer_get_time();
+        for (int b = 1; b < s_boards; b++) {
+            char command[32];
+            snprintf(command, sizeof(command), "CMD %d", r);
+            struct sockaddr_in dest = board_addr(b);
+            sendto(s_sock, command, strlen(command), 0, (struct sockaddr *)&dest, sizeof(dest));
+
+            char name[PEER_TABLE_NAME_LEN];
+            board_name(b, name, sizeof(name));
+            relay_action_t action;
+            xSemaphoreTake(s_lock, portMAX_DELAY);
+            relay_originate(&s_relay, &s_table, name, "GPIO4=1", &action);
+            xSemaphoreGive(s_lock);
+            relayed_t *cmd = &relayed[action.id.seq];
+            cmd->sent_us = esp_timer_get_time();
+            cmd->latency_us = -1;
+            cmd->datagrams = action.next_count;
+            for (size_t i = 0; i < action.next_count; i++) {
+                sendto(s_sock, action.msg, action.len, 0, (struct sockaddr *)&action.next[i],
+                       sizeof(action.next[i]));
+            }
+        }
+        usleep(ROUND_MS * 1000);
+    }
+
+    /* Reports until the last copies settled */
+    struct timeval timeout = {.tv_sec = 0, .tv_usec = GRACE_MS * 1000};
+    setsockopt(s_report, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    char line[96];
+    ssize_t len;
+    while ((len = recv(s_report, line, sizeof(line) - 1, 0)) > 0) {
+        line[len] = '\0';
+        uint32_t origin, seq;
+        unsigned round, hops, count;
+        int board;
+        int64_t at;
+        if (sscanf(line, "D %" SCNx32 ".%" SCNu32 " %d %u %" SCNd64, &origin, &seq, &board, &hops, &at) == 5 &&
+            origin == s_relay.origin && seq < (uint32_t)commands) {
+            relayed[seq].latency_us = at - relayed[seq].sent_us;
+            relayed[seq].hops = hops;
+        } else if (sscanf(line, "F %" SCNx32 ".%" SCNu32 " %u", &origin, &seq, &count) == 3 &&
+                   origin == s_relay.origin && seq < (uint32_t)commands) {
+            relayed[seq].datagrams += count;
+        } else if (sscanf(line, "P %u %d %" SCNd64, &round, &board, &at) == 3 && board > 0 && board < s_boards) {
+            stats[board].direct++;
+        }
+    }
+
+    printf("%d boards, %s, edge loss %d%%, %d rounds, at most %d hops, %d relays per hop\n", s_boards,
+           s_topology == TOPOLOGY_LINE ? "line" : "grid", s_edge_loss, rounds, RELAY_MAX_HOPS, RELAY_FANOUT);
+    printf("%5s %6s %8s %8s %8s %8s %6s %10s\n", "board", "link", "direct", "relayed", "p50 us", "p99 us", "hops",
+           "datagrams");
+    for (int seq = 0; seq < commands; seq++) {
+        board_stats_t *st = &stats[1 + seq % (s_boards - 1)];
+        st->datagrams += relayed[seq].datagrams;
+        if (relayed[seq].latency_us >= 0) {
+            st->relayed++;
+            st->hops += relayed[seq].hops;
+            if (st->latency_count < sizeof(st->latencies) / sizeof(st->latencies[0])) {
+                st->latencies[st->latency_count++] = relayed[seq].latency_us;
+            }
+        }
+    }
+    for (int b = 1; b < s_boards; b++) {
+        board_stats_t *st = &stats[b];
+        qsort(st->latencies, st->latency_count, sizeof(int64_t), compare_i64);
+        int64_t p50 = st->latency_count ? st->latencies[st->latency_count / 2] : 0;
+        int64_t p99 = st->latency_count ? st->latencies[(st->latency_count * 99) / 100] : 0;
+        char link[16];
+        snprintf(link, sizeof(link), "%d%%", 100 - link_loss(0, b));
+        printf("%5d %6s %7.1f%% %7.1f%% %8" PRId64 " %8" PRId64 " %6.2f %10.2f\n", b, link,
+               100.0 * st->direct / rounds, 100.0 * st->relayed / rounds, p50, p99,
+               st->relayed ? (double)st->hops / st->relayed : 0.0, (double)st->datagrams / rounds);
+    }
+    free(relayed);
+    free(stats);
+    free(direct_sent);
+}
+
+int main(int argc, char **argv)
+{
+    int rounds = 200;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:r:e:")) != -1) {
+        switch (opt) {
+        case 'n': s_boards = atoi(optarg); break;
+        case 't': s_topology = strcmp(optarg, "grid") == 0 ? TOPOLOGY_GRID : TOPOLOGY_LINE; break;
+        case 'r': rounds = atoi(optarg); break;
+        case 'e': s_edge_loss = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n boards] [-t line|grid] [-r rounds] [-e edge_loss_pct]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (s_boards < 2 || s_boards > SIM_MAX_BOARDS || s_boards > PEER_TABLE_MAX + 1 || rounds < 1 ||
+        rounds * (s_boards - 1) > 65536) {
+        fprintf(stderr, "relay-sim: 2..%d boards and fewer commands please\n", PEER_TABLE_MAX + 1);
+        return 1;
+    }
+
+    /* The side channel is open before the boards start to report */
+    s_report_addr = (struct sockaddr_in){
+        .sin_family = AF_INET,
+        .sin_port = htons(SIM_REPORT_PORT),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    int collector = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    int rcvbuf = 8 << 20;
+    setsockopt(collector, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    if (bind(collector, (struct sockaddr *)&s_report_addr, sizeof(s_report_addr)) < 0) {
+        perror("relay-sim: report socket");
+        return 1;
+    }
+
+    pid_t children[SIM_MAX_BOARDS];
+    for (int b = 1; b < s_boards; b++) {
+        children[b] = fork();
+        if (children[b] == 0) {
+            close(collector);
+            start_board(b);
+            pause();
+            _exit(0);
+        }
+    }
+
+    start_board(0);
+    close(s_report);
+    s_report = collector;
+    run_controller(rounds);
+
+    for (int b = 1; b < s_boards; b++) {
+        kill(children[b], SIGTERM);
+        waitpid(children[b], NULL, 0);
+    }
+    return 0;
+}
@@ -0,0 +1,13 @@
+/* Host stand-in for the ESP-IDF header: errors and warnings go to stderr,
+ * info is dropped so it does not skew the benchmarks */
+#ifndef _STUB_ESP_LOG_H_
+#define _STUB_ESP_LOG_H_
+
+#include <stdio.h>
+
+#define ESP_LOGE(tag, fmt, ...) fprintf(stderr, "E %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) fprintf(stderr, "W %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) do { (void)(tag); } while (0)
+#define ESP_LOGD(tag, fmt, ...) do { (void)(tag); } while (0)
+
+#endif
@@ -0,0 +1,27 @@
+/* Host stand-in for the ESP-IDF header, same layout as lwIP's */
+#ifndef _STUB_ESP_NETIF_IP_ADDR_H_
+#define _STUB_ESP_NETIF_IP_ADDR_H_
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t addr;
+} esp_ip4_addr_t;
+
+typedef struct {
+    uint32_t addr[4];
+    uint8_t zone;
+} esp_ip6_addr_t;
+
+typedef struct {
+    union {
+        esp_ip6_addr_t ip6;
+        esp_ip4_addr_t ip4;
+    } u_addr;
+    uint8_t type;
+} esp_ip_addr_t;
+
+#define ESP_IPADDR_TYPE_V4 0
+#define ESP_IPADDR_TYPE_V6 6
+
+#endif
@@ -0,0 +1,15 @@
+/* Host stand-in for the ESP-IDF header */
+#ifndef _STUB_ESP_TIMER_H_
+#define _STUB_ESP_TIMER_H_
+
+#include <stdint.h>
+#include <time.h>
+
+static inline int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+#endif
@@ -0,0 +1,16 @@
+/* Host stand-in for the FreeRTOS header, one tick is one millisecond */
+#ifndef _STUB_FREERTOS_H_
+#define _STUB_FREERTOS_H_
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+
+#define portMAX_DELAY      0xffffffffUL
+#define portTICK_PERIOD_MS 1
+#define pdTRUE             1
+#define pdFALSE            0
+#define pdPASS             1
+
+#endif
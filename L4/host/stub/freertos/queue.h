@@ -0,0 +1,97 @@
+/* Host stand-in for the FreeRTOS header, a queue of fixed size items */
+#ifndef _STUB_FREERTOS_QUEUE_H_
+#define _STUB_FREERTOS_QUEUE_H_
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include "freertos/FreeRTOS.h"
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    size_t length;
+    size_t item_size;
+    size_t head;
+    size_t count;
+    unsigned char items[];
+} stub_queue_t;
+
+typedef stub_queue_t *QueueHandle_t;
+
+static inline QueueHandle_t xQueueCreate(size_t length, size_t item_size)
+{
+    stub_queue_t *queue = calloc(1, sizeof(*queue) + length * item_size);
+    if (queue) {
+        pthread_mutex_init(&queue->lock, NULL);
+        pthread_cond_init(&queue->changed, NULL);
+        queue->length = length;
+        queue->item_size = item_size;
+    }
+    return queue;
+}
+
+/* Waits until cond_ok() holds or ticks ran out, with queue->lock held */
+static inline int stub_queue_wait(stub_queue_t *queue, TickType_t ticks, int (*cond_ok)(stub_queue_t *))
+{
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    if (ticks != portMAX_DELAY) {
+        uint64_t ns = until.tv_nsec + (uint64_t)ticks * portTICK_PERIOD_MS * 1000000;
+        until.tv_sec += ns / 1000000000;
+        until.tv_nsec = ns % 1000000000;
+    }
+    while (!cond_ok(queue)) {
+        if (ticks == 0) {
+            return 0;
+        }
+        if (ticks == portMAX_DELAY) {
+            pthread_cond_wait(&queue->changed, &queue->lock);
+        } else if (pthread_cond_timedwait(&queue->changed, &queue->lock, &until) == ETIMEDOUT) {
+            return cond_ok(queue);
+        }
+    }
+    return 1;
+}
+
+static inline int stub_queue_has_space(stub_queue_t *queue)
+{
+    return queue->count < queue->length;
+}
+
+static inline int stub_queue_has_item(stub_queue_t *queue)
+{
+    return queue->count > 0;
+}
+
+static inline BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    pthread_mutex_lock(&queue->lock);
+    int ok = stub_queue_wait(queue, ticks, stub_queue_has_space);
+    if (ok) {
+        size_t tail = (queue->head + queue->count) % queue->length;
+        memcpy(queue->items + tail * queue->item_size, item, queue->item_size);
+        queue->count++;
+        pthread_cond_broadcast(&queue->changed);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+static inline BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    pthread_mutex_lock(&queue->lock);
+    int ok = stub_queue_wait(queue, ticks, stub_queue_has_item);
+    if (ok) {
+        memcpy(item, queue->items + queue->head * queue->item_size, queue->item_size);
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        pthread_cond_broadcast(&queue->changed);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+#endif
@@ -0,0 +1,43 @@
+/* Host stand-in for the FreeRTOS header, mutexes only */
+#ifndef _STUB_FREERTOS_SEMPHR_H_
+#define _STUB_FREERTOS_SEMPHR_H_
+
+#include <stdlib.h>
+#include <pthread.h>
+#include "freertos/FreeRTOS.h"
+
+typedef pthread_mutex_t *SemaphoreHandle_t;
+
+static inline SemaphoreHandle_t stub_mutex_create(int type)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, type);
+    SemaphoreHandle_t mutex = malloc(sizeof(*mutex));
+    if (mutex) {
+        pthread_mutex_init(mutex, &attr);
+    }
+    pthread_mutexattr_destroy(&attr);
+    return mutex;
+}
+
+/* Only portMAX_DELAY is used by the modules built on the host */
+static inline BaseType_t stub_mutex_take(SemaphoreHandle_t mutex, TickType_t ticks)
+{
+    (void)ticks;
+    return pthread_mutex_lock(mutex) == 0 ? pdTRUE : pdFALSE;
+}
+
+static inline BaseType_t stub_mutex_give(SemaphoreHandle_t mutex)
+{
+    return pthread_mutex_unlock(mutex) == 0 ? pdTRUE : pdFALSE;
+}
+
+#define xSemaphoreCreateMutex()          stub_mutex_create(PTHREAD_MUTEX_NORMAL)
+#define xSemaphoreCreateRecursiveMutex() stub_mutex_create(PTHREAD_MUTEX_RECURSIVE)
+#define xSemaphoreTake                   stub_mutex_take
+#define xSemaphoreGive                   stub_mutex_give
+#define xSemaphoreTakeRecursive          stub_mutex_take
+#define xSemaphoreGiveRecursive          stub_mutex_give
+
+#endif
@@ -0,0 +1,59 @@
+/* Host stand-in for the FreeRTOS header, a task is a detached thread */
+#ifndef _STUB_FREERTOS_TASK_H_
+#define _STUB_FREERTOS_TASK_H_
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "freertos/FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *);
+typedef pthread_t TaskHandle_t;
+
+static inline void vTaskDelay(TickType_t ticks)
+{
+    usleep(ticks * 1000 * portTICK_PERIOD_MS);
+}
+
+typedef struct {
+    TaskFunction_t task;
+    void *arg;
+} stub_task_start_t;
+
+static inline void *stub_task_entry(void *start)
+{
+    stub_task_start_t s = *(stub_task_start_t *)start;
+    free(start);
+    s.task(s.arg);
+    return NULL;
+}
+
+static inline BaseType_t xTaskCreate(TaskFunction_t task, const char *name, uint32_t stack_depth,
+                                     void *arg, unsigned priority, TaskHandle_t *handle)
+{
+    (void)name; (void)stack_depth; (void)priority;
+    stub_task_start_t *start = malloc(sizeof(*start));
+    if (start == NULL) {
+        return pdFALSE;
+    }
+    *start = (stub_task_start_t){task, arg};
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, stub_task_entry, start) != 0) {
+        free(start);
+        return pdFALSE;
+    }
+    pthread_detach(thread);
+    if (handle) {
+        *handle = thread;
+    }
+    return pdPASS;
+}
+
+/* Only vTaskDelete(NULL), the calling task, is used */
+static inline void vTaskDelete(void *task)
+{
+    (void)task;
+    pthread_exit(NULL);
+}
+
+#endif
@@ -0,0 +1,21 @@
+/* Force-included (-include stub/host-compat.h) into the firmware sources
+ * built on the host: newlib has strlcpy, glibc only since 2.38 */
+#ifndef _STUB_HOST_COMPAT_H_
+#define _STUB_HOST_COMPAT_H_
+
+#include <string.h>
+
+#if defined(__GLIBC__) && (__GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38))
+static inline size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+    if (size) {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+#endif
+
+#endif
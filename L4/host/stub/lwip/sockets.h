@@ -0,0 +1,12 @@
+/* Host stand-in for the lwIP header, the BSD socket API is the same */
+#ifndef _STUB_LWIP_SOCKETS_H_
+#define _STUB_LWIP_SOCKETS_H_
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#endif
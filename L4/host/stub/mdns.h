@@ -0,0 +1,62 @@
+/* Host stand-in for the ESP-IDF mdns component header. Only the browse
+ * and the async query used by mdns-cache.c, implemented by mdns-host.c. */
+#ifndef _STUB_MDNS_H_
+#define _STUB_MDNS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_netif_ip_addr.h"
+
+#define MDNS_TYPE_A   0x0001
+#define MDNS_TYPE_PTR 0x000C
+#define MDNS_TYPE_TXT 0x0010
+#define MDNS_TYPE_SRV 0x0021
+
+typedef struct mdns_ip_addr_s {
+    esp_ip_addr_t addr;
+    struct mdns_ip_addr_s *next;
+} mdns_ip_addr_t;
+
+typedef struct {
+    const char *key;
+    const char *value;
+} mdns_txt_item_t;
+
+typedef struct mdns_result_s {
+    struct mdns_result_s *next;
+    void *esp_netif;
+    uint32_t ttl;
+    int ip_protocol;
+    char *instance_name;
+    char *service_type;
+    char *proto;
+    char *hostname;
+    uint16_t port;
+    mdns_txt_item_t *txt;
+    uint8_t *txt_value_len;
+    size_t txt_count;
+    mdns_ip_addr_t *addr;
+} mdns_result_t;
+
+typedef struct mdns_search_once_s mdns_search_once_t;
+typedef struct mdns_browse_s mdns_browse_t;
+
+typedef void (*mdns_query_notify_t)(mdns_search_once_t *search);
+typedef void (*mdns_browse_notify_t)(mdns_result_t *result);
+
+esp_err_t mdns_init(void);
+void mdns_free(void);
+
+mdns_browse_t *mdns_browse_new(const char *service, const char *proto, mdns_browse_notify_t notifier);
+
+mdns_search_once_t *mdns_query_async_new(const char *name, const char *service, const char *proto, uint16_t type,
+                                         uint32_t timeout, size_t max_results, mdns_query_notify_t notifier);
+bool mdns_query_async_get_results(mdns_search_once_t *search, uint32_t timeout, mdns_result_t **results,
+                                  uint8_t *num_results);
+esp_err_t mdns_query_async_delete(mdns_search_once_t *search);
+
+void mdns_query_results_free(mdns_result_t *results);
+
+#endif
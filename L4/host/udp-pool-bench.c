@@ -0,0 +1,145 @@
+/* Per-send cost of udp_send_led() before and after the socket pool.
+
+   Runs udp-pool.c on Linux against loopback receivers, with the ESP-IDF
+   headers replaced by the ones in stub/. The absolute numbers are the
+   host's, the ratio between the rows is what carries over to lwIP, where
+   socket()/close() also allocate and free a netconn and a pcb.
+
+   Build: gcc -O2 -Istub -I.. udp-pool-bench.c ../udp-pool.c -o udp-pool-bench -lpthread
+   Run:   ./udp-pool-bench [sends]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "esp_timer.h"
+#include "udp-pool.h"
+
+#define MAX_PEERS 16
+
+static int s_receivers[MAX_PEERS];
+static struct sockaddr_in s_peers[MAX_PEERS];
+static volatile bool s_running = true;
+
+/* Keeps the receive buffers empty so no send is slowed down by drops */
+static void *drain_thread(void *arg)
+{
+    (void)arg;
+    char buffer[64];
+    while (s_running) {
+        for (int i = 0; i < MAX_PEERS; i++) {
+            while (recv(s_receivers[i], buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {
+            }
+        }
+        usleep(100);
+    }
+    return NULL;
+}
+
+static void open_peers(void)
+{
+    for (int i = 0; i < MAX_PEERS; i++) {
+        s_receivers[i] = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+        struct sockaddr_in addr = {
+            .sin_family = AF_INET,
+            .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+            .sin_port = 0,
+        };
+        socklen_t len = sizeof(addr);
+        if (s_receivers[i] < 0 || bind(s_receivers[i], (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+            getsockname(s_receivers[i], (struct sockaddr *)&s_peers[i], &len) < 0) {
+            perror("receiver");
+            exit(1);
+        }
+    }
+}
+
+/* What udp_send_led() did for every command before the pool */
+static int send_with_new_socket(const struct sockaddr_in *dest, const char *payload, size_t len)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (sock < 0) {
+        return -1;
+    }
+    struct timeval timeout = {.tv_sec = 10, .tv_usec = 0};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+    int err = sendto(sock, payload, len, 0, (const struct sockaddr *)dest, sizeof(*dest));
+    shutdown(sock, 0);
+    close(sock);
+    return err;
+}
+
+static void report(const char *name, int sends, int failures, int64_t elapsed_us, double baseline_ns)
+{
+    double ns = elapsed_us * 1000.0 / sends;
+    printf("%-28s %9.0f ns/send", name, ns);
+    if (baseline_ns > 0) {
+        printf("  %5.1fx", baseline_ns / ns);
+    }
+    if (failures) {
+        printf("  (%d failed)", failures);
+    }
+    printf("\n");
+}
+
+static double run_new_socket(int sends, int peers, double baseline_ns, const char *name)
+{
+    const char payload[] = "GPIO4=1";
+    int failures = 0;
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < sends; i++) {
+        if (send_with_new_socket(&s_peers[i % peers], payload, sizeof(payload) - 1) < 0) {
+            failures++;
+        }
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    report(name, sends, failures, elapsed, baseline_ns);
+    return elapsed * 1000.0 / sends;
+}
+
+static void run_pool(int sends, int peers, double baseline_ns, const char *name)
+{
+    const char payload[] = "GPIO4=1";
+    int failures = 0;
+    udp_pool_close_all();
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < sends; i++) {
+        if (udp_pool_send(&s_peers[i % peers], payload, sizeof(payload) - 1) != ESP_OK) {
+            failures++;
+        }
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    report(name, sends, failures, elapsed, baseline_ns);
+}
+
+int main(int argc, char **argv)
+{
+    int sends = argc > 1 ? atoi(argv[1]) : 200000;
+    if (sends <= 0) {
+        fprintf(stderr, "usage: %s [sends]\n", argv[0]);
+        return 1;
+    }
+
+    udp_pool_init();
+    open_peers();
+    pthread_t drain;
+    pthread_create(&drain, NULL, drain_thread, NULL);
+
+    printf("%d sends of one command, pool of %d sockets\n\n", sends, UDP_POOL_SIZE);
+
+    double one_peer = run_new_socket(sends, 1, 0, "new socket, 1 peer");
+    run_pool(sends, 1, one_peer, "pool, 1 peer");
+
+    double pool_peers = run_new_socket(sends, UDP_POOL_SIZE, 0, "new socket, pool-size peers");
+    run_pool(sends, UDP_POOL_SIZE, pool_peers, "pool, pool-size peers");
+
+    /* Round robin over more peers than sockets: every send misses and
+     * evicts, the worst case for the pool */
+    double many_peers = run_new_socket(sends, MAX_PEERS, 0, "new socket, 2x pool peers");
+    run_pool(sends, MAX_PEERS, many_peers, "pool, 2x pool peers (thrash)");
+
+    s_running = false;
+    pthread_join(drain, NULL);
+    udp_pool_close_all();
+    return 0;
+}
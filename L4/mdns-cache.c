@@ -0,0 +1,414 @@
+#include "mdns-cache.h"
+
+#include <string.h>
+#include <strings.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mdns.h"
+
+static const char *TAG = "mdns_cache";
+
+typedef struct {
+    bool used;
+    mdns_cache_entry_t entry;
+} cache_slot_t;
+
+typedef struct {
+    char service[16];
+    char proto[8];
+    mdns_search_once_t *refresh;    /* PTR query in flight, if any */
+} cache_service_t;
+
+/* One answer copied out of an mdns_result_t, the strings are "" and
+ * addr/port 0 when the answer did not carry them */
+typedef struct {
+    char instance[MDNS_CACHE_NAME_LEN];
+    char hostname[MDNS_CACHE_NAME_LEN];
+    char service[16];
+    char proto[8];
+    esp_ip4_addr_t addr;
+    uint16_t port;
+    uint32_t ttl;
+    bool has_txt;
+    char txt[MDNS_CACHE_TXT_LEN];
+    size_t txt_len;
+} cache_answer_t;
+
+typedef struct {
+    mdns_cache_cb_t cb;
+    void *arg;
+} cache_subscriber_t;
+
+static SemaphoreHandle_t s_lock;
+static QueueHandle_t s_answers;
+static cache_slot_t s_slots[MDNS_CACHE_MAX_ENTRIES];
+static cache_service_t s_services[MDNS_CACHE_MAX_SERVICES];
+static size_t s_service_count;
+static cache_subscriber_t s_subscribers[MDNS_CACHE_MAX_SUBSCRIBERS];
+static size_t s_subscriber_count;
+
+static void notify(mdns_cache_event_t event, const mdns_cache_entry_t *entry)
+{
+    for (size_t i = 0; i < s_subscriber_count; i++) {
+        s_subscribers[i].cb(event, entry, s_subscribers[i].arg);
+    }
+}
+
+static cache_slot_t *find_slot(const char *instance, const char *service, const char *proto)
+{
+    for (size_t i = 0; i < MDNS_CACHE_MAX_ENTRIES; i++) {
+        mdns_cache_entry_t *e = &s_slots[i].entry;
+        if (s_slots[i].used && strcmp(e->instance, instance) == 0 &&
+            strcmp(e->service, service) == 0 && strcmp(e->proto, proto) == 0) {
+            return &s_slots[i];
+        }
+    }
+    return NULL;
+}
+
+static cache_slot_t *free_slot(void)
+{
+    for (size_t i = 0; i < MDNS_CACHE_MAX_ENTRIES; i++) {
+        if (!s_slots[i].used) {
+            return &s_slots[i];
+        }
+    }
+    return NULL;
+}
+
+static size_t pack_txt(const mdns_result_t *r, char *txt, size_t size)
+{
+    size_t len = 0;
+    for (size_t t = 0; t < r->txt_count; t++) {
+        int n = snprintf(txt + len, size - len, "%s=%s", r->txt[t].key, r->txt[t].value ? r->txt[t].value : "");
+        if (n < 0 || len + n + 1 > size) {
+            break;
+        }
+        len += n + 1;
+    }
+    return len;
+}
+
+static bool answer_from_result(const char *service, const char *proto, const mdns_result_t *r,
+                               cache_answer_t *a)
+{
+    if (r->instance_name == NULL) {
+        return false;
+    }
+    memset(a, 0, sizeof(*a));
+    strlcpy(a->instance, r->instance_name, sizeof(a->instance));
+    strlcpy(a->service, service, sizeof(a->service));
+    strlcpy(a->proto, proto, sizeof(a->proto));
+    if (r->hostname) {
+        strlcpy(a->hostname, r->hostname, sizeof(a->hostname));
+    }
+    a->port = r->port;
+    for (mdns_ip_addr_t *ip = r->addr; ip; ip = ip->next) {
+        if (ip->addr.type == ESP_IPADDR_TYPE_V4) {
+            a->addr = ip->addr.u_addr.ip4;
+            break;
+        }
+    }
+    if (r->txt_count) {
+        a->has_txt = true;
+        a->txt_len = pack_txt(r, a->txt, sizeof(a->txt));
+    }
+    a->ttl = r->ttl;
+    return true;
+}
+
+/* Merge one answer into the table, with s_lock held. Answers often come
+ * split (PTR and SRV first, the A record later), so a field is only
+ * overwritten when the answer carries it. */
+static void cache_update(const cache_answer_t *a)
+{
+    cache_slot_t *slot = find_slot(a->instance, a->service, a->proto);
+    if (a->ttl == 0) {
+        /* Goodbye packet */
+        if (slot) {
+            slot->used = false;
+            notify(MDNS_CACHE_REMOVED, &slot->entry);
+        }
+        return;
+    }
+
+    mdns_cache_event_t event = MDNS_CACHE_CHANGED;
+    if (slot == NULL) {
+        slot = free_slot();
+        if (slot == NULL) {
+            ESP_LOGW(TAG, "Cache full, dropping %s.%s.%s", a->instance, a->service, a->proto);
+            return;
+        }
+        memset(&slot->entry, 0, sizeof(slot->entry));
+        strlcpy(slot->entry.instance, a->instance, sizeof(slot->entry.instance));
+        strlcpy(slot->entry.service, a->service, sizeof(slot->entry.service));
+        strlcpy(slot->entry.proto, a->proto, sizeof(slot->entry.proto));
+        slot->used = true;
+        event = MDNS_CACHE_ADDED;
+    }
+
+    mdns_cache_entry_t *e = &slot->entry;
+    mdns_cache_entry_t old = *e;
+    if (a->hostname[0]) {
+        strlcpy(e->hostname, a->hostname, sizeof(e->hostname));
+    }
+    if (a->port) {
+        e->port = a->port;
+    }
+    if (a->addr.addr) {
+        e->addr = a->addr;
+    }
+    if (a->has_txt) {
+        memcpy(e->txt, a->txt, a->txt_len);
+        e->txt_len = a->txt_len;
+    }
+    e->ttl = a->ttl;
+    e->updated_us = esp_timer_get_time();
+    e->expires_us = e->updated_us + (int64_t)a->ttl * 1000000;
+
+    if (event == MDNS_CACHE_ADDED ||
+        strcmp(old.hostname, e->hostname) != 0 || old.port != e->port || old.addr.addr != e->addr.addr ||
+        old.txt_len != e->txt_len || memcmp(old.txt, e->txt, e->txt_len) != 0) {
+        notify(event, e);
+    }
+}
+
+static void apply_answer(const cache_answer_t *a)
+{
+    xSemaphoreTakeRecursive(s_lock, portMAX_DELAY);
+    cache_update(a);
+    xSemaphoreGiveRecursive(s_lock);
+}
+
+/* Runs in the mDNS task every time the browse gets an answer, with the
+ * mDNS service lock held. The cache task calls into mdns, so the answers
+ * are only queued here and never wait for s_lock. */
+static void browse_notifier(mdns_result_t *results)
+{
+    cache_answer_t answer;
+    for (mdns_result_t *r = results; r; r = r->next) {
+        if (r->service_type && r->proto && answer_from_result(r->service_type, r->proto, r, &answer) &&
+            xQueueSend(s_answers, &answer, MDNS_CACHE_QUEUE_WAIT_MS / portTICK_PERIOD_MS) != pdTRUE) {
+            ESP_LOGW(TAG, "Answer queue full, dropping %s", answer.instance);
+        }
+    }
+}
+
+static cache_service_t *find_service(const char *service, const char *proto)
+{
+    for (size_t i = 0; i < s_service_count; i++) {
+        if (strcmp(s_services[i].service, service) == 0 && strcmp(s_services[i].proto, proto) == 0) {
+            return &s_services[i];
+        }
+    }
+    return NULL;
+}
+
+/* Takes the answers of a finished refresh, without s_lock held */
+static void collect_refresh(cache_service_t *svc)
+{
+    mdns_result_t *results = NULL;
+    if (!mdns_query_async_get_results(svc->refresh, 0, &results, NULL)) {
+        return;
+    }
+    cache_answer_t answer;
+    for (mdns_result_t *r = results; r; r = r->next) {
+        if (answer_from_result(svc->service, svc->proto, r, &answer)) {
+            apply_answer(&answer);
+        }
+    }
+    mdns_query_results_free(results);
+    mdns_query_async_delete(svc->refresh);
+    svc->refresh = NULL;
+}
+
+/* Expires entries and asks again for the ones close to their TTL, so a
+ * peer that is still there never disappears from the cache. Only this
+ * task touches svc->refresh, and it calls into mdns without s_lock. */
+static void cache_tick(void)
+{
+    bool refresh[MDNS_CACHE_MAX_SERVICES] = {0};
+
+    xSemaphoreTakeRecursive(s_lock, portMAX_DELAY);
+    size_t service_count = s_service_count;
+    xSemaphoreGiveRecursive(s_lock);
+
+    for (size_t i = 0; i < service_count; i++) {
+        if (s_services[i].refresh) {
+            collect_refresh(&s_services[i]);
+        }
+    }
+
+    xSemaphoreTakeRecursive(s_lock, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+    for (size_t i = 0; i < MDNS_CACHE_MAX_ENTRIES; i++) {
+        mdns_cache_entry_t *e = &s_slots[i].entry;
+        if (!s_slots[i].used) {
+            continue;
+        }
+        if (now >= e->expires_us) {
+            s_slots[i].used = false;
+            notify(MDNS_CACHE_REMOVED, e);
+            continue;
+        }
+        int64_t refresh_at = e->updated_us + (int64_t)e->ttl * 10000 * MDNS_CACHE_REFRESH_PERCENT;
+        cache_service_t *svc = find_service(e->service, e->proto);
+        if (now >= refresh_at && svc && svc < s_services + service_count) {
+            refresh[svc - s_services] = true;
+        }
+    }
+    xSemaphoreGiveRecursive(s_lock);
+
+    for (size_t i = 0; i < service_count; i++) {
+        cache_service_t *svc = &s_services[i];
+        if (refresh[i] && svc->refresh == NULL) {
+            /* One PTR query refreshes every instance of the service */
+            svc->refresh = mdns_query_async_new(NULL, svc->service, svc->proto, MDNS_TYPE_PTR,
+                                                3000, MDNS_CACHE_MAX_ENTRIES, NULL);
+        }
+    }
+}
+
+/* Applies the queued browse answers as they come and ticks in between */
+static void mdns_cache_task(void *pvParameters)
+{
+    int64_t next_tick = esp_timer_get_time();
+    while (1) {
+        int64_t now = esp_timer_get_time();
+        if (now >= next_tick) {
+            cache_tick();
+            next_tick = now + MDNS_CACHE_TICK_MS * 1000;
+            now = esp_timer_get_time();
+        }
+
+        int64_t wait_ms = next_tick > now ? (next_tick - now + 999) / 1000 : 0;
+        cache_answer_t answer;
+        if (xQueueReceive(s_answers, &answer, wait_ms / portTICK_PERIOD_MS) == pdTRUE) {
+            apply_answer(&answer);
+        }
+    }
+}
+
+static esp_err_t cache_init(void)
+{
+    if (s_lock) {
+        return ESP_OK;
+    }
+    s_answers = xQueueCreate(MDNS_CACHE_QUEUE_LEN, sizeof(cache_answer_t));
+    if (s_answers == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_lock = xSemaphoreCreateRecursiveMutex();
+    if (s_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreate(mdns_cache_task, "mdns_cache", 3072, NULL, 4, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t mdns_cache_browse(const char *service, const char *proto)
+{
+    esp_err_t err = cache_init();
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    xSemaphoreTakeRecursive(s_lock, portMAX_DELAY);
+    if (find_service(service, proto)) {
+        xSemaphoreGiveRecursive(s_lock);
+        return ESP_OK;
+    }
+    if (s_service_count == MDNS_CACHE_MAX_SERVICES) {
+        xSemaphoreGiveRecursive(s_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    cache_service_t *svc = &s_services[s_service_count++];
+    strlcpy(svc->service, service, sizeof(svc->service));
+    strlcpy(svc->proto, proto, sizeof(svc->proto));
+    svc->refresh = NULL;
+    xSemaphoreGiveRecursive(s_lock);
+
+    if (mdns_browse_new(service, proto, browse_notifier) == NULL) {
+        ESP_LOGE(TAG, "Browse of %s.%s failed", service, proto);
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Browsing %s.%s.local", service, proto);
+    return ESP_OK;
+}
+
+esp_err_t mdns_cache_subscribe(mdns_cache_cb_t cb, void *arg)
+{
+    esp_err_t err = cache_init();
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    xSemaphoreTakeRecursive(s_lock, portMAX_DELAY);
+    if (s_subscriber_count == MDNS_CACHE_MAX_SUBSCRIBERS) {
+        err = ESP_ERR_NO_MEM;
+    } else {
+        s_subscribers[s_subscriber_count].cb = cb;
+        s_subscribers[s_subscriber_count].arg = arg;
+        s_subscriber_count++;
+    }
+    xSemaphoreGiveRecursive(s_lock);
+    return err;
+}
+
+size_t mdns_cache_get(const char *service, const char *proto, mdns_cache_entry_t *out, size_t max)
+{
+    if (s_lock == NULL) {
+        return 0;
+    }
+
+    size_t count = 0;
+    xSemaphoreTakeRecursive(s_lock, portMAX_DELAY);
+    for (size_t i = 0; i < MDNS_CACHE_MAX_ENTRIES; i++) {
+        const mdns_cache_entry_t *e = &s_slots[i].entry;
+        if (s_slots[i].used && strcmp(e->service, service) == 0 && strcmp(e->proto, proto) == 0) {
+            if (count < max) {
+                out[count] = *e;
+            }
+            count++;
+        }
+    }
+    xSemaphoreGiveRecursive(s_lock);
+    return count;
+}
+
+bool mdns_cache_find_host(const char *hostname, esp_ip4_addr_t *addr)
+{
+    if (s_lock == NULL) {
+        return false;
+    }
+
+    bool found = false;
+    xSemaphoreTakeRecursive(s_lock, portMAX_DELAY);
+    for (size_t i = 0; i < MDNS_CACHE_MAX_ENTRIES && !found; i++) {
+        const mdns_cache_entry_t *e = &s_slots[i].entry;
+        if (s_slots[i].used && e->addr.addr && strcasecmp(e->hostname, hostname) == 0) {
+            *addr = e->addr;
+            found = true;
+        }
+    }
+    xSemaphoreGiveRecursive(s_lock);
+    return found;
+}
+
+const char *mdns_cache_txt_get(const mdns_cache_entry_t *entry, const char *key)
+{
+    size_t key_len = strlen(key);
+    for (size_t pos = 0; pos < entry->txt_len; pos += strlen(entry->txt + pos) + 1) {
+        const char *item = entry->txt + pos;
+        if (strncmp(item, key, key_len) == 0 && item[key_len] == '=') {
+            return item + key_len + 1;
+        }
+    }
+    return NULL;
+}
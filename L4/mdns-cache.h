@@ -0,0 +1,67 @@
+#ifndef _MDNS_CACHE_H_
+#define _MDNS_CACHE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_netif_ip_addr.h"
+
+/* The host benchmarks build with bigger caches */
+#ifndef MDNS_CACHE_MAX_ENTRIES
+#define MDNS_CACHE_MAX_ENTRIES     32
+#endif
+#define MDNS_CACHE_MAX_SERVICES    4
+#define MDNS_CACHE_MAX_SUBSCRIBERS 4
+#define MDNS_CACHE_NAME_LEN        64
+#define MDNS_CACHE_TXT_LEN         96
+/* An entry is asked for again once this share of its TTL has passed */
+#define MDNS_CACHE_REFRESH_PERCENT 80
+#define MDNS_CACHE_TICK_MS         500
+/* Browse answers wait here for the cache task, the mDNS task gives up on
+ * one after MDNS_CACHE_QUEUE_WAIT_MS and a later announcement or refresh
+ * brings it back */
+#ifndef MDNS_CACHE_QUEUE_LEN
+#define MDNS_CACHE_QUEUE_LEN       8
+#endif
+#define MDNS_CACHE_QUEUE_WAIT_MS   20
+
+typedef enum {
+    MDNS_CACHE_ADDED,
+    MDNS_CACHE_CHANGED,
+    MDNS_CACHE_REMOVED,
+} mdns_cache_event_t;
+
+typedef struct {
+    char instance[MDNS_CACHE_NAME_LEN];
+    char hostname[MDNS_CACHE_NAME_LEN];
+    char service[16];
+    char proto[8];
+    esp_ip4_addr_t addr;            /* 0 until the A record arrived */
+    uint16_t port;
+    uint32_t ttl;                   /* seconds, as announced */
+    char txt[MDNS_CACHE_TXT_LEN];   /* "key=value" items, each ended by '\0' */
+    size_t txt_len;
+    int64_t updated_us;             /* last time the records were seen */
+    int64_t expires_us;
+} mdns_cache_entry_t;
+
+/* Called from the cache task with the cache locked, so it must be short. The cache may be read from inside the callback. */
+typedef void (*mdns_cache_cb_t)(mdns_cache_event_t event, const mdns_cache_entry_t *entry, void *arg);
+
+/* Keep browsing service.proto in the background. mdns_init() must have
+ * been called. */
+esp_err_t mdns_cache_browse(const char *service, const char *proto);
+
+esp_err_t mdns_cache_subscribe(mdns_cache_cb_t cb, void *arg);
+
+/* Copy the live instances of service.proto to out, returns how many there are */
+size_t mdns_cache_get(const char *service, const char *proto, mdns_cache_entry_t *out, size_t max);
+
+/* Address of a host seen in any browsed service */
+bool mdns_cache_find_host(const char *hostname, esp_ip4_addr_t *addr);
+
+/* Value of a TXT item of the entry, NULL if it has none */
+const char *mdns_cache_txt_get(const mdns_cache_entry_t *entry, const char *key);
+
+#endif
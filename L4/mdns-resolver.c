@@ -0,0 +1,175 @@
+#include "mdns-resolver.h"
+
+#include <string.h>
+#include <strings.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mdns.h"
+#include "mdns-cache.h"
+
+#define QUERY_DONE_BIT BIT0
+
+static const char *TAG = "mdns_resolver";
+
+typedef enum {
+    SLOT_EMPTY,
+    SLOT_IN_FLIGHT,
+    SLOT_RESOLVED,
+    SLOT_NOT_FOUND,
+} slot_state_t;
+
+typedef struct {
+    char name[MDNS_CACHE_NAME_LEN];
+    slot_state_t state;
+    esp_err_t err;              /* result of the last query */
+    esp_ip4_addr_t addr;
+    int64_t valid_until_us;     /* for RESOLVED and NOT_FOUND */
+    uint32_t backoff_ms;
+    int waiters;
+    EventGroupHandle_t done;
+} resolver_slot_t;
+
+static SemaphoreHandle_t s_lock;
+static resolver_slot_t s_slots[MDNS_RESOLVER_SLOTS];
+
+esp_err_t mdns_resolver_init(void)
+{
+    if (s_lock) {
+        return ESP_OK;
+    }
+    for (int i = 0; i < MDNS_RESOLVER_SLOTS; i++) {
+        if (s_slots[i].done == NULL && (s_slots[i].done = xEventGroupCreate()) == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    /* Last, the resolver counts as ready once the lock is there */
+    s_lock = xSemaphoreCreateMutex();
+    return s_lock ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+static resolver_slot_t *find_slot(const char *host_name)
+{
+    for (int i = 0; i < MDNS_RESOLVER_SLOTS; i++) {
+        if (s_slots[i].state != SLOT_EMPTY && strcasecmp(s_slots[i].name, host_name) == 0) {
+            return &s_slots[i];
+        }
+    }
+    return NULL;
+}
+
+/* An empty slot, or else the one closest to expiry that nobody uses */
+static resolver_slot_t *claim_slot(void)
+{
+    resolver_slot_t *victim = NULL;
+    for (int i = 0; i < MDNS_RESOLVER_SLOTS; i++) {
+        resolver_slot_t *slot = &s_slots[i];
+        if (slot->state == SLOT_EMPTY) {
+            return slot;
+        }
+        if (slot->state != SLOT_IN_FLIGHT && slot->waiters == 0 &&
+            (victim == NULL || slot->valid_until_us < victim->valid_until_us)) {
+            victim = slot;
+        }
+    }
+    if (victim) {
+        victim->backoff_ms = 0;
+    }
+    return victim;
+}
+
+static esp_err_t wait_for_query(resolver_slot_t *slot, esp_ip4_addr_t *addr)
+{
+    slot->waiters++;
+    xSemaphoreGive(s_lock);
+
+    EventBits_t bits = xEventGroupWaitBits(slot->done, QUERY_DONE_BIT, pdFALSE, pdFALSE,
+                                           (MDNS_RESOLVER_TIMEOUT_MS + 1000) / portTICK_PERIOD_MS);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = (bits & QUERY_DONE_BIT) ? slot->err : ESP_ERR_TIMEOUT;
+    if (err == ESP_OK) {
+        *addr = slot->addr;
+    }
+    slot->waiters--;
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+static void finish_query(resolver_slot_t *slot, esp_err_t err, const esp_ip4_addr_t *addr)
+{
+    int64_t now = esp_timer_get_time();
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    slot->err = err;
+    if (err == ESP_OK) {
+        slot->state = SLOT_RESOLVED;
+        slot->addr = *addr;
+        slot->backoff_ms = 0;
+        slot->valid_until_us = now + MDNS_RESOLVER_POSITIVE_MS * 1000LL;
+    } else if (err == ESP_ERR_NOT_FOUND) {
+        slot->state = SLOT_NOT_FOUND;
+        slot->backoff_ms = slot->backoff_ms ? slot->backoff_ms * 2 : MDNS_RESOLVER_NEGATIVE_MIN_MS;
+        if (slot->backoff_ms > MDNS_RESOLVER_NEGATIVE_MAX_MS) {
+            slot->backoff_ms = MDNS_RESOLVER_NEGATIVE_MAX_MS;
+        }
+        slot->valid_until_us = now + slot->backoff_ms * 1000LL;
+        ESP_LOGI(TAG, "%s.local not found, next query in %u ms", slot->name, (unsigned)slot->backoff_ms);
+    } else {
+        /* Not an answer about the host, the next caller asks again */
+        slot->state = SLOT_NOT_FOUND;
+        slot->valid_until_us = now;
+    }
+    xEventGroupSetBits(slot->done, QUERY_DONE_BIT);
+    xSemaphoreGive(s_lock);
+}
+
+esp_err_t mdns_resolve_host(const char *host_name, esp_ip4_addr_t *addr)
+{
+    if (mdns_cache_find_host(host_name, addr)) {
+        return ESP_OK;
+    }
+
+    if (s_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    resolver_slot_t *slot = find_slot(host_name);
+    int64_t now = esp_timer_get_time();
+
+    if (slot && slot->state == SLOT_IN_FLIGHT) {
+        return wait_for_query(slot, addr);
+    }
+    if (slot && now < slot->valid_until_us) {
+        esp_err_t err = slot->state == SLOT_RESOLVED ? ESP_OK : ESP_ERR_NOT_FOUND;
+        if (err == ESP_OK) {
+            *addr = slot->addr;
+        }
+        xSemaphoreGive(s_lock);
+        return err;
+    }
+
+    if (slot == NULL) {
+        slot = claim_slot();
+        if (slot == NULL) {
+            /* Every slot is busy, query without caching */
+            xSemaphoreGive(s_lock);
+            return mdns_query_a(host_name, MDNS_RESOLVER_TIMEOUT_MS, addr);
+        }
+        strlcpy(slot->name, host_name, sizeof(slot->name));
+    }
+    slot->state = SLOT_IN_FLIGHT;
+    xEventGroupClearBits(slot->done, QUERY_DONE_BIT);
+    xSemaphoreGive(s_lock);
+
+    esp_ip4_addr_t result = {0};
+    esp_err_t err = mdns_query_a(host_name, MDNS_RESOLVER_TIMEOUT_MS, &result);
+    finish_query(slot, err, &result);
+    if (err == ESP_OK) {
+        *addr = result;
+    }
+    return err;
+}
@@ -0,0 +1,31 @@
+#ifndef _MDNS_RESOLVER_H_
+#define _MDNS_RESOLVER_H_
+
+#include "esp_err.h"
+#include "esp_netif_ip_addr.h"
+
+#define MDNS_RESOLVER_SLOTS         8
+#define MDNS_RESOLVER_TIMEOUT_MS    2000
+/* mdns_query_a() does not return the record TTL, answers are kept this long */
+#define MDNS_RESOLVER_POSITIVE_MS   120000
+/* A missing host is asked for again after MIN, doubling up to MAX */
+#define MDNS_RESOLVER_NEGATIVE_MIN_MS 2000
+#define MDNS_RESOLVER_NEGATIVE_MAX_MS 60000
+
+/* Call once before the tasks that resolve start */
+esp_err_t mdns_resolver_init(void);
+
+/* Resolve host_name.local to an IPv4 address.
+ *
+ * Answers come from the browse cache (mdns-cache.h) when the host
+ * announces a browsed service, then from the resolver's own cache, and
+ * only then from the network. A NOT_FOUND answer is cached too, so an
+ * absent host costs a network query only once per backoff period.
+ * Callers asking for a name that is already being queried wait for that
+ * query and share its result instead of sending their own.
+ *
+ * Returns ESP_OK, ESP_ERR_NOT_FOUND, ESP_ERR_INVALID_STATE before
+ * mdns_resolver_init(), or the error of the query. */
+esp_err_t mdns_resolve_host(const char *host_name, esp_ip4_addr_t *addr);
+
+#endif
@@ -0,0 +1,121 @@
+#include "node-caps.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mdns.h"
+
+static const char *TAG = "node_caps";
+
+static node_caps_t s_caps;
+static char s_service[16];
+static char s_proto[8];
+static bool s_published;
+static volatile uint32_t s_commands;
+static uint32_t s_commands_seen;
+static int64_t s_load_since_us;
+
+int node_caps_encode(const node_caps_t *caps, char *out, size_t size)
+{
+    int len = snprintf(out, size, "%u,f%x,p%u,b%" PRIu32 ",l%u", caps->version, caps->formats, caps->pins,
+                       caps->build, caps->load);
+    return len < 0 || (size_t)len >= size ? -1 : len;
+}
+
+bool node_caps_decode(const char *text, node_caps_t *caps)
+{
+    char *end;
+    unsigned long version = strtoul(text, &end, 10);
+    if (end == text || version == 0 || (*end != ',' && *end != '\0')) {
+        return false;
+    }
+    memset(caps, 0, sizeof(*caps));
+    caps->version = version;
+
+    while (*end == ',' && end[1] != '\0') {
+        char field = end[1];
+        const char *value = end + 2;
+        unsigned long v = strtoul(value, &end, field == 'f' ? 16 : 10);
+        if (end == value) {
+            /* not a number, skip to the next field */
+            end = strchr(value, ',');
+            if (end == NULL) {
+                break;
+            }
+            continue;
+        }
+        switch (field) {
+        case 'f': caps->formats = v; break;
+        case 'p': caps->pins = v; break;
+        case 'b': caps->build = v; break;
+        case 'l': caps->load = v > 100 ? 100 : v; break;
+        default: break;
+        }
+        /* a field of a newer version may carry more than a number */
+        while (*end != ',' && *end != '\0') {
+            end++;
+        }
+    }
+    return true;
+}
+
+static esp_err_t txt_set(void)
+{
+    char value[NODE_CAPS_TXT_LEN];
+    if (node_caps_encode(&s_caps, value, sizeof(value)) < 0) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    esp_err_t err = mdns_service_txt_item_set(s_service, s_proto, NODE_CAPS_TXT_KEY, value);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Publishing %s=%s failed: %d", NODE_CAPS_TXT_KEY, value, err);
+    }
+    return err;
+}
+
+esp_err_t node_caps_publish(const char *service, const char *proto, const node_caps_t *caps)
+{
+    s_caps = *caps;
+    s_caps.version = NODE_CAPS_VERSION;
+    strlcpy(s_service, service, sizeof(s_service));
+    strlcpy(s_proto, proto, sizeof(s_proto));
+    s_commands_seen = s_commands;
+    s_load_since_us = esp_timer_get_time();
+    s_published = true;
+    return txt_set();
+}
+
+void node_caps_count_command(void)
+{
+    s_commands++;
+}
+
+esp_err_t node_caps_update_load(void)
+{
+    if (!s_published) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed_us = now - s_load_since_us;
+    if (elapsed_us <= 0) {
+        return ESP_OK;
+    }
+    uint32_t commands = s_commands;
+    uint32_t rate_pct = (uint64_t)(commands - s_commands_seen) * 100000000 / NODE_CAPS_FULL_LOAD_RATE / elapsed_us;
+    uint8_t load = rate_pct > 100 ? 100 : rate_pct;
+    s_commands_seen = commands;
+    s_load_since_us = now;
+
+    if (abs((int)load - (int)s_caps.load) < NODE_CAPS_LOAD_STEP && !(load == 0 && s_caps.load != 0)) {
+        return ESP_OK;
+    }
+    s_caps.load = load;
+    return txt_set();
+}
+
+uint16_t node_caps_weight(const node_caps_t *caps, uint16_t max_weight)
+{
+    return 1 + (uint32_t)(100 - caps->load) * (max_weight - 1) / 100;
+}
@@ -0,0 +1,69 @@
+#ifndef _NODE_CAPS_H_
+#define _NODE_CAPS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/* What a board can do, published as one TXT item of its service so a
+ * client can pick and configure a target from the browse result alone:
+ *
+ *   cap=1,f3,p1,b42,l17
+ *
+ * The version comes first, then fields of one letter and a number, in
+ * any order. A decoder skips the fields it does not know, so newer
+ * boards stay readable by older clients; the version only changes when
+ * the meaning of an existing field does. */
+#define NODE_CAPS_TXT_KEY   "cap"
+#define NODE_CAPS_VERSION   1
+#define NODE_CAPS_TXT_LEN   32
+
+/* Command formats, the f field */
+#define NODE_CAPS_FMT_GPIO  (1 << 0)    /* "GPIO<n>=<0|1>" */
+#define NODE_CAPS_FMT_PING  (1 << 1)    /* "PING <seq>", answered "PONG <seq>" */
+
+/* Commands per second counted as 100% load, the udp_task of P5 pauses
+ * 200 ms after each one */
+#ifndef NODE_CAPS_FULL_LOAD_RATE
+#define NODE_CAPS_FULL_LOAD_RATE 5
+#endif
+/* The load is published again only after it moved this many points, every
+ * TXT change is an announcement on the network */
+#define NODE_CAPS_LOAD_STEP      10
+
+typedef struct {
+    uint8_t version;
+    uint16_t formats;           /* NODE_CAPS_FMT_* */
+    uint8_t pins;               /* outputs that take commands */
+    uint32_t build;
+    uint8_t load;               /* percent */
+} node_caps_t;
+
+/* Returns the length written, -1 if out is too small */
+int node_caps_encode(const node_caps_t *caps, char *out, size_t size);
+
+/* False if text is not a capability record */
+bool node_caps_decode(const char *text, node_caps_t *caps);
+
+static inline bool node_caps_supports(const node_caps_t *caps, uint16_t formats)
+{
+    return (caps->formats & formats) == formats;
+}
+
+/* Set the cap item of our service.proto, mdns_service_add() first */
+esp_err_t node_caps_publish(const char *service, const char *proto, const node_caps_t *caps);
+
+/* One command handled, counts toward the load */
+void node_caps_count_command(void);
+
+/* Turn the commands counted since the last call into the load and
+ * publish it if it moved by NODE_CAPS_LOAD_STEP. Call it every few
+ * seconds after node_caps_publish(). */
+esp_err_t node_caps_update_load(void);
+
+/* Weight for peer_table_upsert() from the published load, an idle board
+ * gets max_weight turns, a fully loaded one a single turn */
+uint16_t node_caps_weight(const node_caps_t *caps, uint16_t max_weight);
+
+#endif
@@ -0,0 +1,146 @@
+#include "peer-probe.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <errno.h>
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+
+static const char *TAG = "peer_probe";
+
+typedef struct {
+    char name[PEER_TABLE_NAME_LEN];
+    struct sockaddr_in addr;
+    uint32_t seq;
+    int64_t sent_us;
+    bool answered;
+} probe_t;
+
+static peer_table_t *s_table;
+static SemaphoreHandle_t s_lock;
+/* Probes of the current round, too big for the task stack */
+static probe_t s_probes[PEER_TABLE_MAX];
+
+bool peer_probe_answer(const char *msg, size_t len, char *reply, size_t reply_size, size_t *reply_len)
+{
+    size_t prefix = strlen(PEER_PROBE_PING);
+    if (len <= prefix || len - prefix >= reply_size - strlen(PEER_PROBE_PONG) ||
+        memcmp(msg, PEER_PROBE_PING, prefix) != 0) {
+        return false;
+    }
+    memcpy(reply, PEER_PROBE_PONG, strlen(PEER_PROBE_PONG));
+    memcpy(reply + strlen(PEER_PROBE_PONG), msg + prefix, len - prefix);
+    *reply_len = strlen(PEER_PROBE_PONG) + len - prefix;
+    return true;
+}
+
+static void record(const probe_t *probe, bool answered, uint32_t rtt_us)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    /* The peer may have moved in the table or left since the ping */
+    int index = peer_table_find(s_table, probe->name);
+    if (index >= 0) {
+        peer_table_record_probe(s_table, index, answered, rtt_us);
+    }
+    xSemaphoreGive(s_lock);
+}
+
+static void receive_pongs(int sock, size_t count, int64_t deadline_us)
+{
+    char buffer[32];
+    size_t pending = count;
+
+    while (pending) {
+        int64_t left_us = deadline_us - esp_timer_get_time();
+        if (left_us <= 0) {
+            break;
+        }
+        /* lwIP keeps whole milliseconds and takes 0 as no timeout at all,
+         * so round up: a rest under 1 ms would block for good */
+        int64_t left_ms = (left_us + 999) / 1000;
+        struct timeval timeout = {.tv_sec = left_ms / 1000, .tv_usec = (left_ms % 1000) * 1000};
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        struct sockaddr_in source;
+        socklen_t socklen = sizeof(source);
+        int len = recvfrom(sock, buffer, sizeof(buffer) - 1, 0, (struct sockaddr *)&source, &socklen);
+        if (len < 0) {
+            break;
+        }
+        int64_t now = esp_timer_get_time();
+        buffer[len] = '\0';
+        if (strncmp(buffer, PEER_PROBE_PONG, strlen(PEER_PROBE_PONG)) != 0) {
+            continue;
+        }
+
+        uint32_t seq = strtoul(buffer + strlen(PEER_PROBE_PONG), NULL, 10);
+        for (size_t i = 0; i < count; i++) {
+            probe_t *probe = &s_probes[i];
+            if (!probe->answered && probe->seq == seq && probe->addr.sin_addr.s_addr == source.sin_addr.s_addr) {
+                probe->answered = true;
+                pending--;
+                record(probe, true, now - probe->sent_us);
+                break;
+            }
+        }
+    }
+}
+
+static void peer_probe_task(void *pvParameters)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (sock < 0) {
+        ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
+        vTaskDelete(NULL);
+        return;
+    }
+
+    uint32_t seq = 0;
+    while (1) {
+        int64_t round_start = esp_timer_get_time();
+
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        size_t count = s_table->count;
+        for (size_t i = 0; i < count; i++) {
+            memcpy(s_probes[i].name, s_table->names[i], PEER_TABLE_NAME_LEN);
+            s_probes[i].addr = s_table->peers[i].addr;
+        }
+        xSemaphoreGive(s_lock);
+
+        for (size_t i = 0; i < count; i++) {
+            probe_t *probe = &s_probes[i];
+            char ping[24];
+            int len = snprintf(ping, sizeof(ping), PEER_PROBE_PING "%" PRIu32, ++seq);
+            probe->seq = seq;
+            probe->answered = false;
+            probe->sent_us = esp_timer_get_time();
+            sendto(sock, ping, len, 0, (struct sockaddr *)&probe->addr, sizeof(probe->addr));
+        }
+
+        receive_pongs(sock, count, esp_timer_get_time() + PEER_PROBE_TIMEOUT_MS * 1000);
+        for (size_t i = 0; i < count; i++) {
+            if (!s_probes[i].answered) {
+                record(&s_probes[i], false, 0);
+            }
+        }
+
+        int64_t elapsed_ms = (esp_timer_get_time() - round_start) / 1000;
+        if (elapsed_ms < PEER_PROBE_INTERVAL_MS) {
+            vTaskDelay((PEER_PROBE_INTERVAL_MS - elapsed_ms) / portTICK_PERIOD_MS);
+        }
+    }
+}
+
+esp_err_t peer_probe_start(peer_table_t *table, SemaphoreHandle_t lock)
+{
+    s_table = table;
+    s_lock = lock;
+    if (xTaskCreate(peer_probe_task, "peer_probe", 3072, NULL, 5, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
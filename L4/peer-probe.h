@@ -0,0 +1,25 @@
+#ifndef _PEER_PROBE_H_
+#define _PEER_PROBE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "peer-table.h"
+
+#define PEER_PROBE_INTERVAL_MS 1000
+#define PEER_PROBE_TIMEOUT_MS  300
+#define PEER_PROBE_PING        "PING "
+#define PEER_PROBE_PONG        "PONG "
+
+/* Ping every peer of the table once per PEER_PROBE_INTERVAL_MS from a
+ * task of its own and feed the answers, or their absence, to
+ * peer_table_record_probe(). The table is only touched with lock held. */
+esp_err_t peer_probe_start(peer_table_t *table, SemaphoreHandle_t lock);
+
+/* Turn a received "PING <seq>" into the "PONG <seq>" to send back.
+ * Returns false if the message is not a probe. */
+bool peer_probe_answer(const char *msg, size_t len, char *reply, size_t reply_size, size_t *reply_len);
+
+#endif
@@ -0,0 +1,276 @@
+#include "peer-table.h"
+
+#include <string.h>
+
+static void lru_unlink(peer_table_t *table, int index)
+{
+    peer_t *p = &table->peers[index];
+    if (p->lru_prev >= 0) {
+        table->peers[p->lru_prev].lru_next = p->lru_next;
+    } else {
+        table->lru_head = p->lru_next;
+    }
+    if (p->lru_next >= 0) {
+        table->peers[p->lru_next].lru_prev = p->lru_prev;
+    } else {
+        table->lru_tail = p->lru_prev;
+    }
+    p->lru_prev = p->lru_next = -1;
+}
+
+static void lru_append(peer_table_t *table, int index)
+{
+    peer_t *p = &table->peers[index];
+    p->lru_prev = table->lru_tail;
+    p->lru_next = -1;
+    if (table->lru_tail >= 0) {
+        table->peers[table->lru_tail].lru_next = index;
+    } else {
+        table->lru_head = index;
+    }
+    table->lru_tail = index;
+}
+
+static void changed(peer_table_t *table)
+{
+    table->wheel_dirty = true;
+    table->best_dirty = true;
+}
+
+void peer_table_init(peer_table_t *table, peer_policy_t policy)
+{
+    memset(table, 0, sizeof(*table));
+    table->policy = policy;
+    table->lru_head = table->lru_tail = -1;
+    table->best = -1;
+}
+
+int peer_table_find(const peer_table_t *table, const char *name)
+{
+    for (int i = 0; i < table->count; i++) {
+        if (strcmp(table->names[i], name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int peer_table_upsert(peer_table_t *table, const char *name, const struct sockaddr_in *addr, uint16_t weight)
+{
+    if (weight < 1) {
+        weight = 1;
+    } else if (weight > PEER_TABLE_MAX_WEIGHT) {
+        weight = PEER_TABLE_MAX_WEIGHT;
+    }
+
+    int index = peer_table_find(table, name);
+    if (index < 0) {
+        if (table->count == PEER_TABLE_MAX) {
+            return -1;
+        }
+        index = table->count++;
+        memset(&table->peers[index], 0, sizeof(peer_t));
+        strncpy(table->names[index], name, PEER_TABLE_NAME_LEN - 1);
+        table->names[index][PEER_TABLE_NAME_LEN - 1] = '\0';
+        /* A new peer has never been used, so it goes first in LRU order */
+        table->peers[index].lru_prev = -1;
+        table->peers[index].lru_next = table->lru_head;
+        if (table->lru_head >= 0) {
+            table->peers[table->lru_head].lru_prev = index;
+        } else {
+            table->lru_tail = index;
+        }
+        table->lru_head = index;
+        changed(table);
+    }
+
+    peer_t *p = &table->peers[index];
+    if (p->weight != weight) {
+        table->wheel_dirty = true;
+    }
+    p->addr = *addr;
+    p->weight = weight;
+    return index;
+}
+
+bool peer_table_remove(peer_table_t *table, const char *name)
+{
+    int index = peer_table_find(table, name);
+    if (index < 0) {
+        return false;
+    }
+
+    lru_unlink(table, index);
+    int last = --table->count;
+    if (index != last) {
+        /* Move the last peer into the hole and repoint its LRU neighbours */
+        table->peers[index] = table->peers[last];
+        memcpy(table->names[index], table->names[last], PEER_TABLE_NAME_LEN);
+        peer_t *p = &table->peers[index];
+        if (p->lru_prev >= 0) {
+            table->peers[p->lru_prev].lru_next = index;
+        } else {
+            table->lru_head = index;
+        }
+        if (p->lru_next >= 0) {
+            table->peers[p->lru_next].lru_prev = index;
+        } else {
+            table->lru_tail = index;
+        }
+    }
+    if (table->rr_next >= table->count) {
+        table->rr_next = 0;
+    }
+    changed(table);
+    return true;
+}
+
+/* Smooth weighted round robin, played once into the wheel so a selection
+ * is just the next slot: weights 3 and 1 give A A B A rather than A A A B */
+static void build_wheel(peer_table_t *table)
+{
+    int current[PEER_TABLE_MAX] = {0};
+    int total = 0;
+    for (int i = 0; i < table->count; i++) {
+        total += table->peers[i].weight;
+    }
+
+    for (int slot = 0; slot < total; slot++) {
+        int pick = 0;
+        for (int i = 0; i < table->count; i++) {
+            current[i] += table->peers[i].weight;
+            if (current[i] > current[pick]) {
+                pick = i;
+            }
+        }
+        current[pick] -= total;
+        table->wheel[slot] = pick;
+    }
+    table->wheel_len = total;
+    table->wheel_pos = 0;
+    table->wheel_dirty = false;
+}
+
+static void find_best(peer_table_t *table)
+{
+    table->best = -1;
+    for (int i = 0; i < table->count; i++) {
+        if (!peer_healthy(&table->peers[i])) {
+            continue;
+        }
+        if (table->best < 0) {
+            table->best = i;
+            continue;
+        }
+        uint32_t rtt = table->peers[i].srtt_us;
+        uint32_t best_rtt = table->peers[table->best].srtt_us;
+        /* An unmeasured peer only wins against other unmeasured ones */
+        if (rtt && (best_rtt == 0 || rtt < best_rtt)) {
+            table->best = i;
+        }
+    }
+    table->best_dirty = false;
+}
+
+int peer_table_select(peer_table_t *table)
+{
+    if (table->count == 0) {
+        return -1;
+    }
+
+    /* The policies skip the peers that stopped answering, which costs a
+     * few extra steps only while some are down */
+    int index = -1;
+    switch (table->policy) {
+    case PEER_POLICY_WEIGHTED:
+        if (table->wheel_dirty) {
+            build_wheel(table);
+        }
+        for (int step = 0; step < table->wheel_len && index < 0; step++) {
+            int i = table->wheel[table->wheel_pos];
+            table->wheel_pos = (table->wheel_pos + 1) % table->wheel_len;
+            if (peer_healthy(&table->peers[i])) {
+                index = i;
+            }
+        }
+        break;
+    case PEER_POLICY_LRU:
+        for (int i = table->lru_head; i >= 0 && index < 0; i = table->peers[i].lru_next) {
+            if (peer_healthy(&table->peers[i])) {
+                index = i;
+            }
+        }
+        break;
+    case PEER_POLICY_MIN_RTT:
+        if (table->best_dirty) {
+            find_best(table);
+        }
+        index = table->best;
+        break;
+    case PEER_POLICY_ROUND_ROBIN:
+    default:
+        for (int step = 0; step < table->count && index < 0; step++) {
+            int i = table->rr_next;
+            table->rr_next = (table->rr_next + 1) % table->count;
+            if (peer_healthy(&table->peers[i])) {
+                index = i;
+            }
+        }
+        break;
+    }
+    if (index < 0) {
+        return -1;
+    }
+
+    /* Every policy counts as a use for the LRU order */
+    if (table->lru_tail != index) {
+        lru_unlink(table, index);
+        lru_append(table, index);
+    }
+    return index;
+}
+
+void peer_table_set_rtt(peer_table_t *table, int index, uint32_t srtt_us)
+{
+    if (index < 0 || index >= table->count) {
+        return;
+    }
+    uint32_t old = table->peers[index].srtt_us;
+    table->peers[index].srtt_us = srtt_us;
+    if (table->best_dirty || table->best < 0) {
+        return;
+    }
+
+    if (index == table->best) {
+        /* It may have fallen behind another peer */
+        if (srtt_us == 0 || srtt_us > old) {
+            table->best_dirty = true;
+        }
+    } else if (peer_healthy(&table->peers[index])) {
+        uint32_t best_rtt = table->peers[table->best].srtt_us;
+        if (srtt_us && (best_rtt == 0 || srtt_us < best_rtt)) {
+            table->best = index;
+        }
+    }
+}
+
+void peer_table_record_probe(peer_table_t *table, int index, bool answered, uint32_t rtt_us)
+{
+    if (index < 0 || index >= table->count) {
+        return;
+    }
+    peer_t *p = &table->peers[index];
+    bool was_healthy = peer_healthy(p);
+
+    p->loss_pct = (p->loss_pct * 7 + (answered ? 0 : 100)) / 8;
+    if (answered) {
+        p->misses = 0;
+        peer_table_set_rtt(table, index, p->srtt_us ? (p->srtt_us * 7 + rtt_us) / 8 : rtt_us);
+    } else if (p->misses < UINT8_MAX) {
+        p->misses++;
+    }
+
+    if (peer_healthy(p) != was_healthy) {
+        table->best_dirty = true;
+    }
+}
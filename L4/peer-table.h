@@ -0,0 +1,90 @@
+#ifndef _PEER_TABLE_H_
+#define _PEER_TABLE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "lwip/sockets.h"
+
+/* The host benchmarks build with bigger tables */
+#ifndef PEER_TABLE_MAX
+#define PEER_TABLE_MAX        32
+#endif
+#define PEER_TABLE_NAME_LEN   64
+#define PEER_TABLE_MAX_WEIGHT 8
+#define PEER_TABLE_WHEEL_SIZE (PEER_TABLE_MAX * PEER_TABLE_MAX_WEIGHT)
+/* Probes in a row a peer may leave unanswered before it is skipped */
+#define PEER_TABLE_MAX_MISSES 3
+/* A peer that loses this share of its probes is skipped too, even when
+ * it answers often enough never to miss three in a row */
+#define PEER_TABLE_MAX_LOSS_PCT 50
+
+typedef enum {
+    PEER_POLICY_ROUND_ROBIN,
+    PEER_POLICY_WEIGHTED,       /* round robin, weight turns per peer */
+    PEER_POLICY_LRU,            /* the peer unused for the longest time */
+    PEER_POLICY_MIN_RTT,        /* the closest peer, once RTTs are known */
+} peer_policy_t;
+
+/* Only what a send needs, so walking the table stays within a few cache
+ * lines. The names live in a separate array. */
+typedef struct {
+    struct sockaddr_in addr;
+    uint32_t srtt_us;           /* smoothed RTT, 0 until measured */
+    uint16_t weight;
+    uint8_t loss_pct;           /* smoothed share of lost probes */
+    uint8_t misses;             /* probes lost in a row */
+    int16_t lru_prev;
+    int16_t lru_next;
+} peer_t;
+
+/* Peers are kept packed at the front of the array, a removal moves the
+ * last one into the hole. Selection is O(1); the weighted wheel and the
+ * lowest RTT are recomputed only after the table changed.
+ * The table does no locking, the owner serializes the calls. */
+typedef struct {
+    peer_t peers[PEER_TABLE_MAX];
+    char names[PEER_TABLE_MAX][PEER_TABLE_NAME_LEN];
+    uint16_t count;
+    peer_policy_t policy;
+
+    uint16_t rr_next;
+
+    uint16_t wheel[PEER_TABLE_WHEEL_SIZE];
+    uint16_t wheel_len;
+    uint16_t wheel_pos;
+    bool wheel_dirty;
+
+    int16_t lru_head;           /* least recently used */
+    int16_t lru_tail;
+
+    int16_t best;
+    bool best_dirty;
+} peer_table_t;
+
+void peer_table_init(peer_table_t *table, peer_policy_t policy);
+
+/* Add the peer or update its address and weight (1..PEER_TABLE_MAX_WEIGHT).
+ * Returns its index, -1 when the table is full. */
+int peer_table_upsert(peer_table_t *table, const char *name, const struct sockaddr_in *addr, uint16_t weight);
+
+bool peer_table_remove(peer_table_t *table, const char *name);
+
+int peer_table_find(const peer_table_t *table, const char *name);
+
+/* Index of the next peer to use under the table policy, -1 if there is
+ * no peer that still answers its probes */
+int peer_table_select(peer_table_t *table);
+
+void peer_table_set_rtt(peer_table_t *table, int index, uint32_t srtt_us);
+
+/* Fold one probe into the peer's smoothed RTT and loss rate (gain 1/8 as
+ * in RFC 6298). rtt_us is ignored when the probe was not answered. */
+void peer_table_record_probe(peer_table_t *table, int index, bool answered, uint32_t rtt_us);
+
+static inline bool peer_healthy(const peer_t *peer)
+{
+    return peer->misses < PEER_TABLE_MAX_MISSES && peer->loss_pct < PEER_TABLE_MAX_LOSS_PCT;
+}
+
+#endif
@@ -0,0 +1,162 @@
+#include "relay.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+
+static const char *TAG = "relay";
+
+void relay_init(relay_t *relay, const char *self, uint32_t origin)
+{
+    memset(relay, 0, sizeof(*relay));
+    strlcpy(relay->self, self, sizeof(relay->self));
+    relay->origin = origin;
+}
+
+/* Records the id, returns false if it was already there */
+static bool remember(relay_t *relay, relay_id_t id)
+{
+    for (uint16_t i = 0; i < relay->seen_count; i++) {
+        if (relay->seen[i].origin == id.origin && relay->seen[i].seq == id.seq) {
+            return false;
+        }
+    }
+    relay->seen[relay->seen_next] = id;
+    relay->seen_next = (relay->seen_next + 1) % RELAY_SEEN_SIZE;
+    if (relay->seen_count < RELAY_SEEN_SIZE) {
+        relay->seen_count++;
+    }
+    return true;
+}
+
+/* Expected time for one delivery over the link: the RTT stretched by the
+ * share of packets it loses */
+static uint32_t link_cost(const peer_t *peer)
+{
+    uint32_t rtt = peer->srtt_us ? peer->srtt_us : RELAY_UNKNOWN_RTT_US;
+    uint32_t loss = peer->loss_pct > 99 ? 99 : peer->loss_pct;
+    return (uint64_t)rtt * 100 / (100 - loss);
+}
+
+/* By address only: the origin sends from the unbound sockets of its pool,
+ * whose source port is not the one it listens on */
+static bool same_host(const struct sockaddr_in *a, const struct sockaddr_in *b)
+{
+    return a && a->sin_addr.s_addr == b->sin_addr.s_addr;
+}
+
+/* The destination alone when its link is good, else the cheapest healthy
+ * links that do not lead back to where the message came from */
+static void choose_next(const peer_table_t *table, const char *dest, const struct sockaddr_in *from,
+                        relay_action_t *action)
+{
+    action->next_count = 0;
+
+    int index = peer_table_find(table, dest);
+    if (index >= 0 && peer_healthy(&table->peers[index]) &&
+        table->peers[index].loss_pct <= RELAY_DIRECT_LOSS_PCT) {
+        action->next[action->next_count++] = table->peers[index].addr;
+        return;
+    }
+
+    uint32_t costs[RELAY_FANOUT];
+    for (int i = 0; i < table->count; i++) {
+        const peer_t *peer = &table->peers[i];
+        if (!peer_healthy(peer) || same_host(from, &peer->addr)) {
+            continue;
+        }
+        uint32_t cost = link_cost(peer);
+        /* insertion into the short sorted list of the best ones */
+        size_t pos = action->next_count;
+        while (pos > 0 && costs[pos - 1] > cost) {
+            if (pos < RELAY_FANOUT) {
+                costs[pos] = costs[pos - 1];
+                action->next[pos] = action->next[pos - 1];
+            }
+            pos--;
+        }
+        if (pos < RELAY_FANOUT) {
+            costs[pos] = cost;
+            action->next[pos] = peer->addr;
+            if (action->next_count < RELAY_FANOUT) {
+                action->next_count++;
+            }
+        }
+    }
+}
+
+static bool build(relay_action_t *action, const char *dest, const char *command)
+{
+    int len = snprintf(action->msg, sizeof(action->msg), RELAY_PREFIX "%08" PRIx32 ".%" PRIu32 " %u\n%s\n%s",
+                       action->id.origin, action->id.seq, action->hops + 1, dest, command);
+    if (len < 0 || (size_t)len >= sizeof(action->msg)) {
+        return false;
+    }
+    action->len = len;
+    return true;
+}
+
+bool relay_originate(relay_t *relay, const peer_table_t *table, const char *dest, const char *command,
+                     relay_action_t *action)
+{
+    memset(action, 0, sizeof(*action));
+    action->id = (relay_id_t){relay->origin, relay->next_seq++};
+    if (!build(action, dest, command)) {
+        return false;
+    }
+    remember(relay, action->id);
+    choose_next(table, dest, NULL, action);
+    return action->next_count > 0;
+}
+
+bool relay_handle(relay_t *relay, const peer_table_t *table, const struct sockaddr_in *from, const char *msg,
+                  size_t len, relay_action_t *action)
+{
+    size_t prefix = strlen(RELAY_PREFIX);
+    if (len <= prefix || memcmp(msg, RELAY_PREFIX, prefix) != 0) {
+        return false;
+    }
+    memset(action, 0, sizeof(*action));
+
+    char text[RELAY_MSG_LEN];
+    if (len >= sizeof(text)) {
+        return true;
+    }
+    memcpy(text, msg, len);
+    text[len] = '\0';
+
+    char *end;
+    action->id.origin = strtoul(text + prefix, &end, 16);
+    if (*end != '.') {
+        return true;
+    }
+    action->id.seq = strtoul(end + 1, &end, 10);
+    unsigned hops = strtoul(end, &end, 10);
+    char *dest = end + 1;
+    char *command = *end == '\n' ? strchr(dest, '\n') : NULL;
+    if (command == NULL || hops == 0) {
+        return true;
+    }
+    *command++ = '\0';
+
+    if (!remember(relay, action->id)) {
+        return true;            /* a copy that took another path */
+    }
+    action->hops = hops;
+
+    if (strcmp(dest, relay->self) == 0) {
+        action->deliver = true;
+        strlcpy(action->command, command, sizeof(action->command));
+        return true;
+    }
+    if (hops >= RELAY_MAX_HOPS || !build(action, dest, command)) {
+        return true;
+    }
+    choose_next(table, dest, from, action);
+    if (action->next_count == 0) {
+        ESP_LOGD(TAG, "No way to %s from here", dest);
+    }
+    return true;
+}
@@ -0,0 +1,78 @@
+#ifndef _RELAY_H_
+#define _RELAY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "lwip/sockets.h"
+#include "peer-table.h"
+
+/* Commands for boards the sender cannot reach directly travel through
+ * the boards it can:
+ *
+ *   RLY <origin>.<seq> <hops>\n<destination instance>\n<command>
+ *
+ * origin is a random id of the board that sent the command first and seq
+ * its counter, together they let every board drop a copy it has already
+ * seen. hops counts the transmissions so far and stops at RELAY_MAX_HOPS.
+ * A board that has a good link to the destination sends it there
+ * directly, otherwise to the RELAY_FANOUT healthy peers with the best
+ * links, the destination among them when it is healthy but loses more
+ * than RELAY_DIRECT_LOSS_PCT.
+ * Every hop forwards at once, so a command arrives within RELAY_MAX_HOPS
+ * link latencies or not at all. */
+#define RELAY_PREFIX          "RLY "
+/* relay-sim builds with other limits */
+#ifndef RELAY_MAX_HOPS
+#define RELAY_MAX_HOPS        3
+#endif
+#define RELAY_FANOUT          2
+#define RELAY_SEEN_SIZE       64
+#define RELAY_MSG_LEN         128
+/* A link to the destination that loses more takes relays along */
+#define RELAY_DIRECT_LOSS_PCT 10
+/* Cost of a link whose RTT was not measured yet */
+#define RELAY_UNKNOWN_RTT_US  50000
+
+typedef struct {
+    uint32_t origin;
+    uint32_t seq;
+} relay_id_t;
+
+typedef struct {
+    char self[PEER_TABLE_NAME_LEN];
+    uint32_t origin;
+    uint32_t next_seq;
+    relay_id_t seen[RELAY_SEEN_SIZE];   /* ring of the last messages */
+    uint16_t seen_next;
+    uint16_t seen_count;
+} relay_t;
+
+/* What to do with a relay message: run the command here, send msg to
+ * the next hops, or both */
+typedef struct {
+    bool deliver;
+    char command[RELAY_MSG_LEN];
+    uint8_t hops;                       /* transmissions it took to get here */
+    relay_id_t id;
+    char msg[RELAY_MSG_LEN];
+    size_t len;
+    struct sockaddr_in next[RELAY_FANOUT];
+    size_t next_count;
+} relay_action_t;
+
+/* self is our own instance name, origin an id unique to this boot */
+void relay_init(relay_t *relay, const char *self, uint32_t origin);
+
+/* Route a new command to dest. False if it does not fit in a message or
+ * no peer can take it. */
+bool relay_originate(relay_t *relay, const peer_table_t *table, const char *dest, const char *command,
+                     relay_action_t *action);
+
+/* Handle a received datagram. False if it is not a relay message;
+ * duplicates and messages out of hops are consumed with nothing to do.
+ * The table is only read, the caller holds its lock. */
+bool relay_handle(relay_t *relay, const peer_table_t *table, const struct sockaddr_in *from, const char *msg,
+                  size_t len, relay_action_t *action);
+
+#endif
@@ -0,0 +1,52 @@
+#include "udp-fanout.h"
+
+#include <errno.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "udp_fanout";
+
+static int s_sock = -1;
+
+esp_err_t udp_fanout_send(const peer_t *peers, size_t count, const void *data, size_t len,
+                          udp_fanout_result_t *result)
+{
+    result->sent = 0;
+    result->failed = 0;
+    result->elapsed_us = 0;
+
+    if (s_sock < 0) {
+        s_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+        if (s_sock < 0) {
+            ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
+            return ESP_FAIL;
+        }
+    }
+
+    int64_t start = esp_timer_get_time();
+    for (size_t i = 0; i < count; i++) {
+        const struct sockaddr_in *dest = &peers[i].addr;
+        int attempt = 0;
+        bool sent = true;
+        while (sendto(s_sock, data, len, 0, (const struct sockaddr *)dest, sizeof(*dest)) < 0) {
+            /* lwIP answers ENOMEM when the burst used up its pbufs, give
+             * the driver a tick to drain the queue */
+            if ((errno != ENOMEM && errno != ENOBUFS && errno != EAGAIN) || attempt++ == UDP_FANOUT_RETRIES) {
+                ESP_LOGW(TAG, "Error occurred during sending: errno %d", errno);
+                sent = false;
+                break;
+            }
+            vTaskDelay(1);
+        }
+        if (sent) {
+            result->sent++;
+        } else {
+            result->failed++;
+        }
+    }
+    result->elapsed_us = esp_timer_get_time() - start;
+
+    return result->failed ? ESP_FAIL : ESP_OK;
+}
@@ -0,0 +1,25 @@
+#ifndef _UDP_FANOUT_H_
+#define _UDP_FANOUT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "peer-table.h"
+
+/* Retries of one datagram when the stack runs out of buffers mid-burst */
+#define UDP_FANOUT_RETRIES 3
+
+typedef struct {
+    size_t sent;
+    size_t failed;
+    int64_t elapsed_us;         /* first to last send */
+} udp_fanout_result_t;
+
+/* Send the same datagram to every peer in one pass over their prebuilt
+ * addresses, through a single unconnected socket. The pooled sockets of
+ * udp-pool.h are per destination and would thrash above UDP_POOL_SIZE
+ * peers. Not thread safe. */
+esp_err_t udp_fanout_send(const peer_t *peers, size_t count, const void *data, size_t len,
+                          udp_fanout_result_t *result);
+
+#endif
@@ -0,0 +1,150 @@
+#include "udp-pool.h"
+
+#include <string.h>
+#include <errno.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "udp_pool";
+
+typedef struct {
+    int sock;                   /* -1 when the slot is free */
+    uint32_t addr;              /* network order, as in sockaddr_in */
+    uint16_t port;
+    int64_t last_used_us;
+} udp_pool_slot_t;
+
+static udp_pool_slot_t s_slots[UDP_POOL_SIZE];
+/* Every call goes through it, the sends and the forgets come from
+ * different tasks */
+static SemaphoreHandle_t s_lock;
+
+esp_err_t udp_pool_init(void)
+{
+    if (s_lock) {
+        return ESP_OK;
+    }
+    for (size_t i = 0; i < UDP_POOL_SIZE; i++) {
+        s_slots[i].sock = -1;
+    }
+    s_lock = xSemaphoreCreateMutex();
+    return s_lock ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+static void slot_close(udp_pool_slot_t *slot)
+{
+    if (slot->sock >= 0) {
+        close(slot->sock);
+        slot->sock = -1;
+    }
+}
+
+static udp_pool_slot_t *slot_find(const struct sockaddr_in *dest)
+{
+    for (size_t i = 0; i < UDP_POOL_SIZE; i++) {
+        if (s_slots[i].sock >= 0 && s_slots[i].addr == dest->sin_addr.s_addr && s_slots[i].port == dest->sin_port) {
+            return &s_slots[i];
+        }
+    }
+    return NULL;
+}
+
+static udp_pool_slot_t *slot_open(const struct sockaddr_in *dest)
+{
+    /* A free slot, or else the one unused for the longest time */
+    udp_pool_slot_t *slot = &s_slots[0];
+    for (size_t i = 0; i < UDP_POOL_SIZE && slot->sock >= 0; i++) {
+        if (s_slots[i].sock < 0 || s_slots[i].last_used_us < slot->last_used_us) {
+            slot = &s_slots[i];
+        }
+    }
+    slot_close(slot);
+
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (sock < 0) {
+        ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
+        return NULL;
+    }
+    /* Connecting a UDP socket only sets its default destination, nothing
+     * goes on the wire, but lwIP no longer has to look up the route and
+     * the netif for every datagram */
+    if (connect(sock, (const struct sockaddr *)dest, sizeof(*dest)) < 0) {
+        ESP_LOGE(TAG, "Unable to connect socket: errno %d", errno);
+        close(sock);
+        return NULL;
+    }
+    slot->sock = sock;
+    slot->addr = dest->sin_addr.s_addr;
+    slot->port = dest->sin_port;
+    return slot;
+}
+
+esp_err_t udp_pool_send(const struct sockaddr_in *dest, const void *data, size_t len)
+{
+    if (s_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t err = ESP_FAIL;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    udp_pool_slot_t *slot = slot_find(dest);
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (slot == NULL && (slot = slot_open(dest)) == NULL) {
+            break;
+        }
+        slot->last_used_us = esp_timer_get_time();
+        if (send(slot->sock, data, len, 0) >= 0) {
+            err = ESP_OK;
+            break;
+        }
+        /* A connected socket reports the ICMP errors of earlier datagrams
+         * on the next send, start over with a fresh one */
+        ESP_LOGW(TAG, "Error occurred during sending: errno %d", errno);
+        slot_close(slot);
+        slot = NULL;
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+void udp_pool_evict_idle(int64_t max_idle_us)
+{
+    if (s_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+    for (size_t i = 0; i < UDP_POOL_SIZE; i++) {
+        if (s_slots[i].sock >= 0 && now - s_slots[i].last_used_us > max_idle_us) {
+            slot_close(&s_slots[i]);
+        }
+    }
+    xSemaphoreGive(s_lock);
+}
+
+void udp_pool_forget(const struct sockaddr_in *dest)
+{
+    if (s_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    udp_pool_slot_t *slot = slot_find(dest);
+    if (slot) {
+        slot_close(slot);
+    }
+    xSemaphoreGive(s_lock);
+}
+
+void udp_pool_close_all(void)
+{
+    if (s_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (size_t i = 0; i < UDP_POOL_SIZE; i++) {
+        slot_close(&s_slots[i]);
+    }
+    xSemaphoreGive(s_lock);
+}
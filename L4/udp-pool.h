@@ -0,0 +1,34 @@
+#ifndef _UDP_POOL_H_
+#define _UDP_POOL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "lwip/sockets.h"
+
+/* lwIP allows CONFIG_LWIP_MAX_SOCKETS (10 by default) at once, and P5
+ * also keeps the udp_task, peer-probe and udp-fanout sockets open: 6 here
+ * leaves one spare. Raise both together. */
+#define UDP_POOL_SIZE     6
+/* A destination nothing was sent to for this long gives its socket back */
+#define UDP_POOL_IDLE_US  (60 * 1000000LL)
+
+/* Sockets connected to one destination each, kept open between sends.
+ * The calls may come from any task, one mutex serializes them. */
+
+/* Call once before the tasks that use the pool start */
+esp_err_t udp_pool_init(void);
+
+/* Send one datagram to dest, opening a socket for it on first use. When
+ * the pool is full the least recently used socket is closed. */
+esp_err_t udp_pool_send(const struct sockaddr_in *dest, const void *data, size_t len);
+
+/* Close the sockets idle for longer than max_idle_us */
+void udp_pool_evict_idle(int64_t max_idle_us);
+
+/* Forget one destination, e.g. a peer that left the network */
+void udp_pool_forget(const struct sockaddr_in *dest);
+
+void udp_pool_close_all(void);
+
+#endif
@@ -0,0 +1,206 @@
+#include "captive-portal.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_wifi.h"
+#include "esp_netif.h"
+#include "esp_event.h"
+
+#include "lwip/sockets.h"
+
+static const char *TAG = "captive_portal";
+
+#define DNS_HEADER_SIZE     12
+#define DNS_FLAG_QR         0x80        /* in the third byte */
+#define DNS_FLAG_AA         0x04
+#define DNS_FLAG_RD         0x01
+#define DNS_OPCODE_MASK     0x78
+#define DNS_RCODE_NOTIMP    4
+#define DNS_TYPE_A          1
+#define DNS_TYPE_ANY        255
+#define DNS_CLASS_IN        1
+/* pointer to the name of the question, right after the header */
+#define DNS_NAME_POINTER    0xc00c
+
+static TaskHandle_t s_task;
+static volatile bool s_running;
+
+static uint16_t get16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static uint8_t *put16(uint8_t *p, uint16_t value)
+{
+    p[0] = value >> 8;
+    p[1] = value & 0xff;
+    return p + 2;
+}
+
+static void set_counts(uint8_t *packet, uint16_t questions, uint16_t answers)
+{
+    uint8_t *p = put16(packet + 4, questions);
+    p = put16(p, answers);
+    p = put16(p, 0);
+    put16(p, 0);
+}
+
+size_t captive_dns_answer(uint8_t *packet, size_t len, size_t size, uint32_t ip)
+{
+    if (len < DNS_HEADER_SIZE || (packet[2] & DNS_FLAG_QR)) {
+        return 0;
+    }
+
+    // Same id, opcode and RD, answered with authority and no recursion
+    packet[2] = DNS_FLAG_QR | DNS_FLAG_AA | (packet[2] & (DNS_OPCODE_MASK | DNS_FLAG_RD));
+    packet[3] = 0;
+    if ((packet[2] & DNS_OPCODE_MASK) != 0 || get16(packet + 4) != 1) {
+        packet[3] = DNS_RCODE_NOTIMP;
+        set_counts(packet, 0, 0);
+        return DNS_HEADER_SIZE;
+    }
+
+    // The name of the question, labels only, a query has no pointers
+    size_t pos = DNS_HEADER_SIZE;
+    while (pos < len && packet[pos] != 0) {
+        if (packet[pos] & 0xc0) {
+            return 0;
+        }
+        pos += packet[pos] + 1;
+    }
+    if (pos + 5 > len) {
+        return 0;
+    }
+    uint16_t type = get16(packet + pos + 1);
+    uint16_t class = get16(packet + pos + 3);
+    // What follows the question (an EDNS record) is left out
+    pos += 5;
+
+    bool answer = (type == DNS_TYPE_A || type == DNS_TYPE_ANY) && class == DNS_CLASS_IN;
+    if (answer && pos + 16 > size) {
+        return 0;
+    }
+    set_counts(packet, 1, answer ? 1 : 0);
+    if (!answer) {
+        return pos;
+    }
+
+    uint8_t *p = put16(packet + pos, DNS_NAME_POINTER);
+    p = put16(p, DNS_TYPE_A);
+    p = put16(p, DNS_CLASS_IN);
+    p = put16(p, CAPTIVE_DNS_TTL_S >> 16);
+    p = put16(p, CAPTIVE_DNS_TTL_S & 0xffff);
+    p = put16(p, 4);
+    memcpy(p, &ip, 4);
+    return pos + 16;
+}
+
+static bool ap_ip(esp_netif_ip_info_t *info)
+{
+    esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_AP_DEF");
+    return netif != NULL && esp_netif_get_ip_info(netif, info) == ESP_OK;
+}
+
+static void dns_task(void *pvParameters)
+{
+    esp_netif_ip_info_t info;
+    int sock = -1;
+
+    if (!ap_ip(&info)) {
+        ESP_LOGE(TAG, "No AP address");
+        goto done;
+    }
+
+    sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (sock < 0) {
+        ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
+        goto done;
+    }
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(CAPTIVE_DNS_PORT),
+        .sin_addr.s_addr = info.ip.addr,
+    };
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        ESP_LOGE(TAG, "Unable to bind port %d: errno %d", CAPTIVE_DNS_PORT, errno);
+        goto done;
+    }
+    // Wakes up now and then to see if the AP is still there
+    struct timeval timeout = {.tv_sec = 1};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    ESP_LOGI(TAG, "DNS on " IPSTR ":%d", IP2STR(&info.ip), CAPTIVE_DNS_PORT);
+
+    uint8_t packet[CAPTIVE_DNS_PACKET_MAX];
+    while (s_running) {
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        int len = recvfrom(sock, packet, sizeof(packet), 0, (struct sockaddr *)&from, &from_len);
+        if (len < 0) {
+            continue;
+        }
+        size_t answer = captive_dns_answer(packet, len, sizeof(packet), info.ip.addr);
+        if (answer > 0) {
+            sendto(sock, packet, answer, 0, (struct sockaddr *)&from, from_len);
+        }
+    }
+
+done:
+    if (sock >= 0) {
+        close(sock);
+    }
+    ESP_LOGI(TAG, "DNS stopped");
+    s_task = NULL;
+    vTaskDelete(NULL);
+}
+
+static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    if (event_id == WIFI_EVENT_AP_START) {
+        s_running = true;
+        // A task still draining its last timeout carries on
+        if (s_task == NULL &&
+            xTaskCreate(dns_task, "captive_dns", CAPTIVE_DNS_STACK_SIZE, NULL, 5, &s_task) != pdPASS) {
+            ESP_LOGE(TAG, "Unable to start the DNS task");
+        }
+    } else if (event_id == WIFI_EVENT_AP_STOP) {
+        s_running = false;
+    }
+}
+
+esp_err_t captive_portal_init(void)
+{
+    esp_err_t err = esp_event_handler_instance_register(WIFI_EVENT, WIFI_EVENT_AP_START, &wifi_event_handler,
+                                                        NULL, NULL);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return esp_event_handler_instance_register(WIFI_EVENT, WIFI_EVENT_AP_STOP, &wifi_event_handler, NULL, NULL);
+}
+
+static esp_err_t not_found_handler(httpd_req_t *req, httpd_err_code_t error)
+{
+    wifi_mode_t mode;
+    esp_netif_ip_info_t info;
+    if (esp_wifi_get_mode(&mode) != ESP_OK || (mode != WIFI_MODE_AP && mode != WIFI_MODE_APSTA) ||
+        !ap_ip(&info)) {
+        return httpd_resp_send_err(req, error, NULL);
+    }
+
+    // By address, the Host of the probe names a server we are not
+    char location[40];
+    snprintf(location, sizeof(location), "http://" IPSTR CAPTIVE_PORTAL_PAGE, IP2STR(&info.ip));
+    ESP_LOGD(TAG, "%s -> %s", req->uri, location);
+    httpd_resp_set_status(req, "302 Found");
+    httpd_resp_set_hdr(req, "Location", location);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_sendstr(req, "Redirect to the provisioning page");
+}
+
+esp_err_t captive_portal_register(httpd_handle_t server)
+{
+    return httpd_register_err_handler(server, HTTPD_404_NOT_FOUND, not_found_handler);
+}
@@ -3,5 +3,7 @@
 
 #define CONFIG_EXAMPLE_SCAN_LIST_SIZE 10
 #define CONFIG_ESP_MAXIMUM_RETRY 5
+/* Start the web server before the WiFi link is up */
+#define CONFIG_FAST_BOOT 0
 
 #endif
\ No newline at end of file
@@ -9,34 +9,29 @@
 #include "nvs_flash.h"
 #include "config.h"
 #include "index_html.h"
+#include "wifi-scanner.h"
 #include "sta-ap.h"
+#include "http-workers.h"
+#include "captive-portal.h"
 
 #include "lwip/err.h"
 #include "lwip/sys.h"
 #include "freertos/event_groups.h"
 
 #include "esp_http_server.h"
-
-char ssid_list[CONFIG_EXAMPLE_SCAN_LIST_SIZE][33];
-size_t size_ssid = 0;
-
-char* get_ssid_list() {
-    return (char*) ssid_list;
-}
-
-void set_size_ssid(size_t size) {
-    size_ssid = size;
-}
+#include "../common/boot-prof.h"
 
 /* Our URI handler function to be called during GET /uri request */
 esp_err_t get_handler(httpd_req_t *req)
 {
-    /* Send a simple response */
+    boot_prof_mark(BOOT_PHASE_FIRST_PACKET);
 
-    char buffer[2048];
-    set_index_html_content(buffer, get_ssid_list(), size_ssid);
-    httpd_resp_send(req, buffer, HTTPD_RESP_USE_STRLEN);
-    return ESP_OK;
+    /* The last scan result, the radio is never waited for */
+    wifi_scanner_snapshot_t scan;
+    wifi_scanner_get(&scan);
+
+    /* Send the page in chunks while it is rendered */
+    return send_index_html(req, (const char *)scan.ssids, scan.count);
 }
 
 /* Our URI handler function to be called during POST /uri request */
@@ -80,20 +75,37 @@ esp_err_t post_handler(httpd_req_t *req)
     return ESP_OK;
 }
 
-/* URI handler structure for GET /uri */
-httpd_uri_t uri_get = {
-    .uri      = "/index.html",
-    .method   = HTTP_GET,
-    .handler  = get_handler,
-    .user_ctx = NULL
+/* Route for GET /uri, the page can take long to reach a slow client */
+http_route_t route_get = {
+    .uri = {
+        .uri      = "/index.html",
+        .method   = HTTP_GET,
+        .handler  = get_handler,
+        .user_ctx = NULL
+    },
+    .async = true
+};
+
+/* Route for POST /uri, waits on the client for the body */
+http_route_t route_post = {
+    .uri = {
+        .uri      = "/results.html",
+        .method   = HTTP_POST,
+        .handler  = post_handler,
+        .user_ctx = NULL
+    },
+    .async = true
 };
 
-/* URI handler structure for POST /uri */
-httpd_uri_t uri_post = {
-    .uri      = "/results.html",
-    .method   = HTTP_POST,
-    .handler  = post_handler,
-    .user_ctx = NULL
+/* Route for GET /api/stats */
+http_route_t route_stats = {
+    .uri = {
+        .uri      = "/api/stats",
+        .method   = HTTP_GET,
+        .handler  = http_workers_stats_handler,
+        .user_ctx = NULL
+    },
+    .async = false
 };
 
 /* Function for starting the webserver */
@@ -101,15 +113,24 @@ httpd_handle_t start_webserver(void)
 {
     /* Generate default configuration */
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    http_workers_config(&config);
 
     /* Empty handle to esp_http_server */
     httpd_handle_t server = NULL;
 
+    /* The slow handlers run on the workers */
+    if (http_workers_start() != ESP_OK) {
+        return NULL;
+    }
+
     /* Start the httpd server */
     if (httpd_start(&server, &config) == ESP_OK) {
         /* Register URI handlers */
-        httpd_register_uri_handler(server, &uri_get);
-        httpd_register_uri_handler(server, &uri_post);
+        http_workers_register(server, &route_get);
+        http_workers_register(server, &route_post);
+        http_workers_register(server, &route_stats);
+        /* Anything else leads to the page while the AP runs */
+        captive_portal_register(server);
     }
     /* If server failed to start, handle will be NULL */
     return server;
@@ -1,6 +1,10 @@
 #ifndef _INDEX_HTML_H_
 #define _INDEX_HTML_H_
 
-void set_index_html_content(char buffer[], const char* ssid_list, int ssid_count);
+#include "esp_http_server.h"
+
+/* Sends the page with one <option> per SSID as a chunked response.
+ * ssid_list holds ssid_count entries of 33 bytes. */
+esp_err_t send_index_html(httpd_req_t *req, const char* ssid_list, int ssid_count);
 
 #endif
\ No newline at end of file
@@ -12,6 +12,8 @@
 #include "freertos/event_groups.h"
 
 #include "soft-ap.h"
+#include "captive-portal.h"
+#include "../common/boot-prof.h"
 
 #define WIFI_SOFT_AP_STARTED_BIT BIT0
 
@@ -32,6 +34,8 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                  MAC2STR(event->mac), event->aid);
     } else if (event_id == WIFI_EVENT_AP_START) {
         ESP_LOGI(TAG, "Event: SoftAP started");
+        /* The AP link is up, there is no address to wait for */
+        boot_prof_mark(BOOT_PHASE_WIFI_CONNECTED);
         xEventGroupSetBits(s_wifi_event_group, WIFI_SOFT_AP_STARTED_BIT);
     }
 }
@@ -43,6 +47,10 @@ void wifi_init_softap(void)
     ESP_ERROR_CHECK(esp_netif_init());
     
     esp_netif_create_default_wifi_ap();
+    /* The scanner runs on the station interface next to the AP */
+    if (esp_netif_get_handle_from_ifkey("WIFI_STA_DEF") == NULL) {
+        esp_netif_create_default_wifi_sta();
+    }
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
@@ -53,6 +61,9 @@ void wifi_init_softap(void)
                                                         NULL,
                                                         NULL));
 
+    /* Answers DNS and redirects the probes of the clients to the page */
+    ESP_ERROR_CHECK(captive_portal_init());
+
     wifi_config_t wifi_config = {
         .ap = {
             .ssid = EXAMPLE_ESP_WIFI_SSID,
@@ -67,9 +78,10 @@ void wifi_init_softap(void)
         wifi_config.ap.authmode = WIFI_AUTH_OPEN;
     }
 
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_AP));
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_APSTA));
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_AP, &wifi_config));
     ESP_ERROR_CHECK(esp_wifi_start());
+    boot_prof_mark(BOOT_PHASE_WIFI_STARTED);
     esp_wifi_set_ps(WIFI_PS_NONE);
 
     ESP_LOGI(TAG, "wifi_init_softap finished. SSID:%s password:%s channel:%d",
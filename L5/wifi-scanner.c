@@ -0,0 +1,266 @@
+#include "wifi-scanner.h"
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "esp_wifi.h"
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#define SCANNER_READY_BIT BIT0      /* the station interface runs and is not connecting */
+#define SCANNER_DONE_BIT  BIT1
+#define SCANNER_RUN_BIT   BIT2      /* not paused by wifi_scanner_pause() */
+
+ESP_EVENT_DEFINE_BASE(WIFI_SCANNER_EVENT);
+
+static const char *TAG = "wifi_scanner";
+
+typedef struct {
+    char ssid[33];
+    int8_t rssi;
+    uint8_t channel;
+    uint32_t seen_sweep;
+} scan_entry_t;
+
+/* Used by the scan task only */
+static scan_entry_t s_table[WIFI_SCANNER_TABLE_SIZE];
+static size_t s_table_count;
+static uint32_t s_sweep;
+static wifi_ap_record_t s_records[WIFI_SCANNER_RECORDS_MAX];
+
+static wifi_scanner_snapshot_t s_snapshot;
+static SemaphoreHandle_t s_lock;
+static EventGroupHandle_t s_events;
+
+static void scanner_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    wifi_mode_t mode = WIFI_MODE_NULL;
+    if (event_id == WIFI_EVENT_STA_START) {
+        // In STA mode the station connects first, a scan now would delay the association
+        if (esp_wifi_get_mode(&mode) == ESP_OK && mode == WIFI_MODE_APSTA) {
+            xEventGroupSetBits(s_events, SCANNER_READY_BIT);
+        }
+    } else if (event_id == WIFI_EVENT_STA_CONNECTED) {
+        xEventGroupSetBits(s_events, SCANNER_READY_BIT);
+    } else if (event_id == WIFI_EVENT_STA_DISCONNECTED) {
+        if (esp_wifi_get_mode(&mode) == ESP_OK && mode == WIFI_MODE_STA) {
+            xEventGroupClearBits(s_events, SCANNER_READY_BIT);
+        }
+    } else if (event_id == WIFI_EVENT_STA_STOP) {
+        xEventGroupClearBits(s_events, SCANNER_READY_BIT);
+    } else if (event_id == WIFI_EVENT_SCAN_DONE) {
+        xEventGroupSetBits(s_events, SCANNER_DONE_BIT);
+    }
+}
+
+static scan_entry_t *table_find(const char *ssid)
+{
+    for (size_t i = 0; i < s_table_count; i++) {
+        if (strcmp(s_table[i].ssid, ssid) == 0) {
+            return &s_table[i];
+        }
+    }
+    return NULL;
+}
+
+static void table_merge(const wifi_ap_record_t *ap)
+{
+    const char *ssid = (const char *)ap->ssid;
+    if (ssid[0] == '\0' || ap->rssi < WIFI_SCANNER_MIN_RSSI) {
+        return;
+    }
+
+    scan_entry_t *entry = table_find(ssid);
+    if (entry == NULL) {
+        if (s_table_count < WIFI_SCANNER_TABLE_SIZE) {
+            entry = &s_table[s_table_count++];
+        } else {
+            // full, a stronger network takes the place of the weakest
+            entry = &s_table[0];
+            for (size_t i = 1; i < s_table_count; i++) {
+                if (s_table[i].rssi < entry->rssi) {
+                    entry = &s_table[i];
+                }
+            }
+            if (entry->rssi >= ap->rssi) {
+                return;
+            }
+        }
+        strlcpy(entry->ssid, ssid, sizeof(entry->ssid));
+    } else if (ap->rssi <= entry->rssi && ap->primary != entry->channel) {
+        // a weaker AP of the same network, the entry stays on the strongest one
+        return;
+    }
+    entry->rssi = ap->rssi;
+    entry->channel = ap->primary;
+    entry->seen_sweep = s_sweep;
+}
+
+static void table_expire(void)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < s_table_count; i++) {
+        if (s_sweep - s_table[i].seen_sweep < WIFI_SCANNER_EXPIRE_SWEEPS) {
+            s_table[kept++] = s_table[i];
+        }
+    }
+    s_table_count = kept;
+}
+
+static void publish(void)
+{
+    // indexes of the strongest entries, by insertion
+    size_t order[WIFI_SCANNER_MAX_APS];
+    size_t count = 0;
+    for (size_t i = 0; i < s_table_count; i++) {
+        size_t pos = count;
+        while (pos > 0 && s_table[order[pos - 1]].rssi < s_table[i].rssi) {
+            if (pos < WIFI_SCANNER_MAX_APS) {
+                order[pos] = order[pos - 1];
+            }
+            pos--;
+        }
+        if (pos < WIFI_SCANNER_MAX_APS) {
+            order[pos] = i;
+            if (count < WIFI_SCANNER_MAX_APS) {
+                count++;
+            }
+        }
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool changed = count != s_snapshot.count;
+    for (size_t i = 0; i < count; i++) {
+        const scan_entry_t *entry = &s_table[order[i]];
+        if (!changed && strcmp(s_snapshot.ssids[i], entry->ssid) != 0) {
+            changed = true;
+        }
+        strlcpy(s_snapshot.ssids[i], entry->ssid, sizeof(s_snapshot.ssids[i]));
+        s_snapshot.rssi[i] = entry->rssi;
+        s_snapshot.channel[i] = entry->channel;
+    }
+    s_snapshot.count = count;
+    s_snapshot.updated_us = esp_timer_get_time();
+    // RSSI moves all the time, only a new list counts as a new version
+    if (changed) {
+        s_snapshot.version++;
+    }
+    xSemaphoreGive(s_lock);
+
+    if (changed) {
+        ESP_LOGI(TAG, "%u networks, version %lu", (unsigned)count, (unsigned long)s_snapshot.version);
+        uint32_t version = s_snapshot.version;
+        esp_event_post(WIFI_SCANNER_EVENT, WIFI_SCANNER_EVENT_UPDATED, &version, sizeof(version), 0);
+    }
+}
+
+static esp_err_t scan_channel(uint8_t channel)
+{
+    wifi_scan_config_t config = {
+        .channel = channel,
+        .show_hidden = false,
+        .scan_type = WIFI_SCAN_TYPE_ACTIVE,
+        .scan_time.active = {
+            .min = 0,
+            .max = WIFI_SCANNER_DWELL_MS,
+        },
+    };
+    xEventGroupClearBits(s_events, SCANNER_DONE_BIT);
+    esp_err_t err = esp_wifi_scan_start(&config, false);
+    if (err != ESP_OK) {
+        // e.g. while the station connects, the next step tries again
+        return err;
+    }
+    EventBits_t bits = xEventGroupWaitBits(s_events, SCANNER_DONE_BIT, pdTRUE, pdTRUE,
+                                           pdMS_TO_TICKS(WIFI_SCANNER_DWELL_MS * 10));
+    if (!(bits & SCANNER_DONE_BIT)) {
+        esp_wifi_scan_stop();
+        return ESP_ERR_TIMEOUT;
+    }
+
+    uint16_t number = WIFI_SCANNER_RECORDS_MAX;
+    err = esp_wifi_scan_get_ap_records(&number, s_records);
+    if (err != ESP_OK) {
+        return err;
+    }
+    for (uint16_t i = 0; i < number; i++) {
+        table_merge(&s_records[i]);
+    }
+    return ESP_OK;
+}
+
+static void scanner_task(void *pvParameters)
+{
+    uint8_t channel = 1;
+
+    while (1) {
+        xEventGroupWaitBits(s_events, SCANNER_READY_BIT | SCANNER_RUN_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
+
+        esp_err_t err = scan_channel(channel);
+        if (err == ESP_OK) {
+            publish();
+        } else {
+            ESP_LOGD(TAG, "Scan of channel %u failed: %s", channel, esp_err_to_name(err));
+        }
+
+        if (++channel > WIFI_SCANNER_CHANNELS) {
+            channel = 1;
+            s_sweep++;
+            table_expire();
+            publish();
+        }
+        // The first pass runs through so the page has networks right after boot
+        if (s_sweep > 0) {
+            vTaskDelay(pdMS_TO_TICKS(WIFI_SCANNER_STEP_MS));
+        }
+    }
+}
+
+esp_err_t wifi_scanner_start(void)
+{
+    s_lock = xSemaphoreCreateMutex();
+    s_events = xEventGroupCreate();
+    if (s_lock == NULL || s_events == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    xEventGroupSetBits(s_events, SCANNER_RUN_BIT);
+
+    esp_err_t err = esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &scanner_event_handler,
+                                                        NULL, NULL);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (xTaskCreate(scanner_task, "wifi_scanner", 3072, NULL, 4, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void wifi_scanner_get(wifi_scanner_snapshot_t *snapshot)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *snapshot = s_snapshot;
+    xSemaphoreGive(s_lock);
+}
+
+uint32_t wifi_scanner_version(void)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t version = s_snapshot.version;
+    xSemaphoreGive(s_lock);
+    return version;
+}
+
+void wifi_scanner_pause(bool pause)
+{
+    if (pause) {
+        xEventGroupClearBits(s_events, SCANNER_RUN_BIT);
+        // a channel being scanned is left at once
+        esp_wifi_scan_stop();
+    } else {
+        xEventGroupSetBits(s_events, SCANNER_RUN_BIT);
+    }
+}
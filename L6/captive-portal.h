@@ -0,0 +1,38 @@
+#ifndef _CAPTIVE_PORTAL_H_
+#define _CAPTIVE_PORTAL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+/* While the soft AP runs, a DNS server on its address answers every
+ * A query with that address, the DHCP server of the AP already hands it
+ * out as the resolver. The probes of the phones and laptops that join
+ * (connectivitycheck.gstatic.com/generate_204, captive.apple.com,
+ * www.msftconnecttest.com/connecttest.txt, ...) then reach our server,
+ * which redirects every URI it does not know to the page, and the OS
+ * opens it on its own. */
+#define CAPTIVE_DNS_PORT            53
+/* Short, the answers are wrong as soon as the client leaves the AP */
+#define CAPTIVE_DNS_TTL_S           10
+/* Queries over UDP without EDNS fit in 512 bytes */
+#define CAPTIVE_DNS_PACKET_MAX      512
+#define CAPTIVE_DNS_STACK_SIZE      3072
+#define CAPTIVE_PORTAL_PAGE         "/index.html"
+
+/* Starts the DNS server with each WIFI_EVENT_AP_START and stops it with
+ * WIFI_EVENT_AP_STOP, call after esp_wifi_init() */
+esp_err_t captive_portal_init(void);
+
+/* Redirects the requests no handler takes to the page while the AP runs,
+ * they get the usual 404 otherwise */
+esp_err_t captive_portal_register(httpd_handle_t server);
+
+/* Turns the query of len bytes in packet into its answer in place and
+ * returns the length of the answer, 0 if nothing should be sent. An A
+ * query for any name gets ip (network byte order), other types get an
+ * empty answer so the client falls back to A. */
+size_t captive_dns_answer(uint8_t *packet, size_t len, size_t size, uint32_t ip);
+
+#endif
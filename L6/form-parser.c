@@ -0,0 +1,355 @@
+#include "form-parser.h"
+
+#include <string.h>
+
+enum {
+    /* urlencoded */
+    URL_TEXT,
+    URL_PERCENT,
+    /* JSON */
+    JSON_START,
+    JSON_KEY_OR_END,
+    JSON_KEY,
+    JSON_STRING,
+    JSON_ESCAPE,
+    JSON_UNICODE,
+    JSON_COLON,
+    JSON_VALUE,
+    JSON_LITERAL,
+    JSON_COMMA_OR_END,
+    JSON_DONE,
+};
+
+void form_parser_init(form_parser_t *parser, form_format_t format, form_field_t *fields, size_t field_count)
+{
+    memset(parser, 0, sizeof(*parser));
+    parser->format = format;
+    parser->fields = fields;
+    parser->field_count = field_count;
+    for (size_t i = 0; i < field_count; i++) {
+        fields[i].len = 0;
+        fields[i].found = false;
+        fields[i].truncated = false;
+        fields[i].value[0] = '\0';
+    }
+    if (format == FORM_URLENCODED) {
+        parser->state = URL_TEXT;
+        parser->in_key = true;
+    } else {
+        parser->state = JSON_START;
+    }
+}
+
+static void key_start(form_parser_t *parser)
+{
+    parser->in_key = true;
+    parser->key_len = 0;
+    parser->key_overflow = false;
+    parser->current = NULL;
+}
+
+static void key_end(form_parser_t *parser)
+{
+    parser->in_key = false;
+    parser->key[parser->key_len] = '\0';
+    parser->current = NULL;
+    if (parser->key_overflow) {
+        return;
+    }
+    for (size_t i = 0; i < parser->field_count; i++) {
+        form_field_t *field = &parser->fields[i];
+        if (strcmp(field->name, parser->key) == 0) {
+            field->found = true;
+            field->len = 0;
+            field->truncated = false;
+            field->value[0] = '\0';
+            parser->current = field;
+            return;
+        }
+    }
+}
+
+static void put_char(form_parser_t *parser, char c)
+{
+    if (parser->in_key) {
+        if (parser->key_len + 1 < sizeof(parser->key)) {
+            parser->key[parser->key_len++] = c;
+        } else {
+            parser->key_overflow = true;
+        }
+        return;
+    }
+    form_field_t *field = parser->current;
+    if (field == NULL) {
+        return;
+    }
+    if (field->len + 1 < field->size) {
+        field->value[field->len++] = c;
+        field->value[field->len] = '\0';
+    } else {
+        field->truncated = true;
+    }
+}
+
+static void put_utf8(form_parser_t *parser, uint32_t code)
+{
+    if (code < 0x80) {
+        put_char(parser, code);
+    } else if (code < 0x800) {
+        put_char(parser, 0xc0 | (code >> 6));
+        put_char(parser, 0x80 | (code & 0x3f));
+    } else if (code < 0x10000) {
+        put_char(parser, 0xe0 | (code >> 12));
+        put_char(parser, 0x80 | ((code >> 6) & 0x3f));
+        put_char(parser, 0x80 | (code & 0x3f));
+    } else {
+        put_char(parser, 0xf0 | (code >> 18));
+        put_char(parser, 0x80 | ((code >> 12) & 0x3f));
+        put_char(parser, 0x80 | ((code >> 6) & 0x3f));
+        put_char(parser, 0x80 | (code & 0x3f));
+    }
+}
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+static bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool url_char(form_parser_t *parser, char c)
+{
+    if (parser->state == URL_PERCENT) {
+        int value = hex_value(c);
+        if (value < 0) {
+            return false;
+        }
+        parser->code = parser->code * 16 + value;
+        if (++parser->hex_digits == 2) {
+            // a NUL would end the value early
+            if (parser->code == 0) {
+                return false;
+            }
+            put_char(parser, parser->code);
+            parser->state = URL_TEXT;
+        }
+        return true;
+    }
+
+    switch (c) {
+    case '%':
+        parser->state = URL_PERCENT;
+        parser->hex_digits = 0;
+        parser->code = 0;
+        break;
+    case '+':
+        put_char(parser, ' ');
+        break;
+    case '&':
+        if (parser->in_key) {
+            key_end(parser);
+        }
+        key_start(parser);
+        break;
+    case '=':
+        if (parser->in_key) {
+            key_end(parser);
+            break;
+        }
+        put_char(parser, c);
+        break;
+    default:
+        put_char(parser, c);
+        break;
+    }
+    return true;
+}
+
+/* The 4 digits of \uXXXX are in, UTF-16 surrogates come in pairs */
+static bool json_unicode(form_parser_t *parser)
+{
+    uint32_t code = parser->code;
+    if (parser->high_surrogate) {
+        if (code < 0xdc00 || code > 0xdfff) {
+            return false;
+        }
+        code = 0x10000 + ((parser->high_surrogate - 0xd800) << 10) + (code - 0xdc00);
+        parser->high_surrogate = 0;
+    } else if (code >= 0xd800 && code <= 0xdbff) {
+        parser->high_surrogate = code;
+        return true;
+    } else if ((code >= 0xdc00 && code <= 0xdfff) || code == 0) {
+        return false;
+    }
+    put_utf8(parser, code);
+    return true;
+}
+
+static bool json_char(form_parser_t *parser, char c)
+{
+    bool again;
+    do {
+        again = false;
+        switch (parser->state) {
+        case JSON_START:
+            if (c == '{') {
+                parser->state = JSON_KEY_OR_END;
+            } else if (!is_space(c)) {
+                return false;
+            }
+            break;
+        case JSON_KEY_OR_END:
+        case JSON_KEY:
+            if (c == '"') {
+                key_start(parser);
+                parser->state = JSON_STRING;
+            } else if (c == '}' && parser->state == JSON_KEY_OR_END) {
+                parser->state = JSON_DONE;
+            } else if (!is_space(c)) {
+                return false;
+            }
+            break;
+        case JSON_STRING:
+            if (parser->high_surrogate && c != '\\') {
+                return false;
+            }
+            if (c == '"') {
+                if (parser->in_key) {
+                    key_end(parser);
+                    parser->state = JSON_COLON;
+                } else {
+                    parser->current = NULL;
+                    parser->state = JSON_COMMA_OR_END;
+                }
+            } else if (c == '\\') {
+                parser->state = JSON_ESCAPE;
+            } else if ((unsigned char)c < 0x20) {
+                return false;
+            } else {
+                put_char(parser, c);
+            }
+            break;
+        case JSON_ESCAPE:
+            if (parser->high_surrogate && c != 'u') {
+                return false;
+            }
+            parser->state = JSON_STRING;
+            switch (c) {
+            case '"':
+            case '\\':
+            case '/':
+                put_char(parser, c);
+                break;
+            case 'b': put_char(parser, '\b'); break;
+            case 'f': put_char(parser, '\f'); break;
+            case 'n': put_char(parser, '\n'); break;
+            case 'r': put_char(parser, '\r'); break;
+            case 't': put_char(parser, '\t'); break;
+            case 'u':
+                parser->state = JSON_UNICODE;
+                parser->hex_digits = 0;
+                parser->code = 0;
+                break;
+            default:
+                return false;
+            }
+            break;
+        case JSON_UNICODE: {
+            int value = hex_value(c);
+            if (value < 0) {
+                return false;
+            }
+            parser->code = parser->code * 16 + value;
+            if (++parser->hex_digits == 4) {
+                parser->state = JSON_STRING;
+                return json_unicode(parser);
+            }
+            break;
+        }
+        case JSON_COLON:
+            if (c == ':') {
+                parser->state = JSON_VALUE;
+            } else if (!is_space(c)) {
+                return false;
+            }
+            break;
+        case JSON_VALUE:
+            if (c == '"') {
+                parser->state = JSON_STRING;
+            } else if (is_space(c)) {
+                break;
+            } else if (parser->current == NULL && (c == '-' || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z'))) {
+                // a number, true, false or null nobody asked for
+                parser->state = JSON_LITERAL;
+            } else {
+                return false;
+            }
+            break;
+        case JSON_LITERAL:
+            if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '.' ||
+                  c == '+' || c == '-')) {
+                parser->state = JSON_COMMA_OR_END;
+                again = true;
+            }
+            break;
+        case JSON_COMMA_OR_END:
+            if (c == ',') {
+                parser->state = JSON_KEY;
+            } else if (c == '}') {
+                parser->state = JSON_DONE;
+            } else if (!is_space(c)) {
+                return false;
+            }
+            break;
+        case JSON_DONE:
+            if (!is_space(c)) {
+                return false;
+            }
+            break;
+        default:
+            return false;
+        }
+    } while (again);
+    return true;
+}
+
+bool form_parser_feed(form_parser_t *parser, const char *data, size_t len)
+{
+    for (size_t i = 0; i < len && !parser->error; i++) {
+        bool ok = parser->format == FORM_URLENCODED ? url_char(parser, data[i]) : json_char(parser, data[i]);
+        if (!ok) {
+            parser->error = true;
+        }
+    }
+    return !parser->error;
+}
+
+bool form_parser_finish(form_parser_t *parser)
+{
+    if (parser->error) {
+        return false;
+    }
+    if (parser->format == FORM_JSON) {
+        return parser->state == JSON_DONE;
+    }
+    if (parser->state == URL_PERCENT) {
+        return false;
+    }
+    // a last key without '='
+    if (parser->in_key && parser->key_len > 0) {
+        key_end(parser);
+    }
+    return true;
+}
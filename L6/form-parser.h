@@ -0,0 +1,59 @@
+#ifndef _FORM_PARSER_H_
+#define _FORM_PARSER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Reads the fields of a request body as it arrives, in pieces of any
+ * size, without allocating and with a bounded amount of work per byte:
+ *
+ *   ssid=My+Net%21&ipass=secret                  urlencoded
+ *   {"ssid": "My Net!", "password": "secret"}    JSON
+ *
+ * Only the keys of the caller's field table are kept, decoded into their
+ * buffers; others are skipped. JSON must be one flat object, values that
+ * are not strings are only accepted for keys nobody asked for. A value
+ * longer than its buffer is cut and marked truncated. When a key appears
+ * twice the last one wins. */
+#define FORM_PARSER_KEY_MAX 16
+
+typedef enum {
+    FORM_URLENCODED,
+    FORM_JSON,
+} form_format_t;
+
+typedef struct {
+    const char *name;
+    char *value;                /* always terminated */
+    size_t size;                /* of value, with the terminator */
+    size_t len;
+    bool found;
+    bool truncated;
+} form_field_t;
+
+typedef struct {
+    form_format_t format;
+    form_field_t *fields;
+    size_t field_count;
+    form_field_t *current;      /* field of the value being read, NULL to skip it */
+    uint8_t state;
+    bool in_key;
+    char key[FORM_PARSER_KEY_MAX];
+    size_t key_len;
+    bool key_overflow;
+    uint8_t hex_digits;
+    uint32_t code;              /* %XX or \uXXXX being read */
+    uint32_t high_surrogate;
+    bool error;
+} form_parser_t;
+
+void form_parser_init(form_parser_t *parser, form_format_t format, form_field_t *fields, size_t field_count);
+
+/* False once the body is malformed, the rest can be dropped */
+bool form_parser_feed(form_parser_t *parser, const char *data, size_t len);
+
+/* False if the body ended in the middle of something */
+bool form_parser_finish(form_parser_t *parser);
+
+#endif
@@ -0,0 +1,170 @@
+/* Parsing cost of a credentials body, urlencoded and JSON.
+
+   First a set of bodies is parsed at once and again one byte at a time,
+   which must give the same fields, including the malformed ones. Then
+   each format is timed per body and per byte for pieces of 1, 16 and 64
+   bytes (the handler takes 64 at a time), next to the strtok() and
+   sscanf() code post_handler had before, which needs the whole body in
+   one buffer and does not decode anything.
+
+   Build: gcc -O2 -I.. form-parser-bench.c ../form-parser.c -o form-parser-bench
+   Run:   ./form-parser-bench [rounds]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "form-parser.h"
+
+typedef struct {
+    form_format_t format;
+    const char *body;
+    bool ok;                    /* expected from form_parser_finish() */
+    const char *ssid;           /* expected values, NULL if not found */
+    const char *password;
+} parse_case_t;
+
+static const parse_case_t s_cases[] = {
+    {FORM_URLENCODED, "ssid=home&ipass=secret123", true, "home", "secret123"},
+    {FORM_URLENCODED, "ssid=My+Net%21&ipass=a%26b%3Dc%25d", true, "My Net!", "a&b=c%d"},
+    {FORM_URLENCODED, "x=1&ipass=&ssid=caf%C3%A9", true, "café", ""},
+    {FORM_URLENCODED, "ssid=a&ssid=b", true, "b", NULL},
+    {FORM_URLENCODED, "ssid=bad%2", false, "bad", NULL},
+    {FORM_URLENCODED, "ssid=nul%00", false, "nul", NULL},
+    {FORM_JSON, "{\"ssid\": \"home\", \"ipass\": \"secret123\"}", true, "home", "secret123"},
+    {FORM_JSON, " {\"n\":12.5e3,\"ok\":true,\"ssid\":\"a\\\"b\\\\c\\u00e9\\ud83d\\ude00\"} ", true,
+     "a\"b\\c\xc3\xa9\xf0\x9f\x98\x80", NULL},
+    {FORM_JSON, "{}", true, NULL, NULL},
+    {FORM_JSON, "{\"ssid\":1}", false, NULL, NULL},
+    {FORM_JSON, "{\"ssid\":\"x\",}", false, "x", NULL},
+    {FORM_JSON, "{\"o\":{\"ssid\":\"x\"}}", false, NULL, NULL},
+    {FORM_JSON, "{\"ssid\":\"\\ud83d\"}", false, NULL, NULL},
+    {FORM_JSON, "{\"ssid\":\"x\"", false, "x", NULL},
+};
+
+static char s_ssid[33];
+static char s_password[65];
+static form_field_t s_fields[] = {
+    {.name = "ssid", .value = s_ssid, .size = sizeof(s_ssid)},
+    {.name = "ipass", .value = s_password, .size = sizeof(s_password)},
+};
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static bool parse(form_format_t format, const char *body, size_t piece)
+{
+    form_parser_t parser;
+    form_parser_init(&parser, format, s_fields, 2);
+    size_t len = strlen(body);
+    for (size_t i = 0; i < len; i += piece) {
+        size_t n = len - i < piece ? len - i : piece;
+        if (!form_parser_feed(&parser, body + i, n)) {
+            break;
+        }
+    }
+    return form_parser_finish(&parser);
+}
+
+static bool field_is(const form_field_t *field, const char *expected)
+{
+    return expected == NULL ? !field->found : field->found && strcmp(field->value, expected) == 0;
+}
+
+static int check_cases(void)
+{
+    int failed = 0;
+    for (size_t c = 0; c < sizeof(s_cases) / sizeof(s_cases[0]); c++) {
+        const parse_case_t *test = &s_cases[c];
+        for (size_t piece = 1; piece <= 64; piece *= 64) {
+            bool ok = parse(test->format, test->body, piece);
+            /* a malformed body may leave anything behind in the fields */
+            bool same = ok == test->ok &&
+                        (!ok || (field_is(&s_fields[0], test->ssid) && field_is(&s_fields[1], test->password)));
+            if (!same) {
+                printf("FAIL %s (pieces of %zu): ok %d ssid '%s' ipass '%s'\n", test->body, piece, ok, s_ssid,
+                       s_password);
+                failed++;
+            }
+        }
+    }
+
+    /* too long for the buffer: cut, terminated and marked */
+    parse(FORM_URLENCODED, "ssid=0123456789012345678901234567890123456789", 64);
+    if (!s_fields[0].truncated || s_fields[0].len != 32 || strlen(s_ssid) != 32) {
+        printf("FAIL truncation\n");
+        failed++;
+    }
+    return failed;
+}
+
+/* What post_handler did before */
+static void old_parse(const char *body)
+{
+    char content[1024];
+    strcpy(content, body);
+    char *token = strtok(content, "&");
+    if (token == NULL) {
+        return;
+    }
+    sscanf(token, "ssid=%s", s_ssid);
+    token = strtok(NULL, "&");
+    if (token == NULL) {
+        return;
+    }
+    sscanf(token, "ipass=%s", s_password);
+}
+
+int main(int argc, char **argv)
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 200000;
+
+    int failed = check_cases();
+    if (failed) {
+        printf("%d checks failed\n", failed);
+        return 1;
+    }
+
+    static const struct {
+        form_format_t format;
+        const char *name;
+        const char *body;
+    } bodies[] = {
+        {FORM_URLENCODED, "form", "ssid=Home+Network+5G&ipass=correct+horse+battery+staple"},
+        {FORM_URLENCODED, "form %XX", "ssid=Caf%C3%A9+%22Le+Petit%22&ipass=p%40ss%26w0rd%21%21"},
+        {FORM_JSON, "json", "{\"ssid\":\"Home Network 5G\",\"ipass\":\"correct horse battery staple\"}"},
+    };
+    static const size_t pieces[] = {1, 16, 64};
+
+    printf("%-9s %5s %12s %10s %10s %10s\n", "body", "bytes", "old ns", "1 B ns", "16 B ns", "64 B ns");
+    for (size_t b = 0; b < sizeof(bodies) / sizeof(bodies[0]); b++) {
+        size_t len = strlen(bodies[b].body);
+        double old_ns = 0;
+        if (bodies[b].format == FORM_URLENCODED) {
+            int64_t start = now_ns();
+            for (int r = 0; r < rounds; r++) {
+                old_parse(bodies[b].body);
+            }
+            old_ns = (double)(now_ns() - start) / rounds;
+        }
+        double ns[3];
+        for (size_t p = 0; p < 3; p++) {
+            int64_t start = now_ns();
+            for (int r = 0; r < rounds; r++) {
+                parse(bodies[b].format, bodies[b].body, pieces[p]);
+            }
+            ns[p] = (double)(now_ns() - start) / rounds;
+        }
+        char old[16] = "-";
+        if (old_ns > 0) {
+            snprintf(old, sizeof(old), "%.0f", old_ns);
+        }
+        printf("%-9s %5zu %12s %10.0f %10.0f %10.0f   %.1f ns/B\n", bodies[b].name, len, old, ns[0], ns[1], ns[2],
+               ns[2] / len);
+    }
+    return 0;
+}
@@ -0,0 +1,669 @@
+/* Load on the provisioning handlers of http-server.c, off the board.
+
+   http-server.c is compiled as it is, with index_html.c, form-parser.c,
+   net-config.c and the static assets, against the stand-ins of stub/.
+   start_webserver() registers its routes here, and the NVS is kept in
+   memory. The scanner and the provisioning test answer at once. Each
+   case sends the same scripted request a few thousand times and checks
+   the status of every answer. It reports the requests per second and the
+   latency per request.
+
+   Each case then sends its request once more on a stack of its own,
+   painted beforehand and searched afterwards for the deepest byte
+   written, as uxTaskGetStackHighWaterMark() does on the board. "peak" is
+   how far below its caller the handler went. glibc's snprintf() alone
+   takes about 2 KB here, well above newlib, so that figure is for
+   comparing revisions, not for predicting the board. "at send" is how
+   deep the handler's own frames were at its calls into the server. On
+   the board, lwIP's send path starts from there.
+
+   The budget of a route is the stack of the task it runs on, the server
+   or a worker, less STACK_RESERVE for the frames of the server under the
+   handler and of lwIP above a send. A route whose "at send" is over the
+   budget fails the run, and so does a wrong status or a record that was
+   not saved. The GET handler the page had first, which rendered into
+   2048 bytes of stack, runs as a reference and goes over.
+
+   Build: gcc -O2 -Istub -I.. -include stub/newlib.h http-handlers-bench.c ../http-server.c
+          ../index_html.c ../form-parser.c ../net-config.c ../static-assets.c
+          ../static-assets-data.c -o http-handlers-bench
+   Run:   ./http-handlers-bench [rounds]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <ucontext.h>
+#include "freertos/task.h"
+#include "esp_http_server.h"
+#include "http-server.h"
+#include "http-workers.h"
+#include "index_html.h"
+#include "static-assets.h"
+#include "wifi-scanner.h"
+#include "provision.h"
+#include "net-config.h"
+#include "ws-progress.h"
+#include "captive-portal.h"
+#include "esp_rom_crc.h"
+#include "nvs.h"
+#include "../common/boot-prof.h"
+
+#define STACK_AREA     (256 * 1024)
+#define STACK_PAINT    0xa5
+/* What the server and lwIP take from a 4 KB task besides the handler */
+#define STACK_RESERVE  2048
+#define ROUTES_MAX     HTTP_WORKERS_ROUTES_MAX
+#define NVS_ENTRIES    8
+#define NVS_VALUE_MAX  256
+#define RECV_MAX       1460     /* a TCP segment */
+
+/* --- the request, as the stand-ins of esp_http_server see it --- */
+
+typedef struct {
+    const char *accept_encoding;
+    const char *if_none_match;
+    const char *content_type;
+    const char *body;
+    size_t body_pos;
+    int status;                 /* of the answer, 200 unless set */
+    size_t sent;                /* bytes of body */
+} connection_t;
+
+static httpd_config_t s_config;
+static http_route_t *s_routes[ROUTES_MAX];
+static size_t s_route_count;
+/* Deepest frame of a call into the server, where lwIP's send path would
+   start on the board */
+static uint8_t *s_api_low;
+
+/* Not inlined, so its frame lies below the caller's even when the caller
+   was inlined */
+static __attribute__((noinline)) void api_called(void)
+{
+    uint8_t *frame = __builtin_frame_address(0);
+    if (frame < s_api_low) {
+        s_api_low = frame;
+    }
+}
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config)
+{
+    s_config = *config;
+    *handle = &s_config;
+    return ESP_OK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle)
+{
+    (void)handle;
+    return ESP_OK;
+}
+
+/* The static assets, not measured here */
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri_handler)
+{
+    (void)handle;
+    (void)uri_handler;
+    return ESP_OK;
+}
+
+esp_err_t httpd_register_err_handler(httpd_handle_t handle, httpd_err_code_t error,
+                                     httpd_err_handler_func_t handler_fn)
+{
+    (void)handle;
+    (void)error;
+    (void)handler_fn;
+    return ESP_OK;
+}
+
+static const char *header(httpd_req_t *r, const char *field)
+{
+    connection_t *conn = r->aux;
+    if (strcasecmp(field, "Accept-Encoding") == 0) {
+        return conn->accept_encoding;
+    }
+    if (strcasecmp(field, "If-None-Match") == 0) {
+        return conn->if_none_match;
+    }
+    if (strcasecmp(field, "Content-Type") == 0) {
+        return conn->content_type;
+    }
+    return NULL;
+}
+
+size_t httpd_req_get_hdr_value_len(httpd_req_t *r, const char *field)
+{
+    api_called();
+    const char *value = header(r, field);
+    return value == NULL ? 0 : strlen(value);
+}
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *r, const char *field, char *val, size_t val_size)
+{
+    api_called();
+    const char *value = header(r, field);
+    if (value == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    strlcpy(val, value, val_size);
+    return ESP_OK;
+}
+
+int httpd_req_recv(httpd_req_t *r, char *buf, size_t buf_len)
+{
+    api_called();
+    connection_t *conn = r->aux;
+    size_t left = strlen(conn->body + conn->body_pos);
+    size_t n = buf_len < left ? buf_len : left;
+    n = n < RECV_MAX ? n : RECV_MAX;
+    memcpy(buf, conn->body + conn->body_pos, n);
+    conn->body_pos += n;
+    return n;
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t *r, const char *status)
+{
+    api_called();
+    ((connection_t *)r->aux)->status = atoi(status);
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type)
+{
+    api_called();
+    (void)r;
+    (void)type;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *r, const char *field, const char *value)
+{
+    api_called();
+    (void)r;
+    (void)field;
+    (void)value;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len)
+{
+    api_called();
+    size_t len = buf == NULL ? 0 : buf_len == HTTPD_RESP_USE_STRLEN ? strlen(buf) : (size_t)buf_len;
+    ((connection_t *)r->aux)->sent += len;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t buf_len)
+{
+    api_called();
+    return httpd_resp_send(r, buf, buf_len);
+}
+
+esp_err_t httpd_resp_send_err(httpd_req_t *req, httpd_err_code_t error, const char *msg)
+{
+    api_called();
+    httpd_resp_set_status(req, error == HTTPD_400_BAD_REQUEST ? "400" : error == HTTPD_408_REQ_TIMEOUT ? "408"
+                                                                                                         : "500");
+    return httpd_resp_send(req, msg, HTTPD_RESP_USE_STRLEN);
+}
+
+/* --- the modules around the handlers --- */
+
+void http_workers_config(httpd_config_t *config)
+{
+    (void)config;
+}
+
+esp_err_t http_workers_start(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t http_workers_register(httpd_handle_t server, http_route_t *route)
+{
+    (void)server;
+    if (s_route_count < ROUTES_MAX) {
+        s_routes[s_route_count++] = route;
+    }
+    return ESP_OK;
+}
+
+esp_err_t http_workers_stats_handler(httpd_req_t *req)
+{
+    return httpd_resp_sendstr(req, "{}");
+}
+
+esp_err_t ws_progress_register(httpd_handle_t server)
+{
+    (void)server;
+    return ESP_OK;
+}
+
+esp_err_t captive_portal_register(httpd_handle_t server)
+{
+    (void)server;
+    return ESP_OK;
+}
+
+/* A full list, with characters the page and the JSON have to escape */
+static wifi_scanner_snapshot_t s_scan;
+
+static void make_scan(void)
+{
+    s_scan.version = 1;
+    s_scan.count = WIFI_SCANNER_MAX_APS;
+    for (size_t i = 0; i < s_scan.count; i++) {
+        snprintf(s_scan.ssids[i], sizeof(s_scan.ssids[i]), "Net %02u <5G> & \"guests\"", (unsigned)i);
+    }
+}
+
+void wifi_scanner_get(wifi_scanner_snapshot_t *snapshot)
+{
+    *snapshot = s_scan;
+}
+
+/* What provision_start() answers in the current case */
+static esp_err_t s_provision_err;
+static int s_restarts;
+
+esp_err_t provision_start(const char *ssid, const char *password)
+{
+    (void)ssid;
+    (void)password;
+    return s_provision_err;
+}
+
+void provision_get_status(provision_status_t *status)
+{
+    memset(status, 0, sizeof(*status));
+    status->state = PROVISION_CONNECTED;
+    strcpy(status->ssid, "Lab \"2.4\"");
+    status->ip.addr = 0x3201a8c0;      /* 192.168.1.50 */
+    status->elapsed_ms = 2300;
+}
+
+provision_state_t provision_wait(uint32_t timeout_ms)
+{
+    (void)timeout_ms;
+    return PROVISION_CONNECTED;
+}
+
+const char *provision_state_name(provision_state_t state)
+{
+    return state == PROVISION_CONNECTED ? "connected" : "testing";
+}
+
+void boot_prof_mark(boot_phase_t phase)
+{
+    (void)phase;
+}
+
+void vTaskDelay(const TickType_t ticks)
+{
+    (void)ticks;
+}
+
+void esp_restart(void)
+{
+    s_restarts++;
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    return code == ESP_OK ? "ESP_OK" : "ERROR";
+}
+
+#ifdef STUB_NEEDS_STRLCPY
+size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+    if (size > 0) {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+#endif
+
+/* zlib's CRC-32, as in the ROM */
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc >> 1 ^ (0xedb88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+/* --- an NVS in memory, one namespace is all the handlers use --- */
+
+typedef struct {
+    char key[16];
+    uint8_t value[NVS_VALUE_MAX];
+    size_t len;
+    bool used;
+} nvs_entry_t;
+
+static nvs_entry_t s_nvs[NVS_ENTRIES];
+static int s_nvs_commits;
+
+static nvs_entry_t *nvs_find(const char *key)
+{
+    for (size_t i = 0; i < NVS_ENTRIES; i++) {
+        if (s_nvs[i].used && strcmp(s_nvs[i].key, key) == 0) {
+            return &s_nvs[i];
+        }
+    }
+    return NULL;
+}
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    (void)namespace_name;
+    (void)open_mode;
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    (void)handle;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    (void)handle;
+    s_nvs_commits++;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    (void)handle;
+    nvs_entry_t *entry = nvs_find(key);
+    if (entry == NULL) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (*length < entry->len) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    memcpy(out_value, entry->value, entry->len);
+    *length = entry->len;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out_value, size_t *length)
+{
+    return nvs_get_blob(handle, key, out_value, length);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    (void)handle;
+    nvs_entry_t *entry = nvs_find(key);
+    for (size_t i = 0; entry == NULL && i < NVS_ENTRIES; i++) {
+        if (!s_nvs[i].used) {
+            entry = &s_nvs[i];
+        }
+    }
+    if (entry == NULL || length > NVS_VALUE_MAX || strlen(key) >= sizeof(entry->key)) {
+        return ESP_ERR_NO_MEM;
+    }
+    strcpy(entry->key, key);
+    memcpy(entry->value, value, length);
+    entry->len = length;
+    entry->used = true;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value)
+{
+    return nvs_set_blob(handle, key, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    (void)handle;
+    nvs_entry_t *entry = nvs_find(key);
+    if (entry == NULL) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    entry->used = false;
+    return ESP_OK;
+}
+
+/* --- the cases --- */
+
+/* The GET handler of the first version: the list in a global, the page
+   rendered into a buffer on the stack */
+extern const char part1[];
+extern const char part2[];
+
+static esp_err_t old_get_handler(httpd_req_t *req)
+{
+    char buffer[2048];
+    strcpy(buffer, part1);
+    for (size_t i = 0; i < s_scan.count; i++) {
+        strcat(buffer, "<option value=\"");
+        strcat(buffer, s_scan.ssids[i]);
+        strcat(buffer, "\">");
+        strcat(buffer, s_scan.ssids[i]);
+        strcat(buffer, "</option>");
+    }
+    strcat(buffer, part2);
+    return httpd_resp_send(req, buffer, HTTPD_RESP_USE_STRLEN);
+}
+
+static http_route_t s_old_route = {
+    .uri = {.uri = "/index.html", .method = HTTP_GET, .handler = old_get_handler},
+    .async = false,
+};
+
+typedef struct {
+    const char *name;
+    const char *uri;            /* of a route of start_webserver(), NULL for the old handler */
+    httpd_method_t method;
+    esp_err_t provision_err;
+    connection_t request;
+    int status;                 /* expected */
+    const char *saved;          /* SSID expected in the record, NULL if none */
+} load_case_t;
+
+#define FORM "application/x-www-form-urlencoded"
+#define JSON "application/json"
+#define FORM_BODY "ssid=Lab+%222.4%22&ipass=correct+horse+battery+staple"
+
+static const load_case_t s_cases[] = {
+    {"page gzip", "/index.html", HTTP_GET, ESP_OK, {.accept_encoding = "gzip, deflate"}, 200, NULL},
+    {"page rendered", "/index.html", HTTP_GET, ESP_OK, {0}, 200, NULL},
+    {"networks", "/api/networks", HTTP_GET, ESP_OK, {0}, 200, NULL},
+    {"networks 304", "/api/networks", HTTP_GET, ESP_OK, {.if_none_match = "\"scan-5eed1234-1\""}, 304, NULL},
+    {"form, test", "/results.html", HTTP_POST, ESP_OK, {.content_type = FORM, .body = FORM_BODY}, 200, NULL},
+    {"form, saved", "/results.html", HTTP_POST, ESP_ERR_NOT_SUPPORTED, {.content_type = FORM, .body = FORM_BODY},
+     200, "Lab \"2.4\""},
+    {"form, short key", "/results.html", HTTP_POST, ESP_OK, {.content_type = FORM, .body = "ssid=Lab&ipass=short"},
+     400, NULL},
+    {"json, test", "/api/credentials", HTTP_POST, ESP_OK,
+     {.content_type = JSON, .body = "{\"ssid\":\"Lab \\\"2.4\\\"\",\"password\":\"correct horse battery staple\"}"},
+     202, NULL},
+    {"json, saved", "/api/credentials", HTTP_POST, ESP_ERR_NOT_SUPPORTED,
+     {.content_type = JSON, .body = "{\"ssid\":\"Lab\",\"password\":\"correct horse battery staple\"}"}, 200, "Lab"},
+    {"json, busy", "/api/credentials", HTTP_POST, ESP_ERR_INVALID_STATE,
+     {.content_type = JSON, .body = "{\"ssid\":\"Lab\",\"password\":\"\"}"}, 409, NULL},
+    {"json, malformed", "/api/credentials", HTTP_POST, ESP_OK, {.content_type = JSON, .body = "{\"ssid\":"}, 400,
+     NULL},
+    {"provisioning", "/api/provisioning", HTTP_GET, ESP_OK, {0}, 200, NULL},
+    {"old page, 2 KB", NULL, HTTP_GET, ESP_OK, {0}, 200, NULL},
+};
+
+/* The case being run, serve() takes no arguments */
+static const load_case_t *s_case;
+static http_route_t *s_route;
+
+static uint8_t s_stack[STACK_AREA] __attribute__((aligned(16)));
+static ucontext_t s_main_context;
+static ucontext_t s_stack_context;
+/* Where the handler's frames start, and what serve() answered there */
+static uint8_t *s_handler_top;
+static int s_stack_status;
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static __attribute__((noinline)) esp_err_t call_handler(httpd_req_t *req)
+{
+    s_handler_top = __builtin_frame_address(0);
+    s_api_low = s_handler_top;
+    return s_route->uri.handler(req);
+}
+
+/* Sends the request of the case once, returns the status of the answer */
+static int serve(void)
+{
+    connection_t conn = s_case->request;
+    conn.status = 200;
+    httpd_req_t req = {
+        .method = s_case->method,
+        .content_len = conn.body ? strlen(conn.body) : 0,
+        .aux = &conn,
+        .user_ctx = s_route->uri.user_ctx,
+    };
+    call_handler(&req);
+    return conn.status;
+}
+
+static void serve_on_stack(void)
+{
+    s_stack_status = serve();
+}
+
+/* One request on the painted stack. Returns the bytes the handler took
+   at its deepest and sets at_send to the bytes it held while calling the
+   server. Run after the timed requests, so no symbol is left for the
+   dynamic linker to resolve on the way. */
+static size_t handler_stack(size_t *at_send)
+{
+    memset(s_stack, STACK_PAINT, sizeof(s_stack));
+    getcontext(&s_stack_context);
+    s_stack_context.uc_stack.ss_sp = s_stack;
+    s_stack_context.uc_stack.ss_size = sizeof(s_stack);
+    s_stack_context.uc_link = &s_main_context;
+    makecontext(&s_stack_context, serve_on_stack, 0);
+    swapcontext(&s_main_context, &s_stack_context);
+
+    size_t untouched = 0;
+    while (untouched < sizeof(s_stack) && s_stack[untouched] == STACK_PAINT) {
+        untouched++;
+    }
+    *at_send = s_handler_top - s_api_low;
+    return s_handler_top - (s_stack + untouched);
+}
+
+static int compare_ns(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static http_route_t *find_route(const char *uri, httpd_method_t method)
+{
+    for (size_t i = 0; i < s_route_count; i++) {
+        if (strcmp(s_routes[i]->uri.uri, uri) == 0 && s_routes[i]->uri.method == method) {
+            return s_routes[i];
+        }
+    }
+    return NULL;
+}
+
+/* After the saving cases the record must hold what was sent */
+static bool check_saved(const char *ssid)
+{
+    net_config_t config;
+    return net_config_load(&config) == ESP_OK && strcmp(config.ssid, ssid) == 0 &&
+           strcmp(config.password, "correct horse battery staple") == 0;
+}
+
+int main(int argc, char **argv)
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 5000;
+    if (rounds <= 0) {
+        rounds = 1;
+    }
+    int64_t *latency_ns = malloc(rounds * sizeof(*latency_ns));
+
+    if (start_webserver() == NULL) {
+        printf("start_webserver() failed\n");
+        return 1;
+    }
+    make_scan();
+
+    printf("%-16s %-18s %5s %9s %8s %8s %8s %8s %6s %7s %6s\n", "case", "route", "async", "req/s", "mean us",
+           "p50 us", "p99 us", "max us", "peak", "at send", "budget");
+    int failed = 0;
+    for (size_t c = 0; c < sizeof(s_cases) / sizeof(s_cases[0]); c++) {
+        s_case = &s_cases[c];
+        s_route = s_case->uri ? find_route(s_case->uri, s_case->method) : &s_old_route;
+        if (s_route == NULL) {
+            printf("%-16s %s is not registered\n", s_case->name, s_case->uri);
+            failed++;
+            continue;
+        }
+        s_provision_err = s_case->provision_err;
+        memset(s_nvs, 0, sizeof(s_nvs));
+
+        int wrong = 0;
+        int64_t sum = 0;
+        int64_t start = now_ns();
+        for (int r = 0; r < rounds; r++) {
+            int64_t request_start = now_ns();
+            int status = serve();
+            latency_ns[r] = now_ns() - request_start;
+            sum += latency_ns[r];
+            wrong += status != s_case->status;
+        }
+        int64_t total_ns = now_ns() - start;
+        qsort(latency_ns, rounds, sizeof(*latency_ns), compare_ns);
+
+        size_t at_send;
+        size_t peak = handler_stack(&at_send);
+        wrong += s_stack_status != s_case->status;
+        size_t task_stack = s_route->async ? HTTP_WORKERS_STACK_SIZE : s_config.stack_size;
+        size_t budget = task_stack - STACK_RESERVE;
+
+        const char *problem = NULL;
+        if (wrong) {
+            problem = "WRONG STATUS";
+        } else if (s_case->saved != NULL && !check_saved(s_case->saved)) {
+            problem = "NOT SAVED";
+        } else if (at_send > budget) {
+            problem = "OVER BUDGET";
+        }
+        bool reference = s_case->uri == NULL;
+        printf("%-16s %-18s %5s %9.0f %8.2f %8.2f %8.2f %8.2f %6zu %7zu %6zu %s\n", s_case->name, s_route->uri.uri,
+               s_route->async ? "yes" : "no", rounds * 1e9 / total_ns, sum / 1e3 / rounds,
+               latency_ns[rounds / 2] / 1e3, latency_ns[rounds * 99 / 100] / 1e3, latency_ns[rounds - 1] / 1e3,
+               peak, at_send, budget, problem == NULL ? "" : reference ? "(expected)" : problem);
+        if (problem != NULL && !reference) {
+            failed++;
+        }
+    }
+    printf("%d restarts asked, %d NVS commits\n", s_restarts, s_nvs_commits);
+
+    free(latency_ns);
+    if (failed) {
+        printf("%d cases failed\n", failed);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,246 @@
+/* Rendering cost of the provisioning page for 10, 100 and 1000 SSIDs.
+
+   The page goes to one end of a socket pair and a thread drains the
+   other, so every send is a real system call as on the board. The
+   streamed renderer of index_html.c, which writes each chunk the way
+   esp_http_server frames it, is compared to the old one: strcat of every
+   option into one buffer, then a single send. The old renderer gets a
+   heap buffer as large as the page here; on the board it had 2048 bytes
+   of stack, which the table marks as an overflow.
+
+   Before timing, the streamed page for plain SSIDs is checked against
+   the old one byte for byte.
+
+   Build: gcc -O2 -Istub -I.. index-html-bench.c ../index_html.c -o index-html-bench -lpthread
+   Run:   ./index-html-bench [rounds]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "index_html.h"
+
+#define SSID_MAX       1000
+#define OLD_STACK_SIZE 2048
+
+extern const char part1[];
+extern const char part2[];
+
+static char s_ssids[SSID_MAX][33];
+static int s_sink[2];
+
+/* Set while checking the output, the sent bytes are kept there */
+static char *s_capture;
+static size_t s_capture_len;
+static size_t s_sends;
+/* Set to time the rendering alone, nothing is sent */
+static bool s_dry;
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void *drain_thread(void *arg)
+{
+    (void)arg;
+    char buffer[4096];
+    while (read(s_sink[1], buffer, sizeof(buffer)) > 0) {
+    }
+    return NULL;
+}
+
+static esp_err_t sink_send(const char *buf, size_t len)
+{
+    s_sends++;
+    if (s_dry) {
+        return ESP_OK;
+    }
+    while (len > 0) {
+        ssize_t n = send(s_sink[0], buf, len, 0);
+        if (n <= 0) {
+            return ESP_FAIL;
+        }
+        buf += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len)
+{
+    (void)r;
+    size_t len = buf_len == HTTPD_RESP_USE_STRLEN ? strlen(buf) : (size_t)buf_len;
+    if (s_capture) {
+        memcpy(s_capture + s_capture_len, buf, len);
+        s_capture_len += len;
+    }
+    return sink_send(buf, len);
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type)
+{
+    (void)r;
+    (void)type;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *r, const char *field, const char *value)
+{
+    (void)r;
+    (void)field;
+    (void)value;
+    return ESP_OK;
+}
+
+/* Size line, data and CRLF, three sends like httpd_resp_send_chunk() */
+esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t buf_len)
+{
+    (void)r;
+    size_t len = buf == NULL ? 0 : buf_len == HTTPD_RESP_USE_STRLEN ? strlen(buf) : (size_t)buf_len;
+    char line[16];
+    int line_len = snprintf(line, sizeof(line), "%zx\r\n", len);
+    if (sink_send(line, line_len) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    if (len > 0) {
+        if (s_capture) {
+            memcpy(s_capture + s_capture_len, buf, len);
+            s_capture_len += len;
+        }
+        if (sink_send(buf, len) != ESP_OK) {
+            return ESP_FAIL;
+        }
+    }
+    return sink_send("\r\n", 2);
+}
+
+/* The renderer index_html.c had before */
+static void old_render(char *buffer, const char *ssid_list, int ssid_count)
+{
+    strcpy(buffer, part1);
+    for (int i = 0; i < ssid_count; i++) {
+        strcat(buffer, "<option value=\"");
+        strcat(buffer, ssid_list + i * 33);
+        strcat(buffer, "\">");
+        strcat(buffer, ssid_list + i * 33);
+        strcat(buffer, "</option>");
+    }
+    strcat(buffer, part2);
+}
+
+static void make_ssids(bool special)
+{
+    static const char plain[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 -_";
+    static const char escaped[] = "&<>\"'";
+    srand(1);
+    for (int i = 0; i < SSID_MAX; i++) {
+        int len = 1 + rand() % 32;
+        for (int j = 0; j < len; j++) {
+            s_ssids[i][j] = special && rand() % 8 == 0 ? escaped[rand() % 5] : plain[rand() % (sizeof(plain) - 1)];
+        }
+        s_ssids[i][len] = '\0';
+    }
+}
+
+static size_t page_size(int count)
+{
+    size_t size = strlen(part1) + strlen(part2) + 1;
+    for (int i = 0; i < count; i++) {
+        size += 15 + 2 + 9 + 2 * strlen(s_ssids[i]);
+    }
+    return size;
+}
+
+static bool check_output(void)
+{
+    make_ssids(false);
+    size_t size = page_size(SSID_MAX);
+    char *expected = malloc(size);
+    s_capture = malloc(size);
+    s_capture_len = 0;
+    old_render(expected, (const char *)s_ssids, SSID_MAX);
+
+    httpd_req_t req = {0};
+    bool same = send_index_html(&req, (const char *)s_ssids, SSID_MAX) == ESP_OK &&
+                s_capture_len == strlen(expected) && memcmp(s_capture, expected, s_capture_len) == 0;
+
+    /* an SSID that tries to close the attribute must stay inside it */
+    strcpy(s_ssids[0], "\"><script>");
+    s_capture_len = 0;
+    send_index_html(&req, (const char *)s_ssids, 1);
+    s_capture[s_capture_len] = '\0';
+    same = same && strstr(s_capture, "<script>") == NULL && strstr(s_capture, "&quot;&gt;&lt;script&gt;") != NULL;
+
+    free(expected);
+    free(s_capture);
+    s_capture = NULL;
+    return same;
+}
+
+int main(int argc, char **argv)
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 200;
+    static const int counts[] = {10, 100, 1000};
+
+    socketpair(AF_UNIX, SOCK_STREAM, 0, s_sink);
+    pthread_t drain;
+    pthread_create(&drain, NULL, drain_thread, NULL);
+
+    if (!check_output()) {
+        printf("streamed page differs from the old one\n");
+        return 1;
+    }
+
+    printf("%6s %9s %10s %10s %6s %10s %10s %6s %10s\n", "ssids", "page B", "old us", "+send", "sends",
+           "stream us", "+send", "sends", "old stack");
+    for (int c = 0; c < 2; c++) {
+        make_ssids(c == 1);
+        if (c == 1) {
+            printf("with characters to escape:\n");
+        }
+        for (size_t k = 0; k < sizeof(counts) / sizeof(counts[0]); k++) {
+            int count = counts[k];
+            size_t size = page_size(count);
+            char *buffer = malloc(size);
+            double old_us[2], stream_us[2];
+            size_t old_sends = 0, stream_sends = 0;
+
+            /* rendering alone first, then with the sends */
+            for (int send = 0; send < 2; send++) {
+                httpd_req_t req = {0};
+                s_dry = !send;
+
+                s_sends = 0;
+                int64_t start = now_us();
+                for (int r = 0; r < rounds; r++) {
+                    old_render(buffer, (const char *)s_ssids, count);
+                    httpd_resp_send(&req, buffer, HTTPD_RESP_USE_STRLEN);
+                }
+                old_us[send] = (double)(now_us() - start) / rounds;
+                old_sends = s_sends / rounds;
+
+                s_sends = 0;
+                start = now_us();
+                for (int r = 0; r < rounds; r++) {
+                    send_index_html(&req, (const char *)s_ssids, count);
+                }
+                stream_us[send] = (double)(now_us() - start) / rounds;
+                stream_sends = s_sends / rounds;
+            }
+
+            printf("%6d %9zu %10.1f %10.1f %6zu %10.1f %10.1f %6zu %10s\n", count, size - 1, old_us[0], old_us[1],
+                   old_sends, stream_us[0], stream_us[1], stream_sends, size > OLD_STACK_SIZE ? "overflow" : "fits");
+            free(buffer);
+        }
+    }
+
+    shutdown(s_sink[0], SHUT_WR);
+    pthread_join(drain, NULL);
+    return 0;
+}
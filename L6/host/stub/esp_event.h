@@ -0,0 +1,12 @@
+/* Host stand-in for the ESP-IDF header, enough for the L6 headers */
+#ifndef _STUB_ESP_EVENT_H_
+#define _STUB_ESP_EVENT_H_
+
+#include "esp_err.h"
+
+typedef const char *esp_event_base_t;
+
+#define ESP_EVENT_DECLARE_BASE(id) extern esp_event_base_t const id
+#define ESP_EVENT_DEFINE_BASE(id)  esp_event_base_t const id = #id
+
+#endif
@@ -0,0 +1,99 @@
+/* Host stand-in for the ESP-IDF header. The functions are defined by the
+ * host program that links the handlers. */
+#ifndef _STUB_ESP_HTTP_SERVER_H_
+#define _STUB_ESP_HTTP_SERVER_H_
+
+#include <stddef.h>
+#include <sys/types.h>
+#include "esp_err.h"
+
+#define HTTPD_RESP_USE_STRLEN        -1
+#define HTTPD_SOCK_ERR_TIMEOUT       -3
+#define ESP_ERR_HTTPD_HANDLER_EXISTS 0xb001
+
+typedef void *httpd_handle_t;
+
+typedef enum {
+    HTTP_GET = 1,
+    HTTP_POST = 3,
+} httpd_method_t;
+
+typedef enum {
+    HTTPD_400_BAD_REQUEST = 400,
+    HTTPD_404_NOT_FOUND = 404,
+    HTTPD_408_REQ_TIMEOUT = 408,
+    HTTPD_500_INTERNAL_SERVER_ERROR = 500,
+} httpd_err_code_t;
+
+typedef struct {
+    size_t stack_size;
+    uint16_t max_open_sockets;
+    uint16_t max_uri_handlers;
+    bool lru_purge_enable;
+} httpd_config_t;
+
+#define HTTPD_DEFAULT_CONFIG() { \
+    .stack_size = 4096, \
+    .max_open_sockets = 7, \
+    .max_uri_handlers = 8, \
+    .lru_purge_enable = false, \
+}
+
+typedef struct httpd_req {
+    httpd_handle_t handle;
+    int method;
+    const char uri[512 + 1];
+    size_t content_len;
+    void *aux;                  /* the host program's connection */
+    void *user_ctx;
+    void *sess_ctx;
+} httpd_req_t;
+
+typedef struct httpd_uri {
+    const char *uri;
+    httpd_method_t method;
+    esp_err_t (*handler)(httpd_req_t *r);
+    void *user_ctx;
+#if CONFIG_HTTPD_WS_SUPPORT
+    bool is_websocket;
+    bool handle_ws_control_frames;
+    const char *supported_subprotocol;
+#endif
+} httpd_uri_t;
+
+typedef esp_err_t (*httpd_err_handler_func_t)(httpd_req_t *req, httpd_err_code_t error);
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config);
+esp_err_t httpd_stop(httpd_handle_t handle);
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri_handler);
+esp_err_t httpd_register_err_handler(httpd_handle_t handle, httpd_err_code_t error,
+                                     httpd_err_handler_func_t handler_fn);
+
+int httpd_req_recv(httpd_req_t *r, char *buf, size_t buf_len);
+
+size_t httpd_req_get_hdr_value_len(httpd_req_t *r, const char *field);
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *r, const char *field, char *val, size_t val_size);
+
+esp_err_t httpd_resp_set_status(httpd_req_t *r, const char *status);
+esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type);
+esp_err_t httpd_resp_set_hdr(httpd_req_t *r, const char *field, const char *value);
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len);
+esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t buf_len);
+esp_err_t httpd_resp_send_err(httpd_req_t *req, httpd_err_code_t error, const char *msg);
+
+static inline esp_err_t httpd_resp_sendstr(httpd_req_t *r, const char *str)
+{
+    return httpd_resp_send(r, str, HTTPD_RESP_USE_STRLEN);
+}
+
+static inline esp_err_t httpd_resp_send_408(httpd_req_t *r)
+{
+    return httpd_resp_send_err(r, HTTPD_408_REQ_TIMEOUT, NULL);
+}
+
+static inline esp_err_t httpd_resp_send_500(httpd_req_t *r)
+{
+    return httpd_resp_send_err(r, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+}
+
+#endif
@@ -0,0 +1,17 @@
+/* Host stand-in for the ESP-IDF header, enough for the L6 headers */
+#ifndef _STUB_ESP_NETIF_H_
+#define _STUB_ESP_NETIF_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef struct {
+    uint32_t addr;              /* network byte order */
+} esp_ip4_addr_t;
+
+#define esp_ip4_addr_get_byte(ipaddr, idx) (((const uint8_t *)(&(ipaddr)->addr))[idx])
+#define IP2STR(ipaddr) esp_ip4_addr_get_byte(ipaddr, 0), esp_ip4_addr_get_byte(ipaddr, 1), \
+    esp_ip4_addr_get_byte(ipaddr, 2), esp_ip4_addr_get_byte(ipaddr, 3)
+#define IPSTR "%d.%d.%d.%d"
+
+#endif
@@ -0,0 +1,15 @@
+/* Host stand-in for the ESP-IDF header, a fixed value so the ETags of the
+ * bench cases are known */
+#ifndef _STUB_ESP_RANDOM_H_
+#define _STUB_ESP_RANDOM_H_
+
+#include <stdint.h>
+
+#define STUB_ESP_RANDOM 0x5eed1234u
+
+static inline uint32_t esp_random(void)
+{
+    return STUB_ESP_RANDOM;
+}
+
+#endif
@@ -0,0 +1,10 @@
+/* Host stand-in for the ESP-IDF header. The function is defined by the
+ * host program that links the modules. */
+#ifndef _STUB_ESP_ROM_CRC_H_
+#define _STUB_ESP_ROM_CRC_H_
+
+#include <stdint.h>
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+#endif
@@ -0,0 +1,8 @@
+/* Host stand-in for the ESP-IDF header. esp_restart() is defined by the
+ * host program that links the handlers. */
+#ifndef _STUB_ESP_SYSTEM_H_
+#define _STUB_ESP_SYSTEM_H_
+
+void esp_restart(void);
+
+#endif
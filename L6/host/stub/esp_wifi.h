@@ -0,0 +1,9 @@
+/* Host stand-in for the ESP-IDF header, only the headers it pulls in */
+#ifndef _STUB_ESP_WIFI_H_
+#define _STUB_ESP_WIFI_H_
+
+#include "esp_system.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+
+#endif
@@ -0,0 +1,12 @@
+/* Host stand-in for the FreeRTOS header, enough for the L6 handlers */
+#ifndef _STUB_FREERTOS_H_
+#define _STUB_FREERTOS_H_
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+
+#define portTICK_PERIOD_MS 1
+#define BIT0               0x01
+
+#endif
@@ -0,0 +1,7 @@
+/* Host stand-in for the FreeRTOS header, nothing of it is used */
+#ifndef _STUB_FREERTOS_EVENT_GROUPS_H_
+#define _STUB_FREERTOS_EVENT_GROUPS_H_
+
+#include "freertos/FreeRTOS.h"
+
+#endif
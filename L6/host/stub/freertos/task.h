@@ -0,0 +1,10 @@
+/* Host stand-in for the FreeRTOS header. vTaskDelay() is defined by the
+ * host program that links the handlers. */
+#ifndef _STUB_FREERTOS_TASK_H_
+#define _STUB_FREERTOS_TASK_H_
+
+#include "freertos/FreeRTOS.h"
+
+void vTaskDelay(const TickType_t ticks);
+
+#endif
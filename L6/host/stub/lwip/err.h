@@ -0,0 +1,5 @@
+/* Host stand-in for the lwIP header, nothing of it is used */
+#ifndef _STUB_LWIP_ERR_H_
+#define _STUB_LWIP_ERR_H_
+
+#endif
@@ -0,0 +1,14 @@
+/* What the ESP toolchain's newlib has and an older glibc lacks. Included
+ * ahead of every file with -include, the functions are defined by the
+ * host program. */
+#ifndef _STUB_NEWLIB_H_
+#define _STUB_NEWLIB_H_
+
+#include <string.h>
+
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+#define STUB_NEEDS_STRLCPY 1
+size_t strlcpy(char *dst, const char *src, size_t size);
+#endif
+
+#endif
@@ -0,0 +1,5 @@
+/* Host stand-in for the ESP-IDF header, nothing of it is used */
+#ifndef _STUB_NVS_FLASH_H_
+#define _STUB_NVS_FLASH_H_
+
+#endif
@@ -1,3 +1,4 @@
+#include <stdio.h>
 #include <string.h>
 #include <sys/param.h>
 #include "freertos/FreeRTOS.h"
@@ -6,9 +7,18 @@
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_random.h"
 #include "nvs_flash.h"
 #include "config.h"
 #include "index_html.h"
+#include "static-assets.h"
+#include "wifi-scanner.h"
+#include "form-parser.h"
+#include "http-workers.h"
+#include "captive-portal.h"
+#include "net-config.h"
+#include "provision.h"
+#include "ws-progress.h"
 #include "nvs_flash.h"
 #include "nvs.h"
 
@@ -17,128 +27,325 @@
 #include "freertos/event_groups.h"
 
 #include "esp_http_server.h"
+#include "../common/boot-prof.h"
 
 static const char *TAG = "wifi station";
 
-char ssid_list[CONFIG_EXAMPLE_SCAN_LIST_SIZE][33];
-size_t size_ssid = 0;
-
-char* get_ssid_list() {
-    return (char*) ssid_list;
-}
-
-void set_size_ssid(size_t size) {
-    size_ssid = size;
-}
+/* The scan version starts over at every boot, this tells the boots apart
+ * in the ETag of the networks */
+static uint32_t s_boot_tag;
 
 /* Our URI handler function to be called during GET /uri request */
 esp_err_t get_handler(httpd_req_t *req)
 {
-    /* Send a simple response */
+    boot_prof_mark(BOOT_PHASE_FIRST_PACKET);
 
-    char buffer[2048];
-    set_index_html_content(buffer, get_ssid_list(), size_ssid);
-    httpd_resp_send(req, buffer, HTTPD_RESP_USE_STRLEN);
-    return ESP_OK;
+    /* The page comes from flash and its script fetches the networks */
+    const static_asset_t *page = static_assets_find("/index.html");
+    if (page != NULL && static_assets_accepts_gzip(req)) {
+        return static_assets_send(req, page);
+    }
+    /* A client without gzip gets it rendered with the networks in it */
+    wifi_scanner_snapshot_t scan;
+    wifi_scanner_get(&scan);
+    return send_index_html(req, (const char *)scan.ssids, scan.count);
 }
 
-/* Our URI handler function to be called during POST /uri request */
-esp_err_t post_handler(httpd_req_t *req)
+/* Our URI handler function to be called during GET /api/networks request */
+esp_err_t networks_handler(httpd_req_t *req)
 {
-    /* Destination buffer for content of HTTP POST request.
-     * httpd_req_recv() accepts char* only, but content could
-     * as well be any binary data (needs type casting).
-     * In case of string data, null termination will be absent, and
-     * content length would give length of string */
-    char content[1024];
-
-    /* Truncate if content length larger than the buffer */
-    size_t recv_size = MIN(req->content_len, sizeof(content));
-
-    int ret = httpd_req_recv(req, content, recv_size);
-    if (ret <= 0) {  /* 0 return value indicates connection closed */
-        /* Check if timeout occurred */
-        if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
-            /* In case of timeout one can choose to retry calling
-             * httpd_req_recv(), but to keep it simple, here we
-             * respond with an HTTP 408 (Request Timeout) error */
-            httpd_resp_send_408(req);
-        }
-        /* In case of error, returning ESP_FAIL will
-         * ensure that the underlying socket is closed */
-        return ESP_FAIL;
+    wifi_scanner_snapshot_t scan;
+    wifi_scanner_get(&scan);
+
+    /* The page asks again every few seconds, the list only changes when
+     * the scanner finds another network */
+    char etag[32];
+    snprintf(etag, sizeof(etag), "\"scan-%08lx-%lu\"", (unsigned long)s_boot_tag, (unsigned long)scan.version);
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    if (static_assets_etag_matches(req, etag)) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
     }
-    // Null-terminate the buffer
-    content[ret] = '\0';
+    return send_networks_json(req, (const char *)scan.ssids, scan.count);
+}
 
-    // Get the SSID and password from the POST request
-    char ssid[33];
-    char password[65];
-    
-    char* token;
-	token  = strtok(content, "&");
-    if (token == NULL) {
+/* Longest request body taken, the fields need far less */
+#define FORM_BODY_MAX 512
+/* Bytes taken from the socket at a time */
+#define FORM_CHUNK_SIZE 64
+
+/* Reads the body a piece at a time into fields, as JSON or urlencoded
+ * by its Content-Type. On failure the error response is already sent. */
+static esp_err_t recv_form(httpd_req_t *req, form_field_t *fields, size_t field_count)
+{
+    if (req->content_len > FORM_BODY_MAX) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Body too long");
         return ESP_FAIL;
     }
 
-	sscanf(token, "ssid=%s", ssid);
-	token = strtok(NULL, "&");
+    /* A longer value comes back cut, the start is all that is compared */
+    char type[24] = "";
+    httpd_req_get_hdr_value_str(req, "Content-Type", type, sizeof(type));
+    form_format_t format = strncmp(type, "application/json", 16) == 0 ? FORM_JSON : FORM_URLENCODED;
+
+    form_parser_t parser;
+    form_parser_init(&parser, format, fields, field_count);
 
-    if (token == NULL) {
+    char chunk[FORM_CHUNK_SIZE];
+    size_t remaining = req->content_len;
+    while (remaining > 0) {
+        int ret = httpd_req_recv(req, chunk, MIN(remaining, sizeof(chunk)));
+        if (ret <= 0) {  /* 0 return value indicates connection closed */
+            /* Check if timeout occurred */
+            if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
+                httpd_resp_send_408(req);
+            }
+            /* In case of error, returning ESP_FAIL will
+             * ensure that the underlying socket is closed */
+            return ESP_FAIL;
+        }
+        remaining -= ret;
+        if (!form_parser_feed(&parser, chunk, ret)) {
+            break;
+        }
+    }
+    if (!form_parser_finish(&parser)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Malformed body");
         return ESP_FAIL;
     }
+    return ESP_OK;
+}
 
-	sscanf(token, "ipass=%s", password);
+/* NULL if the two fields can be used to join a network */
+static const char *check_credentials(const form_field_t *ssid, const form_field_t *password)
+{
+    if (!ssid->found || ssid->len == 0) {
+        return "SSID missing";
+    }
+    if (ssid->truncated) {
+        return "SSID longer than 32 bytes";
+    }
+    /* An open network has no key, WPA takes 8 to 63 characters or 64 hex digits */
+    if (password->truncated || (password->len > 0 && password->len < 8)) {
+        return "Security key must have 8 to 64 characters";
+    }
+    return NULL;
+}
 
-    // Save the SSID and password to the NVS
-    nvs_handle_t nvs_handle;
-    esp_err_t err;
-    err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGI(TAG, "Error (%s) opening NVS handle", esp_err_to_name(err));
-        return ESP_FAIL;
+static esp_err_t save_credentials(const char *ssid, const char *password)
+{
+    // Save the SSID and password to the NVS, with what else is known of the network
+    net_config_t config;
+    if (net_config_load(&config) != ESP_OK) {
+        memset(&config, 0, sizeof(config));
     }
+    /* The AP, the lease and a fixed address belong to the old network */
+    if (strcmp(config.ssid, ssid) != 0) {
+        config.flags = 0;
+    }
+    strlcpy(config.ssid, ssid, sizeof(config.ssid));
+    strlcpy(config.password, password, sizeof(config.password));
 
-    err = nvs_set_str(nvs_handle, "ssid", ssid);
+    esp_err_t err = net_config_save(&config);
     if (err != ESP_OK) {
-        ESP_LOGI(TAG, "Error (%s) setting NVS value ssid", esp_err_to_name(err));
+        ESP_LOGI(TAG, "Error (%s) saving the network configuration", esp_err_to_name(err));
+    }
+    return err;
+}
+
+/* Lets the response leave before the restart */
+static void restart_soon(void)
+{
+    ESP_LOGI(TAG, "SSID and password saved to NVS. Restarting...");
+    vTaskDelay(500 / portTICK_PERIOD_MS);
+    esp_restart();
+}
+
+/* Our URI handler function to be called during POST /uri request */
+esp_err_t post_handler(httpd_req_t *req)
+{
+    // Get the SSID and password from the POST request
+    char ssid[33];
+    char password[65];
+    form_field_t fields[] = {
+        { .name = "ssid", .value = ssid, .size = sizeof(ssid) },
+        { .name = "ipass", .value = password, .size = sizeof(password) },
+    };
+    if (recv_form(req, fields, 2) != ESP_OK) {
         return ESP_FAIL;
     }
 
-    err = nvs_set_str(nvs_handle, "password", password);
-    if (err != ESP_OK) {
-        ESP_LOGI(TAG, "Error (%s) setting NVS value password", esp_err_to_name(err));
+    const char *problem = check_credentials(&fields[0], &fields[1]);
+    if (problem != NULL) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, problem);
         return ESP_FAIL;
     }
 
-    err = nvs_commit(nvs_handle);
+    esp_err_t err = provision_start(ssid, password);
+    if (err == ESP_ERR_NOT_SUPPORTED) {
+        /* Provisioned already, the new network is joined after a restart */
+        if (save_credentials(ssid, password) != ESP_OK) {
+            httpd_resp_send_500(req);
+            return ESP_FAIL;
+        }
+        httpd_resp_sendstr(req, "Saved, the board restarts and joins the network.");
+        restart_soon();
+        return ESP_OK;
+    }
+    httpd_resp_set_type(req, "text/plain");
     if (err != ESP_OK) {
-        ESP_LOGI(TAG, "Error (%s) committing NVS values", esp_err_to_name(err));
+        httpd_resp_set_status(req, "409 Conflict");
+        return httpd_resp_sendstr(req, "The board is already joining a network.");
+    }
+
+    /* This runs on a worker, the server answers the others meanwhile */
+    provision_wait(PROVISION_TIMEOUT_MS + 1000);
+    provision_status_t status;
+    provision_get_status(&status);
+    char text[160];
+    if (status.state == PROVISION_CONNECTED) {
+        snprintf(text, sizeof(text), "Joined %s with address " IPSTR ", the board stays on that network.",
+                 status.ssid, IP2STR(&status.ip));
+    } else {
+        snprintf(text, sizeof(text), "Could not join %s: %s. Go back and try again.", status.ssid,
+                 status.error != NULL ? status.error : "no answer");
+    }
+    return httpd_resp_sendstr(req, text);
+}
+
+static esp_err_t send_json_status(httpd_req_t *req, const char *status, const char *json)
+{
+    httpd_resp_set_status(req, status);
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_sendstr(req, json);
+}
+
+/* Our URI handler function to be called during POST /api/credentials request.
+ * Takes {"ssid": ..., "password": ...} or the same keys urlencoded. */
+esp_err_t credentials_handler(httpd_req_t *req)
+{
+    char ssid[33];
+    char password[65];
+    form_field_t fields[] = {
+        { .name = "ssid", .value = ssid, .size = sizeof(ssid) },
+        { .name = "password", .value = password, .size = sizeof(password) },
+    };
+    if (recv_form(req, fields, 2) != ESP_OK) {
         return ESP_FAIL;
     }
 
-    nvs_close(nvs_handle);
+    const char *problem = check_credentials(&fields[0], &fields[1]);
+    if (problem != NULL) {
+        char json[96];
+        snprintf(json, sizeof(json), "{\"error\":\"%s\"}", problem);
+        return send_json_status(req, "400 Bad Request", json);
+    }
 
-    ESP_LOGI(TAG, "SSID and password saved to NVS. Restarting...");
-    esp_restart();
+    /* Tried while the AP stays up, GET /api/provisioning tells the outcome */
+    esp_err_t err = provision_start(ssid, password);
+    if (err == ESP_OK) {
+        return send_json_status(req, "202 Accepted", "{\"state\":\"testing\"}");
+    }
+    if (err == ESP_ERR_INVALID_STATE) {
+        return send_json_status(req, "409 Conflict", "{\"error\":\"The board is already joining a network\"}");
+    }
 
+    /* Provisioned already, the new network is joined after a restart */
+    if (save_credentials(ssid, password) != ESP_OK) {
+        return send_json_status(req, "500 Internal Server Error", "{\"error\":\"Saving failed\"}");
+    }
+    send_json_status(req, "200 OK", "{\"saved\":true}");
+    restart_soon();
     return ESP_OK;
 }
 
-/* URI handler structure for GET /uri */
-httpd_uri_t uri_get = {
-    .uri      = "/index.html",
-    .method   = HTTP_GET,
-    .handler  = get_handler,
-    .user_ctx = NULL
+/* Our URI handler function to be called during GET /api/provisioning request */
+esp_err_t provisioning_handler(httpd_req_t *req)
+{
+    provision_status_t status;
+    provision_get_status(&status);
+
+    char ssid[33 * 6 + 1];
+    json_escape(ssid, sizeof(ssid), status.ssid);
+    char json[320];
+    int len = snprintf(json, sizeof(json), "{\"state\":\"%s\",\"ssid\":\"%s\",\"elapsed_ms\":%lu",
+                       provision_state_name(status.state), ssid, (unsigned long)status.elapsed_ms);
+    if (status.state == PROVISION_CONNECTED) {
+        snprintf(json + len, sizeof(json) - len, ",\"ip\":\"" IPSTR "\"}", IP2STR(&status.ip));
+    } else if (status.state == PROVISION_FAILED) {
+        snprintf(json + len, sizeof(json) - len, ",\"error\":\"%s\"}", status.error);
+    } else {
+        snprintf(json + len, sizeof(json) - len, "}");
+    }
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return send_json_status(req, "200 OK", json);
+}
+
+/* Route for GET /uri, the page can take long to reach a slow client */
+http_route_t route_get = {
+    .uri = {
+        .uri      = "/index.html",
+        .method   = HTTP_GET,
+        .handler  = get_handler,
+        .user_ctx = NULL
+    },
+    .async = true
 };
 
-/* URI handler structure for POST /uri */
-httpd_uri_t uri_post = {
-    .uri      = "/results.html",
-    .method   = HTTP_POST,
-    .handler  = post_handler,
-    .user_ctx = NULL
+/* Route for GET /api/networks, only copies the last scan */
+http_route_t route_networks = {
+    .uri = {
+        .uri      = "/api/networks",
+        .method   = HTTP_GET,
+        .handler  = networks_handler,
+        .user_ctx = NULL
+    },
+    .async = false
+};
+
+/* Route for POST /api/credentials, commits to flash when provisioned already */
+http_route_t route_credentials = {
+    .uri = {
+        .uri      = "/api/credentials",
+        .method   = HTTP_POST,
+        .handler  = credentials_handler,
+        .user_ctx = NULL
+    },
+    .async = true
+};
+
+/* Route for POST /uri, waits for the network to take the credentials */
+http_route_t route_post = {
+    .uri = {
+        .uri      = "/results.html",
+        .method   = HTTP_POST,
+        .handler  = post_handler,
+        .user_ctx = NULL
+    },
+    .async = true
+};
+
+/* Route for GET /api/provisioning */
+http_route_t route_provisioning = {
+    .uri = {
+        .uri      = "/api/provisioning",
+        .method   = HTTP_GET,
+        .handler  = provisioning_handler,
+        .user_ctx = NULL
+    },
+    .async = false
+};
+
+/* Route for GET /api/stats */
+http_route_t route_stats = {
+    .uri = {
+        .uri      = "/api/stats",
+        .method   = HTTP_GET,
+        .handler  = http_workers_stats_handler,
+        .user_ctx = NULL
+    },
+    .async = false
 };
 
 /* Function for starting the webserver */
@@ -146,15 +353,34 @@ httpd_handle_t start_webserver(void)
 {
     /* Generate default configuration */
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    http_workers_config(&config);
+    /* The routes, the stats, the WebSocket and the static assets */
+    config.max_uri_handlers = 14;
 
     /* Empty handle to esp_http_server */
     httpd_handle_t server = NULL;
+    s_boot_tag = esp_random();
+
+    /* The slow handlers run on the workers */
+    if (http_workers_start() != ESP_OK) {
+        return NULL;
+    }
 
     /* Start the httpd server */
     if (httpd_start(&server, &config) == ESP_OK) {
         /* Register URI handlers */
-        httpd_register_uri_handler(server, &uri_get);
-        httpd_register_uri_handler(server, &uri_post);
+        http_workers_register(server, &route_get);
+        http_workers_register(server, &route_post);
+        http_workers_register(server, &route_networks);
+        http_workers_register(server, &route_credentials);
+        http_workers_register(server, &route_provisioning);
+        http_workers_register(server, &route_stats);
+        /* Anything else leads to the page while the AP runs */
+        captive_portal_register(server);
+        /* Pushes the scan and provisioning progress to the page */
+        ws_progress_register(server);
+        /* The style sheet and the script, /index.html is handled above */
+        static_assets_register(server);
     }
     /* If server failed to start, handle will be NULL */
     return server;
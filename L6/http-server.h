@@ -2,7 +2,5 @@
 #define _HTTP_S_H_
 
 httpd_handle_t start_webserver(void);
-char* get_ssid_list();
-void set_size_ssid(size_t size);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,193 @@
+#include "http-workers.h"
+
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "http_workers";
+
+/* Upper bounds of the buckets, the last one takes the rest */
+static const uint16_t s_bounds_ms[HTTP_WORKERS_BUCKETS - 1] = {1, 2, 5, 10, 20, 50, 100, 200, 500, 1000};
+
+typedef struct {
+    httpd_req_t *req;           /* the copy from httpd_req_async_handler_begin() */
+    http_route_t *route;
+    int64_t start_us;
+} http_work_t;
+
+static QueueHandle_t s_queue;
+static SemaphoreHandle_t s_lock;
+static http_route_t *s_routes[HTTP_WORKERS_ROUTES_MAX];
+static size_t s_route_count;
+
+static void record(http_route_t *route, int64_t start_us)
+{
+    uint32_t us = esp_timer_get_time() - start_us;
+    size_t bucket = 0;
+    while (bucket < HTTP_WORKERS_BUCKETS - 1 && us > s_bounds_ms[bucket] * 1000u) {
+        bucket++;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    http_latency_t *latency = &route->latency;
+    latency->count++;
+    latency->total_us += us;
+    if (us > latency->max_us) {
+        latency->max_us = us;
+    }
+    latency->buckets[bucket]++;
+    xSemaphoreGive(s_lock);
+}
+
+static void worker_task(void *pvParameters)
+{
+    http_work_t work;
+
+    while (1) {
+        xQueueReceive(s_queue, &work, portMAX_DELAY);
+
+        work.req->user_ctx = work.route->uri.user_ctx;
+        esp_err_t err = work.route->uri.handler(work.req);
+        record(work.route, work.start_us);
+        if (err != ESP_OK) {
+            // as the server does when a handler fails on its own task
+            httpd_sess_trigger_close(work.req->handle, httpd_req_to_sockfd(work.req));
+        }
+        httpd_req_async_handler_complete(work.req);
+    }
+}
+
+static esp_err_t dispatch(httpd_req_t *req)
+{
+    http_route_t *route = req->user_ctx;
+    int64_t start_us = esp_timer_get_time();
+
+    if (!route->async) {
+        req->user_ctx = route->uri.user_ctx;
+        esp_err_t err = route->uri.handler(req);
+        record(route, start_us);
+        return err;
+    }
+
+    // Only this task queues, the space cannot go away before the send
+    if (uxQueueSpacesAvailable(s_queue) == 0) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        route->latency.rejected++;
+        xSemaphoreGive(s_lock);
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "1");
+        return httpd_resp_sendstr(req, "Busy, try again");
+    }
+
+    http_work_t work = {
+        .route = route,
+        .start_us = start_us,
+    };
+    esp_err_t err = httpd_req_async_handler_begin(req, &work.req);
+    if (err != ESP_OK) {
+        return err;
+    }
+    xQueueSend(s_queue, &work, portMAX_DELAY);
+    return ESP_OK;
+}
+
+void http_workers_config(httpd_config_t *config)
+{
+    if (config->max_open_sockets < HTTP_WORKERS_COUNT + HTTP_WORKERS_QUEUE_LEN + 1) {
+        config->max_open_sockets = HTTP_WORKERS_COUNT + HTTP_WORKERS_QUEUE_LEN + 1;
+    }
+    config->lru_purge_enable = true;
+}
+
+esp_err_t http_workers_start(void)
+{
+    if (s_queue != NULL) {
+        return ESP_OK;
+    }
+    s_queue = xQueueCreate(HTTP_WORKERS_QUEUE_LEN, sizeof(http_work_t));
+    s_lock = xSemaphoreCreateMutex();
+    if (s_queue == NULL || s_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (int i = 0; i < HTTP_WORKERS_COUNT; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "http_worker%d", i);
+        if (xTaskCreate(worker_task, name, HTTP_WORKERS_STACK_SIZE, NULL, 5, NULL) != pdPASS) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t http_workers_register(httpd_handle_t server, http_route_t *route)
+{
+    httpd_uri_t uri = route->uri;
+    uri.handler = dispatch;
+    uri.user_ctx = route;
+    esp_err_t err = httpd_register_uri_handler(server, &uri);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "%s not registered: %s", route->uri.uri, esp_err_to_name(err));
+        return err;
+    }
+
+    // Registered again after a restart of the server
+    for (size_t i = 0; i < s_route_count; i++) {
+        if (s_routes[i] == route) {
+            return ESP_OK;
+        }
+    }
+    if (s_route_count < HTTP_WORKERS_ROUTES_MAX) {
+        s_routes[s_route_count++] = route;
+    }
+    return ESP_OK;
+}
+
+esp_err_t http_workers_stats_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    // room for a route with every count at its widest
+    char line[384];
+    int len = snprintf(line, sizeof(line), "{\"workers\":%d,\"queued\":%u,\"bounds_ms\":[", HTTP_WORKERS_COUNT,
+                       (unsigned)uxQueueMessagesWaiting(s_queue));
+    for (size_t i = 0; i < HTTP_WORKERS_BUCKETS - 1; i++) {
+        len += snprintf(line + len, sizeof(line) - len, "%s%u", i ? "," : "", s_bounds_ms[i]);
+    }
+    snprintf(line + len, sizeof(line) - len, "],\"routes\":[");
+    if (httpd_resp_send_chunk(req, line, HTTPD_RESP_USE_STRLEN) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    for (size_t r = 0; r < s_route_count; r++) {
+        const http_route_t *route = s_routes[r];
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        http_latency_t latency = route->latency;
+        xSemaphoreGive(s_lock);
+
+        uint32_t mean_us = latency.count ? latency.total_us / latency.count : 0;
+        len = snprintf(line, sizeof(line),
+                       "%s{\"uri\":\"%s\",\"method\":\"%s\",\"async\":%s,\"count\":%lu,\"rejected\":%lu,"
+                       "\"mean_us\":%lu,\"max_us\":%lu,\"buckets\":[",
+                       r ? "," : "", route->uri.uri, http_method_str(route->uri.method),
+                       route->async ? "true" : "false", (unsigned long)latency.count,
+                       (unsigned long)latency.rejected, (unsigned long)mean_us, (unsigned long)latency.max_us);
+        for (size_t i = 0; i < HTTP_WORKERS_BUCKETS; i++) {
+            len += snprintf(line + len, sizeof(line) - len, "%s%lu", i ? "," : "",
+                            (unsigned long)latency.buckets[i]);
+        }
+        snprintf(line + len, sizeof(line) - len, "]}");
+        if (httpd_resp_send_chunk(req, line, HTTPD_RESP_USE_STRLEN) != ESP_OK) {
+            return ESP_FAIL;
+        }
+    }
+
+    if (httpd_resp_send_chunk(req, "]}", HTTPD_RESP_USE_STRLEN) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
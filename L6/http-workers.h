@@ -0,0 +1,50 @@
+#ifndef _HTTP_WORKERS_H_
+#define _HTTP_WORKERS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+/* Handlers that write to flash, restart the board or send a whole page
+ * to a slow client run on a few worker tasks, so the server task keeps
+ * accepting and answering the quick requests meanwhile. The request is
+ * handed over with httpd_req_async_handler_begin(); when every worker is
+ * busy and the queue is full the client gets 503 at once.
+ *
+ * Each route counts its latency, from the server task taking the request
+ * to the end of the handler (the wait in the queue included), in buckets
+ * up to 1, 2, 5, ... 1000 ms and one above. */
+#define HTTP_WORKERS_COUNT      2
+#define HTTP_WORKERS_QUEUE_LEN  3
+#define HTTP_WORKERS_STACK_SIZE 4096
+#define HTTP_WORKERS_BUCKETS    11
+#define HTTP_WORKERS_ROUTES_MAX 12
+
+typedef struct {
+    uint32_t count;
+    uint32_t rejected;          /* 503, no worker free */
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t buckets[HTTP_WORKERS_BUCKETS];
+} http_latency_t;
+
+typedef struct {
+    httpd_uri_t uri;            /* handler and user_ctx as without the pool */
+    bool async;                 /* run on a worker */
+    http_latency_t latency;
+} http_route_t;
+
+/* A socket for each request a worker holds, and idle clients give way */
+void http_workers_config(httpd_config_t *config);
+
+/* Starts the workers, before the routes are registered */
+esp_err_t http_workers_start(void);
+
+/* Registers route->uri behind the pool and the latency count */
+esp_err_t http_workers_register(httpd_handle_t server, http_route_t *route);
+
+/* GET handler listing the routes with their latency as JSON */
+esp_err_t http_workers_stats_handler(httpd_req_t *req);
+
+#endif
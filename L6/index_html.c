@@ -1,5 +1,11 @@
 #include "index_html.h"
+#include <stdio.h>
 #include <string.h>
+#include <stdbool.h>
+
+/* The page is collected in a buffer of this size and sent a chunk at a
+ * time */
+#define INDEX_HTML_CHUNK_SIZE 512
 
 const char part1[] = R""""(<html>
 <body>
@@ -17,17 +23,145 @@ const char part2[] = R""""(</select>
 </body>
 </html>)"""";
 
-void set_index_html_content(char* buffer, const char* ssid_list, int ssid_count) {
-	// Copy first part of the HTML page
-	strcpy(buffer, part1);
+typedef struct {
+	httpd_req_t *req;
+	char buf[INDEX_HTML_CHUNK_SIZE];
+	size_t len;
+	esp_err_t err;
+} html_writer_t;
+
+static void html_flush(html_writer_t *w) {
+	if (w->len > 0 && w->err == ESP_OK) {
+		w->err = httpd_resp_send_chunk(w->req, w->buf, w->len);
+	}
+	w->len = 0;
+}
+
+static void html_put(html_writer_t *w, const char *text, size_t len) {
+	while (len > 0) {
+		if (w->len == sizeof(w->buf)) {
+			html_flush(w);
+		}
+		size_t room = sizeof(w->buf) - w->len;
+		size_t n = len < room ? len : room;
+		memcpy(w->buf + w->len, text, n);
+		w->len += n;
+		text += n;
+		len -= n;
+	}
+}
+
+static inline bool html_special(char c) {
+	return c == '&' || c == '<' || c == '>' || c == '"' || c == '\'';
+}
+
+// An SSID is any 32 bytes, it must not be able to close the tag
+static void html_put_escaped(html_writer_t *w, const char *text, size_t len) {
+	while (len > 0) {
+		size_t plain = 0;
+		while (plain < len && !html_special(text[plain])) {
+			plain++;
+		}
+		html_put(w, text, plain);
+		text += plain;
+		len -= plain;
+		if (len == 0) {
+			break;
+		}
+		switch (*text) {
+		case '&': html_put(w, "&amp;", 5); break;
+		case '<': html_put(w, "&lt;", 4); break;
+		case '>': html_put(w, "&gt;", 4); break;
+		case '"': html_put(w, "&quot;", 6); break;
+		default: html_put(w, "&#39;", 5); break;
+		}
+		text++;
+		len--;
+	}
+}
+
+esp_err_t send_index_html(httpd_req_t *req, const char* ssid_list, int ssid_count) {
+	html_writer_t w = { .req = req, .len = 0, .err = ESP_OK };
+
+	html_put(&w, part1, sizeof(part1) - 1);
 	int i = 0;
 	for (i = 0; i < ssid_count; i++) {
-		strcat(buffer, "<option value=\"");
-		strcat(buffer, ssid_list + i * 33);
-		strcat(buffer, "\">");
-		strcat(buffer, ssid_list + i * 33);
-		strcat(buffer, "</option>");
-	}
-	// Copy second part of the HTML page
-	strcat(buffer, part2);
+		const char *ssid = ssid_list + i * 33;
+		size_t len = strnlen(ssid, 32);
+		html_put(&w, "<option value=\"", 15);
+		html_put_escaped(&w, ssid, len);
+		html_put(&w, "\">", 2);
+		html_put_escaped(&w, ssid, len);
+		html_put(&w, "</option>", 9);
+	}
+	html_put(&w, part2, sizeof(part2) - 1);
+	html_flush(&w);
+	// The empty chunk ends the response
+	if (w.err == ESP_OK) {
+		w.err = httpd_resp_send_chunk(req, NULL, 0);
+	}
+	return w.err;
+}
+
+static inline bool json_special(char c) {
+	return c == '"' || c == '\\' || (unsigned char)c < 0x20;
+}
+
+static void json_put_escaped(html_writer_t *w, const char *text, size_t len) {
+	while (len > 0) {
+		size_t plain = 0;
+		while (plain < len && !json_special(text[plain])) {
+			plain++;
+		}
+		html_put(w, text, plain);
+		text += plain;
+		len -= plain;
+		if (len == 0) {
+			break;
+		}
+		char escaped[8];
+		int n = *text == '"' || *text == '\\' ? snprintf(escaped, sizeof(escaped), "\\%c", *text)
+		                                      : snprintf(escaped, sizeof(escaped), "\\u%04x", *text);
+		html_put(w, escaped, n);
+		text++;
+		len--;
+	}
+}
+
+size_t json_escape(char *out, size_t size, const char *text) {
+	size_t len = 0;
+	for (; *text != '\0' && len + 7 < size; text++) {
+		if (!json_special(*text)) {
+			out[len++] = *text;
+		} else if (*text == '"' || *text == '\\') {
+			out[len++] = '\\';
+			out[len++] = *text;
+		} else {
+			len += snprintf(out + len, size - len, "\\u%04x", *text);
+		}
+	}
+	out[len] = '\0';
+	return len;
+}
+
+esp_err_t send_networks_json(httpd_req_t *req, const char* ssid_list, int ssid_count) {
+	html_writer_t w = { .req = req, .len = 0, .err = ESP_OK };
+
+	httpd_resp_set_type(req, "application/json");
+	html_put(&w, "[", 1);
+	int i = 0;
+	for (i = 0; i < ssid_count; i++) {
+		if (i > 0) {
+			html_put(&w, ",", 1);
+		}
+		html_put(&w, "\"", 1);
+		json_put_escaped(&w, ssid_list + i * 33, strnlen(ssid_list + i * 33, 32));
+		html_put(&w, "\"", 1);
+	}
+	html_put(&w, "]", 1);
+	html_flush(&w);
+	if (w.err == ESP_OK) {
+		w.err = httpd_resp_send_chunk(req, NULL, 0);
+	}
+	return w.err;
 }
\ No newline at end of file
@@ -1,6 +1,19 @@
 #ifndef _INDEX_HTML_H_
 #define _INDEX_HTML_H_
 
-void set_index_html_content(char buffer[], const char* ssid_list, int ssid_count);
+#include "esp_http_server.h"
+
+/* Sends the page with one <option> per SSID as a chunked response.
+ * ssid_list holds ssid_count entries of 33 bytes. */
+esp_err_t send_index_html(httpd_req_t *req, const char* ssid_list, int ssid_count);
+
+/* Sends the SSIDs as a JSON array of strings, for the page in flash.
+ * Caching headers are up to the caller. */
+esp_err_t send_networks_json(httpd_req_t *req, const char* ssid_list, int ssid_count);
+
+/* Writes text into out as the inside of a JSON string, cut short rather
+ * than overflowing; 6 * strlen(text) + 1 bytes always take all of it.
+ * Returns the length written. */
+size_t json_escape(char *out, size_t size, const char *text);
 
 #endif
\ No newline at end of file
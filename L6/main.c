@@ -27,11 +27,13 @@
 
 #include "soft-ap.h"
 #include "sta-ap.h"
+#include "net-config.h"
 #include "http-server.h"
+#include "wifi-scanner.h"
 
 #include "../mdns/include/mdns.h"
+#include "../common/boot-prof.h"
 
-static const char *TAG_SCAN = "scan";
 static const char *TAG = "main";
 
 void start_mdns_service()
@@ -57,63 +59,16 @@ static void mdns_task(void *pvParameters)
     vTaskDelete(NULL);
 }
 
-void ssid_scan_task() {
-  char* ssid_list = get_ssid_list();
-  ESP_ERROR_CHECK(esp_netif_init());
-  esp_netif_t *sta_netif = esp_netif_create_default_wifi_sta();
-  assert(sta_netif);
-
-  wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-  ESP_ERROR_CHECK(esp_wifi_init(&cfg));
-
-  uint16_t number = CONFIG_EXAMPLE_SCAN_LIST_SIZE;
-  wifi_ap_record_t ap_info[CONFIG_EXAMPLE_SCAN_LIST_SIZE];
-  uint16_t ap_count = 0;
-  memset(ap_info, 0, sizeof(ap_info));
-
-  ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-  ESP_ERROR_CHECK(esp_wifi_start());
-  esp_wifi_scan_start(NULL, true);
-  ESP_LOGI(TAG_SCAN, "Max AP number ap_info can hold = %u", number);
-  ESP_ERROR_CHECK(esp_wifi_scan_get_ap_num(&ap_count));
-  ESP_ERROR_CHECK(esp_wifi_scan_get_ap_records(&number, ap_info));
-  
-  set_size_ssid(ap_count);
-  ESP_LOGI(TAG_SCAN, "Total APs scanned = %u %u", ap_count, number);
-
-  for (int i = 0; (i < CONFIG_EXAMPLE_SCAN_LIST_SIZE) && (i < ap_count); i++) {
-    memcpy(ssid_list + 33 * i, ap_info[i].ssid, sizeof(ap_info[i].ssid));
-    ESP_LOGI(TAG_SCAN, "SSID %d: %s", i, ap_info[i].ssid);
-  }
-}
-
 void btn_long_press_cb(void* arg, void* user_data)
 {
   // Reset the WiFi configuration (NVS)
-  nvs_handle_t nvs_handle;
-  esp_err_t ret = nvs_open("storage", NVS_READWRITE, &nvs_handle);
+  esp_err_t ret = net_config_erase();
   if (ret == ESP_OK) {
-    ret = nvs_erase_key(nvs_handle, "ssid");
-    if (ret != ESP_OK) {
-      ESP_LOGE(TAG, "SSID erase failed %d", ret);
-    }
-
-    ret = nvs_erase_key(nvs_handle, "password");
-    if (ret != ESP_OK) {
-      ESP_LOGE(TAG, "Password erase failed %d", ret);
-    }
-
-    ret = nvs_commit(nvs_handle);
-    if (ret != ESP_OK) {
-      ESP_LOGE(TAG, "Commit erase failed %d", ret);
-    }
-
-    nvs_close(nvs_handle);
     ESP_LOGI(TAG, "NVS erase done. Restarting...");
-    
+
     esp_restart();
   } else {
-    ESP_LOGE(TAG, "NVS open failed %d", ret);
+    ESP_LOGE(TAG, "NVS erase failed %d", ret);
   }
 }
 
@@ -134,10 +89,13 @@ void init_button()
 
   iot_button_register_cb(btn, BUTTON_LONG_PRESS_START, &args, btn_long_press_cb, NULL);
   ESP_LOGI(TAG, "Button init done");
+  boot_prof_mark(BOOT_PHASE_GPIO_READY);
 }
 
 void app_main(void)
 {
+  boot_prof_mark(BOOT_PHASE_APP_MAIN);
+
   //Initialize NVS
   esp_err_t ret = nvs_flash_init();
   if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
@@ -145,54 +103,44 @@ void app_main(void)
     ret = nvs_flash_init();
   }
   ESP_ERROR_CHECK(ret);
+  boot_prof_mark(BOOT_PHASE_NVS_READY);
   ESP_ERROR_CHECK(esp_event_loop_create_default());
 
-  // TODO: 3. SSID scanning in STA mode
-  ssid_scan_task();
+  ESP_ERROR_CHECK(esp_netif_init());
 
-  // Read the configuration from NVS
-  nvs_handle_t nvs_handle;
-  ret = nvs_open("storage", NVS_READWRITE, &nvs_handle);
-  if (ret == ESP_OK) {
-    bool flag = true;
-    char ssid[33];
-    char password[65];
-
-    size_t length = 33;
-    ret = nvs_get_str(nvs_handle, "ssid", NULL, &length);
-    if (ret != ESP_OK)
-    {
-      flag = false;
-      ESP_LOGI(TAG, "SSID not found %d", ret);
-    }
+  // TODO: 3. SSID scanning in STA mode
+  // The networks are scanned in the background once the Wi-Fi runs, in
+  // either mode, and the AP does not wait for them
+  ESP_ERROR_CHECK(wifi_scanner_start());
 
-    ssid[length - 1] = '\0';
+#if CONFIG_FAST_BOOT
+  // The TCP/IP stack is up, mDNS and the server do not need
+  // the link, so they start while the STA is still connecting
+  xTaskCreate(&mdns_task, "mdns_task", 4096, NULL, 5, NULL);
+  start_webserver();
+  boot_prof_mark(BOOT_PHASE_TASKS_STARTED);
+#endif
 
-    length = 65;
-    ret = nvs_get_str(nvs_handle, "password", password, &length);
-    if (ret != ESP_OK) {
-      flag = false;
-      ESP_LOGI(TAG, "Password not found %d", ret);
-    }
-    password[length - 1] = '\0';
-
-    if (flag) {
-      init_button();
-      // Init the WiFi in STA mode
-      sta_set_ssid(ssid);
-      sta_set_password(password);
-      wifi_init_sta();
-    } else {
-      wifi_init_softap(true);
-    }
+  // Read the configuration from NVS
+  net_config_t config;
+  ret = net_config_load(&config);
+  // Also while provisioning, the board goes on as a station without a restart
+  init_button();
+  if (ret == ESP_OK && config.ssid[0] != '\0') {
+    // Init the WiFi in STA mode
+    sta_set_config(&config);
+    wifi_init_sta();
   } else {
-    ESP_LOGI(TAG, "NVS not found %d", ret);
+    ESP_LOGI(TAG, "No network configured (%s)", esp_err_to_name(ret));
     wifi_init_softap(true);
   }
 
+#if !CONFIG_FAST_BOOT
   // TODO: 4. mDNS init (if there is time left)
   xTaskCreate(&mdns_task, "mdns_task", 4096, NULL, 5, NULL);
 
   // TODO: 2. Start the web server
   start_webserver();
+  boot_prof_mark(BOOT_PHASE_TASKS_STARTED);
+#endif
 }
\ No newline at end of file
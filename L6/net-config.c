@@ -0,0 +1,110 @@
+#include "net-config.h"
+
+#include <stddef.h>
+#include <string.h>
+#include "nvs.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+
+static const char *TAG = "net_config";
+
+static uint32_t config_crc(const net_config_t *config)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)config, offsetof(net_config_t, crc));
+}
+
+/* Firmware before the record kept the credentials as two strings */
+static esp_err_t load_legacy(nvs_handle_t handle, net_config_t *config)
+{
+    memset(config, 0, sizeof(*config));
+    size_t length = sizeof(config->ssid);
+    esp_err_t err = nvs_get_str(handle, "ssid", config->ssid, &length);
+    if (err != ESP_OK) {
+        return err;
+    }
+    length = sizeof(config->password);
+    return nvs_get_str(handle, "password", config->password, &length);
+}
+
+esp_err_t net_config_load(net_config_t *config)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NET_CONFIG_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err == ESP_ERR_NVS_NOT_FOUND ? ESP_ERR_NOT_FOUND : err;
+    }
+
+    size_t len = sizeof(*config);
+    err = nvs_get_blob(handle, NET_CONFIG_KEY, config, &len);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        err = load_legacy(handle, config);
+        if (err == ESP_OK) {
+            ESP_LOGI(TAG, "Moving the credentials into the record");
+            err = net_config_save(config);
+            if (err == ESP_OK) {
+                nvs_erase_key(handle, "ssid");
+                nvs_erase_key(handle, "password");
+                nvs_commit(handle);
+            }
+        }
+        nvs_close(handle);
+        return err == ESP_ERR_NVS_NOT_FOUND ? ESP_ERR_NOT_FOUND : err;
+    }
+    nvs_close(handle);
+    if (err != ESP_OK) {
+        // a blob longer than the record
+        return err == ESP_ERR_NVS_INVALID_LENGTH ? ESP_ERR_INVALID_VERSION : err;
+    }
+
+    if (len != sizeof(*config) || config->version != NET_CONFIG_VERSION) {
+        ESP_LOGW(TAG, "Record of another version");
+        return ESP_ERR_INVALID_VERSION;
+    }
+    if (config->crc != config_crc(config)) {
+        ESP_LOGW(TAG, "Record damaged");
+        return ESP_ERR_INVALID_CRC;
+    }
+    // A factory image is trusted as little as a damaged record
+    config->ssid[sizeof(config->ssid) - 1] = '\0';
+    config->password[sizeof(config->password) - 1] = '\0';
+    return ESP_OK;
+}
+
+esp_err_t net_config_save(net_config_t *config)
+{
+    config->version = NET_CONFIG_VERSION;
+    config->crc = config_crc(config);
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NET_CONFIG_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_blob(handle, NET_CONFIG_KEY, config, sizeof(*config));
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Saving failed: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+esp_err_t net_config_erase(void)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NET_CONFIG_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_erase_key(handle, NET_CONFIG_KEY);
+    // and what older firmware left
+    nvs_erase_key(handle, "ssid");
+    nvs_erase_key(handle, "password");
+    if (err == ESP_OK || err == ESP_ERR_NVS_NOT_FOUND) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return err;
+}
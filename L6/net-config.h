@@ -0,0 +1,54 @@
+#ifndef _NET_CONFIG_H_
+#define _NET_CONFIG_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/* Everything the station needs to join its network, kept as one NVS blob
+ * that is read and written whole and checked by a CRC. tools/gen-nvs.py
+ * writes the same record into partition images for factory flashing, so
+ * the layout is fixed: packed, little endian, addresses as their four
+ * bytes in network order (as esp_ip4_addr_t holds them). */
+#define NET_CONFIG_VERSION   1
+#define NET_CONFIG_NAMESPACE "storage"
+#define NET_CONFIG_KEY       "net_config"
+
+/* bssid and channel are those of the AP of the last connection */
+#define NET_CONFIG_FLAG_AP_CACHED     0x01
+/* ip to dns are the last DHCP lease, reused for lease_boots more boots */
+#define NET_CONFIG_FLAG_LEASE_CACHED  0x02
+/* ip to dns are a fixed address, DHCP never runs */
+#define NET_CONFIG_FLAG_STATIC_IP     0x04
+
+/* The lease has no expiry we could check, nothing tells how long the
+ * board was off; after this many boots DHCP runs again */
+#define NET_CONFIG_LEASE_BOOTS 8
+
+typedef struct __attribute__((packed)) {
+    uint8_t version;
+    uint8_t flags;
+    uint8_t channel;
+    uint8_t lease_boots;
+    char ssid[33];
+    char password[65];
+    uint8_t bssid[6];
+    uint32_t ip;
+    uint32_t netmask;
+    uint32_t gw;
+    uint32_t dns;
+    uint32_t crc;               /* CRC-32 of the bytes before it */
+} net_config_t;
+
+_Static_assert(sizeof(net_config_t) == 128, "net_config_t is flashed by tools/gen-nvs.py");
+
+/* ESP_ERR_NOT_FOUND when nothing is stored, ESP_ERR_INVALID_CRC or
+ * ESP_ERR_INVALID_VERSION when the record cannot be used. The ssid and
+ * password strings of older firmware are moved into the record. */
+esp_err_t net_config_load(net_config_t *config);
+
+/* Fills in version and crc */
+esp_err_t net_config_save(net_config_t *config);
+
+esp_err_t net_config_erase(void);
+
+#endif
@@ -0,0 +1,280 @@
+#include "provision.h"
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "esp_wifi.h"
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "net-config.h"
+#include "wifi-scanner.h"
+
+#define PROVISION_DONE_BIT BIT0
+
+ESP_EVENT_DEFINE_BASE(PROVISION_EVENT);
+
+static const char *TAG = "provision";
+
+static SemaphoreHandle_t s_lock;
+static EventGroupHandle_t s_events;
+static esp_timer_handle_t s_timeout_timer;
+static esp_timer_handle_t s_linger_timer;
+
+/* Under s_lock */
+static provision_status_t s_status;
+static char s_password[65];
+static int s_attempts;
+static int64_t s_started_us;
+
+/* Called with s_lock taken, the handlers run later on the event loop */
+static void post_event(provision_event_t event, uint8_t reason)
+{
+    provision_event_data_t data = {
+        .attempt = s_attempts + 1,
+        .reason = reason,
+    };
+    esp_event_post(PROVISION_EVENT, event, &data, sizeof(data), 0);
+}
+
+static const char *disconnect_error(uint8_t reason)
+{
+    switch (reason) {
+    case WIFI_REASON_NO_AP_FOUND:
+        return "Network not found";
+    case WIFI_REASON_AUTH_FAIL:
+    case WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT:
+    case WIFI_REASON_HANDSHAKE_TIMEOUT:
+    case WIFI_REASON_MIC_FAILURE:
+        return "Wrong security key";
+    case WIFI_REASON_ASSOC_FAIL:
+    case WIFI_REASON_AUTH_EXPIRE:
+        return "The network refused the board";
+    default:
+        return "Could not join the network";
+    }
+}
+
+/* Called with s_lock taken */
+static void finish(provision_state_t state, const char *error)
+{
+    s_status.state = state;
+    s_status.error = error;
+    s_status.elapsed_ms = (esp_timer_get_time() - s_started_us) / 1000;
+    esp_timer_stop(s_timeout_timer);
+    xEventGroupSetBits(s_events, PROVISION_DONE_BIT);
+
+    post_event(state == PROVISION_CONNECTED ? PROVISION_EVENT_CONNECTED : PROVISION_EVENT_FAILED, 0);
+    if (state == PROVISION_CONNECTED) {
+        ESP_LOGI(TAG, "%s joined in %lu ms, " IPSTR, s_status.ssid, (unsigned long)s_status.elapsed_ms,
+                 IP2STR(&s_status.ip));
+        esp_timer_start_once(s_linger_timer, PROVISION_AP_LINGER_MS * 1000ULL);
+    } else {
+        ESP_LOGI(TAG, "%s failed: %s", s_status.ssid, error);
+        esp_wifi_disconnect();
+    }
+    wifi_scanner_pause(false);
+}
+
+/* What the test found is what the next boot connects with */
+static esp_err_t save(const ip_event_got_ip_t *event)
+{
+    net_config_t config = {0};
+    strlcpy(config.ssid, s_status.ssid, sizeof(config.ssid));
+    strlcpy(config.password, s_password, sizeof(config.password));
+
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+        memcpy(config.bssid, ap.bssid, sizeof(config.bssid));
+        config.channel = ap.primary;
+        config.flags |= NET_CONFIG_FLAG_AP_CACHED;
+    }
+    config.ip = event->ip_info.ip.addr;
+    config.netmask = event->ip_info.netmask.addr;
+    config.gw = event->ip_info.gw.addr;
+    config.dns = event->ip_info.gw.addr;
+    esp_netif_dns_info_t dns;
+    if (esp_netif_get_dns_info(event->esp_netif, ESP_NETIF_DNS_MAIN, &dns) == ESP_OK &&
+        dns.ip.type == ESP_IPADDR_TYPE_V4) {
+        config.dns = dns.ip.u_addr.ip4.addr;
+    }
+    config.flags |= NET_CONFIG_FLAG_LEASE_CACHED;
+    config.lease_boots = NET_CONFIG_LEASE_BOOTS;
+    esp_err_t err = net_config_save(&config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Saving the network failed: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+static void event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
+        wifi_event_sta_disconnected_t *event = event_data;
+        if (event->reason == WIFI_REASON_ASSOC_LEAVE) {
+            // left on purpose by esp_wifi_disconnect()
+        } else if (s_status.state == PROVISION_TESTING) {
+            if (s_attempts + 1 < PROVISION_ATTEMPTS) {
+                ESP_LOGI(TAG, "Attempt %d failed, reason %u", s_attempts + 1, event->reason);
+                post_event(PROVISION_EVENT_ATTEMPT_FAILED, event->reason);
+                s_attempts++;
+                post_event(PROVISION_EVENT_ATTEMPT, 0);
+                esp_wifi_connect();
+            } else {
+                finish(PROVISION_FAILED, disconnect_error(event->reason));
+            }
+        } else if (s_status.state == PROVISION_CONNECTED) {
+            // the board runs on this network now
+            esp_wifi_connect();
+        }
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        if (s_status.state == PROVISION_TESTING) {
+            post_event(PROVISION_EVENT_ASSOCIATED, 0);
+        }
+    } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
+        ip_event_got_ip_t *event = event_data;
+        if (s_status.state == PROVISION_TESTING) {
+            s_status.ip = event->ip_info.ip;
+            // Joined, but the next boot would not know the network
+            if (save(event) != ESP_OK) {
+                finish(PROVISION_FAILED, "Saving failed");
+            } else {
+                finish(PROVISION_CONNECTED, NULL);
+            }
+        }
+    }
+    xSemaphoreGive(s_lock);
+}
+
+static void timeout_cb(void *arg)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_status.state == PROVISION_TESTING) {
+        finish(PROVISION_FAILED, "No answer from the network");
+    }
+    xSemaphoreGive(s_lock);
+}
+
+/* The browser had its answer, the AP goes away */
+static void linger_cb(void *arg)
+{
+    ESP_LOGI(TAG, "Provisioned, stopping the AP");
+    esp_wifi_set_mode(WIFI_MODE_STA);
+}
+
+esp_err_t provision_init(void)
+{
+    if (s_lock != NULL) {
+        return ESP_OK;
+    }
+    s_lock = xSemaphoreCreateMutex();
+    s_events = xEventGroupCreate();
+    if (s_lock == NULL || s_events == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    const esp_timer_create_args_t timeout_args = {
+        .callback = timeout_cb,
+        .name = "provision_timeout",
+    };
+    const esp_timer_create_args_t linger_args = {
+        .callback = linger_cb,
+        .name = "provision_linger",
+    };
+    esp_err_t err = esp_timer_create(&timeout_args, &s_timeout_timer);
+    if (err == ESP_OK) {
+        err = esp_timer_create(&linger_args, &s_linger_timer);
+    }
+    if (err == ESP_OK) {
+        err = esp_event_handler_instance_register(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &event_handler, NULL,
+                                                  NULL);
+    }
+    if (err == ESP_OK) {
+        err = esp_event_handler_instance_register(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, &event_handler, NULL,
+                                                  NULL);
+    }
+    if (err == ESP_OK) {
+        err = esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &event_handler, NULL, NULL);
+    }
+    return err;
+}
+
+esp_err_t provision_start(const char *ssid, const char *password)
+{
+    wifi_mode_t mode;
+    if (s_lock == NULL || esp_wifi_get_mode(&mode) != ESP_OK || mode != WIFI_MODE_APSTA) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_status.state == PROVISION_TESTING || s_status.state == PROVISION_CONNECTED) {
+        xSemaphoreGive(s_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    memset(&s_status, 0, sizeof(s_status));
+    s_status.state = PROVISION_TESTING;
+    strlcpy(s_status.ssid, ssid, sizeof(s_status.ssid));
+    strlcpy(s_password, password, sizeof(s_password));
+    s_attempts = 0;
+    s_started_us = esp_timer_get_time();
+    xEventGroupClearBits(s_events, PROVISION_DONE_BIT);
+
+    // The radio stays on the network being joined
+    wifi_scanner_pause(true);
+    esp_wifi_disconnect();
+
+    wifi_config_t wifi_config = {0};
+    strlcpy((char *)wifi_config.sta.ssid, ssid, sizeof(wifi_config.sta.ssid));
+    strlcpy((char *)wifi_config.sta.password, password, sizeof(wifi_config.sta.password));
+    esp_err_t err = esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+    if (err == ESP_OK) {
+        err = esp_wifi_connect();
+    }
+    if (err != ESP_OK) {
+        finish(PROVISION_FAILED, "Could not start the station");
+    } else {
+        esp_timer_start_once(s_timeout_timer, PROVISION_TIMEOUT_MS * 1000ULL);
+        post_event(PROVISION_EVENT_ATTEMPT, 0);
+        ESP_LOGI(TAG, "Testing %s", ssid);
+    }
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
+
+void provision_get_status(provision_status_t *status)
+{
+    if (s_lock == NULL) {
+        memset(status, 0, sizeof(*status));
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *status = s_status;
+    if (status->state == PROVISION_TESTING) {
+        status->elapsed_ms = (esp_timer_get_time() - s_started_us) / 1000;
+    }
+    xSemaphoreGive(s_lock);
+}
+
+provision_state_t provision_wait(uint32_t timeout_ms)
+{
+    xEventGroupWaitBits(s_events, PROVISION_DONE_BIT, pdFALSE, pdTRUE, pdMS_TO_TICKS(timeout_ms));
+    provision_status_t status;
+    provision_get_status(&status);
+    return status.state;
+}
+
+const char *provision_state_name(provision_state_t state)
+{
+    switch (state) {
+    case PROVISION_TESTING:
+        return "testing";
+    case PROVISION_CONNECTED:
+        return "connected";
+    case PROVISION_FAILED:
+        return "failed";
+    default:
+        return "idle";
+    }
+}
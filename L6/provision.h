@@ -0,0 +1,67 @@
+#ifndef _PROVISION_H_
+#define _PROVISION_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+
+/* Tries submitted credentials on the station interface while the
+ * provisioning AP keeps running, and stores them only once the network
+ * gave an address, so a wrong key costs a retry instead of a restart.
+ * The AP follows the station to the channel of the tested network and
+ * clients usually lose it for a moment, the page keeps asking for the
+ * outcome. After a success the AP stays up PROVISION_AP_LINGER_MS for the
+ * browser to read it, then the board goes on as a station. */
+#define PROVISION_TIMEOUT_MS    15000
+#define PROVISION_ATTEMPTS      3
+#define PROVISION_AP_LINGER_MS  10000
+
+typedef enum {
+    PROVISION_IDLE,
+    PROVISION_TESTING,
+    PROVISION_CONNECTED,
+    PROVISION_FAILED,
+} provision_state_t;
+
+typedef struct {
+    provision_state_t state;
+    char ssid[33];
+    const char *error;          /* why it failed */
+    esp_ip4_addr_t ip;          /* given by the network */
+    uint32_t elapsed_ms;        /* of the test, up to now while it runs */
+} provision_status_t;
+
+/* Posted on the default event loop as the test goes, with a
+ * provision_event_data_t; provision_get_status() has the rest */
+ESP_EVENT_DECLARE_BASE(PROVISION_EVENT);
+
+typedef enum {
+    PROVISION_EVENT_ATTEMPT,        /* associating */
+    PROVISION_EVENT_ASSOCIATED,     /* asking DHCP for an address */
+    PROVISION_EVENT_ATTEMPT_FAILED, /* another attempt follows */
+    PROVISION_EVENT_CONNECTED,
+    PROVISION_EVENT_FAILED,
+} provision_event_t;
+
+typedef struct {
+    int attempt;                /* from 1 */
+    uint8_t reason;             /* wifi_err_reason_t of a failed attempt */
+} provision_event_data_t;
+
+/* Registers for the Wi-Fi events, after esp_wifi_init() */
+esp_err_t provision_init(void);
+
+/* Starts a test. ESP_ERR_NOT_SUPPORTED outside AP+STA mode (the board is
+ * provisioned already), ESP_ERR_INVALID_STATE while a test runs or after
+ * one succeeded. */
+esp_err_t provision_start(const char *ssid, const char *password);
+
+void provision_get_status(provision_status_t *status);
+
+/* Waits for the end of the running test, for the form without script */
+provision_state_t provision_wait(uint32_t timeout_ms);
+
+const char *provision_state_name(provision_state_t state);
+
+#endif
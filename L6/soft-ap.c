@@ -12,6 +12,9 @@
 #include "freertos/event_groups.h"
 
 #include "soft-ap.h"
+#include "captive-portal.h"
+#include "provision.h"
+#include "../common/boot-prof.h"
 
 #define WIFI_SOFT_AP_STARTED_BIT BIT0
 
@@ -32,6 +35,8 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                  MAC2STR(event->mac), event->aid);
     } else if (event_id == WIFI_EVENT_AP_START) {
         ESP_LOGI(TAG, "Event: SoftAP started");
+        /* The AP link is up, there is no address to wait for */
+        boot_prof_mark(BOOT_PHASE_WIFI_CONNECTED);
         xEventGroupSetBits(s_wifi_event_group, WIFI_SOFT_AP_STARTED_BIT);
     }
 }
@@ -45,6 +50,10 @@ void wifi_init_softap(bool netif_init)
     }
     
     esp_netif_create_default_wifi_ap();
+    /* The scanner runs on the station interface next to the AP */
+    if (esp_netif_get_handle_from_ifkey("WIFI_STA_DEF") == NULL) {
+        esp_netif_create_default_wifi_sta();
+    }
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
@@ -54,6 +63,11 @@ void wifi_init_softap(bool netif_init)
                                                         &wifi_event_handler,
                                                         NULL,
                                                         NULL));
+    /* Credentials from the page are tried on the station next to the AP */
+    ESP_ERROR_CHECK(provision_init());
+
+    /* Answers DNS and redirects the probes of the clients to the page */
+    ESP_ERROR_CHECK(captive_portal_init());
 
     wifi_config_t wifi_config = {
         .ap = {
@@ -69,9 +83,10 @@ void wifi_init_softap(bool netif_init)
         wifi_config.ap.authmode = WIFI_AUTH_OPEN;
     }
 
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_AP));
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_APSTA));
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_AP, &wifi_config));
     ESP_ERROR_CHECK(esp_wifi_start());
+    boot_prof_mark(BOOT_PHASE_WIFI_STARTED);
     esp_wifi_set_ps(WIFI_PS_NONE);
 
     ESP_LOGI(TAG, "wifi_init_softap finished. SSID:%s password:%s channel:%d",
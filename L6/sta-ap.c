@@ -2,9 +2,14 @@
 
 #include "esp_wifi.h"
 #include "esp_event.h"
+#include "esp_mac.h"
 #include "config.h"
 #include <string.h>
 #include "esp_log.h"
+#include "ping/ping_sock.h"
+#include "lwip/ip_addr.h"
+#include "net-config.h"
+#include "../common/boot-prof.h"
 
 /* FreeRTOS event group to signal when we are connected*/
 static EventGroupHandle_t s_wifi_event_group;
@@ -17,19 +22,175 @@ static EventGroupHandle_t s_wifi_event_group;
 
 static const char *TAG = "wifi station";
 
+/* A cached lease is only used once the gateway answers a ping on it */
+#define GW_CHECK_COUNT 3
+#define GW_CHECK_INTERVAL_MS 200
+#define GW_CHECK_TIMEOUT_MS 500
+
 static int s_retry_num = 0;
 
+static esp_netif_t *s_netif;
+static net_config_t s_config;
+/* Associating to the cached AP, and starting with a known address */
+static bool s_fast;
+static bool s_fast_ip;
+static ip_event_got_ip_t s_got_ip;
+
 char ssid[33];
-char password[64];
+char password[65];
+
+void sta_set_config(const net_config_t *config)
+{
+	s_config = *config;
+	strlcpy(ssid, config->ssid, sizeof(ssid));
+	strlcpy(password, config->password, sizeof(password));
+}
+
+static void use_known_ip(void)
+{
+	esp_netif_ip_info_t ip_info = {
+			.ip.addr = s_config.ip,
+			.netmask.addr = s_config.netmask,
+			.gw.addr = s_config.gw,
+	};
+	esp_netif_dhcpc_stop(s_netif);
+	esp_netif_set_ip_info(s_netif, &ip_info);
+
+	esp_netif_dns_info_t dns = {0};
+	dns.ip.type = ESP_IPADDR_TYPE_V4;
+	dns.ip.u_addr.ip4.addr = s_config.dns;
+	esp_netif_set_dns_info(s_netif, ESP_NETIF_DNS_MAIN, &dns);
+}
+
+/* The cached AP did not take us: forget it, scan for the network and ask DHCP */
+static void fall_back_to_scan(void)
+{
+	ESP_LOGI(TAG, "cached AP failed, scanning");
+	s_fast = false;
+	s_config.flags &= ~(NET_CONFIG_FLAG_AP_CACHED | NET_CONFIG_FLAG_LEASE_CACHED);
+	net_config_save(&s_config);
+
+	wifi_config_t wifi_config;
+	esp_wifi_get_config(WIFI_IF_STA, &wifi_config);
+	wifi_config.sta.bssid_set = false;
+	wifi_config.sta.channel = 0;
+	esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+
+	if (s_fast_ip && !(s_config.flags & NET_CONFIG_FLAG_STATIC_IP))
+	{
+		s_fast_ip = false;
+		esp_netif_dhcpc_start(s_netif);
+	}
+}
+
+/* Keeps what this connection found for the next boot */
+static void update_config(const ip_event_got_ip_t *event)
+{
+	bool changed = false;
+
+	wifi_ap_record_t ap;
+	if (!s_fast && esp_wifi_sta_get_ap_info(&ap) == ESP_OK)
+	{
+		memcpy(s_config.bssid, ap.bssid, sizeof(s_config.bssid));
+		s_config.channel = ap.primary;
+		s_config.flags |= NET_CONFIG_FLAG_AP_CACHED;
+		changed = true;
+	}
 
-void sta_set_ssid(const char *new_ssid)
+	if (s_config.flags & NET_CONFIG_FLAG_STATIC_IP)
+	{
+		// nothing to renew
+	}
+	else if (s_fast_ip)
+	{
+		s_config.lease_boots--;
+		changed = true;
+	}
+	else
+	{
+		s_config.ip = event->ip_info.ip.addr;
+		s_config.netmask = event->ip_info.netmask.addr;
+		s_config.gw = event->ip_info.gw.addr;
+		esp_netif_dns_info_t dns;
+		if (esp_netif_get_dns_info(s_netif, ESP_NETIF_DNS_MAIN, &dns) == ESP_OK && dns.ip.type == ESP_IPADDR_TYPE_V4)
+		{
+			s_config.dns = dns.ip.u_addr.ip4.addr;
+		}
+		else
+		{
+			s_config.dns = s_config.gw;
+		}
+		s_config.flags |= NET_CONFIG_FLAG_LEASE_CACHED;
+		s_config.lease_boots = NET_CONFIG_LEASE_BOOTS;
+		changed = true;
+	}
+
+	if (changed)
+	{
+		net_config_save(&s_config);
+	}
+}
+
+static void set_connected(void)
 {
-	strcpy(ssid, new_ssid);
+	update_config(&s_got_ip);
+	xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
 }
 
-void sta_set_password(const char *pass)
+/* The network moved on since the lease was cached (another subnet, or
+ * the address handed to someone else): forget it and ask DHCP */
+static void drop_cached_lease(void)
 {
-	strcpy(password, pass);
+	ESP_LOGW(TAG, "gateway " IPSTR " does not answer, asking DHCP", IP2STR(&s_got_ip.ip_info.gw));
+	s_fast_ip = false;
+	s_config.flags &= ~NET_CONFIG_FLAG_LEASE_CACHED;
+	net_config_save(&s_config);
+	esp_netif_dhcpc_start(s_netif);
+}
+
+static void gw_check_success(esp_ping_handle_t hdl, void *args)
+{
+	// The first answer is enough
+	if (!(xEventGroupGetBits(s_wifi_event_group) & WIFI_CONNECTED_BIT))
+	{
+		set_connected();
+	}
+}
+
+static void gw_check_end(esp_ping_handle_t hdl, void *args)
+{
+	uint32_t received = 0;
+	esp_ping_get_profile(hdl, ESP_PING_PROF_REPLY, &received, sizeof(received));
+	esp_ping_delete_session(hdl);
+	if (received == 0)
+	{
+		drop_cached_lease();
+	}
+}
+
+static void check_gateway(void)
+{
+	esp_ping_config_t config = ESP_PING_DEFAULT_CONFIG();
+	ip_addr_set_ip4_u32(&config.target_addr, s_got_ip.ip_info.gw.addr);
+	config.count = GW_CHECK_COUNT;
+	config.interval_ms = GW_CHECK_INTERVAL_MS;
+	config.timeout_ms = GW_CHECK_TIMEOUT_MS;
+	config.interface = esp_netif_get_netif_impl_index(s_netif);
+
+	esp_ping_callbacks_t callbacks = {
+			.on_ping_success = gw_check_success,
+			.on_ping_end = gw_check_end,
+	};
+	esp_ping_handle_t ping;
+	if (esp_ping_new_session(&config, &callbacks, &ping) != ESP_OK)
+	{
+		drop_cached_lease();
+	}
+	else if (esp_ping_start(ping) != ESP_OK)
+	{
+		esp_ping_delete_session(ping);
+		drop_cached_lease();
+	}
 }
 
 static void event_handler(void *arg, esp_event_base_t event_base,
@@ -39,9 +200,18 @@ static void event_handler(void *arg, esp_event_base_t event_base,
 	{
 		esp_wifi_connect();
 	}
+	else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED)
+	{
+		boot_prof_mark(BOOT_PHASE_WIFI_CONNECTED);
+	}
 	else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED)
 	{
-		if (s_retry_num < CONFIG_ESP_MAXIMUM_RETRY)
+		if (s_fast && !(xEventGroupGetBits(s_wifi_event_group) & WIFI_CONNECTED_BIT))
+		{
+			fall_back_to_scan();
+			esp_wifi_connect();
+		}
+		else if (s_retry_num < CONFIG_ESP_MAXIMUM_RETRY)
 		{
 			esp_wifi_connect();
 			s_retry_num++;
@@ -58,13 +228,27 @@ static void event_handler(void *arg, esp_event_base_t event_base,
 		ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
 		ESP_LOGI(TAG, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
 		s_retry_num = 0;
-		xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+		boot_prof_mark(BOOT_PHASE_GOT_IP);
+		if (xEventGroupGetBits(s_wifi_event_group) & WIFI_CONNECTED_BIT)
+		{
+			// a renewal, nothing new to keep
+		}
+		else if (s_fast_ip && !(s_config.flags & NET_CONFIG_FLAG_STATIC_IP))
+		{
+			// The cached lease may be stale, connected once the gateway answers
+			s_got_ip = *event;
+			check_gateway();
+		}
+		else
+		{
+			s_got_ip = *event;
+			set_connected();
+		}
 	}
 }
 
 void wifi_init_sta(void)
 {
-	vTaskDelay(1000 / portTICK_PERIOD_MS);
 	s_wifi_event_group = xEventGroupCreate();
 
 	if (strlen(ssid) == 0)
@@ -73,12 +257,6 @@ void wifi_init_sta(void)
 		return;
 	}
 
-	if (strlen(password) == 0)
-	{
-		ESP_LOGE(TAG, "Password not set");
-		return;
-	}
-
 	ESP_ERROR_CHECK(esp_netif_init());
 	
   // Deinitialize the existing network interface if it exists
@@ -87,7 +265,7 @@ void wifi_init_sta(void)
 		esp_netif_destroy(netif);
   }
 
-	esp_netif_create_default_wifi_sta();
+	s_netif = esp_netif_create_default_wifi_sta();
 
 	wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
 	ESP_ERROR_CHECK(esp_wifi_init(&cfg));
@@ -114,10 +292,32 @@ void wifi_init_sta(void)
 
 	strncpy((char *)wifi_config.sta.ssid, ssid, sizeof(wifi_config.sta.ssid) - 1);
   strncpy((char *)wifi_config.sta.password, password, sizeof(wifi_config.sta.password) - 1);
+	// An open network has no key, the page accepts one without
+	if (strlen(password) == 0)
+	{
+		wifi_config.sta.threshold.authmode = WIFI_AUTH_OPEN;
+	}
+
+	// Go straight to the AP of the last connection, on its channel and with its lease
+	s_fast = s_config.flags & NET_CONFIG_FLAG_AP_CACHED;
+	if (s_fast)
+	{
+		memcpy(wifi_config.sta.bssid, s_config.bssid, sizeof(s_config.bssid));
+		wifi_config.sta.bssid_set = true;
+		wifi_config.sta.channel = s_config.channel;
+		ESP_LOGI(TAG, "trying cached AP " MACSTR " on channel %u", MAC2STR(s_config.bssid), s_config.channel);
+	}
+	s_fast_ip = (s_config.flags & NET_CONFIG_FLAG_STATIC_IP) ||
+							((s_config.flags & NET_CONFIG_FLAG_LEASE_CACHED) && s_config.lease_boots > 0);
+	if (s_fast_ip)
+	{
+		use_known_ip();
+	}
 
 	ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
 	ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
 	ESP_ERROR_CHECK(esp_wifi_start());
+	boot_prof_mark(BOOT_PHASE_WIFI_STARTED);
 
 	ESP_LOGI(TAG, "wifi_init_sta finished.");
 
@@ -135,6 +335,9 @@ void wifi_init_sta(void)
 	{
 		ESP_LOGI(TAG, "connected to ap SSID:%s password:%s",
 						 ssid, password);
+		ESP_LOGI(TAG, "got ip through %s and %s", s_fast ? "the cached AP" : "a scan",
+						 s_fast_ip ? "a known address" : "DHCP");
+		boot_prof_report();
 	}
 	else if (bits & WIFI_FAIL_BIT)
 	{
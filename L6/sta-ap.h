@@ -1,8 +1,10 @@
 #ifndef _STA_AP_H_
 #define _STA_AP_H_
 
-void sta_set_ssid(const char *new_ssid);
-void sta_set_password(const char *pass);
+#include "net-config.h"
+
+/* Credentials, and the AP and address known from a previous connection */
+void sta_set_config(const net_config_t *config);
 
 void wifi_init_sta(void);
 
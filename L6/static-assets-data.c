@@ -0,0 +1,155 @@
+/* Generated by tools/gen-assets.py from www/, do not edit */
+#include "static-assets.h"
+
+/* app.js: 4706 bytes, 1616 gzipped */
+static const uint8_t asset_app_js[] = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xb5, 0x58, 0x6d, 0x6f, 0xdb, 0x36,
+    0x10, 0xfe, 0x9e, 0x5f, 0x71, 0xfd, 0x52, 0xd9, 0xa8, 0x2b, 0xbb, 0xeb, 0xf6, 0xc5, 0x81, 0x37,
+    0x74, 0x99, 0x8b, 0xb5, 0x68, 0xe3, 0xa0, 0x0e, 0xd6, 0x01, 0xc3, 0x10, 0x30, 0x12, 0x6d, 0xb3,
+    0x91, 0x49, 0x81, 0xa4, 0xe3, 0x19, 0xad, 0xff, 0xfb, 0xee, 0xf8, 0x22, 0x51, 0xa9, 0xed, 0xac,
+    0x40, 0x57, 0x20, 0x88, 0x42, 0x1e, 0x8f, 0xf7, 0xf2, 0xdc, 0x73, 0xc7, 0x0e, 0x87, 0x70, 0xbd,
+    0xe2, 0x50, 0xb3, 0x25, 0x07, 0x61, 0xc0, 0xe2, 0xb7, 0x61, 0x6b, 0x0e, 0x0b, 0xa5, 0x81, 0xdf,
+    0x73, 0xbd, 0x53, 0x92, 0x03, 0x93, 0x25, 0x14, 0xac, 0x58, 0xf1, 0x72, 0xe0, 0x24, 0x24, 0xb7,
+    0x5b, 0xa5, 0xef, 0x0c, 0x14, 0x8a, 0x44, 0xb5, 0x5a, 0xd3, 0xf2, 0xd9, 0x70, 0x08, 0xa6, 0x60,
+    0x52, 0x72, 0x9d, 0x3b, 0xa5, 0xb7, 0x8a, 0xe9, 0x12, 0xea, 0x8d, 0x59, 0x71, 0x03, 0x0c, 0x4f,
+    0x6d, 0xa1, 0x12, 0xc6, 0x3a, 0x75, 0xa4, 0xa6, 0xd6, 0xea, 0x5e, 0x18, 0xa1, 0xa4, 0x90, 0x4b,
+    0xfa, 0x63, 0xa9, 0xb9, 0x31, 0xa0, 0xf0, 0x56, 0x60, 0xa4, 0xec, 0x23, 0xbf, 0x9d, 0xab, 0xe2,
+    0x8e, 0xe3, 0x09, 0x67, 0xd9, 0x0e, 0x56, 0xac, 0xae, 0xb9, 0x3c, 0x87, 0xed, 0x4a, 0x54, 0x68,
+    0xaf, 0x25, 0x93, 0xa5, 0xb2, 0xa0, 0x70, 0xd5, 0xa9, 0x74, 0xfa, 0x71, 0x91, 0x99, 0x3b, 0x5e,
+    0x92, 0x13, 0xa4, 0x87, 0x2d, 0x99, 0x90, 0xde, 0x72, 0x26, 0xcd, 0x16, 0xd5, 0x93, 0x04, 0xbc,
+    0x1c, 0xfd, 0x08, 0x1b, 0x69, 0x45, 0x45, 0x8a, 0x8a, 0x15, 0x93, 0x4b, 0x6e, 0xf2, 0xb3, 0x7b,
+    0xa6, 0xe1, 0xc3, 0xf4, 0xf5, 0x87, 0xe9, 0xfc, 0xf7, 0x9b, 0xf7, 0x73, 0x98, 0xc0, 0x4f, 0xa3,
+    0xd1, 0xe8, 0x3c, 0x2c, 0x5f, 0xcc, 0x2e, 0x2f, 0xa7, 0x17, 0xd7, 0x7e, 0xe3, 0x87, 0x66, 0xc3,
+    0xac, 0xd4, 0x56, 0xe2, 0x8a, 0xdc, 0x54, 0x55, 0x58, 0xf1, 0x76, 0xa7, 0x4b, 0x9a, 0x2f, 0xd0,
+    0xbf, 0xd5, 0xb5, 0x58, 0xa3, 0x01, 0x71, 0xe3, 0x6c, 0xb1, 0x91, 0x85, 0xc5, 0x10, 0x38, 0x1d,
+    0x97, 0x21, 0xae, 0x3d, 0x63, 0x44, 0x69, 0xfa, 0xf0, 0xf9, 0x0c, 0x80, 0x8e, 0xde, 0xa1, 0xeb,
+    0x13, 0x78, 0x3b, 0x9f, 0x5d, 0xe6, 0xc6, 0x6a, 0x8c, 0x96, 0x58, 0xec, 0x82, 0xcc, 0x39, 0x8a,
+    0x88, 0x05, 0xf4, 0x9c, 0xc8, 0x64, 0xe2, 0x4d, 0xf1, 0x27, 0x01, 0xaf, 0xb4, 0x1b, 0x2d, 0x49,
+    0x64, 0x8f, 0x3f, 0xd1, 0x4a, 0x14, 0xc5, 0x8b, 0xbd, 0x66, 0xc3, 0x2b, 0x5e, 0x90, 0x9d, 0xa5,
+    0x2a, 0x36, 0x6b, 0x2e, 0x6d, 0xbe, 0xe4, 0x76, 0x5a, 0x71, 0xfa, 0xfc, 0x75, 0xf7, 0xa6, 0xec,
+    0x65, 0x74, 0x4d, 0xe6, 0xae, 0x69, 0xe5, 0x31, 0xb4, 0x93, 0xf0, 0x99, 0xdf, 0xb3, 0x6a, 0xc3,
+    0x69, 0x3b, 0xfc, 0x6d, 0xf9, 0x3f, 0xf6, 0x42, 0x49, 0x8b, 0x0a, 0x50, 0x28, 0xcb, 0xdc, 0x16,
+    0x99, 0x9a, 0x63, 0x36, 0xa6, 0x08, 0xa2, 0x5e, 0xe3, 0xb2, 0x73, 0x21, 0xda, 0x4a, 0xda, 0x55,
+    0xed, 0xd6, 0x13, 0x6b, 0x0a, 0xcd, 0x99, 0xe5, 0xc1, 0xa0, 0x5e, 0xe6, 0x05, 0xbc, 0x39, 0x10,
+    0xc4, 0xbd, 0x05, 0x64, 0x10, 0x6a, 0xeb, 0x6c, 0x74, 0x4d, 0xf9, 0x6a, 0x3b, 0xf5, 0x05, 0xf7,
+    0x7c, 0xf8, 0xc2, 0x9a, 0x17, 0x0c, 0x2e, 0x39, 0xd0, 0x95, 0x17, 0x88, 0xb9, 0xb2, 0xe7, 0xcf,
+    0x3a, 0x03, 0xf6, 0x4d, 0xf0, 0xbd, 0x7f, 0x15, 0x97, 0x4b, 0xbb, 0x72, 0x6a, 0x46, 0xa9, 0x57,
+    0x92, 0x4a, 0xe8, 0xbf, 0xfa, 0x44, 0xc2, 0x0f, 0x63, 0x38, 0xa7, 0xa2, 0xc2, 0xac, 0xe7, 0x79,
+    0x9e, 0x25, 0x52, 0xa5, 0x30, 0xec, 0xb6, 0x72, 0xf6, 0x5b, 0xed, 0x73, 0x70, 0xd0, 0x64, 0x12,
+    0xf6, 0x06, 0x9f, 0xed, 0x13, 0xc0, 0x05, 0x3c, 0xf6, 0xbc, 0xa9, 0x07, 0xd1, 0x19, 0xbc, 0xf3,
+    0x58, 0x7e, 0x32, 0xf1, 0xcb, 0xf0, 0xf4, 0x69, 0x80, 0x77, 0x8e, 0x8e, 0x94, 0xbb, 0xb9, 0x45,
+    0x6f, 0x9c, 0xd7, 0x4d, 0xbd, 0xe6, 0xb3, 0xab, 0xe9, 0xe5, 0x61, 0x10, 0x2e, 0xb8, 0x45, 0x08,
+    0x64, 0x43, 0x56, 0x8b, 0x61, 0xa4, 0x91, 0x6c, 0x00, 0x9f, 0x3d, 0xbf, 0x8c, 0x21, 0x93, 0xea,
+    0xb9, 0xfb, 0xcc, 0x30, 0xbe, 0xee, 0x7c, 0x8e, 0x75, 0x2b, 0x13, 0xd0, 0xa0, 0x99, 0xb5, 0x92,
+    0x86, 0xa3, 0xfe, 0xa0, 0x1b, 0xe2, 0x52, 0xfe, 0xc9, 0x28, 0xd9, 0xeb, 0x9f, 0x77, 0x8f, 0xa6,
+    0x95, 0x15, 0xd6, 0x0b, 0x66, 0x3b, 0x40, 0x44, 0x5d, 0x47, 0x6e, 0xf3, 0xb7, 0x74, 0x62, 0x63,
+    0xb8, 0xa5, 0x4f, 0xb5, 0xb1, 0xbd, 0xb0, 0x33, 0x48, 0x18, 0xc3, 0xdd, 0x7e, 0x4e, 0x91, 0x46,
+    0xe6, 0xb9, 0xc6, 0xbc, 0x80, 0x92, 0x05, 0x77, 0xe4, 0x63, 0xb9, 0x27, 0x27, 0x62, 0xb8, 0x6e,
+    0xe1, 0x5f, 0x25, 0x4c, 0x48, 0x0e, 0x6e, 0x2a, 0xdb, 0x56, 0xbf, 0xc1, 0x00, 0x6f, 0xcc, 0xc9,
+    0x1a, 0x75, 0x12, 0x59, 0x83, 0x47, 0xaf, 0x21, 0x37, 0x4d, 0x66, 0xb2, 0x42, 0x21, 0x2d, 0x13,
+    0xb0, 0xb3, 0x98, 0x16, 0x7f, 0xe6, 0x21, 0xd4, 0xde, 0x2a, 0x21, 0x11, 0x51, 0x19, 0x3c, 0x83,
+    0xa8, 0x84, 0x4a, 0xe3, 0x19, 0xae, 0x6c, 0x05, 0x82, 0x9b, 0x95, 0xa5, 0x23, 0xe9, 0x44, 0x40,
+    0xd4, 0xf0, 0xcc, 0x69, 0x04, 0xc8, 0x3c, 0xc9, 0x7a, 0xde, 0xc7, 0x0b, 0x76, 0xe8, 0x2b, 0xf1,
+    0x32, 0xb3, 0xb1, 0x65, 0x44, 0x00, 0x87, 0xc4, 0x45, 0xdc, 0xee, 0x8f, 0x1a, 0xbe, 0x60, 0xc8,
+    0xf4, 0x8f, 0x59, 0x7d, 0xa1, 0x36, 0x55, 0xe9, 0x1a, 0xc1, 0x27, 0xb4, 0xff, 0x90, 0xf5, 0xe3,
+    0x74, 0x91, 0x6b, 0x8d, 0xdd, 0x0d, 0x57, 0xb1, 0x4d, 0xe9, 0x9d, 0x6f, 0x0f, 0xdf, 0x62, 0x18,
+    0x55, 0x42, 0x46, 0xc9, 0xc4, 0x6c, 0x65, 0x5d, 0x98, 0xc3, 0x82, 0x55, 0xa6, 0x39, 0xe9, 0xb3,
+    0xc7, 0x6b, 0xb4, 0xd1, 0x0b, 0x31, 0x6b, 0xf9, 0xba, 0xb6, 0x63, 0x1f, 0x68, 0x6a, 0x7b, 0x07,
+    0x6c, 0x1d, 0x44, 0xb1, 0x74, 0x33, 0x2e, 0x91, 0xd5, 0x48, 0x03, 0x83, 0x54, 0xdd, 0x8d, 0x0f,
+    0x12, 0x6a, 0x7d, 0x75, 0xf2, 0x20, 0x78, 0x39, 0x4c, 0x92, 0xde, 0xd1, 0xdd, 0xde, 0xf1, 0x56,
+    0x9b, 0xc1, 0xb2, 0x16, 0xe8, 0x60, 0x39, 0x3e, 0x05, 0x84, 0x01, 0x6c, 0x99, 0x20, 0xd7, 0xdd,
+    0x8c, 0xc0, 0x64, 0xc4, 0x44, 0x54, 0xb4, 0xff, 0x2b, 0x86, 0xf9, 0x1e, 0xd3, 0xf3, 0xb7, 0xe3,
+    0xff, 0x43, 0x59, 0x73, 0x81, 0xf9, 0xf2, 0xe5, 0x64, 0x28, 0x50, 0xa7, 0x5b, 0x7e, 0xcf, 0xec,
+    0x2a, 0xd7, 0x6a, 0x23, 0xcb, 0x98, 0x09, 0x5e, 0xb1, 0xda, 0xf0, 0xf2, 0x66, 0x6d, 0x60, 0x08,
+    0x2f, 0xb0, 0x13, 0xf7, 0x9d, 0x87, 0xc6, 0xa5, 0xb1, 0x9b, 0x8b, 0x94, 0xf4, 0x42, 0x1d, 0x04,
+    0xd2, 0xa3, 0xcc, 0x3e, 0xe9, 0x65, 0x0d, 0x6f, 0x65, 0x80, 0xe8, 0xd9, 0x0a, 0x59, 0xaa, 0x6d,
+    0xff, 0x48, 0x0f, 0x6d, 0xfa, 0x3a, 0x0e, 0x33, 0xcd, 0xb9, 0x5e, 0xb6, 0x35, 0xe3, 0xe1, 0x90,
+    0x2c, 0xad, 0x14, 0x72, 0x0b, 0x75, 0x97, 0x95, 0x32, 0x2e, 0xe8, 0xc3, 0x6d, 0x28, 0xcc, 0xc0,
+    0x99, 0x4a, 0xae, 0x31, 0x58, 0x34, 0x6e, 0x4d, 0xa0, 0xa5, 0x19, 0x17, 0xab, 0xb4, 0x69, 0xb4,
+    0x42, 0xae, 0xed, 0xd7, 0x4c, 0x1b, 0xee, 0xa5, 0xf2, 0x92, 0x59, 0x16, 0xba, 0x05, 0x39, 0x10,
+    0x24, 0x73, 0xbb, 0xab, 0x43, 0xcd, 0x34, 0xbc, 0x1a, 0x15, 0x42, 0x77, 0xba, 0x88, 0x27, 0xda,
+    0x09, 0x02, 0x9d, 0x03, 0x8e, 0xc1, 0x3a, 0xa2, 0x30, 0x1d, 0xd4, 0x32, 0xe2, 0xff, 0x46, 0xc6,
+    0x59, 0xe4, 0x0b, 0x22, 0x90, 0x10, 0xa5, 0xb4, 0xb9, 0xa0, 0x2d, 0x17, 0x51, 0x56, 0x3c, 0xeb,
+    0x77, 0x0d, 0xea, 0xb0, 0x5e, 0x38, 0x13, 0xcd, 0xa1, 0x78, 0xd3, 0xe7, 0xd0, 0xcf, 0xa7, 0xaf,
+    0xae, 0xe2, 0x84, 0xe6, 0x7e, 0x4b, 0x5e, 0x85, 0x19, 0x90, 0x45, 0x66, 0x71, 0xd3, 0xab, 0x16,
+    0x71, 0x44, 0x0d, 0x89, 0xa2, 0x01, 0xd5, 0xc0, 0x2d, 0x2b, 0xee, 0xbc, 0x2e, 0x1a, 0x3d, 0x85,
+    0x35, 0xb0, 0x10, 0x1a, 0xd3, 0x13, 0xee, 0xc4, 0x83, 0xbc, 0x22, 0x85, 0x5c, 0x13, 0x51, 0xa3,
+    0x35, 0x86, 0x20, 0x2b, 0xcb, 0x34, 0x6b, 0x45, 0xa5, 0x4c, 0x37, 0x67, 0x0d, 0x27, 0x75, 0x67,
+    0xbd, 0x98, 0x97, 0x6e, 0xd7, 0x08, 0xcd, 0xb3, 0x0d, 0x40, 0xd3, 0x7e, 0x5b, 0x87, 0x21, 0x6d,
+    0x2d, 0x01, 0xa9, 0x83, 0xce, 0xd4, 0xe9, 0xdb, 0xb8, 0x83, 0x74, 0x83, 0xe4, 0xf3, 0xb3, 0x44,
+    0x15, 0x35, 0x9d, 0x99, 0xac, 0x76, 0x8e, 0xad, 0x51, 0x4d, 0x12, 0x0b, 0x37, 0x84, 0x5e, 0x7d,
+    0x98, 0xfd, 0xf1, 0x66, 0xfe, 0x66, 0x76, 0x79, 0x73, 0x35, 0x7b, 0xf7, 0xce, 0xcf, 0xb1, 0x2f,
+    0x9a, 0x39, 0xb6, 0xbb, 0x3b, 0xbf, 0x79, 0xff, 0xea, 0x4f, 0xdc, 0x7f, 0x39, 0x4a, 0xe7, 0x54,
+    0x2a, 0xfe, 0xd7, 0x4a, 0x77, 0x72, 0x57, 0xab, 0xaa, 0x32, 0x6d, 0x49, 0xfd, 0x6f, 0x03, 0x43,
+    0x07, 0x87, 0x0f, 0x86, 0x06, 0x63, 0x95, 0xfe, 0xce, 0x43, 0x43, 0xea, 0xe3, 0xf1, 0xc1, 0xa1,
+    0xcb, 0x36, 0xc7, 0x0c, 0x28, 0x69, 0x08, 0x6b, 0x92, 0x4f, 0x51, 0xea, 0xae, 0xa4, 0x6e, 0xb7,
+    0x78, 0xf0, 0x92, 0x2e, 0xbc, 0xf0, 0xf3, 0xe4, 0x50, 0x7e, 0x52, 0x0d, 0x8f, 0xce, 0x07, 0x5d,
+    0x06, 0x6e, 0xce, 0x61, 0xe3, 0x6e, 0x9f, 0x6b, 0xa5, 0xf0, 0x9d, 0xd4, 0xbf, 0x94, 0x06, 0x68,
+    0x56, 0x40, 0x1a, 0x58, 0xe5, 0x4a, 0x27, 0xd6, 0x1b, 0x95, 0x92, 0xe6, 0x95, 0x62, 0x65, 0xec,
+    0x9d, 0xc7, 0xbd, 0x48, 0x70, 0xdd, 0x8d, 0xdd, 0x51, 0x34, 0x21, 0x75, 0xbe, 0xa0, 0x9c, 0x0c,
+    0xbe, 0x86, 0x6c, 0xac, 0x98, 0x66, 0xca, 0xfa, 0x98, 0x62, 0xbd, 0xd0, 0xa2, 0xf6, 0x9f, 0xd8,
+    0x9e, 0xd6, 0x58, 0xc7, 0x02, 0x11, 0x58, 0x23, 0x19, 0x1b, 0x72, 0x60, 0xe8, 0xdb, 0x87, 0xc9,
+    0x57, 0x76, 0x5d, 0x9d, 0x1d, 0x0d, 0x18, 0x8d, 0x11, 0x18, 0x2e, 0xec, 0x6c, 0x53, 0x22, 0xb8,
+    0x77, 0xf8, 0xaa, 0xe4, 0xf8, 0xac, 0xc5, 0x48, 0x6e, 0x6e, 0xd7, 0xc2, 0x22, 0xf6, 0x0e, 0x52,
+    0xb7, 0xe7, 0xe7, 0x5a, 0xbb, 0xdf, 0xbf, 0xf1, 0x05, 0xc3, 0xab, 0x7a, 0xed, 0xdb, 0xe9, 0x9b,
+    0xe6, 0xb8, 0xc3, 0x93, 0xce, 0x1c, 0xa7, 0xfa, 0xe4, 0x25, 0x90, 0x16, 0x07, 0x3e, 0x2b, 0x4a,
+    0x94, 0x12, 0x08, 0x43, 0xaa, 0x0d, 0x17, 0xa3, 0x35, 0xc7, 0xc8, 0x50, 0x3b, 0xbf, 0x9a, 0xcd,
+    0xaf, 0x43, 0x9b, 0x5f, 0x61, 0x0d, 0x72, 0x6d, 0xc6, 0x18, 0xfd, 0x2c, 0x68, 0x7e, 0x7e, 0x8d,
+    0x54, 0x4f, 0x33, 0x12, 0x3e, 0x1b, 0x2a, 0xe1, 0x1b, 0xd8, 0x90, 0xca, 0x02, 0xeb, 0xc9, 0x1f,
+    0xba, 0x55, 0xe5, 0x6e, 0xfc, 0xf0, 0x05, 0xda, 0x70, 0x39, 0xf6, 0x91, 0xf1, 0x63, 0x2f, 0x48,
+    0xff, 0x4c, 0x1b, 0x84, 0x23, 0x35, 0x0e, 0x1b, 0x88, 0xa2, 0x53, 0xc7, 0x04, 0xc9, 0x74, 0xcf,
+    0xed, 0xfb, 0x6e, 0xc0, 0xf8, 0x4e, 0x25, 0xde, 0x39, 0xda, 0x4c, 0xdc, 0x2d, 0x7d, 0x3f, 0x1c,
+    0x45, 0x1f, 0x4e, 0x7c, 0xa7, 0xa7, 0xe8, 0xce, 0x7b, 0x8d, 0xfe, 0x1d, 0x82, 0xfa, 0xa8, 0xdf,
+    0x54, 0x8a, 0xef, 0xbf, 0x8f, 0x68, 0x8e, 0x46, 0xb1, 0x7b, 0x9c, 0xcd, 0x7e, 0x41, 0x38, 0xd0,
+    0x47, 0x3a, 0x74, 0xa3, 0x80, 0x65, 0x1a, 0xb1, 0x4e, 0xd5, 0x49, 0x28, 0x36, 0xe9, 0x7f, 0xd8,
+    0xe4, 0x19, 0x8c, 0x3b, 0x43, 0x70, 0xb7, 0x4e, 0xf7, 0x27, 0x48, 0xee, 0xb0, 0xa3, 0xc7, 0x68,
+    0x03, 0xfd, 0xf6, 0xf5, 0x89, 0x3f, 0xff, 0x02, 0xfb, 0xd0, 0x62, 0x16, 0x62, 0x12, 0x00, 0x00,
+};
+
+/* index.html: 648 bytes, 395 gzipped */
+static const uint8_t asset_index_html[] = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x65, 0x52, 0xb1, 0x8e, 0xdb, 0x30,
+    0x0c, 0xdd, 0xf3, 0x15, 0xaa, 0xe6, 0x8b, 0x8d, 0xf6, 0x96, 0xe2, 0x60, 0x7b, 0x69, 0x6f, 0x6d,
+    0x03, 0xa4, 0x4b, 0xa7, 0x83, 0x2c, 0x31, 0x67, 0x5e, 0x64, 0x49, 0x10, 0xe9, 0x04, 0xfe, 0xfb,
+    0x52, 0x96, 0x53, 0x14, 0xe8, 0x44, 0x88, 0x7c, 0x8f, 0xef, 0x3d, 0xda, 0xdd, 0xa7, 0xef, 0x3f,
+    0xbf, 0xfd, 0xfa, 0x7d, 0x7a, 0x55, 0x13, 0xcf, 0x7e, 0x38, 0x74, 0x8f, 0x02, 0xc6, 0x49, 0x99,
+    0x81, 0x8d, 0xb2, 0x93, 0xc9, 0x04, 0xdc, 0xeb, 0x85, 0x2f, 0xc7, 0xaf, 0xfa, 0xd1, 0x0e, 0x66,
+    0x86, 0x5e, 0xdf, 0x10, 0xee, 0x29, 0x66, 0xd6, 0xca, 0xc6, 0xc0, 0x10, 0x04, 0x76, 0x47, 0xc7,
+    0x53, 0xef, 0xe0, 0x86, 0x16, 0x8e, 0xdb, 0xe3, 0x49, 0x61, 0x40, 0x46, 0xe3, 0x8f, 0x64, 0x8d,
+    0x87, 0xfe, 0x73, 0x59, 0xc2, 0xc8, 0x1e, 0x86, 0xd7, 0xf3, 0xe9, 0xf9, 0x8b, 0x3a, 0xe5, 0x78,
+    0x43, 0xc2, 0x18, 0x30, 0xbc, 0x77, 0x6d, 0x9d, 0x1c, 0x3a, 0x8f, 0xe1, 0xaa, 0x32, 0xf8, 0x5e,
+    0x13, 0xaf, 0x1e, 0x68, 0x02, 0x10, 0x9d, 0x29, 0xc3, 0xa5, 0xd7, 0xed, 0xd6, 0x6a, 0x2c, 0x51,
+    0xd9, 0x45, 0x36, 0x63, 0x62, 0x45, 0xd9, 0xca, 0xc4, 0xa4, 0xd4, 0x7c, 0x90, 0x56, 0x0e, 0x2e,
+    0x90, 0x87, 0xae, 0xad, 0x43, 0x41, 0xb5, 0x7b, 0xaa, 0x31, 0xba, 0x55, 0xca, 0x25, 0xe6, 0x59,
+    0xa1, 0xeb, 0xf5, 0x47, 0xc4, 0xa0, 0x95, 0xb1, 0x2c, 0x06, 0x84, 0x9f, 0x81, 0x16, 0xcf, 0xd4,
+    0x94, 0x53, 0x68, 0xc5, 0x26, 0xbf, 0x97, 0xf0, 0x6f, 0xa3, 0x37, 0xe1, 0xaa, 0x95, 0x64, 0x9f,
+    0xa2, 0x90, 0x52, 0x24, 0x2e, 0xd2, 0xde, 0x8c, 0xe0, 0x95, 0xec, 0x12, 0x97, 0x84, 0x4e, 0x0f,
+    0x3f, 0x80, 0xef, 0x31, 0x5f, 0x49, 0x7a, 0x4b, 0x70, 0x2f, 0x5d, 0xbb, 0x21, 0x8a, 0x6c, 0x2e,
+    0x4e, 0xc1, 0x83, 0xe5, 0x4d, 0x76, 0x83, 0xef, 0x67, 0xac, 0xd4, 0x43, 0x17, 0x53, 0x31, 0xa1,
+    0x6e, 0xc6, 0x2f, 0xd2, 0x95, 0x0c, 0x48, 0x66, 0xf4, 0xe0, 0x54, 0xe5, 0x81, 0x1b, 0xce, 0xd6,
+    0x84, 0x72, 0xa6, 0xa6, 0x69, 0xba, 0xb6, 0xc2, 0x4b, 0xb4, 0x3a, 0x7f, 0xa8, 0xfc, 0x63, 0x0a,
+    0x93, 0x29, 0x37, 0x3a, 0x83, 0x5d, 0x32, 0xf2, 0xaa, 0xae, 0xb0, 0xfe, 0xf5, 0x54, 0xc1, 0x18,
+    0xd2, 0xc2, 0x8a, 0xd7, 0x24, 0x8a, 0x05, 0x2c, 0xee, 0xc5, 0x57, 0x71, 0x58, 0xb9, 0xbb, 0xc5,
+    0x7d, 0xd1, 0xff, 0x1c, 0x5a, 0xc6, 0x19, 0xe5, 0xc3, 0xec, 0xa6, 0xcf, 0xf5, 0x59, 0x4c, 0x95,
+    0x0b, 0x4b, 0x4d, 0x35, 0x2e, 0x1b, 0x5e, 0xca, 0x82, 0x36, 0x95, 0xd9, 0xfe, 0x11, 0xda, 0xfa,
+    0xc3, 0xfd, 0x01, 0xf5, 0x41, 0xde, 0x9b, 0x88, 0x02, 0x00, 0x00,
+};
+
+/* style.css: 112 bytes, 111 gzipped */
+static const uint8_t asset_style_css[] = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x35, 0x8b, 0x4b, 0x0e, 0x40, 0x30,
+    0x10, 0x86, 0xf7, 0x3d, 0xc5, 0x7f, 0x00, 0x15, 0x8f, 0xc4, 0xa2, 0x4e, 0x53, 0x4c, 0x99, 0x44,
+    0x87, 0x68, 0x45, 0x44, 0xdc, 0xdd, 0x2b, 0xb6, 0xdf, 0xa3, 0x99, 0xba, 0x1d, 0x87, 0x02, 0xdc,
+    0x24, 0x51, 0x3b, 0xeb, 0x79, 0xdc, 0x0d, 0x82, 0x95, 0xa0, 0x03, 0x2d, 0xec, 0xea, 0x5b, 0x79,
+    0xbb, 0xf4, 0x2c, 0x06, 0x05, 0xf9, 0x5a, 0x9d, 0x4a, 0x05, 0x1a, 0xa9, 0x8d, 0x09, 0x58, 0xe6,
+    0x35, 0xbe, 0xf3, 0x5f, 0x64, 0x69, 0x49, 0x1e, 0x19, 0xf2, 0xa7, 0xbc, 0x31, 0x8b, 0xde, 0xb8,
+    0x8b, 0x83, 0x41, 0x5e, 0x7d, 0xf3, 0x05, 0x2f, 0x49, 0x2c, 0x99, 0x70, 0x00, 0x00, 0x00,
+};
+
+const static_asset_t static_assets[] = {
+    {"/app.js", "application/javascript", asset_app_js, sizeof(asset_app_js), "\"2d3ac176903c6d8f\""},
+    {"/index.html", "text/html", asset_index_html, sizeof(asset_index_html), "\"3f70952c7a84ca99\""},
+    {"/style.css", "text/css", asset_style_css, sizeof(asset_style_css), "\"c8f94a899e3e47c5\""},
+};
+
+const size_t static_assets_count = sizeof(static_assets) / sizeof(static_assets[0]);
@@ -0,0 +1,85 @@
+#include "static-assets.h"
+
+#include <string.h>
+#include "esp_log.h"
+
+/* Longest header value looked at, a longer one counts as absent */
+#define STATIC_ASSETS_HDR_LEN 128
+
+static const char *TAG = "static_assets";
+
+const static_asset_t *static_assets_find(const char *uri)
+{
+    for (size_t i = 0; i < static_assets_count; i++) {
+        if (strcmp(static_assets[i].uri, uri) == 0) {
+            return &static_assets[i];
+        }
+    }
+    return NULL;
+}
+
+static bool header_contains(httpd_req_t *req, const char *field, const char *value)
+{
+    char buffer[STATIC_ASSETS_HDR_LEN];
+    size_t len = httpd_req_get_hdr_value_len(req, field);
+    if (len == 0 || len >= sizeof(buffer)) {
+        return false;
+    }
+    if (httpd_req_get_hdr_value_str(req, field, buffer, sizeof(buffer)) != ESP_OK) {
+        return false;
+    }
+    return strstr(buffer, value) != NULL;
+}
+
+bool static_assets_accepts_gzip(httpd_req_t *req)
+{
+    return header_contains(req, "Accept-Encoding", "gzip");
+}
+
+bool static_assets_etag_matches(httpd_req_t *req, const char *etag)
+{
+    return header_contains(req, "If-None-Match", etag);
+}
+
+esp_err_t static_assets_send(httpd_req_t *req, const static_asset_t *asset)
+{
+    httpd_resp_set_hdr(req, "ETag", asset->etag);
+    // no-cache still lets the browser keep it, it only has to ask first
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    if (static_assets_etag_matches(req, asset->etag)) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    httpd_resp_set_type(req, asset->type);
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+    return httpd_resp_send(req, (const char *)asset->data, asset->len);
+}
+
+// Every browser accepts gzip, the page is the only asset with another way
+static esp_err_t asset_handler(httpd_req_t *req)
+{
+    return static_assets_send(req, req->user_ctx);
+}
+
+esp_err_t static_assets_register(httpd_handle_t server)
+{
+    for (size_t i = 0; i < static_assets_count; i++) {
+        httpd_uri_t uri = {
+            .uri = static_assets[i].uri,
+            .method = HTTP_GET,
+            .handler = asset_handler,
+            .user_ctx = (void *)&static_assets[i],
+        };
+        esp_err_t err = httpd_register_uri_handler(server, &uri);
+        if (err == ESP_ERR_HTTPD_HANDLER_EXISTS) {
+            continue;
+        }
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Registering %s failed: %s", uri.uri, esp_err_to_name(err));
+            return err;
+        }
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,38 @@
+#ifndef _STATIC_ASSETS_H_
+#define _STATIC_ASSETS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_http_server.h"
+
+/* The files of www/, embedded gzip compressed by tools/gen-assets.py.
+ * Every response carries the ETag and asks the browser to check it
+ * again, so a file the browser already has costs a 304 without a body. */
+typedef struct {
+    const char *uri;
+    const char *type;
+    const uint8_t *data;        /* gzip */
+    size_t len;
+    const char *etag;           /* quoted, as sent */
+} static_asset_t;
+
+/* static-assets-data.c */
+extern const static_asset_t static_assets[];
+extern const size_t static_assets_count;
+
+/* NULL if no asset has this URI */
+const static_asset_t *static_assets_find(const char *uri);
+
+bool static_assets_accepts_gzip(httpd_req_t *req);
+
+/* True if If-None-Match names etag, for dynamic responses with their own */
+bool static_assets_etag_matches(httpd_req_t *req, const char *etag);
+
+/* 304 if the request names the current ETag, else the gzip body */
+esp_err_t static_assets_send(httpd_req_t *req, const static_asset_t *asset);
+
+/* A GET handler for every asset, URIs registered before keep theirs */
+esp_err_t static_assets_register(httpd_handle_t server);
+
+#endif
@@ -0,0 +1,82 @@
+"""Embed the files of www/ in the firmware, gzip compressed.
+
+Writes static-assets-data.c with one static_asset_t per file, served at
+/<file name>. The ETag is the start of the SHA-256 of the uncompressed
+file, so it only changes when the content does. Run it from L6 after
+editing www/ and commit the generated file with the change:
+
+    python3 tools/gen-assets.py
+"""
+import gzip
+import hashlib
+import os
+import sys
+
+DIR_ASSETS = 'www'
+FILENAME_OUTPUT = 'static-assets-data.c'
+# Hex digits of the hash kept in the ETag
+ETAG_LEN = 16
+
+CONTENT_TYPES = {
+    '.html': 'text/html',
+    '.css': 'text/css',
+    '.js': 'application/javascript',
+    '.json': 'application/json',
+    '.svg': 'image/svg+xml',
+    '.ico': 'image/x-icon',
+}
+
+
+def c_identifier(name):
+    return 'asset_' + ''.join(c if c.isalnum() else '_' for c in name)
+
+
+def c_bytes(data):
+    lines = []
+    for i in range(0, len(data), 16):
+        lines.append('    ' + ' '.join('0x{:02x},'.format(b) for b in data[i:i + 16]))
+    return '\n'.join(lines)
+
+
+def main():
+    names = sorted(os.listdir(DIR_ASSETS))
+    out = [
+        '/* Generated by tools/gen-assets.py from www/, do not edit */',
+        '#include "static-assets.h"',
+        '',
+    ]
+    table = []
+    total_raw = total_gz = 0
+    for name in names:
+        ext = os.path.splitext(name)[1]
+        if ext not in CONTENT_TYPES:
+            print('skipping {}: unknown content type'.format(name), file=sys.stderr)
+            continue
+        with open(os.path.join(DIR_ASSETS, name), 'rb') as f:
+            raw = f.read()
+        # mtime 0 so the same input always gives the same bytes
+        data = gzip.compress(raw, compresslevel=9, mtime=0)
+        etag = hashlib.sha256(raw).hexdigest()[:ETAG_LEN]
+        ident = c_identifier(name)
+        out.append('/* {}: {} bytes, {} gzipped */'.format(name, len(raw), len(data)))
+        out.append('static const uint8_t {}[] = {{'.format(ident))
+        out.append(c_bytes(data))
+        out.append('};')
+        out.append('')
+        table.append('    {{"/{}", "{}", {}, sizeof({}), "\\"{}\\""}},'.format(
+            name, CONTENT_TYPES[ext], ident, ident, etag))
+        total_raw += len(raw)
+        total_gz += len(data)
+
+    out.append('const static_asset_t static_assets[] = {')
+    out.extend(table)
+    out.append('};')
+    out.append('')
+    out.append('const size_t static_assets_count = sizeof(static_assets) / sizeof(static_assets[0]);')
+    with open(FILENAME_OUTPUT, 'w') as f:
+        f.write('\n'.join(out) + '\n')
+    print('{}: {} assets, {} bytes, {} gzipped'.format(FILENAME_OUTPUT, len(table), total_raw, total_gz))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,121 @@
+"""Make the NVS partition of each board for factory flashing.
+
+Reads a list of boards, one per line, and writes for each one the
+net_config_t record of net-config.h in the CSV that ESP-IDF's
+nvs_partition_gen.py takes. With IDF_PATH set it also runs that tool,
+so <name>.bin can be flashed at the offset of the nvs partition:
+
+    python3 tools/gen-nvs.py boards.csv out/
+    esptool.py write_flash 0x9000 out/board-01.bin
+
+The boards file has a header line and these columns, the last ones may
+be left empty (a fixed address needs ip, netmask and gw):
+
+    name,ssid,password,ip,netmask,gw,dns
+    board-01,Lab,correct horse,192.168.1.50,255.255.255.0,192.168.1.1,
+"""
+import csv
+import ipaddress
+import os
+import struct
+import subprocess
+import sys
+import zlib
+
+# Must match net-config.h
+NET_CONFIG_VERSION = 1
+NET_CONFIG_NAMESPACE = 'storage'
+NET_CONFIG_KEY = 'net_config'
+NET_CONFIG_FLAG_STATIC_IP = 0x04
+NET_CONFIG_SIZE = 128
+# version, flags, channel, lease_boots, ssid, password, bssid, ip, netmask, gw, dns
+RECORD_FORMAT = '<BBBB33s65s6s4s4s4s4s'
+
+# Size of the nvs partition in the default partition table
+PARTITION_SIZE = '0x6000'
+
+
+def address(text, field):
+    try:
+        return ipaddress.IPv4Address(text).packed
+    except ValueError:
+        raise ValueError('{} is not an IPv4 address: {!r}'.format(field, text))
+
+
+def record(board):
+    ssid = board['ssid'].encode('utf-8')
+    password = board['password'].encode('utf-8')
+    # the checks of check_credentials() in http-server.c
+    if not 0 < len(ssid) <= 32:
+        raise ValueError('SSID must have 1 to 32 bytes')
+    if len(password) > 64 or 0 < len(password) < 8:
+        raise ValueError('Security key must have 8 to 64 characters')
+
+    flags = 0
+    ip = netmask = gw = dns = bytes(4)
+    if board.get('ip'):
+        ip = address(board['ip'], 'ip')
+        netmask = address(board.get('netmask', ''), 'netmask')
+        gw = address(board.get('gw', ''), 'gw')
+        dns = address(board['dns'], 'dns') if board.get('dns') else gw
+        flags |= NET_CONFIG_FLAG_STATIC_IP
+
+    body = struct.pack(RECORD_FORMAT, NET_CONFIG_VERSION, flags, 0, 0, ssid, password, bytes(6),
+                       ip, netmask, gw, dns)
+    # zlib's CRC-32 is esp_rom_crc32_le() started from 0
+    data = body + struct.pack('<I', zlib.crc32(body))
+    assert len(data) == NET_CONFIG_SIZE
+    return data
+
+
+def nvs_csv(data):
+    return '\n'.join([
+        'key,type,encoding,value',
+        '{},namespace,,'.format(NET_CONFIG_NAMESPACE),
+        '{},data,hex2bin,{}'.format(NET_CONFIG_KEY, data.hex()),
+    ]) + '\n'
+
+
+def nvs_partition_gen():
+    idf_path = os.environ.get('IDF_PATH')
+    if not idf_path:
+        return None
+    tool = os.path.join(idf_path, 'components', 'nvs_flash', 'nvs_partition_generator', 'nvs_partition_gen.py')
+    return tool if os.path.exists(tool) else None
+
+
+def main():
+    if len(sys.argv) != 3:
+        print('usage: gen-nvs.py <boards.csv> <output dir>', file=sys.stderr)
+        sys.exit(2)
+    filename_boards, dir_output = sys.argv[1:]
+    os.makedirs(dir_output, exist_ok=True)
+    tool = nvs_partition_gen()
+    if tool is None:
+        print('IDF_PATH not set, writing the CSV files only', file=sys.stderr)
+
+    failed = 0
+    with open(filename_boards, newline='') as f:
+        for line, board in enumerate(csv.DictReader(f), start=2):
+            name = board.get('name') or 'line-{}'.format(line)
+            try:
+                data = record(board)
+            except (ValueError, KeyError) as e:
+                print('{}: {}'.format(name, e), file=sys.stderr)
+                failed += 1
+                continue
+            filename_csv = os.path.join(dir_output, name + '.csv')
+            with open(filename_csv, 'w') as out:
+                out.write(nvs_csv(data))
+            if tool is not None:
+                filename_bin = os.path.join(dir_output, name + '.bin')
+                subprocess.run([sys.executable, tool, 'generate', filename_csv, filename_bin, PARTITION_SIZE],
+                               check=True, stdout=subprocess.DEVNULL)
+                print('{}: {}'.format(name, filename_bin))
+            else:
+                print('{}: {}'.format(name, filename_csv))
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == '__main__':
+    main()
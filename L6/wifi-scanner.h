@@ -0,0 +1,60 @@
+#ifndef _WIFI_SCANNER_H_
+#define _WIFI_SCANNER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_event.h"
+#include "config.h"
+
+/* Scans in the background, one channel per step, so the radio leaves the
+ * channel of our AP only for a short dwell at a time and nothing waits
+ * for a whole scan. Each network is kept once, under its strongest AP,
+ * and dropped after it was not heard for WIFI_SCANNER_EXPIRE_SWEEPS
+ * passes over all channels. Hidden networks and APs too weak to join
+ * are left out. In STA mode scans wait while the station connects. */
+#define WIFI_SCANNER_MAX_APS        CONFIG_EXAMPLE_SCAN_LIST_SIZE
+/* Networks tracked, the snapshot shows the strongest of them */
+#define WIFI_SCANNER_TABLE_SIZE     32
+/* APs read per channel */
+#define WIFI_SCANNER_RECORDS_MAX    16
+#define WIFI_SCANNER_CHANNELS       13
+#define WIFI_SCANNER_DWELL_MS       120
+/* Pause between two channels; the first pass after boot has none */
+#define WIFI_SCANNER_STEP_MS        2000
+#define WIFI_SCANNER_EXPIRE_SWEEPS  2
+#define WIFI_SCANNER_MIN_RSSI       -90
+
+typedef struct {
+    uint32_t version;           /* changes whenever the list does */
+    int64_t updated_us;
+    size_t count;
+    /* strongest first, 33 bytes each as send_index_html() takes them */
+    char ssids[WIFI_SCANNER_MAX_APS][33];
+    int8_t rssi[WIFI_SCANNER_MAX_APS];
+    uint8_t channel[WIFI_SCANNER_MAX_APS];
+} wifi_scanner_snapshot_t;
+
+/* Posted on the default event loop when the list changes, with the new
+ * version as uint32_t */
+ESP_EVENT_DECLARE_BASE(WIFI_SCANNER_EVENT);
+
+enum {
+    WIFI_SCANNER_EVENT_UPDATED,
+};
+
+/* Starts the scan task. Call it after esp_event_loop_create_default() and
+ * before the Wi-Fi starts, in AP+STA or STA mode. */
+esp_err_t wifi_scanner_start(void);
+
+/* Copies the current list, never waits on the radio */
+void wifi_scanner_get(wifi_scanner_snapshot_t *snapshot);
+
+uint32_t wifi_scanner_version(void);
+
+/* Keeps the radio on one channel, e.g. while the station is tested on a
+ * network; the list stays as it was */
+void wifi_scanner_pause(bool pause);
+
+#endif
@@ -0,0 +1,230 @@
+#include "ws-progress.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_event.h"
+#include "esp_log.h"
+#include "index_html.h"
+#include "provision.h"
+#include "wifi-scanner.h"
+
+static const char *TAG = "ws_progress";
+
+#if CONFIG_HTTPD_WS_SUPPORT
+
+/* Touched on the server task only */
+static int s_clients[WS_PROGRESS_CLIENTS_MAX];
+static size_t s_client_count;
+
+static httpd_handle_t s_server;
+
+typedef struct {
+    int fd;                     /* one client, or -1 for all of them */
+    size_t len;
+    char text[];
+} ws_message_t;
+
+static const char *event_names[] = {
+    [PROVISION_EVENT_ATTEMPT] = "attempt",
+    [PROVISION_EVENT_ASSOCIATED] = "associated",
+    [PROVISION_EVENT_ATTEMPT_FAILED] = "attempt_failed",
+    [PROVISION_EVENT_CONNECTED] = "connected",
+    [PROVISION_EVENT_FAILED] = "failed",
+};
+
+static void client_remove(size_t i)
+{
+    s_clients[i] = s_clients[--s_client_count];
+}
+
+static void send_work(void *arg)
+{
+    ws_message_t *message = arg;
+    httpd_ws_frame_t frame = {
+        .final = true,
+        .type = HTTPD_WS_TYPE_TEXT,
+        .payload = (uint8_t *)message->text,
+        .len = message->len,
+    };
+
+    for (size_t i = 0; i < s_client_count;) {
+        int fd = s_clients[i];
+        // a closed socket may already be reused by a plain HTTP client
+        if (httpd_ws_get_fd_info(s_server, fd) != HTTPD_WS_CLIENT_WEBSOCKET) {
+            client_remove(i);
+            continue;
+        }
+        if ((message->fd < 0 || message->fd == fd) && httpd_ws_send_frame_async(s_server, fd, &frame) != ESP_OK) {
+            ESP_LOGD(TAG, "Dropping client %d", fd);
+            httpd_sess_trigger_close(s_server, fd);
+            client_remove(i);
+            continue;
+        }
+        i++;
+    }
+    free(message);
+}
+
+/* Takes text over and sends it to fd, or to every client when fd < 0 */
+static void queue_message(int fd, ws_message_t *message)
+{
+    if (message == NULL) {
+        return;
+    }
+    message->fd = fd;
+    if (httpd_queue_work(s_server, send_work, message) != ESP_OK) {
+        free(message);
+    }
+}
+
+static ws_message_t *networks_message(void)
+{
+    wifi_scanner_snapshot_t *scan = malloc(sizeof(*scan));
+    if (scan == NULL) {
+        return NULL;
+    }
+    wifi_scanner_get(scan);
+
+    // every SSID escaped at its longest, with its quotes and comma
+    size_t size = 64 + scan->count * (32 * 6 + 3);
+    ws_message_t *message = malloc(sizeof(*message) + size);
+    if (message != NULL) {
+        char *text = message->text;
+        size_t len = snprintf(text, size, "{\"type\":\"networks\",\"version\":%lu,\"ssids\":[",
+                              (unsigned long)scan->version);
+        for (size_t i = 0; i < scan->count; i++) {
+            if (i > 0) {
+                text[len++] = ',';
+            }
+            text[len++] = '"';
+            len += json_escape(text + len, size - len, scan->ssids[i]);
+            text[len++] = '"';
+        }
+        len += snprintf(text + len, size - len, "]}");
+        message->len = len;
+    }
+    free(scan);
+    return message;
+}
+
+static ws_message_t *provisioning_message(const char *event, int attempt)
+{
+    provision_status_t status;
+    provision_get_status(&status);
+    char ssid[33 * 6];
+    json_escape(ssid, sizeof(ssid), status.ssid);
+
+    size_t size = 384;
+    ws_message_t *message = malloc(sizeof(*message) + size);
+    if (message == NULL) {
+        return NULL;
+    }
+    char *text = message->text;
+    size_t len = snprintf(text, size, "{\"type\":\"provisioning\",\"event\":\"%s\",\"attempt\":%d,"
+                          "\"state\":\"%s\",\"ssid\":\"%s\",\"elapsed_ms\":%lu",
+                          event, attempt, provision_state_name(status.state), ssid,
+                          (unsigned long)status.elapsed_ms);
+    if (status.state == PROVISION_CONNECTED) {
+        len += snprintf(text + len, size - len, ",\"ip\":\"" IPSTR "\"", IP2STR(&status.ip));
+    } else if (status.state == PROVISION_FAILED && status.error != NULL) {
+        len += snprintf(text + len, size - len, ",\"error\":\"%s\"", status.error);
+    }
+    len += snprintf(text + len, size - len, "}");
+    message->len = len;
+    return message;
+}
+
+static void event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    if (event_base == WIFI_SCANNER_EVENT) {
+        queue_message(-1, networks_message());
+    } else if (event_base == PROVISION_EVENT && event_id >= 0 &&
+               (size_t)event_id < sizeof(event_names) / sizeof(event_names[0])) {
+        const provision_event_data_t *data = event_data;
+        queue_message(-1, provisioning_message(event_names[event_id], data->attempt));
+    }
+}
+
+static esp_err_t ws_handler(httpd_req_t *req)
+{
+    int fd = httpd_req_to_sockfd(req);
+    if (req->method == HTTP_GET) {
+        // Clients that went away without a send noticing still hold a slot
+        bool known = false;
+        for (size_t i = 0; i < s_client_count;) {
+            if (s_clients[i] == fd) {
+                known = true;
+            } else if (httpd_ws_get_fd_info(s_server, s_clients[i]) != HTTPD_WS_CLIENT_WEBSOCKET) {
+                client_remove(i);
+                continue;
+            }
+            i++;
+        }
+        // The handshake is done, the client is told where things stand
+        if (!known) {
+            if (s_client_count == WS_PROGRESS_CLIENTS_MAX) {
+                ESP_LOGW(TAG, "Too many clients");
+                return ESP_FAIL;
+            }
+            s_clients[s_client_count++] = fd;
+        }
+        queue_message(fd, networks_message());
+        queue_message(fd, provisioning_message("status", 0));
+        return ESP_OK;
+    }
+
+    // Nothing is expected from the page, its frames are read and dropped
+    httpd_ws_frame_t frame = {0};
+    esp_err_t err = httpd_ws_recv_frame(req, &frame, 0);
+    if (err != ESP_OK || frame.len == 0) {
+        return err;
+    }
+    uint8_t buf[128];
+    if (frame.len > sizeof(buf)) {
+        return ESP_FAIL;
+    }
+    frame.payload = buf;
+    return httpd_ws_recv_frame(req, &frame, sizeof(buf));
+}
+
+esp_err_t ws_progress_register(httpd_handle_t server)
+{
+    s_server = server;
+    s_client_count = 0;
+
+    static const httpd_uri_t uri_ws = {
+        .uri          = "/ws",
+        .method       = HTTP_GET,
+        .handler      = ws_handler,
+        .user_ctx     = NULL,
+        .is_websocket = true,
+    };
+    esp_err_t err = httpd_register_uri_handler(server, &uri_ws);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // Once, the server may be started again
+    static bool subscribed;
+    if (!subscribed) {
+        err = esp_event_handler_instance_register(WIFI_SCANNER_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL, NULL);
+        if (err == ESP_OK) {
+            err = esp_event_handler_instance_register(PROVISION_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL,
+                                                      NULL);
+        }
+        subscribed = err == ESP_OK;
+    }
+    return err;
+}
+
+#else
+
+esp_err_t ws_progress_register(httpd_handle_t server)
+{
+    ESP_LOGW(TAG, "No WebSocket support, the page polls");
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
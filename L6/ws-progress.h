@@ -0,0 +1,23 @@
+#ifndef _WS_PROGRESS_H_
+#define _WS_PROGRESS_H_
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+/* GET /ws upgrades to a WebSocket that pushes JSON text frames as things
+ * happen, so the page does not poll:
+ *
+ *   {"type":"networks","version":4,"ssids":["Lab","Home"]}
+ *   {"type":"provisioning","event":"associated","attempt":1,"state":"testing","ssid":"Lab",...}
+ *
+ * A new client first gets the current list and provisioning state, which
+ * also covers the clients that lost the AP while it changed channel. The
+ * frames are sent from the server task through httpd_queue_work(), and
+ * the client table is only touched there. Needs CONFIG_HTTPD_WS_SUPPORT
+ * in sdkconfig, without it the page keeps polling. */
+#define WS_PROGRESS_CLIENTS_MAX 4
+
+/* Registers /ws and subscribes to the scanner and provisioning events */
+esp_err_t ws_progress_register(httpd_handle_t server);
+
+#endif
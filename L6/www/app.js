@@ -0,0 +1,147 @@
+// The page is the same for everyone and cached, the networks come from the
+// scanner. The board pushes a new list and the provisioning progress over a
+// WebSocket as they happen; while it is not open the list is asked for
+// again, the answer is a 304 until it changes.
+var REFRESH_MS = 5000;
+var RECONNECT_MS = 2000;
+var shown = null;
+var socket = null;
+var refreshTimer = null;
+
+function showNetworks(ssids) {
+  var key = JSON.stringify(ssids);
+  if (key === shown) {
+    return;
+  }
+  shown = key;
+
+  var select = document.getElementById('ssid');
+  var selected = select.value;
+  select.textContent = '';
+  ssids.forEach(function (ssid) {
+    var option = document.createElement('option');
+    option.value = ssid;
+    option.textContent = ssid;
+    option.selected = ssid === selected;
+    select.appendChild(option);
+  });
+  if (ssids.length === 0) {
+    var none = document.createElement('option');
+    none.textContent = 'Scanning...';
+    none.disabled = true;
+    select.appendChild(none);
+  }
+}
+
+function refresh() {
+  refreshTimer = null;
+  if (socket !== null && socket.readyState === WebSocket.OPEN) {
+    return;
+  }
+  fetch('/api/networks', { cache: 'no-cache' })
+    .then(function (response) { return response.json(); })
+    .then(showNetworks)
+    .catch(function () {})
+    .then(function () { refreshTimer = setTimeout(refresh, REFRESH_MS); });
+}
+
+// True once the test is over
+function showProvisioning(result) {
+  var status = document.getElementById('status');
+  if (result.state === 'connected') {
+    status.textContent = 'Joined ' + result.ssid + ' with address ' + result.ip +
+      ', the board stays on that network.';
+    return true;
+  }
+  if (result.state === 'failed') {
+    status.textContent = 'Could not join ' + result.ssid + ': ' + result.error + '. Try again.';
+    return true;
+  }
+  if (result.state !== 'testing') {
+    return false;
+  }
+  var step = {
+    attempt: 'Joining ' + result.ssid + ', attempt ' + result.attempt + '...',
+    attempt_failed: 'Attempt ' + result.attempt + ' failed, trying again...',
+    associated: 'Joined ' + result.ssid + ', waiting for an address...',
+  }[result.event];
+  status.textContent = step || 'Joining ' + result.ssid + '... ' + Math.round(result.elapsed_ms / 1000) + ' s';
+  return false;
+}
+
+function connect() {
+  if (!('WebSocket' in window)) {
+    return;
+  }
+  socket = new WebSocket('ws://' + location.host + '/ws');
+  socket.onmessage = function (event) {
+    var message = JSON.parse(event.data);
+    if (message.type === 'networks') {
+      showNetworks(message.ssids);
+    } else if (message.type === 'provisioning' && (message.event !== 'status' || message.state !== 'idle')) {
+      showProvisioning(message);
+    }
+  };
+  // The AP changes channel while a network is tried, the socket comes back
+  // and its first messages tell where things stand
+  socket.onclose = function () {
+    socket = null;
+    if (refreshTimer === null) {
+      refresh();
+    }
+    setTimeout(connect, RECONNECT_MS);
+  };
+}
+
+connect();
+refresh();
+
+// Only without the socket
+var PROVISION_POLL_MS = 1000;
+var PROVISION_POLLS_MAX = 30;
+
+function waitForProvisioning(polls) {
+  if (socket !== null && socket.readyState === WebSocket.OPEN) {
+    return;
+  }
+  fetch('/api/provisioning', { cache: 'no-store' })
+    .then(function (response) { return response.json(); })
+    .then(showProvisioning)
+    .catch(function () { return false; })
+    .then(function (done) {
+      if (done) {
+        return;
+      }
+      if (polls >= PROVISION_POLLS_MAX) {
+        document.getElementById('status').textContent =
+          'The board did not answer, reconnect to its network and reload.';
+        return;
+      }
+      setTimeout(function () { waitForProvisioning(polls + 1); }, PROVISION_POLL_MS);
+    });
+}
+
+// Without the script the form still posts to /results.html
+document.getElementById('join').addEventListener('submit', function (event) {
+  event.preventDefault();
+  var status = document.getElementById('status');
+  status.textContent = 'Sending...';
+  fetch('/api/credentials', {
+    method: 'POST',
+    headers: { 'Content-Type': 'application/json' },
+    body: JSON.stringify({
+      ssid: document.getElementById('ssid').value,
+      password: document.getElementById('ipass').value,
+    }),
+  })
+    .then(function (response) { return response.json(); })
+    .then(function (result) {
+      if (result.state === 'testing') {
+        status.textContent = 'Joining...';
+        waitForProvisioning(0);
+      } else {
+        status.textContent = result.saved ? 'Saved, the board restarts and joins the network.' : result.error;
+      }
+    })
+    .catch(function () { status.textContent = 'The board did not answer.'; });
+});
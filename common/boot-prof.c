@@ -0,0 +1,128 @@
+#include "boot-prof.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "soc/rtc.h"
+
+/* Slow clock cycles measured to convert the RTC count, under 1 ms on the
+ * internal 150 kHz clock */
+#define BOOT_PROF_CAL_CYCLES 128
+
+static const char *TAG = "boot_prof";
+
+static const char *phase_names[BOOT_PHASE_MAX] = {
+    "app_main",
+    "nvs ready",
+    "gpio ready",
+    "wifi started",
+    "wifi connected",
+    "got ip",
+    "tasks started",
+    "first packet",
+};
+
+/* The phases are marked from several tasks */
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool s_started;
+/* Time from reset until esp_timer started counting, 0 when unknown */
+static bool s_offset_known;
+static int64_t s_boot_offset_us;
+static int64_t s_marks_us[BOOT_PHASE_MAX];
+
+/* The RTC counts from its own reset, which only a power-on brings. After
+ * esp_restart() or a watchdog it still holds the time of the earlier
+ * boots, so the span before app_main is then unknown. */
+static bool boot_offset(int64_t now, int64_t *offset)
+{
+    if (esp_reset_reason() != ESP_RST_POWERON) {
+        return false;
+    }
+    uint32_t period = rtc_clk_cal(RTC_CAL_RTC_MUX, BOOT_PROF_CAL_CYCLES);
+    if (period == 0) {
+        return false;
+    }
+    *offset = (int64_t)rtc_time_slowclk_to_us(rtc_time_get(), period) - now;
+    return true;
+}
+
+void boot_prof_mark(boot_phase_t phase)
+{
+    if (phase >= BOOT_PHASE_MAX) {
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    bool started = s_started;
+    portEXIT_CRITICAL(&s_lock);
+
+    /* Outside the lock, the calibration takes a while. Two first marks
+     * racing both compute it, the first to take the lock wins. */
+    int64_t offset = 0;
+    bool known = !started && boot_offset(now, &offset);
+
+    bool report = false;
+    portENTER_CRITICAL(&s_lock);
+    if (!s_started) {
+        s_started = true;
+        s_offset_known = known;
+        s_boot_offset_us = offset;
+    }
+    if (!s_marks_us[phase]) {
+        s_marks_us[phase] = s_boot_offset_us + now;
+        report = phase == BOOT_PHASE_FIRST_PACKET;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (report) {
+        boot_prof_report();
+    }
+}
+
+void boot_prof_report(void)
+{
+    int64_t marks[BOOT_PHASE_MAX];
+    portENTER_CRITICAL(&s_lock);
+    bool started = s_started;
+    bool known = s_offset_known;
+    int64_t offset = s_boot_offset_us;
+    memcpy(marks, s_marks_us, sizeof(marks));
+    portEXIT_CRITICAL(&s_lock);
+    if (!started) {
+        return;
+    }
+
+    /* In fast-boot mode the phases overlap, so list them in time order */
+    int order[BOOT_PHASE_MAX];
+    int count = 0;
+    for (int i = 0; i < BOOT_PHASE_MAX; i++) {
+        if (!marks[i]) {
+            continue;
+        }
+        int j = count++;
+        while (j > 0 && marks[order[j - 1]] > marks[i]) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    if (known) {
+        ESP_LOGI(TAG, "%-16s %8.1f ms", "bootloader", offset / 1000.0);
+    } else {
+        ESP_LOGI(TAG, "%-16s  unknown (reset reason %d), times from esp_timer start", "bootloader",
+                 (int)esp_reset_reason());
+    }
+    int64_t previous = offset;
+    for (int i = 0; i < count; i++) {
+        int64_t mark = marks[order[i]];
+        ESP_LOGI(TAG, "%-16s %8.1f ms  (+%.1f ms)", phase_names[order[i]],
+                 mark / 1000.0, (mark - previous) / 1000.0);
+        previous = mark;
+    }
+}
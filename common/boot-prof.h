@@ -0,0 +1,34 @@
+#ifndef _BOOT_PROF_H_
+#define _BOOT_PROF_H_
+
+/* Boot-to-ready instrumentation shared by the apps.
+ *
+ * Every phase is stamped once, in microseconds since reset. The span
+ * before app_main (ROM bootloader, second stage bootloader and the IDF
+ * startup code) comes from the RTC clock, which keeps running through
+ * the bootloaders, so it is only as precise as the RTC slow clock. The
+ * RTC is only reset at power-on: after any other reset that span is
+ * reported as unknown and the phases count from the start of esp_timer.
+ * The marks may come from any task. */
+
+typedef enum {
+    BOOT_PHASE_APP_MAIN = 0,    /* app_main() entered */
+    BOOT_PHASE_NVS_READY,       /* nvs_flash_init() done */
+    BOOT_PHASE_GPIO_READY,      /* pins configured */
+    BOOT_PHASE_WIFI_STARTED,    /* esp_wifi_start() returned */
+    BOOT_PHASE_WIFI_CONNECTED,  /* associated to the AP (or soft AP up) */
+    BOOT_PHASE_GOT_IP,          /* DHCP lease received */
+    BOOT_PHASE_TASKS_STARTED,   /* application tasks created */
+    BOOT_PHASE_FIRST_PACKET,    /* first request/command served */
+    BOOT_PHASE_MAX
+} boot_phase_t;
+
+/* Only the first call for a phase is kept. Marking BOOT_PHASE_FIRST_PACKET
+ * prints the report. */
+void boot_prof_mark(boot_phase_t phase);
+
+/* Logs every phase stamped so far, with the time since reset and since
+ * the previous phase */
+void boot_prof_report(void);
+
+#endif